@@ -52,7 +52,7 @@ then
     echo "Usage build.sh -dhpsvn"
     echo "  -d : Build with debugging enabled"
     echo "  -h : Show this help"
-    echo "  -p : Build with profiling enabled"
+    echo "  -p : Build with profiling counters, frame pointers and debug information"
     echo "  -s : Build with single thread"
     echo "  -v : Build with verbose compiler output"
     echo "  -n : No silencing of deprecated declarations"
@@ -0,0 +1,294 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Implement the CatalogDialog class.
+ */
+
+
+/**
+ * @page catalog_dialog Symbol Catalog Dialog
+ * The symbol catalog dialog gives access to the @ref library_catalog. The upper part of the dialog lists the
+ * directories that are scanned for symbol libraries. Directories can be added and removed, and the catalog is
+ * rescanned in the background when the dialog is opened and when the directories are changed.
+ *
+ * The lower part shows the symbols in the catalog. The symbols shown can be restricted to those in files whose
+ * name contains the filter text, to those identical to the symbol in the editor or to those that look most
+ * like the symbol in the editor. Double clicking a symbol opens the library containing it and places the symbol
+ * in the editor.
+ */
+
+
+#include "CatalogDialog.h"
+
+#include <QDialogButtonBox>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+#include <KLocalizedString>
+
+#include <algorithm>
+
+#include "Editor.h"
+#include "LibraryCatalog.h"
+
+
+/**
+ * Constructor
+ * Create the widgets and connect the signals from them and the catalog.
+ *
+ * @param catalog a pointer to the LibraryCatalog to manage
+ * @param editor a pointer to the Editor containing the symbol used for comparisons
+ * @param parent a pointer to the parent widget
+ */
+CatalogDialog::CatalogDialog(LibraryCatalog *catalog, Editor *editor, QWidget *parent)
+    :   QDialog(parent),
+        m_catalog(catalog),
+        m_editor(editor),
+        m_directories(new QListWidget(this)),
+        m_filter(new QLineEdit(this)),
+        m_results(new QListWidget(this)),
+        m_status(new QLabel(this)),
+        m_progress(new QProgressBar(this))
+{
+    setWindowTitle(i18n("Symbol Catalog"));
+
+    m_directories->addItems(m_catalog->directories());
+    m_directories->setMaximumHeight(100);
+
+    QPushButton *addDirectoryButton = new QPushButton(i18n("Add Directory..."), this);
+    QPushButton *removeDirectoryButton = new QPushButton(i18n("Remove Directory"), this);
+    QPushButton *rescanButton = new QPushButton(i18n("Rescan"), this);
+
+    QVBoxLayout *directoryButtons = new QVBoxLayout;
+    directoryButtons->addWidget(addDirectoryButton);
+    directoryButtons->addWidget(removeDirectoryButton);
+    directoryButtons->addWidget(rescanButton);
+    directoryButtons->addStretch();
+
+    QHBoxLayout *directoryLayout = new QHBoxLayout;
+    directoryLayout->addWidget(m_directories);
+    directoryLayout->addLayout(directoryButtons);
+
+    m_filter->setPlaceholderText(i18n("Filter by file name"));
+    m_filter->setClearButtonEnabled(true);
+
+    QPushButton *identicalButton = new QPushButton(i18n("Identical to Editor Symbol"), this);
+    QPushButton *similarButton = new QPushButton(i18n("Similar to Editor Symbol"), this);
+
+    QHBoxLayout *searchLayout = new QHBoxLayout;
+    searchLayout->addWidget(m_filter);
+    searchLayout->addWidget(identicalButton);
+    searchLayout->addWidget(similarButton);
+
+    m_results->setViewMode(QListView::IconMode);
+    m_results->setResizeMode(QListView::Adjust);
+    m_results->setMovement(QListView::Static);
+    m_results->setUniformItemSizes(true);
+    m_results->setIconSize(QSize(48, 48));
+    m_results->setGridSize(QSize(48, 48));
+
+    m_progress->hide();
+
+    QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Close, this);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(directoryLayout);
+    layout->addLayout(searchLayout);
+    layout->addWidget(m_results, 1);
+    layout->addWidget(m_progress);
+    layout->addWidget(m_status);
+    layout->addWidget(buttonBox);
+
+    resize(640, 480);
+
+    connect(addDirectoryButton, SIGNAL(clicked()), this, SLOT(addDirectory()));
+    connect(removeDirectoryButton, SIGNAL(clicked()), this, SLOT(removeDirectory()));
+    connect(rescanButton, SIGNAL(clicked()), m_catalog, SLOT(rescan()));
+    connect(m_filter, SIGNAL(textChanged(QString)), this, SLOT(filterChanged(QString)));
+    connect(identicalButton, SIGNAL(clicked()), this, SLOT(showIdentical()));
+    connect(similarButton, SIGNAL(clicked()), this, SLOT(showSimilar()));
+    connect(m_results, SIGNAL(itemActivated(QListWidgetItem*)), this, SLOT(itemActivated(QListWidgetItem*)));
+    connect(buttonBox, SIGNAL(rejected()), this, SLOT(reject()));
+    connect(m_catalog, SIGNAL(scanStarted(int)), this, SLOT(scanStarted(int)));
+    connect(m_catalog, SIGNAL(scanProgress(int)), this, SLOT(scanProgress(int)));
+    connect(m_catalog, SIGNAL(scanFinished()), this, SLOT(scanFinished()));
+
+    filterChanged(QString());
+}
+
+
+/**
+ * Set the editor providing the symbol to compare with.
+ * This is called when another editor pane becomes the active one.
+ *
+ * @param editor a pointer to the Editor
+ */
+void CatalogDialog::setEditor(Editor *editor)
+{
+    m_editor = editor;
+}
+
+
+/**
+ * Add a directory to be scanned.
+ * The user is asked to select a directory which is added to the catalog and a rescan started.
+ */
+void CatalogDialog::addDirectory()
+{
+    QString directory = QFileDialog::getExistingDirectory(this, i18n("Add Directory"), QDir::homePath());
+    QStringList directories = m_catalog->directories();
+
+    if (directory.isEmpty() || directories.contains(directory)) {
+        return;
+    }
+
+    directories.append(directory);
+    m_catalog->setDirectories(directories);
+    m_directories->addItem(directory);
+    m_catalog->rescan();
+}
+
+
+/**
+ * Remove the selected directory from those scanned and start a rescan.
+ */
+void CatalogDialog::removeDirectory()
+{
+    QListWidgetItem *item = m_directories->currentItem();
+
+    if (item == nullptr) {
+        return;
+    }
+
+    QStringList directories = m_catalog->directories();
+    directories.removeAll(item->text());
+    m_catalog->setDirectories(directories);
+    delete item;
+    m_catalog->rescan();
+}
+
+
+/**
+ * Show the catalog entries in files whose path contains the text.
+ *
+ * @param text the filter text, an empty string shows all entries
+ */
+void CatalogDialog::filterChanged(const QString &text)
+{
+    showEntries(m_catalog->entries(text));
+}
+
+
+/**
+ * Show the catalog entries that are identical to the symbol in the editor.
+ */
+void CatalogDialog::showIdentical()
+{
+    showEntries(m_catalog->identical(m_editor->flattenedSymbol()));
+}
+
+
+/**
+ * Show the catalog entries that look most like the symbol in the editor.
+ */
+void CatalogDialog::showSimilar()
+{
+    showEntries(m_catalog->similar(m_editor->flattenedSymbol(), similarResults));
+}
+
+
+/**
+ * Called when a scan has started indexing files.
+ *
+ * @param files the number of files being indexed
+ */
+void CatalogDialog::scanStarted(int files)
+{
+    m_progress->setRange(0, files);
+    m_progress->setValue(0);
+    m_progress->show();
+}
+
+
+/**
+ * Called as the files are indexed.
+ *
+ * @param files the number of files indexed so far
+ */
+void CatalogDialog::scanProgress(int files)
+{
+    m_progress->setValue(files);
+}
+
+
+/**
+ * Called when a scan has finished, refresh the results with the updated catalog.
+ */
+void CatalogDialog::scanFinished()
+{
+    m_progress->hide();
+    filterChanged(m_filter->text());
+}
+
+
+/**
+ * Request the library containing the activated symbol to be opened.
+ *
+ * @param item a pointer to the activated QListWidgetItem
+ */
+void CatalogDialog::itemActivated(QListWidgetItem *item)
+{
+    emit openSymbol(item->data(Qt::UserRole).toString(), static_cast<qint16>(item->data(Qt::UserRole + 1).toInt()));
+}
+
+
+/**
+ * Fill the results with icons for the catalog entries.
+ * The number of icons is limited to maximumResults.
+ *
+ * @param entries a const reference to a QList of the CatalogEntry to show
+ */
+void CatalogDialog::showEntries(const QList<CatalogEntry> &entries)
+{
+    m_results->clear();
+
+    QColor color = palette().color(QPalette::WindowText);
+    int total = entries.count();
+    int count = std::min(total, static_cast<int>(maximumResults));
+
+    for (int i = 0 ; i < count ; ++i) {
+        const CatalogEntry &entry = entries.at(i);
+        QImage image = LibraryCatalog::thumbnailImage(entry.thumbnail, color);
+
+        QListWidgetItem *item = new QListWidgetItem(m_results);
+        item->setIcon(QPixmap::fromImage(image.scaled(m_results->iconSize(), Qt::KeepAspectRatio, Qt::SmoothTransformation)));
+        item->setToolTip(i18n("%1\nSymbol %2", QFileInfo(entry.path).fileName(), entry.index));
+        item->setData(Qt::UserRole, entry.path);
+        item->setData(Qt::UserRole + 1, entry.index);
+    }
+
+    if (count < total) {
+        m_status->setText(i18n("Showing %1 of %2 symbols", count, total));
+    } else {
+        m_status->setText(i18np("%1 symbol", "%1 symbols", count));
+    }
+}
+
+#include "moc_CatalogDialog.cpp"
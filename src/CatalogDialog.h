@@ -0,0 +1,86 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Header file for the CatalogDialog class.
+ */
+
+
+#ifndef CatalogDialog_H
+#define CatalogDialog_H
+
+
+#include <QDialog>
+#include <QList>
+
+
+class QLabel;
+class QLineEdit;
+class QListWidget;
+class QListWidgetItem;
+class QProgressBar;
+
+class CatalogEntry;
+class Editor;
+class LibraryCatalog;
+
+
+/**
+ * @brief Dialog to manage and search the LibraryCatalog.
+ *
+ * The dialog shows the directories scanned by the catalog allowing directories to be added and
+ * removed. The symbols in the catalog are shown as icons which can be filtered by file name or
+ * by comparison with the symbol currently in the editor. Activating one of the icons requests
+ * the library containing it to be opened with the symbol in the editor.
+ */
+class CatalogDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    CatalogDialog(LibraryCatalog *catalog, Editor *editor, QWidget *parent);
+    ~CatalogDialog() = default;
+
+    void setEditor(Editor *editor);
+
+signals:
+    void openSymbol(const QString &path, qint16 index);
+
+private slots:
+    void addDirectory();
+    void removeDirectory();
+    void filterChanged(const QString &text);
+    void showIdentical();
+    void showSimilar();
+    void scanStarted(int files);
+    void scanProgress(int files);
+    void scanFinished();
+    void itemActivated(QListWidgetItem *item);
+
+private:
+    void showEntries(const QList<CatalogEntry> &entries);
+
+    static const int maximumResults = 2000; /**< the maximum number of icons shown in the results */
+    static const int similarResults = 100;  /**< the number of icons shown for a similarity search */
+
+    LibraryCatalog  *m_catalog;             /**< pointer to the LibraryCatalog being searched */
+    Editor          *m_editor;              /**< pointer to the Editor providing the symbol to compare with */
+
+    QListWidget     *m_directories;         /**< list of the directories scanned */
+    QLineEdit       *m_filter;              /**< file name filter text */
+    QListWidget     *m_results;             /**< icons of the catalog entries found */
+    QLabel          *m_status;              /**< status of the last search */
+    QProgressBar    *m_progress;            /**< progress of a scan */
+};
+
+
+#endif
@@ -30,12 +30,14 @@
 
 #include "Commands.h"
 
-#include <QIODevice>
+#include <QHash>
 #include <QPainterPath>
-#include <QMimeData>
+#include <QSet>
 
 #include <KLocalizedString>
 
+#include <algorithm>
+
 #include "Editor.h"
 #include "SymbolLibrary.h"
 
@@ -48,10 +50,7 @@ enum IDs {MoveTo,
           MovePoint,
           UpdateSymbol,
           ImportLibrary,
-          RotateLeft,
-          RotateRight,
-          FlipHorizontal,
-          FlipVertical,
+          Transform,
           ChangeFilled,
           ChangeFillRule,
           ChangeCapStyle,
@@ -279,40 +278,57 @@ void MovePointCommand::redo()
  *
  * @param library a pointer to the SymbolLibrary
  * @param index the index of the symbol to be updated
- * @param symbol a const reference to a Symbol representing the updated symbol
+ * @param symbol a const reference to a Symbol representing the updated symbol, if this is the
+ * same as the symbol in the library the command is made obsolete
  */
 UpdateSymbolCommand::UpdateSymbolCommand(SymbolLibrary *library, qint16 index, const Symbol &symbol)
     :   QUndoCommand(i18n("Update Symbol")),
         m_symbolLibrary(library),
         m_index(index),
-        m_symbol(symbol)
+        m_symbol(symbol),
+        m_existed(false)
 {
+    if (m_index && library->symbol(m_index).hash() == m_symbol.hash()) {
+        setObsolete(true);
+    }
 }
 
 
 /**
- * Undo the update symbol command. If the original path was not empty it is restored
- * to the indexed symbol otherwise the indexes symbol is removed from the library.
+ * Undo the update symbol command. If the library had a symbol at the index the original symbol
+ * is restored and removed from the history of the symbol, otherwise the symbol added is removed
+ * from the library. A symbol made only of components has an empty path, so whether the symbol
+ * existed is recorded by redo() rather than taken from the original symbol.
  */
 void UpdateSymbolCommand::undo()
 {
-    if (m_originalSymbol.path().isEmpty()) {
+    if (m_existed) {
+        m_symbolLibrary->removeRevision(m_index);
+        m_symbolLibrary->setSymbol(m_index, m_originalSymbol);
+    } else {
         m_symbolLibrary->takeSymbol(m_index);
         m_index = 0;
-    } else {
-        m_symbolLibrary->setSymbol(m_index, m_originalSymbol);
     }
 }
 
 
 /**
- * Redo the update symbol command. The original Symbol is saved for undo. This may be empty.
- * The new Symbol is set in the library for the given index. If the index is 0 a new index
- * is generated, returned and saved for undo.
+ * Redo the update symbol command. Whether the library has a symbol at the index is recorded for
+ * undo, and if it has the original Symbol is saved for undo and added to the history of the symbol.
+ * The new Symbol is set in the library for the given index. If the index is 0 a new index is
+ * generated, returned and saved for undo.
  */
 void UpdateSymbolCommand::redo()
 {
-    m_originalSymbol = m_symbolLibrary->symbol(m_index);
+    m_existed = m_index && m_symbolLibrary->contains(m_index);
+
+    if (m_existed) {
+        m_originalSymbol = m_symbolLibrary->symbol(m_index);
+        m_symbolLibrary->addRevision(m_index, m_originalSymbol);
+    } else {
+        m_originalSymbol = Symbol();
+    }
+
     m_index = m_symbolLibrary->setSymbol(m_index, m_symbol);
 }
 
@@ -321,141 +337,132 @@ void UpdateSymbolCommand::redo()
  * Constructor
  *
  * @param library a pointer to the SymbolLibrary
- * @param imported a pointer to the imported SymbolLibrary
+ * @param symbols a const reference to a QList of the imported Symbols, these should be flattened as
+ * the indexes of their components are not valid in the current library
+ * @param libraries the number of libraries the symbols were imported from
  */
-ImportLibraryCommand::ImportLibraryCommand(SymbolLibrary *library, SymbolLibrary *imported)
-    :   QUndoCommand(i18n("Import Library")),
+ImportLibraryCommand::ImportLibraryCommand(SymbolLibrary *library, const QList<Symbol> &symbols, int libraries)
+    :   QUndoCommand(i18np("Import Library", "Import %1 Libraries", libraries)),
         m_symbolLibrary(library),
-        m_imported(imported)
-{
-}
-
-
-/**
- * Destructor
- * The imported library is deleted as this class has taken ownership of it.
- */
-ImportLibraryCommand::~ImportLibraryCommand()
+        m_symbols(symbols)
 {
-    delete m_imported;
 }
 
 
 /**
  * Undo the import library command. All symbols that were added are removed
- * from the library. The list of added indexes is cleared.
+ * from the library in a single pass. The list of added indexes is cleared.
  */
 void ImportLibraryCommand::undo()
 {
-    foreach (qint16 i, m_addedIndexes) {
-        m_symbolLibrary->takeSymbol(i);
-    }
-
+    m_symbolLibrary->takeSymbols(m_addedIndexes);
     m_addedIndexes.clear();
 }
 
 
 /**
- * Redo the import library command. Each symbol in the imported library are added to the current
- * library creating new indexes which are added to the m_addedIndexes list for undo.
+ * Redo the import library command. The imported symbols are added to the current library in a
+ * single pass creating new indexes which are stored in the m_addedIndexes list for undo.
  */
 void ImportLibraryCommand::redo()
 {
-    foreach (qint16 i, m_imported->indexes()) {
-        m_addedIndexes.append(m_symbolLibrary->setSymbol(0, m_imported->symbol(i))); // gets a new index
-    }
+    m_addedIndexes = m_symbolLibrary->addSymbols(m_symbols);
 }
 
 
 /**
  * Constructor
  *
+ * @param text the text describing the command
  * @param editor a pointer to the Editor
+ * @param transform a const reference to the QTransform applied by the command
  */
-RotateLeftCommand::RotateLeftCommand(Editor *editor)
-    :   QUndoCommand(i18n("Rotate Left")),
-        m_editor(editor)
+TransformCommand::TransformCommand(const QString &text, Editor *editor, const QTransform &transform)
+    :   QUndoCommand(text),
+        m_editor(editor),
+        m_transform(transform)
 {
 }
 
 
 /**
- * Undo the rotate left command. Call the Editor::rotatePointRight function to reverse
- * the rotate left.
+ * Undo the transform command. Call the Editor::transformPoints function with the inverse transform.
  */
-void RotateLeftCommand::undo()
+void TransformCommand::undo()
 {
-    m_editor->rotatePointsRight();
+    m_editor->transformPoints(m_transform.inverted());
 }
 
 
 /**
- * Redo the rotate left command. Call the Editor::rotatePointsLeft function to rotate the points.
+ * Redo the transform command. Call the Editor::transformPoints function to transform the points.
  */
-void RotateLeftCommand::redo()
+void TransformCommand::redo()
 {
-    m_editor->rotatePointsLeft();
+    m_editor->transformPoints(m_transform);
 }
 
 
 /**
- * Constructor
+ * Get the id related to this command.
+ * All the rotate and flip commands share the same id so that those cancelling each other can be merged.
  *
- * @param editor a pointer to the Editor
+ * @return int representing the value from the IDs enum
  */
-RotateRightCommand::RotateRightCommand(Editor *editor)
-    :   QUndoCommand(i18n("Rotate Right")),
-        m_editor(editor)
+int TransformCommand::id() const
 {
+    return static_cast<int>(Transform);
 }
 
 
 /**
- * Undo the rotate right command. Call the Editor::rotatePointsLeft function to reverse
- * the rotate right.
+ * Merge this command with another TransformCommand.
+ * The commands are only merged when the transform of the other command undoes this one, the
+ * command is then made obsolete and the undo stack removes it. Other transforms are kept as
+ * separate commands.
+ *
+ * @param command a pointer to the additional QUndoCommand
+ *
+ * @return @c true if the merge succeeded, @c false otherwise
  */
-void RotateRightCommand::undo()
+bool TransformCommand::mergeWith(const QUndoCommand *command)
 {
-    m_editor->rotatePointsLeft();
-}
+    if (command->id() != id()) {
+        return false;
+    }
 
+    QTransform transform = m_transform * static_cast<const TransformCommand *>(command)->transform();
 
-/**
- * Redo the rotate right command. Call the Editor::rotatePointsRight function to rotate the points.
- */
-void RotateRightCommand::redo()
-{
-    m_editor->rotatePointsRight();
-}
+    if (!transform.isIdentity()) {
+        return false;
+    }
 
+    m_transform = transform;
+    setObsolete(true);
 
-/**
- * Constructor
- *
- * @param editor a pointer to the Editor
- */
-FlipHorizontalCommand::FlipHorizontalCommand(Editor *editor)
-    :   QUndoCommand(i18n("Flip Horizontal")),
-        m_editor(editor)
-{
+    return true;
 }
 
 
 /**
- * Undo the flip horizontal command. Call the Editor::flipPointsHorizontal to flip the points.
+ * Get the transform applied by the command.
+ *
+ * @return a QTransform
  */
-void FlipHorizontalCommand::undo()
+QTransform TransformCommand::transform() const
 {
-    m_editor->flipPointsHorizontal();
+    return m_transform;
 }
 
 
 /**
- * Redo the flip horizontal command. Call the Editor::flipPointsHorizontal to flip the points.
+ * Constructor
+ *
+ * @param editor a pointer to the Editor
  */
-void FlipHorizontalCommand::redo()
+RotateLeftCommand::RotateLeftCommand(Editor *editor)
+    :   TransformCommand(i18n("Rotate Left"), editor, QTransform(0.0, -1.0, 1.0, 0.0, 0.0, 1.0))
 {
-    m_editor->flipPointsHorizontal();
 }
 
 
@@ -464,28 +471,31 @@ void FlipHorizontalCommand::redo()
  *
  * @param editor a pointer to the Editor
  */
-FlipVerticalCommand::FlipVerticalCommand(Editor *editor)
-    :   QUndoCommand(i18n("Flip Vertical")),
-        m_editor(editor)
+RotateRightCommand::RotateRightCommand(Editor *editor)
+    :   TransformCommand(i18n("Rotate Right"), editor, QTransform(0.0, 1.0, -1.0, 0.0, 1.0, 0.0))
 {
 }
 
 
 /**
- * Undo the flip vertical command. Call the Editor::flipPointsVertical to flip the points.
+ * Constructor
+ *
+ * @param editor a pointer to the Editor
  */
-void FlipVerticalCommand::undo()
+FlipHorizontalCommand::FlipHorizontalCommand(Editor *editor)
+    :   TransformCommand(i18n("Flip Horizontal"), editor, QTransform(-1.0, 0.0, 0.0, 1.0, 1.0, 0.0))
 {
-    m_editor->flipPointsVertical();
 }
 
 
 /**
- * Redo the flip vertical command. Call the Editor::flipPointsVertical to flip the points.
+ * Constructor
+ *
+ * @param editor a pointer to the Editor
  */
-void FlipVerticalCommand::redo()
+FlipVerticalCommand::FlipVerticalCommand(Editor *editor)
+    :   TransformCommand(i18n("Flip Vertical"), editor, QTransform(1.0, 0.0, 0.0, -1.0, 0.0, 1.0))
 {
-    m_editor->flipPointsVertical();
 }
 
 
@@ -692,25 +702,36 @@ void ChangeJoinStyleCommand::redo()
 DeleteSymbolCommand::DeleteSymbolCommand(SymbolLibrary *library, qint16 index)
     :   QUndoCommand(i18n("Delete Symbol")),
         m_symbolLibrary(library),
-        m_index(index)
+        m_index(index),
+        m_following(0)
 {
 }
 
 
 /**
- * Undo deleting the Symbol restoring it from the saved one.
+ * Undo deleting the Symbol restoring it from the saved one. If the library has been reordered
+ * the symbol is moved back before the symbol that followed it.
  */
 void DeleteSymbolCommand::undo()
 {
     m_symbolLibrary->setSymbol(m_index, m_symbol);
+
+    if (m_following) {
+        m_symbolLibrary->moveSymbols(QList<qint16>() << m_index, m_following);
+    }
 }
 
 
 /**
- * Redo deleting the Symbol. Store the removed Symbol for undo.
+ * Redo deleting the Symbol. Store the removed Symbol and the symbol following it in the display
+ * order for undo.
  */
 void DeleteSymbolCommand::redo()
 {
+    QList<qint16> order = m_symbolLibrary->displayOrder();
+    int position = order.indexOf(m_index);
+    m_following = (position != -1 && position + 1 < order.count()) ? order.at(position + 1) : 0;
+
     m_symbol = m_symbolLibrary->takeSymbol(m_index);
 }
 
@@ -847,31 +868,23 @@ bool DecreaseLineWidthCommand::mergeWith(const QUndoCommand *command)
  * Constructor.
  *
  * @param library pointer to the symbol library to add the new symbols to
- * @param mimeData pointer to the QMimeData containing the new symbols
+ * @param symbols a const reference to a QList of the Symbols dropped, as decoded by SymbolMimeData::symbols()
  */
-DragAndDropCommand::DragAndDropCommand(SymbolLibrary *library, const QMimeData *mimeData)
+DragAndDropCommand::DragAndDropCommand(SymbolLibrary *library, const QList<Symbol> &symbols)
     :   QUndoCommand(i18n("Add Symbols")),
-        m_library(library)
+        m_library(library),
+        m_symbols(symbols)
 {
-    QByteArray data = mimeData->data(QStringLiteral("application/kxstitchsymbol"));
-    QDataStream stream(&data, QIODevice::ReadOnly);
-
-    while (!stream.atEnd()) {
-        Symbol symbol;
-        stream >> symbol;
-        m_symbols.append(symbol);
-    }
 }
 
 
 /**
  * Redo the addition of symbols dragged to the list.
+ * The list widget creates the icons of the symbols as they are scrolled into view.
  */
 void DragAndDropCommand::redo()
 {
-    foreach (const Symbol & symbol, m_symbols) {
-        m_indexes.append(m_library->setSymbol(0, symbol));
-    }
+    m_indexes = m_library->addSymbols(m_symbols);
 }
 
 
@@ -880,11 +893,259 @@ void DragAndDropCommand::redo()
  */
 void DragAndDropCommand::undo()
 {
-    foreach (qint16 index, m_indexes) {
-        m_library->takeSymbol(index);
+    m_library->takeSymbols(m_indexes);
+    m_indexes.clear();
+}
+
+
+/**
+ * Constructor.
+ * The symbols to move are put into their current display order.
+ *
+ * @param library pointer to the symbol library
+ * @param indexes a const reference to a QList of the indexes of the symbols to move
+ * @param before the index of the symbol to move them before, 0 to move them to the end
+ */
+MoveSymbolsCommand::MoveSymbolsCommand(SymbolLibrary *library, const QList<qint16> &indexes, qint16 before)
+    :   QUndoCommand(i18np("Move Symbol", "Move %1 Symbols", indexes.count())),
+        m_library(library),
+        m_before(before)
+{
+    QList<qint16> order = library->orderedIndexes();
+    QSet<qint16> moved(indexes.constBegin(), indexes.constEnd());
+
+    foreach (qint16 index, order) {
+        if (moved.contains(index)) {
+            m_indexes.append(index);
+        }
     }
+}
 
-    m_indexes.clear();
+
+/**
+ * Redo moving the symbols. The display order is stored for undo.
+ */
+void MoveSymbolsCommand::redo()
+{
+    m_order = m_library->displayOrder();
+    m_library->moveSymbols(m_indexes, m_before);
+}
+
+
+/**
+ * Undo moving the symbols. The stored display order is restored and the moved symbols are returned
+ * to their positions in it.
+ */
+void MoveSymbolsCommand::undo()
+{
+    m_library->setDisplayOrder(m_order, m_indexes);
+}
+
+
+/**
+ * Constructor.
+ *
+ * @param library pointer to the symbol library
+ * @param merge a const reference to the LibraryMerge of the library with its file
+ * @param keepTheirs true if the conflicts are resolved by keeping the symbols of the file
+ */
+MergeLibraryCommand::MergeLibraryCommand(SymbolLibrary *library, const LibraryMerge &merge, bool keepTheirs)
+    :   QUndoCommand(i18np("Merge One Change", "Merge %1 Changes", merge.changes(keepTheirs))),
+        m_library(library),
+        m_updates(merge.updates(keepTheirs)),
+        m_removals(merge.removals(keepTheirs)),
+        m_additions(merge.additions()),
+        m_additionIndexes(merge.additionIndexes()),
+        m_histories(merge.histories()),
+        m_fileOrder(merge.order())
+{
+}
+
+
+/**
+ * Redo the merge. The symbols replaced, whether they were in the library and their histories are
+ * stored for undo. A symbol taken from the file gets its history from the file, otherwise the
+ * symbol it replaces is added to its history. The symbols removed and the indexes of the symbols
+ * added are stored for undo. The symbols new to the library are then placed in the display order
+ * after the symbol they follow in the file, starting with those that are first in the file.
+ */
+void MergeLibraryCommand::redo()
+{
+    m_replaced.clear();
+    m_existed.clear();
+    m_replacedHistories.clear();
+    m_order = m_library->displayOrder();
+
+    QList<qint16> inserted;
+
+    for (QMap<qint16, Symbol>::const_iterator i = m_updates.constBegin() ; i != m_updates.constEnd() ; ++i) {
+        bool existed = m_library->contains(i.key());
+        Symbol original = existed ? m_library->symbol(i.key()) : Symbol();
+        m_replaced.insert(i.key(), original);
+        m_replacedHistories.insert(i.key(), m_library->history(i.key()));
+
+        if (existed) {
+            m_existed.insert(i.key());
+        } else {
+            inserted.append(i.key());
+        }
+
+        if (existed && !m_histories.contains(i.key())) {
+            m_library->addRevision(i.key(), original);
+        }
+
+        m_library->setSymbol(i.key(), i.value());
+
+        if (m_histories.contains(i.key())) {
+            m_library->setHistory(i.key(), m_histories.value(i.key()));
+        }
+    }
+
+    foreach (qint16 index, m_removals) {
+        m_replaced.insert(index, m_library->takeSymbol(index));
+    }
+
+    m_addedIndexes = m_library->addSymbols(m_additions);
+
+    QHash<qint16, qint16> fileIndexes;                  // map of the file indexes of the additions to their new indexes
+
+    for (int i = 0 ; i < m_addedIndexes.count() ; ++i) {
+        fileIndexes.insert(m_additionIndexes.at(i), m_addedIndexes.at(i));
+        m_library->setHistory(m_addedIndexes.at(i), m_histories.value(m_additionIndexes.at(i)));
+    }
+
+    inserted.append(m_addedIndexes);
+
+    if (inserted.isEmpty()) {
+        return;
+    }
+
+    QList<qint16> current = m_library->orderedIndexes();
+    QSet<qint16> present(current.constBegin(), current.constEnd());
+    QSet<qint16> insertedSet(inserted.constBegin(), inserted.constEnd());
+    QHash<qint16, qint16> following;                    // map of the indexes to the inserted symbol that follows them, 0 for the start
+    qint16 previous = 0;
+
+    foreach (qint16 fileIndex, m_fileOrder) {
+        qint16 index = fileIndexes.value(fileIndex, fileIndex);
+
+        if (insertedSet.contains(index)) {
+            following.insert(previous, index);
+            previous = index;
+        } else if (present.contains(index)) {
+            previous = index;
+        }
+    }
+
+    QList<qint16> order;
+    order.reserve(current.count());
+    QSet<qint16> placed;
+
+    for (qint16 index = 0 ; following.contains(index) ; ) {
+        index = following.value(index);
+        order.append(index);
+        placed.insert(index);
+    }
+
+    foreach (qint16 index, current) {
+        if (insertedSet.contains(index)) {
+            continue;
+        }
+
+        order.append(index);
+
+        while (following.contains(index)) {
+            index = following.value(index);
+            order.append(index);
+            placed.insert(index);
+        }
+    }
+
+    foreach (qint16 index, inserted) {
+        if (!placed.contains(index)) {
+            order.append(index);                        // not in the order of the file, left at the end
+        }
+    }
+
+    QList<qint16> sorted = order;
+    std::sort(sorted.begin(), sorted.end());
+
+    m_library->setDisplayOrder((m_order.isEmpty() && order == sorted) ? QList<qint16>() : order, inserted);
+}
+
+
+/**
+ * Undo the merge. The symbols added are removed with their histories, the symbols updated are
+ * restored or removed if they were not in the library before, with their histories restored, and
+ * the symbols removed are restored. The display order is then restored.
+ */
+void MergeLibraryCommand::undo()
+{
+    m_library->takeSymbols(m_addedIndexes);
+
+    foreach (qint16 index, m_addedIndexes) {
+        m_library->setHistory(index, SymbolHistory());
+    }
+
+    m_addedIndexes.clear();
+
+    for (QMap<qint16, Symbol>::const_iterator i = m_replaced.constBegin() ; i != m_replaced.constEnd() ; ++i) {
+        if (!m_updates.contains(i.key())) {
+            m_library->setSymbol(i.key(), i.value());
+        } else if (m_existed.contains(i.key())) {
+            m_library->setSymbol(i.key(), i.value());
+            m_library->setHistory(i.key(), m_replacedHistories.value(i.key()));
+        } else {
+            m_library->takeSymbol(i.key());
+            m_library->setHistory(i.key(), m_replacedHistories.value(i.key()));
+        }
+    }
+
+    m_library->setDisplayOrder(m_order, m_removals);
+}
+
+
+/**
+ * Constructor
+ *
+ * @param library a pointer to the SymbolLibrary
+ * @param text a const reference to a QString describing the change for the undo stack
+ * @param symbols a const reference to a QMap of the indexes of the symbols to replace and the Symbols to replace them with
+ */
+UpdateSymbolsCommand::UpdateSymbolsCommand(SymbolLibrary *library, const QString &text, const QMap<qint16, Symbol> &symbols)
+    :   QUndoCommand(text),
+        m_library(library),
+        m_symbols(symbols)
+{
+}
+
+
+/**
+ * Redo the update. The symbols replaced are stored for undo and added to their history.
+ */
+void UpdateSymbolsCommand::redo()
+{
+    m_replaced.clear();
+
+    for (QMap<qint16, Symbol>::const_iterator i = m_symbols.constBegin() ; i != m_symbols.constEnd() ; ++i) {
+        Symbol original = m_library->symbol(i.key());
+        m_replaced.insert(i.key(), original);
+        m_library->addRevision(i.key(), original);
+        m_library->setSymbol(i.key(), i.value());
+    }
+}
+
+
+/**
+ * Undo the update. The symbols replaced are restored and the revisions added for them are
+ * removed from their history.
+ */
+void UpdateSymbolsCommand::undo()
+{
+    for (QMap<qint16, Symbol>::const_iterator i = m_replaced.constBegin() ; i != m_replaced.constEnd() ; ++i) {
+        m_library->removeRevision(i.key());
+        m_library->setSymbol(i.key(), i.value());
+    }
 }
 
 
@@ -912,3 +1173,35 @@ void AddCharacterCommand::undo()
 {
     m_path = m_editor->setPath(m_path);
 }
+
+
+/**
+ * Constructor
+ *
+ * @param editor a pointer to the Editor
+ * @param components a const reference to a QList of the new SymbolComponent
+ */
+ChangeComponentsCommand::ChangeComponentsCommand(Editor *editor, const QList<SymbolComponent> &components)
+    :   QUndoCommand(i18n("Change Components")),
+        m_editor(editor),
+        m_components(components)
+{
+}
+
+
+/**
+ * Redo the change components command. Set the new components, storing the original ones for undo.
+ */
+void ChangeComponentsCommand::redo()
+{
+    m_components = m_editor->setComponents(m_components);
+}
+
+
+/**
+ * Undo the change components command. Restore the original components, storing the new ones for redo.
+ */
+void ChangeComponentsCommand::undo()
+{
+    m_components = m_editor->setComponents(m_components);
+}
@@ -19,14 +19,15 @@
 #define Commands_H
 
 
+#include <QSet>
+#include <QTransform>
 #include <QUndoCommand>
 #include <QWidget>
 
+#include "LibraryMerge.h"
 #include "SymbolLibrary.h"
 
 
-class QMimeData;
-
 class Editor;
 
 
@@ -188,7 +189,11 @@ private:
  * Implement updating a symbol in the library using the index specified. The index may
  * be 0 for new symbols and a new index will be generated by the library.
  *
- * The original Symbol is stored for a possible undo.
+ * The original Symbol is stored for a possible undo. Updating an existing symbol with a
+ * symbol having the same hash is made obsolete when constructed, the undo stack then
+ * discards it without redoing it, so saving an unchanged symbol adds nothing to the history.
+ * The symbol being replaced is added to the SymbolHistory of the symbol in the library and
+ * removed again when the command is undone.
  */
 class UpdateSymbolCommand : public QUndoCommand
 {
@@ -204,51 +209,76 @@ private:
     qint16          m_index;            /**< index of the symbol in the library */
     Symbol          m_symbol;           /**< the updated symbol */
     Symbol          m_originalSymbol;   /**< original symbol to be restored on undo */
+    bool            m_existed;          /**< true if the library had a symbol at the index when the command was redone */
 };
 
 
 /**
  * @brief Import library command class.
  *
- * Implement importing the symbols from one library into the current library. The indexes
- * from the import library are ignored and new indexes are generated by the current library.
+ * Implement importing the symbols from one or more libraries into the current library. The
+ * indexes from the imported libraries are ignored and new indexes are generated by the current
+ * library.
  *
  * The list of generated indexes is stored for a possible undo.
  */
 class ImportLibraryCommand : public QUndoCommand
 {
 public:
-    ImportLibraryCommand(SymbolLibrary *library, SymbolLibrary *imported);
-    virtual ~ImportLibraryCommand();
+    ImportLibraryCommand(SymbolLibrary *library, const QList<Symbol> &symbols, int libraries);
+    virtual ~ImportLibraryCommand() = default;
 
     virtual void undo() Q_DECL_OVERRIDE;
     virtual void redo() Q_DECL_OVERRIDE;
 
 private:
     SymbolLibrary   *m_symbolLibrary;   /**< pointer to the symbol library */
-    SymbolLibrary   *m_imported;        /**< pointer to the imported library */
+    QList<Symbol>   m_symbols;          /**< the flattened symbols imported */
     QList<qint16>   m_addedIndexes;     /**< indexes of the symbols imported to be removed on undo */
 };
 
 
 /**
- * @brief Rotate left command class.
+ * @brief Transform command class.
  *
- * Implement the rotation of the QPainterPath for the current symbol left (counter clockwise).
+ * Base class of the rotate and flip commands. The effect of each command is held as a QTransform
+ * mapping the unit square of the symbol onto itself, undo applying the inverse transform.
  *
- * Nothing is stored for undo as this is implemented as a rotate right.
+ * A transform command is only merged with the following one when together they leave the symbol
+ * unchanged, such as rotating left then right or flipping twice. The command is then made obsolete and
+ * removed from the stack leaving no entry in the history, any other sequence of rotations and flips
+ * being kept as separate steps.
  */
-class RotateLeftCommand : public QUndoCommand
+class TransformCommand : public QUndoCommand
 {
 public:
-    explicit RotateLeftCommand(Editor *editor);
-    virtual ~RotateLeftCommand() = default;
+    TransformCommand(const QString &text, Editor *editor, const QTransform &transform);
+    virtual ~TransformCommand() = default;
 
     virtual void undo() Q_DECL_OVERRIDE;
     virtual void redo() Q_DECL_OVERRIDE;
 
+    virtual int id() const Q_DECL_OVERRIDE;
+    virtual bool mergeWith(const QUndoCommand *command) Q_DECL_OVERRIDE;
+
+    QTransform transform() const;
+
 private:
-    Editor  *m_editor;                  /**< pointer to the editor */
+    Editor      *m_editor;              /**< pointer to the editor */
+    QTransform  m_transform;            /**< the transform applied, this may be changed by merging commands */
+};
+
+
+/**
+ * @brief Rotate left command class.
+ *
+ * Implement the rotation of the QPainterPath for the current symbol left (counter clockwise).
+ */
+class RotateLeftCommand : public TransformCommand
+{
+public:
+    explicit RotateLeftCommand(Editor *editor);
+    virtual ~RotateLeftCommand() = default;
 };
 
 
@@ -256,20 +286,12 @@ private:
  * @brief Rotate right command class.
  *
  * Implement the rotation of the QPainterPath for the current symbol right (clockwise).
- *
- * Nothing is stored for undo as this is implemented as a rotate left.
  */
-class RotateRightCommand : public QUndoCommand
+class RotateRightCommand : public TransformCommand
 {
 public:
     explicit RotateRightCommand(Editor *editor);
     virtual ~RotateRightCommand() = default;
-
-    virtual void undo() Q_DECL_OVERRIDE;
-    virtual void redo() Q_DECL_OVERRIDE;
-
-private:
-    Editor  *m_editor;                  /**< pointer to the editor */
 };
 
 
@@ -278,20 +300,12 @@ private:
  *
  * Implement the flipping of the QPainterPath for the current symbol horizontally about
  * the vertical axis passing through the center line of the symbol.
- *
- * Nothing is stored for undo as this implemented by another flip horizontal.
  */
-class FlipHorizontalCommand : public QUndoCommand
+class FlipHorizontalCommand : public TransformCommand
 {
 public:
     explicit FlipHorizontalCommand(Editor *editor);
     virtual ~FlipHorizontalCommand() = default;
-
-    virtual void undo() Q_DECL_OVERRIDE;
-    virtual void redo() Q_DECL_OVERRIDE;
-
-private:
-    Editor  *m_editor;                  /**< pointer to the editor */
 };
 
 
@@ -300,20 +314,12 @@ private:
  *
  * Implement the flipping of the QPainterPath for the current symbol vertically about
  * the horizontal axis passing through the center line of the symbol.
- *
- * Nothing is stored for undo as this is implemented by another flip vertical.
  */
-class FlipVerticalCommand : public QUndoCommand
+class FlipVerticalCommand : public TransformCommand
 {
 public:
     explicit FlipVerticalCommand(Editor *editor);
     virtual ~FlipVerticalCommand() = default;
-
-    virtual void undo() Q_DECL_OVERRIDE;
-    virtual void redo() Q_DECL_OVERRIDE;
-
-private:
-    Editor  *m_editor;                  /**< pointer to the editor */
 };
 
 
@@ -437,7 +443,8 @@ private:
  *
  * Implement deleting a symbol from the library using the index specified.
  *
- * The index and the symbol removed are stored for a possible undo.
+ * The index and the symbol removed are stored for a possible undo, with the index of the
+ * symbol following it in the display order so that it is restored to the same position.
  */
 class DeleteSymbolCommand : public QUndoCommand
 {
@@ -452,6 +459,7 @@ private:
     SymbolLibrary   *m_symbolLibrary;   /**< pointer to the SymbolLibrary */
     qint16          m_index;            /**< index of the symbol */
     Symbol          m_symbol;           /**< the symbol deleted, stored for undo */
+    qint16          m_following;        /**< index of the symbol following it in the display order, 0 if there is none */
 };
 
 
@@ -517,15 +525,102 @@ private:
 class DragAndDropCommand : public QUndoCommand
 {
 public:
-    DragAndDropCommand(SymbolLibrary *library, const QMimeData *mimeData);
+    DragAndDropCommand(SymbolLibrary *library, const QList<Symbol> &symbols);
 
     virtual void redo() Q_DECL_OVERRIDE;
     virtual void undo() Q_DECL_OVERRIDE;
 
 private:
-    SymbolLibrary   *m_library;
-    QList<Symbol>   m_symbols;
-    QList<qint16>   m_indexes;
+    SymbolLibrary   *m_library;         /**< pointer to the library the symbols are added to */
+    QList<Symbol>   m_symbols;          /**< the symbols dropped */
+    QList<qint16>   m_indexes;          /**< the indexes the symbols were added with */
+};
+
+
+/**
+ * @brief Move symbols to a new position in the library view.
+ *
+ * Implement reordering the symbols of the library by dragging them within the library view.
+ * Only the display order of the library is changed.
+ *
+ * The display order before the move is stored so that undo can return the symbols to their
+ * original positions in a single pass.
+ */
+class MoveSymbolsCommand : public QUndoCommand
+{
+public:
+    MoveSymbolsCommand(SymbolLibrary *library, const QList<qint16> &indexes, qint16 before);
+    virtual ~MoveSymbolsCommand() = default;
+
+    virtual void redo() Q_DECL_OVERRIDE;
+    virtual void undo() Q_DECL_OVERRIDE;
+
+private:
+    SymbolLibrary   *m_library;         /**< pointer to the symbol library */
+    QList<qint16>   m_indexes;          /**< indexes of the symbols moved in their original order */
+    QList<qint16>   m_order;            /**< the display order of the library before the move */
+    qint16          m_before;           /**< index of the symbol they are moved before, 0 for the end */
+};
+
+
+/**
+ * @brief Merge the changes made to the library file by another application.
+ *
+ * Implement applying a LibraryMerge to the library, setting the symbols changed in the file,
+ * removing those removed from it and adding the symbols added to it with new indexes. The
+ * conflicts are resolved by keeping either the symbols of the library or those of the file.
+ *
+ * The symbols taken from the file keep their history from the file, or the symbols they replace
+ * are added to their history when the file has none, and the symbols new to the library are
+ * placed as they are in the display order of the file. The symbols replaced or removed, their
+ * histories and the display order are stored for a possible undo.
+ */
+class MergeLibraryCommand : public QUndoCommand
+{
+public:
+    MergeLibraryCommand(SymbolLibrary *library, const LibraryMerge &merge, bool keepTheirs);
+    virtual ~MergeLibraryCommand() = default;
+
+    virtual void redo() Q_DECL_OVERRIDE;
+    virtual void undo() Q_DECL_OVERRIDE;
+
+private:
+    SymbolLibrary           *m_library;         /**< pointer to the symbol library */
+    QMap<qint16, Symbol>    m_updates;          /**< the symbols to set from the file */
+    QList<qint16>           m_removals;         /**< indexes of the symbols to remove */
+    QList<Symbol>           m_additions;        /**< the symbols to add with new indexes */
+    QList<qint16>           m_additionIndexes;  /**< indexes of the additions in the file */
+    QMap<qint16, SymbolHistory> m_histories;    /**< histories in the file of the symbols taken from it, by their index in the file */
+    QList<qint16>           m_fileOrder;        /**< indexes of the symbols of the file in the order they are shown */
+    QMap<qint16, Symbol>    m_replaced;         /**< the symbols replaced or removed, stored for undo */
+    QSet<qint16>            m_existed;          /**< indexes of the updated symbols that were in the library, stored for undo */
+    QMap<qint16, SymbolHistory> m_replacedHistories;    /**< histories of the updated symbols, stored for undo */
+    QList<qint16>           m_order;            /**< the display order of the library before the merge, stored for undo */
+    QList<qint16>           m_addedIndexes;     /**< indexes of the symbols added, stored for undo */
+};
+
+
+/**
+ * @brief Update a set of library symbols command class.
+ *
+ * Implement replacing several symbols of the library in one step, such as with the results of
+ * a LibraryJob run over the whole library.
+ *
+ * The symbols replaced are added to their history and stored for a possible undo.
+ */
+class UpdateSymbolsCommand : public QUndoCommand
+{
+public:
+    UpdateSymbolsCommand(SymbolLibrary *library, const QString &text, const QMap<qint16, Symbol> &symbols);
+    virtual ~UpdateSymbolsCommand() = default;
+
+    virtual void redo() Q_DECL_OVERRIDE;
+    virtual void undo() Q_DECL_OVERRIDE;
+
+private:
+    SymbolLibrary           *m_library;         /**< pointer to the symbol library */
+    QMap<qint16, Symbol>    m_symbols;          /**< the symbols to set */
+    QMap<qint16, Symbol>    m_replaced;         /**< the symbols replaced, stored for undo */
 };
 
 
@@ -548,5 +643,27 @@ private:
 };
 
 
+/**
+ * @brief Change the components of the symbol command class.
+ *
+ * Implement adding or removing the components of the current symbol.
+ *
+ * The original components are stored for a possible undo.
+ */
+class ChangeComponentsCommand : public QUndoCommand
+{
+public:
+    ChangeComponentsCommand(Editor *editor, const QList<SymbolComponent> &components);
+    virtual ~ChangeComponentsCommand() = default;
+
+    virtual void redo() Q_DECL_OVERRIDE;
+    virtual void undo() Q_DECL_OVERRIDE;
+
+private:
+    Editor                  *m_editor;      /**< pointer to the editor */
+    QList<SymbolComponent>  m_components;   /**< the components to be set, swapped with the original ones when set */
+};
+
+
 #endif
 
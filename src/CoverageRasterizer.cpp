@@ -0,0 +1,303 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Implement the CoverageRasterizer class.
+ */
+
+
+/**
+ * @page coverage_rasterizer Coverage Rasterizer
+ * The icons in the library view and the thumbnails in the symbol catalog are drawn in a single color, so only the
+ * coverage of each pixel by the symbol is needed. The coverage rasterizer converts the symbol path to polygons in
+ * pixel coordinates and samples each row of pixels with a number of sub scanlines. On each sub scanline the edges
+ * crossing it are sorted and the fill rule applied to find the spans inside the symbol, the exact horizontal
+ * coverage of the spans being accumulated for each pixel. The runs of fully covered pixels and the conversion of
+ * the accumulated coverage to 8 bit values are simple loops that the compiler can vectorize.
+ *
+ * Draft images sample each row with two sub scanlines rather than sixteen. They are drawn while the library
+ * view is scrolled quickly and replaced with refined images once the scrolling stops.
+ *
+ * Filled symbols are drawn by the editor with a one pixel cosmetic outline in addition to the fill, and outline
+ * symbols with a pen scaled with the symbol. Both are converted to filled outlines with a QPainterPathStroker, the
+ * coverage of the outline being combined with that of the fill.
+ *
+ * The CoverageRasterizerTest compares the coverage of filled and outline symbols at several sizes, at both
+ * qualities, with the alpha channel of an antialiased QPainter rendering of the same symbols.
+ */
+
+
+#include "CoverageRasterizer.h"
+
+#include <QColor>
+#include <QPainterPathStroker>
+#include <QPolygonF>
+#include <QTransform>
+#include <QVector>
+
+#include <algorithm>
+#include <cmath>
+
+#include "Symbol.h"
+
+
+namespace
+{
+/**
+ * @brief An edge of a polygon, oriented from top to bottom.
+ */
+class Edge
+{
+public:
+    qreal   top;            /**< the y coordinate of the top of the edge */
+    qreal   bottom;         /**< the y coordinate of the bottom of the edge */
+    qreal   x;              /**< the x coordinate of the top of the edge */
+    qreal   dxdy;           /**< the change in x for each unit of y */
+    int     direction;      /**< 1 for edges originally going down, -1 for those going up */
+};
+
+
+/**
+ * @brief A crossing of a sub scanline by an edge.
+ */
+class Crossing
+{
+public:
+    qreal   x;              /**< the x coordinate of the crossing */
+    int     direction;      /**< the direction of the edge crossing */
+};
+
+
+bool operator<(const Edge &a, const Edge &b)
+{
+    return a.top < b.top;
+}
+
+
+bool operator<(const Crossing &a, const Crossing &b)
+{
+    return a.x < b.x;
+}
+
+
+/**
+ * Add the coverage of a span to the accumulator.
+ * The pixels partly covered at each end receive the fraction covered, those in between the full weight.
+ *
+ * @param accumulator a pointer to the accumulated coverage, this has width + 1 entries
+ * @param x0 the start of the span
+ * @param x1 the end of the span
+ * @param weight the coverage of a fully covered pixel on a sub scanline
+ * @param width the width of the image
+ */
+void addSpan(float *accumulator, qreal x0, qreal x1, float weight, int width)
+{
+    x0 = qBound(qreal(0), x0, qreal(width));
+    x1 = qBound(qreal(0), x1, qreal(width));
+
+    if (x1 <= x0) {
+        return;
+    }
+
+    int i0 = static_cast<int>(x0);
+    int i1 = static_cast<int>(x1);
+
+    if (i0 == i1) {
+        accumulator[i0] += static_cast<float>(x1 - x0) * weight;
+        return;
+    }
+
+    accumulator[i0] += static_cast<float>(i0 + 1 - x0) * weight;
+
+    for (int i = i0 + 1 ; i < i1 ; ++i) {
+        accumulator[i] += weight;
+    }
+
+    accumulator[i1] += static_cast<float>(x1 - i1) * weight;
+}
+}
+
+
+/**
+ * Render the coverage of a symbol.
+ * The symbol is scaled to the size of the image. Filled symbols are filled with their fill rule and
+ * have a one pixel outline added, matching the cosmetic pen used when drawing them. Outline symbols
+ * are stroked with their line width, cap and join styles.
+ *
+ * @param symbol a const reference to the Symbol to render
+ * @param size the width and height of the image in pixels
+ * @param quality the Quality of the coverage, a draft samples fewer sub scanlines
+ *
+ * @return a QImage in QImage::Format_Alpha8 containing the coverage of each pixel
+ */
+QImage CoverageRasterizer::coverage(const Symbol &symbol, int size, Quality quality)
+{
+    int samples = (quality == Draft) ? draftSubScanlines : subScanlines;
+    QImage image(size, size, QImage::Format_Alpha8);
+    image.fill(0);
+
+    QPainterPath path = QTransform::fromScale(size, size).map(symbol.path());
+    QPainterPathStroker stroker;
+
+    if (symbol.filled()) {
+        fill(path, path.fillRule(), samples, image);
+        stroker.setWidth(1.0);
+    } else {
+        stroker.setWidth(symbol.lineWidth() * size);
+        stroker.setCapStyle(symbol.capStyle());
+        stroker.setJoinStyle(symbol.joinStyle());
+    }
+
+    fill(stroker.createStroke(path), Qt::WindingFill, samples, image);
+
+    return image;
+}
+
+
+/**
+ * Create a displayable image from a coverage image.
+ *
+ * @param coverage a const reference to a QImage created by coverage()
+ * @param color the color to draw the symbol in
+ *
+ * @return a QImage in QImage::Format_ARGB32_Premultiplied
+ */
+QImage CoverageRasterizer::colorized(const QImage &coverage, const QColor &color)
+{
+    QImage image(coverage.size(), QImage::Format_ARGB32_Premultiplied);
+    QRgb rgb = color.rgb();
+
+    for (int y = 0 ; y < coverage.height() ; ++y) {
+        const uchar *source = coverage.constScanLine(y);
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+
+        for (int x = 0 ; x < coverage.width() ; ++x) {
+            line[x] = qPremultiply(qRgba(qRed(rgb), qGreen(rgb), qBlue(rgb), source[x]));
+        }
+    }
+
+    return image;
+}
+
+
+/**
+ * Fill a path into a coverage image.
+ * The path is converted to closed polygons whose edges are sorted by their top coordinate so that
+ * the active edges for each sub scanline can be maintained incrementally. The coverage of the path
+ * is combined with the existing contents of the image by taking the maximum of the two.
+ *
+ * @param path a const reference to the QPainterPath in pixel coordinates
+ * @param rule the Qt::FillRule used to decide which spans are inside the path
+ * @param samples the number of sub scanlines sampled for each row of pixels
+ * @param image a reference to the QImage in QImage::Format_Alpha8 to fill
+ */
+void CoverageRasterizer::fill(const QPainterPath &path, Qt::FillRule rule, int samples, QImage &image)
+{
+    int width = image.width();
+    int height = image.height();
+
+    QVector<Edge> edges;
+
+    foreach (const QPolygonF &polygon, path.toSubpathPolygons()) {
+        int points = polygon.count();
+
+        for (int i = 0 ; i < points ; ++i) {
+            QPointF from = polygon.at(i);
+            QPointF to = polygon.at((i + 1) % points);
+
+            if (from.y() == to.y()) {
+                continue;
+            }
+
+            Edge edge;
+            edge.direction = 1;
+
+            if (from.y() > to.y()) {
+                std::swap(from, to);
+                edge.direction = -1;
+            }
+
+            edge.top = from.y();
+            edge.bottom = to.y();
+            edge.x = from.x();
+            edge.dxdy = (to.x() - from.x()) / (to.y() - from.y());
+            edges.append(edge);
+        }
+    }
+
+    if (edges.isEmpty()) {
+        return;
+    }
+
+    std::sort(edges.begin(), edges.end());
+
+    QVector<float> accumulator(width + 1, 0.0f);
+    QVector<int> active;
+    QVector<Crossing> crossings;
+    const float weight = 1.0f / samples;
+    int next = 0;
+
+    for (int row = 0 ; row < height ; ++row) {
+        for (int sub = 0 ; sub < samples ; ++sub) {
+            qreal y = row + (sub + 0.5) / samples;
+
+            while (next < edges.count() && edges.at(next).top <= y) {
+                active.append(next++);
+            }
+
+            crossings.clear();
+
+            for (int i = 0 ; i < active.count() ; ) {
+                const Edge &edge = edges.at(active.at(i));
+
+                if (edge.bottom <= y) {
+                    active[i] = active.last();
+                    active.removeLast();
+                    continue;
+                }
+
+                Crossing crossing;
+                crossing.x = edge.x + (y - edge.top) * edge.dxdy;
+                crossing.direction = edge.direction;
+                crossings.append(crossing);
+                ++i;
+            }
+
+            if (crossings.count() < 2) {
+                continue;
+            }
+
+            std::sort(crossings.begin(), crossings.end());
+
+            int winding = 0;
+
+            for (int i = 0 ; i < crossings.count() - 1 ; ++i) {
+                winding += crossings.at(i).direction;
+
+                if ((rule == Qt::WindingFill) ? (winding != 0) : (winding & 1)) {
+                    addSpan(accumulator.data(), crossings.at(i).x, crossings.at(i + 1).x, weight, width);
+                }
+            }
+        }
+
+        uchar *line = image.scanLine(row);
+        float *coverage = accumulator.data();
+
+        for (int x = 0 ; x < width ; ++x) {
+            int value = static_cast<int>(std::min(coverage[x], 1.0f) * 255.0f + 0.5f);
+            line[x] = static_cast<uchar>(std::max(static_cast<int>(line[x]), value));
+            coverage[x] = 0.0f;
+        }
+
+        coverage[width] = 0.0f;
+    }
+}
@@ -0,0 +1,209 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Implement the DiagnosticsDialog class.
+ */
+
+
+/**
+ * @page diagnostics_dialog Diagnostics Dialog
+ * The diagnostics dialog enables the recording of the @ref latency_histograms, which is off until the user turns
+ * it on. For each operation the dialog shows the number of times it was recorded and the times below which half,
+ * nine tenths and ninety nine hundredths of them fell, along with the longest time. As the histogram buckets
+ * double in width the times shown are the upper limits of the buckets. The histograms of earlier versions of the
+ * application are shown by choosing the version, and all of them can be discarded.
+ */
+
+
+#include "DiagnosticsDialog.h"
+
+#include <QCheckBox>
+#include <QComboBox>
+#include <QCoreApplication>
+#include <QDialogButtonBox>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLocale>
+#include <QPushButton>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+#include <KLocalizedString>
+#include <KMessageBox>
+
+#include "LatencyHistograms.h"
+
+#include "SymbolEditor.h"
+
+
+/**
+ * Constructor
+ * Create the widgets and connect the signals from them.
+ *
+ * @param parent a pointer to the parent widget
+ */
+DiagnosticsDialog::DiagnosticsDialog(QWidget *parent)
+    :   QDialog(parent),
+        m_record(new QCheckBox(i18n("Record how long operations take on this computer"), this)),
+        m_versions(new QComboBox(this)),
+        m_histograms(new QTreeWidget(this)),
+        m_machine(new QLabel(this))
+{
+    setWindowTitle(i18n("Diagnostics"));
+
+    m_record->setChecked(LatencyHistograms::isEnabled());
+    m_record->setWhatsThis(i18n("The times are kept in the application data directory and are never sent anywhere."));
+
+    QHBoxLayout *versionLayout = new QHBoxLayout;
+    versionLayout->addWidget(new QLabel(i18n("Version:"), this));
+    versionLayout->addWidget(m_versions, 1);
+
+    m_histograms->setRootIsDecorated(false);
+    m_histograms->setHeaderLabels(QStringList() << i18n("Operation") << i18n("Samples") << i18n("Median") << i18n("90%") << i18n("99%") << i18n("Slowest"));
+    m_histograms->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+
+    m_machine->setText(LatencyHistograms::machine());
+
+    QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Reset | QDialogButtonBox::Close, this);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(m_record);
+    layout->addLayout(versionLayout);
+    layout->addWidget(m_histograms, 1);
+    layout->addWidget(m_machine);
+    layout->addWidget(buttonBox);
+
+    resize(560, 320);
+
+    connect(m_record, SIGNAL(toggled(bool)), this, SLOT(recordToggled(bool)));
+    connect(m_versions, SIGNAL(currentIndexChanged(int)), this, SLOT(showHistograms()));
+    connect(buttonBox->button(QDialogButtonBox::Reset), SIGNAL(clicked()), this, SLOT(resetHistograms()));
+    connect(buttonBox, SIGNAL(rejected()), this, SLOT(reject()));
+}
+
+
+/**
+ * Called when the dialog is shown, the versions and histograms are updated to include the times
+ * recorded since it was last shown. The version running is selected.
+ *
+ * @param event a pointer to the QShowEvent
+ */
+void DiagnosticsDialog::showEvent(QShowEvent *event)
+{
+    QDialog::showEvent(event);
+    updateVersions();
+}
+
+
+/**
+ * Update the versions there are histograms for, selecting the version running, and show its histograms.
+ */
+void DiagnosticsDialog::updateVersions()
+{
+    m_versions->blockSignals(true);
+    m_versions->clear();
+    m_versions->addItems(LatencyHistograms::versions());
+    m_versions->setCurrentText(QCoreApplication::applicationVersion());
+    m_versions->blockSignals(false);
+
+    showHistograms();
+}
+
+
+/**
+ * Enable or disable the recording of the histograms and store the setting.
+ *
+ * @param checked true if recording has been enabled
+ */
+void DiagnosticsDialog::recordToggled(bool checked)
+{
+    LatencyHistograms::setEnabled(checked);
+    Configuration::setDiagnostics_RecordLatency(checked);
+    Configuration::self()->save();
+}
+
+
+/**
+ * Show the summary of the histograms for the selected version.
+ */
+void DiagnosticsDialog::showHistograms()
+{
+    m_histograms->clear();
+
+    QString version = m_versions->currentText();
+
+    for (int operation = 0 ; operation < LatencyHistograms::OperationCount ; ++operation) {
+        QVector<quint64> histogram = LatencyHistograms::histogram(version, static_cast<LatencyHistograms::Operation>(operation));
+        quint64 samples = 0;
+        int slowest = -1;
+
+        for (int bucket = 0 ; bucket < histogram.count() ; ++bucket) {
+            samples += histogram.at(bucket);
+
+            if (histogram.at(bucket)) {
+                slowest = bucket;
+            }
+        }
+
+        QTreeWidgetItem *item = new QTreeWidgetItem(m_histograms);
+        item->setText(0, LatencyHistograms::operationName(static_cast<LatencyHistograms::Operation>(operation)));
+        item->setText(1, QString::number(samples));
+
+        if (samples) {
+            item->setText(2, formatLimit(LatencyHistograms::percentile(histogram, 0.5)));
+            item->setText(3, formatLimit(LatencyHistograms::percentile(histogram, 0.9)));
+            item->setText(4, formatLimit(LatencyHistograms::percentile(histogram, 0.99)));
+            item->setText(5, formatLimit(LatencyHistograms::bucketLimit(slowest)));
+        }
+
+        for (int column = 1 ; column < m_histograms->columnCount() ; ++column) {
+            item->setTextAlignment(column, Qt::AlignRight | Qt::AlignVCenter);
+        }
+    }
+}
+
+
+/**
+ * Discard all the histograms after asking the user to confirm.
+ */
+void DiagnosticsDialog::resetHistograms()
+{
+    if (KMessageBox::warningContinueCancel(this, i18n("Discard the times recorded for all versions?"), QString(), KStandardGuiItem::discard()) == KMessageBox::Continue) {
+        LatencyHistograms::reset();
+        updateVersions();
+    }
+}
+
+
+/**
+ * Format a bucket limit for display.
+ *
+ * @param usecs the limit in microseconds as returned by LatencyHistograms::bucketLimit()
+ *
+ * @return a QString describing the limit
+ */
+QString DiagnosticsDialog::formatLimit(qint64 usecs)
+{
+    if (usecs < 0) {
+        return i18n("> %1 s", LatencyHistograms::bucketLimit(LatencyHistograms::bucketCount - 2) / 1000000);
+    }
+
+    if (usecs < 1000) {
+        return i18n("< %1 µs", usecs);
+    }
+
+    return i18n("< %1 ms", QLocale().toString(usecs / 1000.0, 'f', (usecs < 10000) ? 1 : 0));
+}
+
+#include "moc_DiagnosticsDialog.cpp"
@@ -0,0 +1,65 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Header file for the DiagnosticsDialog class.
+ */
+
+
+#ifndef DiagnosticsDialog_H
+#define DiagnosticsDialog_H
+
+
+#include <QDialog>
+
+
+class QCheckBox;
+class QComboBox;
+class QLabel;
+class QTreeWidget;
+
+
+/**
+ * @brief Dialog showing the LatencyHistograms recorded on this computer.
+ *
+ * The dialog allows recording to be enabled and disabled, shows a summary of the histogram of each
+ * operation for a chosen application version and allows the histograms to be discarded.
+ */
+class DiagnosticsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit DiagnosticsDialog(QWidget *parent);
+    ~DiagnosticsDialog() = default;
+
+protected:
+    virtual void showEvent(QShowEvent *event) Q_DECL_OVERRIDE;
+
+private slots:
+    void recordToggled(bool checked);
+    void showHistograms();
+    void resetHistograms();
+
+private:
+    void updateVersions();
+
+    static QString formatLimit(qint64 usecs);
+
+    QCheckBox       *m_record;              /**< enables recording the histograms */
+    QComboBox       *m_versions;            /**< the application version the histograms are shown for */
+    QTreeWidget     *m_histograms;          /**< summary of the histogram of each operation */
+    QLabel          *m_machine;             /**< description of the computer the histograms are recorded on */
+};
+
+
+#endif
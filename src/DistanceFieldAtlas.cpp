@@ -0,0 +1,403 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Implement the DistanceFieldAtlas class.
+ */
+
+
+/**
+ * @page distance_field_atlas Distance Field Atlas
+ * File->Export Distance Field Atlas writes all the symbols of the library into a single PNG image as signed
+ * distance fields, for viewers that show the symbols at many different scales. Each symbol occupies a square
+ * cell of the chosen size and the cells are arranged in a grid. Pixel values above 127 are inside the symbol and
+ * values below 128 are outside, the distance from the edge of the symbol being encoded over a spread of one
+ * eighth of the cell size either side of the edge. Outline symbols have their line width included in the field.
+ *
+ * A JSON file with the same name as the image describes the atlas, giving the cell size, the spread and the
+ * position of the cell for each symbol index.
+ *
+ * The fields are calculated in the background with the progress shown in the status bar, where the export
+ * can also be cancelled. An atlas too large to be held in memory is reported rather than being created.
+ */
+
+
+#include "DistanceFieldAtlas.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QSaveFile>
+#include <QtMath>
+
+#include <KLocalizedString>
+
+#include <cmath>
+#include <cstring>
+
+#include "CoverageRasterizer.h"
+#include "Exceptions.h"
+#include "Symbol.h"
+#include "SymbolLibrary.h"
+
+
+namespace
+{
+const float infinity = 1.0e20f;     /**< the initial squared distance of pixels that are not sources */
+}
+
+
+/**
+ * Constructor.
+ *
+ * @param library a pointer to the SymbolLibrary to export, any unread shards of a collection should have been read
+ * @param fileName the name of the PNG image file
+ * @param size the width and height of each symbol in pixels
+ * @param parent a pointer to the parent QObject
+ */
+DistanceFieldAtlas::DistanceFieldAtlas(SymbolLibrary *library, const QString &fileName, int size, QObject *parent)
+    :   QObject(parent),
+        m_library(library),
+        m_fileName(fileName),
+        m_size(size),
+        m_spread(qMax(1, size / 8)),
+        m_columns(1),
+        m_processed(0),
+        m_remaining(0)
+{
+}
+
+
+/**
+ * Destructor.
+ * Any batches still being processed are cancelled.
+ */
+DistanceFieldAtlas::~DistanceFieldAtlas()
+{
+    foreach (TaskToken token, m_tokens) {
+        token.cancel();
+    }
+}
+
+
+/**
+ * Get the description of the export.
+ *
+ * @return a QString containing the description
+ */
+QString DistanceFieldAtlas::text() const
+{
+    return i18n("Export Distance Field Atlas");
+}
+
+
+/**
+ * Start the export.
+ * The atlas is created for a grid of cells as close to square as possible and the flattened symbols
+ * are scheduled in batches at the TaskScheduler::Analysis priority.
+ *
+ * @exception FailedFileAccess if the atlas is too large to be created
+ */
+void DistanceFieldAtlas::start()
+{
+    m_indexes = m_library->indexes();
+    m_columns = qMax(1, qCeil(std::sqrt(static_cast<qreal>(m_indexes.count()))));
+    int rows = qMax(1, (m_indexes.count() + m_columns - 1) / m_columns);
+
+    m_atlas = QImage(m_columns * m_size, rows * m_size, QImage::Format_Grayscale8);
+
+    if (m_atlas.isNull()) {
+        throw FailedFileAccess(m_fileName, i18n("An atlas of %1 by %2 pixels is too large to be created, choose a smaller symbol size", m_columns * m_size, rows * m_size));
+    }
+
+    m_atlas.fill(0);
+    m_tokens.clear();
+    m_processed = 0;
+    m_remaining = 0;
+
+    int size = m_size;
+    int spread = m_spread;
+
+    for (int first = 0 ; first < m_indexes.count() ; first += batchSize) {
+        QList<QPair<int, Symbol> > batch;
+
+        for (int cell = first ; cell < m_indexes.count() && cell < first + batchSize ; ++cell) {
+            batch.append(qMakePair(cell, m_library->flattenedSymbol(m_indexes.at(cell))));
+        }
+
+        ++m_remaining;
+
+        m_tokens.append(TaskScheduler::instance()->schedule<Fields>(TaskScheduler::Analysis, QByteArray(),
+            [batch, size, spread](const TaskToken &token) {
+                Fields fields;
+
+                foreach (const auto &pair, batch) {
+                    if (token.isCancelled()) {
+                        break;
+                    }
+
+                    fields.append(qMakePair(pair.first, distanceField(pair.second, size, spread)));
+                }
+
+                return fields;
+            },
+            this,
+            [this](const Fields &fields) {
+                batchProcessed(fields);
+            }));
+    }
+
+    emit progress(m_processed, m_indexes.count());
+
+    if (m_remaining == 0) {
+        writeFiles();
+    }
+}
+
+
+/**
+ * Cancel the export.
+ * The batches being processed are cancelled and nothing is written, unless the files are already
+ * being written.
+ */
+void DistanceFieldAtlas::cancel()
+{
+    foreach (TaskToken token, m_tokens) {
+        token.cancel();
+    }
+
+    m_tokens.clear();
+    m_remaining = 0;
+    m_atlas = QImage();
+
+    emit cancelled();
+}
+
+
+/**
+ * Called on the GUI thread as each batch is processed.
+ * The fields are copied into their cells of the atlas and released. When the last batch has been
+ * processed the files are written.
+ *
+ * @param fields a const reference to the Fields of the batch
+ */
+void DistanceFieldAtlas::batchProcessed(const Fields &fields)
+{
+    if (m_remaining == 0) {
+        return;     // the export was cancelled
+    }
+
+    foreach (const auto &pair, fields) {
+        int left = (pair.first % m_columns) * m_size;
+        int top = (pair.first / m_columns) * m_size;
+
+        for (int y = 0 ; y < m_size ; ++y) {
+            memcpy(m_atlas.scanLine(top + y) + left, pair.second.constScanLine(y), m_size);
+        }
+
+        ++m_processed;
+    }
+
+    emit progress(m_processed, m_indexes.count());
+
+    if (--m_remaining == 0) {
+        writeFiles();
+    }
+}
+
+
+/**
+ * Write the atlas image and its description.
+ * The description is made on the GUI thread and the files are written on a worker thread, the
+ * image being handed over to the task. The JSON file has the same name as the image and a .json
+ * suffix. When the files have been written finished() is emitted, or failed() if they couldn't be.
+ */
+void DistanceFieldAtlas::writeFiles()
+{
+    QJsonArray cells;
+
+    for (int cell = 0 ; cell < m_indexes.count() ; ++cell) {
+        QJsonObject object;
+        object.insert(QStringLiteral("index"), m_indexes.at(cell));
+        object.insert(QStringLiteral("x"), (cell % m_columns) * m_size);
+        object.insert(QStringLiteral("y"), (cell / m_columns) * m_size);
+        cells.append(object);
+    }
+
+    QFileInfo info(m_fileName);
+
+    QJsonObject description;
+    description.insert(QStringLiteral("image"), info.fileName());
+    description.insert(QStringLiteral("cellSize"), m_size);
+    description.insert(QStringLiteral("spread"), m_spread);
+    description.insert(QStringLiteral("symbols"), cells);
+
+    QImage atlas = m_atlas;
+    QString fileName = m_fileName;
+    QString descriptionName = info.dir().filePath(info.completeBaseName() + QLatin1String(".json"));
+    QByteArray json = QJsonDocument(description).toJson();
+
+    m_atlas = QImage();
+    m_tokens.clear();
+
+    m_tokens.append(TaskScheduler::instance()->schedule<QPair<QString, QString> >(TaskScheduler::Analysis, QByteArray(),
+        [atlas, fileName, descriptionName, json](const TaskToken &token) {
+            if (token.isCancelled()) {
+                return QPair<QString, QString>();
+            }
+
+            if (!atlas.save(fileName, "PNG")) {
+                return qMakePair(fileName, i18n("The image could not be written"));
+            }
+
+            QSaveFile file(descriptionName);
+
+            if (!file.open(QIODevice::WriteOnly)) {
+                return qMakePair(file.fileName(), file.errorString());
+            }
+
+            file.write(json);
+
+            if (!file.commit()) {
+                return qMakePair(file.fileName(), file.errorString());
+            }
+
+            return QPair<QString, QString>();
+        },
+        this,
+        [this](const QPair<QString, QString> &result) {
+            m_tokens.clear();
+
+            if (result.second.isEmpty()) {
+                emit finished();
+            } else {
+                emit failed(result.first, result.second);
+            }
+        }));
+}
+
+
+/**
+ * Calculate the signed distance field of a symbol.
+ * The symbol is rendered with the CoverageRasterizer and pixels more than half covered are treated as
+ * inside. The distances from each outside pixel to the nearest inside pixel, and from each inside pixel
+ * to the nearest outside pixel, are calculated with an exact euclidean distance transform. The signed
+ * distance is mapped so that 0.5 is on the edge of the symbol and the spread either side covers the
+ * range 0 to 1.
+ *
+ * @param symbol a const reference to the Symbol
+ * @param size the width and height of the field in pixels
+ * @param spread the distance in pixels either side of the edge encoded in the field
+ *
+ * @return a QImage in QImage::Format_Grayscale8
+ */
+QImage DistanceFieldAtlas::distanceField(const Symbol &symbol, int size, int spread)
+{
+    QImage coverage = CoverageRasterizer::coverage(symbol, size);
+    QVector<float> inside(size * size);
+    QVector<float> outside(size * size);
+
+    for (int y = 0 ; y < size ; ++y) {
+        const uchar *line = coverage.constScanLine(y);
+
+        for (int x = 0 ; x < size ; ++x) {
+            bool covered = (line[x] >= 128);
+            outside[y * size + x] = (covered ? 0.0f : infinity);
+            inside[y * size + x] = (covered ? infinity : 0.0f);
+        }
+    }
+
+    transform(outside, size);
+    transform(inside, size);
+
+    QImage field(size, size, QImage::Format_Grayscale8);
+
+    for (int y = 0 ; y < size ; ++y) {
+        uchar *line = field.scanLine(y);
+
+        for (int x = 0 ; x < size ; ++x) {
+            int i = y * size + x;
+            float distance = (outside.at(i) > 0.0f) ? (std::sqrt(outside.at(i)) - 0.5f) : -(std::sqrt(inside.at(i)) - 0.5f);
+            float value = 0.5f - distance / (2.0f * spread);
+            line[x] = static_cast<uchar>(qBound(0, static_cast<int>(value * 255.0f + 0.5f), 255));
+        }
+    }
+
+    return field;
+}
+
+
+/**
+ * Calculate the squared euclidean distance transform of a grid in place.
+ * The grid holds 0 for the source pixels and a large value for the others. The transform is done
+ * separably, first down each column and then along each row, using the lower envelope of parabolas
+ * method of Felzenszwalb and Huttenlocher which is linear in the number of pixels.
+ *
+ * @param grid a reference to the QVector of size * size values
+ * @param size the width and height of the grid
+ */
+void DistanceFieldAtlas::transform(QVector<float> &grid, int size)
+{
+    QVector<float> f(size);
+    QVector<float> d(size);
+    QVector<int> v(size);
+    QVector<float> z(size + 1);
+
+    for (int pass = 0 ; pass < 2 ; ++pass) {
+        for (int line = 0 ; line < size ; ++line) {
+            int offset = (pass == 0) ? line : line * size;
+            int step = (pass == 0) ? size : 1;
+
+            for (int q = 0 ; q < size ; ++q) {
+                f[q] = grid.at(offset + q * step);
+            }
+
+            int k = 0;
+            v[0] = 0;
+            z[0] = -infinity;
+            z[1] = infinity;
+
+            for (int q = 1 ; q < size ; ++q) {
+                float s = ((f.at(q) + q * q) - (f.at(v.at(k)) + v.at(k) * v.at(k))) / (2 * q - 2 * v.at(k));
+
+                while (k > 0 && s <= z.at(k)) {
+                    --k;
+                    s = ((f.at(q) + q * q) - (f.at(v.at(k)) + v.at(k) * v.at(k))) / (2 * q - 2 * v.at(k));
+                }
+
+                ++k;
+                v[k] = q;
+                z[k] = s;
+                z[k + 1] = infinity;
+            }
+
+            k = 0;
+
+            for (int q = 0 ; q < size ; ++q) {
+                while (z.at(k + 1) < q) {
+                    ++k;
+                }
+
+                d[q] = (q - v.at(k)) * (q - v.at(k)) + f.at(v.at(k));
+            }
+
+            for (int q = 0 ; q < size ; ++q) {
+                grid[offset + q * step] = d.at(q);
+            }
+        }
+    }
+}
+
+#include "moc_DistanceFieldAtlas.cpp"
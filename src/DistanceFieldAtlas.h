@@ -0,0 +1,92 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Header file for the DistanceFieldAtlas class.
+ */
+
+
+#ifndef DistanceFieldAtlas_H
+#define DistanceFieldAtlas_H
+
+
+#include <QImage>
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+#include "TaskScheduler.h"
+
+
+class Symbol;
+class SymbolLibrary;
+
+
+/**
+ * @brief Exports the symbols of a library as an atlas of signed distance fields.
+ *
+ * Each symbol is converted to a signed distance field of a fixed size, the fields being
+ * calculated in batches in the background by the TaskScheduler and copied into a grid in a
+ * single grayscale image as each batch is received, so only the fields of the batches in
+ * progress are held. The image and a description of the atlas giving the position of each
+ * symbol are written on a worker thread once all the fields have been copied. Viewers can
+ * render the symbols at any scale from the atlas by thresholding the sampled distance.
+ */
+class DistanceFieldAtlas : public QObject
+{
+    Q_OBJECT
+
+public:
+    DistanceFieldAtlas(SymbolLibrary *library, const QString &fileName, int size, QObject *parent = nullptr);
+    ~DistanceFieldAtlas();
+
+    QString text() const;
+
+    void start();
+
+    static QImage distanceField(const Symbol &symbol, int size, int spread);
+
+public slots:
+    void cancel();
+
+signals:
+    void progress(int processed, int count);
+    void finished();
+    void failed(const QString &fileName, const QString &error);
+    void cancelled();
+
+private:
+    typedef QList<QPair<int, QImage> > Fields;      /**< the cells of the symbols of a batch and their distance fields */
+
+    void batchProcessed(const Fields &fields);
+    void writeFiles();
+
+    static void transform(QVector<float> &grid, int size);
+
+    static const int batchSize = 16;        /**< the number of symbols processed by each task */
+
+    SymbolLibrary   *m_library;             /**< pointer to the SymbolLibrary being exported */
+    QString         m_fileName;             /**< the name of the PNG image file */
+    int             m_size;                 /**< the width and height of each symbol in pixels */
+    int             m_spread;               /**< the distance in pixels either side of the edge encoded in the fields */
+    QList<qint16>   m_indexes;              /**< the indexes of the symbols in the order of their cells */
+    int             m_columns;              /**< the number of cells in each row of the atlas */
+    QImage          m_atlas;                /**< the atlas the fields are copied into */
+    QList<TaskToken>    m_tokens;           /**< tokens for the batches being processed and the writing of the files */
+    int             m_processed;            /**< the number of symbols whose fields have been copied into the atlas */
+    int             m_remaining;            /**< the number of batches still to be processed */
+};
+
+
+#endif
@@ -147,6 +147,13 @@
  * use this symbol as a basis for other symbols using rotation and flipping, use the File->Save Symbol as New
  * command which will save the symbol to the library as a new one. Further changes to the symbol which are
  * saved will also become new symbols.
+ *
+ * @section editing_components Symbol Components
+ * Other symbols in the library can be added to the symbol being edited as components using the Use as Component
+ * command from the context menu of the library view. The components are drawn in the editor more faintly than
+ * the path being edited and can not be edited themselves, but they are rotated and flipped along with the path.
+ * The Remove Components command removes all the components from the symbol. Changing a symbol in the library
+ * updates all the symbols using it as a component.
  */
 
 
@@ -156,12 +163,16 @@
 #include <QMouseEvent>
 #include <QPainter>
 #include <QString>
+#include <QTransform>
 
 #include <KCharSelect>
 #include <KLocalizedString>
 
 #include <math.h>
 
+#include "EditorCache.h"
+#include "LatencyHistograms.h"
+#include "Profiling.h"
 #include "SymbolEditor.h"
 
 
@@ -205,17 +216,31 @@ const KLocalizedString statusMessages[][3] = {
  * Construct the Editor.
  * The editor is a sub class of a QWidget and is added to a layout widget.
  * The boundary edges of the symbol editor are defined in the range 0..1. These are used to intersect
- * the guidelines which are shown at the m_angles relative to existing points
+ * the guidelines which are shown at the angles of the EditorCache guide directions relative to existing points
  *
+ * @param cache a pointer to the EditorCache shared by the editors
  * @param parent a pointer to the parent widget, this is passed to the base class object
  */
-Editor::Editor(QWidget *parent)
+Editor::Editor(EditorCache *cache, QWidget *parent)
     :   QWidget(parent),
+        m_cache(cache),
+        m_active(false),
+        m_snap(true),
+        m_guides(true),
+        m_toolMode(MoveTo),
         m_index(0),
+        m_library(nullptr),
+        m_pathLayerGeneration(0),
+        m_pathLayerRequested(0),
+        m_draft(false),
         m_charSelect(nullptr)
 {
     readSettings();
 
+    m_draftTimer.setSingleShot(true);
+    m_draftTimer.setInterval(draftIdleDelay);
+    connect(&m_draftTimer, SIGNAL(timeout()), this, SLOT(restoreQuality()));
+
     setMouseTracking(true);
     setFocusPolicy(Qt::StrongFocus);
 
@@ -228,9 +253,11 @@ Editor::Editor(QWidget *parent)
 
 /**
  * Destructor for the Editor.
+ * Any render of the path still waiting is cancelled.
  */
 Editor::~Editor()
 {
+    m_pathLayerToken.cancel();
     delete m_charSelect;
 }
 
@@ -248,6 +275,23 @@ QPair<qint16, Symbol> Editor::symbol()
 }
 
 
+/**
+ * Get the Symbol with its components flattened into its path.
+ * This is the form of the symbol used for comparison with the rendered library symbols.
+ *
+ * @return a Symbol
+ */
+Symbol Editor::flattenedSymbol()
+{
+    Symbol symbol = this->symbol().second;
+    QPainterPath path = m_painterPath;
+    path.addPath(m_componentsPath);
+    symbol.setPath(path);
+    symbol.setComponents(QList<SymbolComponent>());
+    return symbol;
+}
+
+
 /**
  * Set the symbol and index to be edited.
  * The undo stack will be cleared.
@@ -261,7 +305,59 @@ void Editor::setSymbol(const QPair<qint16, Symbol> &pair)
     m_symbol = pair.second;
     m_painterPath = m_symbol.path();
     deconstructPainterPath();
-    update();
+    updateComponents();
+}
+
+
+/**
+ * Set the library used to resolve the components of the symbol.
+ *
+ * @param library a pointer to the SymbolLibrary
+ */
+void Editor::setLibrary(SymbolLibrary *library)
+{
+    m_library = library;
+    updateComponents();
+}
+
+
+/**
+ * Set the components of the symbol.
+ * Returns the original components for later undo.
+ *
+ * @param components a const reference to a QList of the SymbolComponent
+ *
+ * @return a QList of the original SymbolComponent
+ */
+QList<SymbolComponent> Editor::setComponents(const QList<SymbolComponent> &components)
+{
+    QList<SymbolComponent> original = m_symbol.components();
+    m_symbol.setComponents(components);
+    updateComponents();
+    return original;
+}
+
+
+/**
+ * Transform the components of the symbol.
+ * This is used by the rotate and flip functions so the components follow the points.
+ *
+ * @param transform a const reference to the QTransform to apply after the existing component transforms
+ */
+void Editor::transformComponents(const QTransform &transform)
+{
+    QList<SymbolComponent> components = m_symbol.components();
+
+    if (components.isEmpty()) {
+        return;
+    }
+
+    for (int i = 0 ; i < components.count() ; ++i) {
+        components[i].transform *= transform;
+    }
+
+    m_symbol.setComponents(components);
+    m_componentsPath = transform.map(m_componentsPath);
 }
 
 
@@ -392,84 +488,23 @@ void Editor::movePoint(int index, const QPointF &to)
 
 
 /**
- * Rotate all the points around the center of the symbol 90 degrees counter clockwise.
- */
-void Editor::rotatePointsLeft()
-{
-    for (int i = 0 ; i < m_points.count() ; ++i) {
-        QPointF p = m_points[i];
-        m_points[i] = QPointF(p.y(), 1.0 - p.x());
-    }
-
-    for (int i = 0 ; i < m_activePoints.count() ; ++i) {
-        QPointF p = m_activePoints[i];
-        m_activePoints[i] = QPointF(p.y(), 1.0 - p.x());
-    }
-
-    constructPainterPath();
-    update();
-}
-
-
-/**
- * Rotate all the points around the center of the symbol 90 degrees clockwise
- */
-void Editor::rotatePointsRight()
-{
-    for (int i = 0 ; i < m_points.count() ; ++i) {
-        QPointF p = m_points[i];
-        m_points[i] = QPointF(1.0 - p.y(), p.x());
-    }
-
-    for (int i = 0 ; i < m_activePoints.count() ; ++i) {
-        QPointF p = m_activePoints[i];
-        m_activePoints[i] = QPointF(1.0 - p.y(), p.x());
-    }
-
-    constructPainterPath();
-    update();
-}
-
-
-/**
- * Flip all the points about a vertical axis passing through the symbol center.
- */
-void Editor::flipPointsHorizontal()
-{
-    for (int i = 0 ; i < m_points.count() ; ++i) {
-        QPointF p = m_points[i];
-        p.setX(1.0 - p.x());
-        m_points[i] = p;
-    }
-
-    for (int i = 0 ; i < m_activePoints.count() ; ++i) {
-        QPointF p = m_activePoints[i];
-        p.setX(1.0 - p.x());
-        m_activePoints[i] = p;
-    }
-
-    constructPainterPath();
-    update();
-}
-
-
-/**
- * Flip all the points about a horizontal axis passing through the symbol center.
+ * Transform all the points and the components of the symbol.
+ * The rotate and flip commands use this with transforms that map the unit square onto itself,
+ * a merged command applying the combined transform of the commands merged into it.
+ *
+ * @param transform a const reference to the QTransform to apply, in symbol coordinates
  */
-void Editor::flipPointsVertical()
+void Editor::transformPoints(const QTransform &transform)
 {
     for (int i = 0 ; i < m_points.count() ; ++i) {
-        QPointF p = m_points[i];
-        p.setY(1.0 - p.y());
-        m_points[i] = p;
+        m_points[i] = transform.map(m_points.at(i));
     }
 
     for (int i = 0 ; i < m_activePoints.count() ; ++i) {
-        QPointF p = m_activePoints[i];
-        p.setY(1.0 - p.y());
-        m_activePoints[i] = p;
+        m_activePoints[i] = transform.map(m_activePoints.at(i));
     }
 
+    transformComponents(transform);
     constructPainterPath();
     update();
 }
@@ -571,6 +606,7 @@ void Editor::clear()
     m_index = 0;
     m_symbol = Symbol();
     m_painterPath = m_symbol.path();
+    m_componentsPath = QPainterPath();
     update();
 }
 
@@ -586,6 +622,32 @@ QUndoStack *Editor::undoStack()
 }
 
 
+/**
+ * Get the tool currently selected.
+ *
+ * @return the ToolMode of the tool
+ */
+Editor::ToolMode Editor::toolMode() const
+{
+    return m_toolMode;
+}
+
+
+/**
+ * Set whether this is the active editor.
+ * When several editors are shown the active one is highlighted with a frame.
+ *
+ * @param active true if the editor is to be highlighted, false otherwise
+ */
+void Editor::setActive(bool active)
+{
+    if (m_active != active) {
+        m_active = active;
+        update();
+    }
+}
+
+
 /**
  * Select the next tool.
  * Remove any points that may have been used in the last tool command but not yet committed.
@@ -774,6 +836,29 @@ void Editor::scalePreferred()
 }
 
 
+/**
+ * Remove all the components from the symbol.
+ */
+void Editor::removeComponents()
+{
+    if (!m_symbol.components().isEmpty()) {
+        m_undoStack.push(new ChangeComponentsCommand(this, QList<SymbolComponent>()));
+    }
+}
+
+
+/**
+ * Update the path of the components from the library.
+ * This is called when the components of the symbol change and when the library changes, as the
+ * component symbols may have been changed.
+ */
+void Editor::updateComponents()
+{
+    m_componentsPath = (m_library ? m_library->componentsPath(m_symbol) : QPainterPath());
+    update();
+}
+
+
 /**
  * Read the settings from the configuration file and apply them.
  * The widget is resized to accommodate a gridElements number of cells of width elementSize. An
@@ -790,14 +875,6 @@ void Editor::readSettings()
     m_preferredSizeColor = Configuration::editor_PreferredSizeColor();
     m_guideLineColor     = Configuration::editor_GuideLineColor();
 
-    m_angles.clear();
-
-    if (Configuration::editor_SimplifiedGuideLines()) {
-        m_angles << 0 << 45 << 90 << 135;
-    } else {
-        m_angles << 0 << 15 << 30 << 45 << 60 << 75 << 90 << 105 << 120 << 135 << 150 << 165;
-    }
-
     int minimumSize = m_elementSize * m_gridElements + 1;
     setMinimumSize(minimumSize, minimumSize);
 }
@@ -843,6 +920,10 @@ void Editor::mousePressEvent(QMouseEvent *event)
  * Guide lines are constructed for each of the existing points to show if the new
  * position lies in line with or at a specific angle to or on a circular path to
  * that point.
+ * Once the guide buffers have grown to the size needed for the points being edited, moving the
+ * mouse does not allocate, see constructGuides(). The cursor is only set when its shape changes
+ * and the timer restoring the full quality is not restarted on each move, as both allocate. This
+ * is checked by EditorAllocationTest.
  *
  * @param event a pointer to a QMouseEvent
  */
@@ -851,27 +932,34 @@ void Editor::mouseMoveEvent(QMouseEvent *event)
     QPoint p = event->pos();
 
     if (event->buttons() & Qt::LeftButton) {
-        if (m_tracking != snapPoint(p)) {
-            m_tracking = snapPoint(p);
+        QPointF tracking = snapPoint(p);
+
+        if (m_tracking != tracking) {
+            m_tracking = tracking;
 
             if (m_dragging) {
+                m_draft = true;
+                m_sinceDragged.start();
+
+                if (!m_draftTimer.isActive()) {
+                    m_draftTimer.start(draftIdleDelay);
+                }
+
                 if (m_dragPointIndex.first) {
                     m_points[m_dragPointIndex.second] = m_tracking;
-                    constructPainterPath();
+                    movePainterPathPoint(m_dragPointIndex.second);
                 } else {
                     m_activePoints[m_dragPointIndex.second] = m_tracking;
                 }
             } else if (m_toolMode == Rectangle || m_toolMode == Ellipse) {
                 m_rubberBand = QRectF(m_start, m_tracking).normalized();
             }
-
-            update();
         }
     } else {
-        if (node(toSymbol(p))) {
-            setCursor(Qt::SizeAllCursor);
-        } else {
-            setCursor(Qt::ArrowCursor);
+        Qt::CursorShape shape = (node(toSymbol(p)) ? Qt::SizeAllCursor : Qt::ArrowCursor);
+
+        if (cursor().shape() != shape) {
+            setCursor(shape);
         }
     }
 
@@ -903,6 +991,8 @@ void Editor::mouseReleaseEvent(QMouseEvent *event)
         }
 
         m_dragging = false;
+        m_draft = false;
+        m_draftTimer.stop();
     } else if (m_toolMode == Rectangle || m_toolMode == Ellipse) {
         m_rubberBand = QRectF();
 
@@ -996,66 +1086,35 @@ void Editor::resizeEvent(QResizeEvent *event)
 
 /**
  * Paint the contents of the editor.
- * This will fill the background and draw a grid based on the elementSize and elementGroup.
+ * This will draw the grid from the EditorCache, highlighting the editor if it is the active one.
  * For each element of the current path the control points are drawn with suitable lines
  * joining them, for example for a cubic curve, a curve is drawn, but the control points
  * are joined with dashed lines.
  * A complete path is constructed and painted in a light color with transparency to show
  * the current symbol shape.
+ * While a point is being dragged the editor is drawn without antialiasing, the path is drawn
+ * as an outline and the guide circles are left out.
  *
  * @param event a pointer to a QPaintEvent
  */
 void Editor::paintEvent(QPaintEvent *event)
 {
-    // initialise the painter
-    QPainter p(this);
-    p.setRenderHint(QPainter::Antialiasing, true);
-    p.fillRect(event->rect(), Qt::white);
-
-    QPen lightGray(Qt::lightGray);
-    lightGray.setCosmetic(true);
-
-    QPen darkGray(Qt::darkGray);
-    darkGray.setCosmetic(true);
-
-    // scale the painter to suit the number of elements in the grid
-    p.setWindow(0, 0, m_gridElements, m_gridElements);
-
-    // draw vertical grid
-    for (int x = 0 ; x <= m_gridElements ; ++x) {
-        if (x % m_elementGrouping) {
-            p.setPen(lightGray);
-        } else {
-            p.setPen(darkGray);
-        }
+    Q_UNUSED(event);
 
-        p.drawLine(x, 0, x, m_gridElements);
-    }
+    LatencyTimer latency(LatencyHistograms::EditorFrame);
 
-    // draw horizontal grid
-    for (int y = 0 ; y <= m_gridElements ; ++y) {
-        if (y % m_elementGrouping) {
-            p.setPen(lightGray);
-        } else {
-            p.setPen(darkGray);
-        }
+    // initialise the painter, the grid is shared by the editors and is stretched to the editor if it is not yet square
+    QPainter p(this);
+    p.drawPixmap(rect(), m_cache->grid(width(), devicePixelRatioF()));
+    p.setRenderHint(QPainter::Antialiasing, !m_draft);
 
-        p.drawLine(0, y, m_gridElements, y);
+    if (m_active) {
+        QPen highlightPen(palette().color(QPalette::Highlight), 2);
+        p.setPen(highlightPen);
+        p.setBrush(Qt::NoBrush);
+        p.drawRect(QRectF(rect()).adjusted(1, 1, -1, -1));
     }
 
-    // draw a rectangle representing the preferred symbol size allowing for some white space
-    QRectF preferredSizeRect = QRectF(0, 0, m_gridElements, m_gridElements).adjusted(m_borderSize, m_borderSize, -m_borderSize, -m_borderSize);
-
-    QColor preferredSizeColor(m_preferredSizeColor);
-    preferredSizeColor.setAlpha(128);
-
-    QPen preferredSizeColorPen(preferredSizeColor);
-    preferredSizeColorPen.setCosmetic(true);
-
-    p.setPen(preferredSizeColorPen);
-    p.setBrush(Qt::NoBrush);
-    p.drawRect(preferredSizeRect);
-
     // define a rectangle for the points
     QRectF dot(0, 0, m_pointSize, m_pointSize);
 
@@ -1144,18 +1203,28 @@ void Editor::paintEvent(QPaintEvent *event)
         }
     }
 
-    // scale the painter and draw the path
+    // draw the path and the components, complex paths are rendered on a worker thread and an outline
+    // of them is drawn until the image is ready, only the outline is drawn while a point is dragged
     QColor c(Qt::black);
     c.setAlpha(128);
     QPen pathPen(m_symbol.pen());
     pathPen.setColor(c);
-    p.setPen(pathPen);
 
     QBrush pathFill(m_symbol.brush());
     pathFill.setColor(c);
-    p.setBrush(pathFill);
 
-    p.drawPath(m_painterPath);
+    if (!m_draft && m_painterPath.elementCount() + m_componentsPath.elementCount() < offThreadElements) {
+        drawPathLayer(p, m_painterPath, m_componentsPath, pathPen, pathFill);
+    } else if (!m_draft && pathLayerReady(pathPen, pathFill)) {
+        p.drawImage(QRectF(0, 0, 1, 1), m_pathLayer);
+    } else {
+        QPen outlinePen(c);
+        outlinePen.setCosmetic(true);
+        p.setPen(outlinePen);
+        p.setBrush(Qt::NoBrush);
+        p.drawPath(m_painterPath);
+        p.drawPath(m_componentsPath);
+    }
 
     // draw the guidelines
     QColor guideLineColor(m_guideLineColor);
@@ -1177,12 +1246,145 @@ void Editor::paintEvent(QPaintEvent *event)
         p.drawLine(guideLine);
     }
 
+    if (m_draft) {
+        return;     // the guide circles are left out while dragging
+    }
+
     foreach (qreal guideCircle, m_guideCircles) {
         p.drawEllipse(QPointF(0.5, 0.5), guideCircle, guideCircle);
     }
 }
 
 
+/**
+ * Restore the full quality drawing when a dragged point has rested.
+ * If the point was moved since the timer was started, the timer is started again for the
+ * rest of the delay.
+ */
+void Editor::restoreQuality()
+{
+    qint64 elapsed = m_sinceDragged.elapsed();
+
+    if (m_dragging && elapsed < draftIdleDelay) {
+        m_draftTimer.start(draftIdleDelay - static_cast<int>(elapsed));
+        return;
+    }
+
+    m_draft = false;
+    update();
+}
+
+
+/**
+ * Check if the rendered path layer is ready to be drawn.
+ * If the path, the components, the rendering attributes or the size of the editor have changed
+ * since the last render was requested, any render still running is cancelled and a new one is
+ * scheduled. When the render completes the editor is updated to draw it.
+ *
+ * @param pen a const reference to the QPen used to draw the path
+ * @param brush a const reference to the QBrush used to fill the path
+ *
+ * @return true if m_pathLayer holds the current path, false if a render is pending
+ */
+bool Editor::pathLayerReady(const QPen &pen, const QBrush &brush)
+{
+    qreal devicePixelRatio = devicePixelRatioF();
+    QSize size = this->size() * devicePixelRatio;
+
+    if (m_pathLayerSize != size || m_pathLayerPen != pen || m_pathLayerBrush != brush || m_pathLayerPath != m_painterPath || m_pathLayerComponents != m_componentsPath) {
+        m_pathLayerToken.cancel();
+
+        m_pathLayerSize = size;
+        m_pathLayerPen = pen;
+        m_pathLayerBrush = brush;
+        m_pathLayerPath = m_painterPath;
+        m_pathLayerComponents = m_componentsPath;
+
+        int generation = ++m_pathLayerRequested;
+        QPainterPath path = m_painterPath;
+        QPainterPath components = m_componentsPath;
+
+        m_pathLayerToken = TaskScheduler::instance()->schedule<QImage>(TaskScheduler::Interactive, QByteArray(),
+            [path, components, pen, brush, size, devicePixelRatio](const TaskToken &) {
+                return renderPathLayer(path, components, pen, brush, size, devicePixelRatio);
+            },
+            this,
+            [this, generation](const QImage &image) {
+                if (generation == m_pathLayerRequested) {
+                    m_pathLayer = image;
+                    m_pathLayerGeneration = generation;
+                    update();
+                }
+            });
+    }
+
+    return (m_pathLayerGeneration == m_pathLayerRequested);
+}
+
+
+/**
+ * Draw the path and the components.
+ * The components are drawn more faintly than the path. The painter is expected to have its window
+ * set to the symbol coordinates.
+ *
+ * @param painter a reference to the QPainter
+ * @param path a const reference to the QPainterPath being edited
+ * @param components a const reference to the QPainterPath of the components
+ * @param pen a const reference to the QPen used to draw the path
+ * @param brush a const reference to the QBrush used to fill the path
+ */
+void Editor::drawPathLayer(QPainter &painter, const QPainterPath &path, const QPainterPath &components, const QPen &pen, const QBrush &brush)
+{
+    painter.setPen(pen);
+    painter.setBrush(brush);
+    painter.drawPath(path);
+
+    QColor c(pen.color());
+    c.setAlpha(64);
+
+    QPen componentsPen(pen);
+    componentsPen.setColor(c);
+
+    QBrush componentsFill(brush);
+    componentsFill.setColor(c);
+
+    painter.setPen(componentsPen);
+    painter.setBrush(componentsFill);
+    painter.drawPath(components);
+}
+
+
+/**
+ * Render the path and the components into an image.
+ * This is called on a worker thread so only uses the copies of the paths and attributes it is given.
+ *
+ * @param path a const reference to the QPainterPath being edited
+ * @param components a const reference to the QPainterPath of the components
+ * @param pen a const reference to the QPen used to draw the path
+ * @param brush a const reference to the QBrush used to fill the path
+ * @param size a const reference to the QSize of the image in device pixels
+ * @param devicePixelRatio the device pixel ratio of the editor
+ *
+ * @return a QImage containing the rendered paths on a transparent background
+ */
+QImage Editor::renderPathLayer(const QPainterPath &path, const QPainterPath &components, const QPen &pen, const QBrush &brush, const QSize &size, qreal devicePixelRatio)
+{
+    PROFILE_COUNT(PathLayersRendered);
+    PROFILE_TIMER(PathLayersRendered);
+
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(devicePixelRatio);
+    image.fill(Qt::transparent);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setWindow(0, 0, 1, 1);
+    drawPathLayer(painter, path, components, pen, brush);
+
+    return image;
+}
+
+
 /**
  * Process key presses to check for Escape to clear the current points being entered.
  *
@@ -1203,6 +1405,19 @@ void Editor::keyPressEvent(QKeyEvent *event)
 }
 
 
+/**
+ * Signal that the editor has become the active one when it gets the focus.
+ * The focus is given before a mouse press is processed so the editor is active before it is edited.
+ *
+ * @param event a pointer to a QFocusEvent
+ */
+void Editor::focusInEvent(QFocusEvent *event)
+{
+    QWidget::focusInEvent(event);
+    emit activated();
+}
+
+
 /**
  * Convert a point to a symbol point.
  *
@@ -1406,7 +1621,10 @@ void Editor::deconstructPainterPath()
  */
 void Editor::constructPainterPath()
 {
-    QPainterPath path;;
+    PROFILE_COUNT(PathRebuilds);
+    PROFILE_TIMER(PathRebuilds);
+
+    QPainterPath path;
 
     for (int i = 0, j = 0 ; i < m_elements.count() ; ++i) {
         QPainterPath::ElementType e = m_elements[i];
@@ -1435,6 +1653,25 @@ void Editor::constructPainterPath()
 }
 
 
+/**
+ * Move a point of the QPainterPath to the position it has in m_points.
+ * Each element of a path deconstructed into m_points has a point in the same position, so the
+ * element is moved in place rather than the path being constructed again. If the path has a
+ * different number of elements the path is constructed from the commands and points.
+ *
+ * @param index the index of the point in m_points
+ */
+void Editor::movePainterPathPoint(int index)
+{
+    if (m_painterPath.elementCount() == m_points.count()) {
+        const QPointF &point = m_points.at(index);
+        m_painterPath.setElementPositionAt(index, point.x(), point.y());
+    } else {
+        constructPainterPath();
+    }
+}
+
+
 /**
  * Construct guides for the cursor position point being tested relative to the other points.
  * Iterate through points in m_points and m_active points projecting them out in the directions
@@ -1445,28 +1682,37 @@ void Editor::constructPainterPath()
  * points are calculated for the projected lines and if these are close to the cursor position they
  * are added to the snap points along with the circles and lines.
  * If the generation of guide lines is turned off, the existing guides are cleared on no more are created.
+ * The guides are constructed into lists that are cleared rather than replaced, so they keep their capacity
+ * and no memory is allocated once they have grown to the size needed for the points being edited.
  *
  * @param to a const reference to a QPointF representing the cursor position
  */
 void Editor::constructGuides(const QPointF &to)
 {
+    LatencyTimer latency(LatencyHistograms::GuideBuild);
+
+#if defined(WITH_PROFILING)
+    qsizetype capacity = m_guideLines.capacity() + m_guideCircles.capacity() + m_snapPoints.capacity() + m_projectedLines.capacity() + m_nearCircles.capacity();
+#endif
+
     m_guideLines.clear();
     m_guideCircles.clear();
     m_snapPoints.clear();
+    m_projectedLines.clear();
+    m_nearCircles.clear();
 
     if (!m_guides) {
         return;
     }
 
-    QList<QPointF> points;
-    points << m_points << m_activePoints;   // construct list of all points on screen
-
-    QList<double> guideCircles;             // local list of circles, used for filtering
-    QList<QLineF> guideLines;               // local list of lines, used for filtering
-
+    const QVector<QPointF> &directions = m_cache->guideDirections();
     double radiusTo = sqrt(pow(0.5 - to.x(), 2) + pow(0.5 - to.y(), 2));
+    int committed = m_points.count();
+
+    // iterate all the points on screen, the committed points followed by the active points
+    for (int n = 0 ; n < committed + m_activePoints.count() ; ++n) {
+        const QPointF &from = (n < committed) ? m_points.at(n) : m_activePoints.at(n - committed);
 
-    foreach (const QPointF &from, points) {
         if ((from - to).manhattanLength() < m_snapThreshold * 2) {
             continue;    // cursor close to existing point so ignore it
         }
@@ -1474,20 +1720,22 @@ void Editor::constructGuides(const QPointF &to)
         double radiusFrom = sqrt(pow(0.5 - from.x(), 2) + pow(0.5 - from.y(), 2));
 
         if (fabs(radiusTo - radiusFrom) < m_snapThreshold) {
-            guideCircles.append(radiusFrom);
+            m_nearCircles.append(radiusFrom);
         }
 
         // construct line guides
-        QLineF guideLine(from, from + QPointF(1.0, 0.0));
-
-        foreach (double angle, m_angles) {
-            guideLine.setAngle(angle);
-            QLineF projectedGuideLine = projected(guideLine);
+        for (int d = 0 ; d < directions.count() ; ++d) {
+            QLineF projectedGuideLine = projected(QLineF(from, from + directions.at(d)));
+            PROFILE_COUNT(GuideLinesGenerated);
 
             QPointF intersection;
 
-            foreach (const QLineF &line, guideLines) {
-		if (projectedGuideLine.intersects(line, &intersection)) {
+            PROFILE_COUNT_N(IntersectionsTested, m_projectedLines.count());
+
+            for (int l = 0 ; l < m_projectedLines.count() ; ++l) {
+                const QLineF &line = m_projectedLines.at(l);
+
+                if (projectedGuideLine.intersects(line, &intersection)) {
                     if (((to - intersection).manhattanLength() < m_snapThreshold)) {
                         addGuideLine(line);
                         addGuideLine(projectedGuideLine);
@@ -1496,12 +1744,17 @@ void Editor::constructGuides(const QPointF &to)
                 }
             }
 
-            guideLines.append(projectedGuideLine);
+            m_projectedLines.append(projectedGuideLine);
         }
 
         // construct circle guides
-        foreach (double radius, guideCircles) {
-            foreach (const QLineF &line, guideLines) {
+        for (int c = 0 ; c < m_nearCircles.count() ; ++c) {
+            double radius = m_nearCircles.at(c);
+
+            PROFILE_COUNT_N(IntersectionsTested, m_projectedLines.count());
+
+            for (int l = 0 ; l < m_projectedLines.count() ; ++l) {
+                const QLineF &line = m_projectedLines.at(l);
                 double ax = line.x1();
                 double ay = line.y1();
                 double bx = line.x2();
@@ -1553,6 +1806,12 @@ void Editor::constructGuides(const QPointF &to)
             }
         }
     }
+
+#if defined(WITH_PROFILING)
+    if (m_guideLines.capacity() + m_guideCircles.capacity() + m_snapPoints.capacity() + m_projectedLines.capacity() + m_nearCircles.capacity() > capacity) {
+        PROFILE_COUNT(GuideBufferGrowths);
+    }
+#endif
 }
 
 
@@ -19,20 +19,32 @@
 #define Editor_H
 
 
+#include <QBrush>
+#include <QElapsedTimer>
+#include <QImage>
 #include <QMap>
 #include <QPainterPath>
 #include <QPair>
+#include <QPen>
 #include <QPointF>
+#include <QSize>
+#include <QTimer>
 #include <QUndoStack>
 #include <QWidget>
 
 #include "Commands.h"
+#include "TaskScheduler.h"
 
 
+class QPainter;
 class QPaintEvent;
+class QTransform;
 
+class EditorCache;
 class KCharSelect;
 
+class SymbolLibrary;
+
 
 /**
  * @brief Manages the editor window allowing user interaction with the various tools.
@@ -67,6 +79,18 @@ class KCharSelect;
  * editor aligns with an existing point either horizontally, vertically or at a pre-defined
  * angle, or if the point lies on the same circle as the original where its origin is at
  * the center of the grid.
+ *
+ * The components of the symbol are resolved using the SymbolLibrary and drawn behind the
+ * path being edited. They are not editable but follow the rotate and flip tools.
+ *
+ * Complex paths, such as those of characters, are rendered into an image on a worker thread when
+ * they change so that drawing the editor remains quick. A thin outline of the path is drawn until
+ * the image is ready. The points and guides are always drawn directly. While a point is dragged the
+ * editor is drawn without antialiasing, showing only the outline of the path and the guide lines, the full
+ * quality being restored when the point is released or rests.
+ *
+ * Several editors can be shown side by side, each with its own symbol and undo stack. The grid
+ * and the guide directions are taken from an EditorCache shared by all of them.
  */
 class Editor : public QWidget
 {
@@ -75,11 +99,13 @@ class Editor : public QWidget
 public:
     enum ToolMode {MoveTo, LineTo, CubicTo, Rectangle, Ellipse, Character};
 
-    explicit Editor(QWidget *parent = nullptr);
+    explicit Editor(EditorCache *cache, QWidget *parent = nullptr);
     virtual ~Editor();
 
     QPair<qint16, Symbol> symbol();
+    Symbol flattenedSymbol();
     void setSymbol(const QPair<qint16, Symbol> &pair);
+    void setLibrary(SymbolLibrary *library);
 
     QPainterPath moveTo(const QPointF &to);
     QPainterPath lineTo(const QPointF &to);
@@ -88,21 +114,21 @@ public:
     QPainterPath addEllipse(const QPointF &from, const QPointF &to);
     void removeLast(const QPainterPath &path);
     void movePoint(int index, const QPointF &to);
-    void rotatePointsLeft();
-    void rotatePointsRight();
-    void flipPointsHorizontal();
-    void flipPointsVertical();
+    void transformPoints(const QTransform &transform);
     void setFilled(bool filled);
     void setFillRule(Qt::FillRule rule);
     void setCapStyle(Qt::PenCapStyle capStyle);
     void setJoinStyle(Qt::PenJoinStyle joinStyle);
     void setLineWidth(double width);
     QPainterPath setPath(const QPainterPath &path);
+    QList<SymbolComponent> setComponents(const QList<SymbolComponent> &components);
 
     void clear();
 
     QUndoStack *undoStack();
+    ToolMode toolMode() const;
 
+    void setActive(bool active);
     void updateStatusMessage();
 
 public slots:
@@ -122,13 +148,19 @@ public slots:
     void flipHorizontal();
     void flipVertical();
     void scalePreferred();
+    void removeComponents();
 
+    void updateComponents();
     void readSettings();
 
 signals:
     void message(const QString &text);
     void minLineWidth(bool reached);
     void maxLineWidth(bool reached);
+    void activated();
+
+private slots:
+    void restoreQuality();
 
 protected:
     virtual void mousePressEvent(QMouseEvent *event) Q_DECL_OVERRIDE;
@@ -139,6 +171,7 @@ protected:
     virtual void paintEvent(QPaintEvent *event) Q_DECL_OVERRIDE;
 
     virtual void keyPressEvent(QKeyEvent *event) Q_DECL_OVERRIDE;
+    virtual void focusInEvent(QFocusEvent *event) Q_DECL_OVERRIDE;
 
 private:
     void addPoint(const QPointF &point);
@@ -150,13 +183,25 @@ private:
     QPair<bool, int> nodeUnderCursor(const QPointF &point) const;
     void deconstructPainterPath();
     void constructPainterPath();
+    void movePainterPathPoint(int index);
     void constructGuides(const QPointF &to);
     void addGuideLine(const QLineF &line);
     void addGuideCircle(double radius);
     void addSnapPoint(const QPointF &point);
     QLineF projected(const QLineF &line) const;
+    void transformComponents(const QTransform &transform);
+    bool pathLayerReady(const QPen &pen, const QBrush &brush);
+
+    static void drawPathLayer(QPainter &painter, const QPainterPath &path, const QPainterPath &components, const QPen &pen, const QBrush &brush);
+    static QImage renderPathLayer(const QPainterPath &path, const QPainterPath &components, const QPen &pen, const QBrush &brush, const QSize &size, qreal devicePixelRatio);
+
+    static const int offThreadElements = 256;       /**< the number of path elements from which the path is rendered on a worker thread */
+    static const int draftIdleDelay = 250;          /**< the time in milliseconds a dragged point must rest for before full quality is restored */
+
+    EditorCache *m_cache;                           /**< pointer to the EditorCache shared with the other editor panes */
 
     int     m_size;                                 /**< the overall size of the editor */
+    bool    m_active;                               /**< true if the editor is the active one of several panes */
 
     bool    m_snap;                                 /**< true if snap mode is enabled */
     bool    m_fill;                                 /**< true if fill mode is enabled */
@@ -174,17 +219,33 @@ private:
     qint16              m_index;                    /**< the index of the symbol as stored in the library, this is 0 for new symbols */
     QPainterPath        m_painterPath;              /**< the path from m_symbol currently being edited */
     Symbol              m_symbol;                   /**< the symbol containing the QPainterPath and rendering attributes */
+    SymbolLibrary       *m_library;                 /**< pointer to the SymbolLibrary used to resolve the components, may be null */
+    QPainterPath        m_componentsPath;           /**< the flattened paths of the components of m_symbol */
+
+    QImage              m_pathLayer;                /**< the path and components rendered on a worker thread */
+    int                 m_pathLayerGeneration;      /**< the generation of the render in m_pathLayer */
+    int                 m_pathLayerRequested;       /**< the generation of the latest render requested */
+    QPainterPath        m_pathLayerPath;            /**< the path of the latest render requested */
+    QPainterPath        m_pathLayerComponents;      /**< the components path of the latest render requested */
+    QPen                m_pathLayerPen;             /**< the pen of the latest render requested */
+    QBrush              m_pathLayerBrush;           /**< the brush of the latest render requested */
+    QSize               m_pathLayerSize;            /**< the size in device pixels of the latest render requested */
+    TaskToken           m_pathLayerToken;           /**< token allowing the latest render to be cancelled */
 
     bool                m_dragging;                 /**< true if currently dragging a point around */
     QPointF             m_start;                    /**< the start position of a drag operation or the start of a rubber band selection */
     QPointF             m_tracking;                 /**< the current position of a drag operation or the position of a rubber band selection */
     QRectF              m_rubberBand;               /**< a rubber band rectangle in symbol coordinates, is null when not required */
     QPair<bool, int>    m_dragPointIndex;           /**< represents the list and index of the point being moved, true for m_points, false for m_activePoints */
+    bool                m_draft;                    /**< true if drawing with the interactive quality while a point is dragged */
+    QTimer              m_draftTimer;               /**< single shot timer restoring the full quality when a dragged point rests */
+    QElapsedTimer       m_sinceDragged;             /**< time since a point was last dragged, the timer is only restarted when it expires */
 
-    QVector<qreal>      m_angles;                   /**< the angles allowed for constructing guide lines */
     QList<QLineF>       m_guideLines;               /**< the guide lines that have been constructed for a given point */
     QList<qreal>        m_guideCircles;             /**< the guide circles that have been constructed for a given point */
     QList<QPointF>      m_snapPoints;               /**< points that intersect with guide lines */
+    QList<QLineF>       m_projectedLines;           /**< the lines projected from each point while constructing guides, reused to avoid allocation */
+    QList<qreal>        m_nearCircles;              /**< the circles near the cursor while constructing guides, reused to avoid allocation */
     QLineF              m_topEdge;                  /**< represents the top edge of the editor from 0,0 to 1,0 */
     QLineF              m_bottomEdge;               /**< represents the bottom edge of the editor from 0,1 to 1,1 */
     QLineF              m_leftEdge;                 /**< represents the left edge of the editor from 0,1 to 0,1 */
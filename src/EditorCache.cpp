@@ -0,0 +1,148 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Implement the EditorCache class.
+ */
+
+
+#include "EditorCache.h"
+
+#include <QPainter>
+#include <QPen>
+#include <QRectF>
+
+#include <math.h>
+
+#include "SymbolEditor.h"
+
+
+/**
+ * Constructor.
+ * The settings are read so that the cache is ready before the first editor is created.
+ */
+EditorCache::EditorCache()
+    :   m_grids(cachedGridBytes)
+{
+    readSettings();
+}
+
+
+/**
+ * Read the settings from the configuration file.
+ * The cached grids are discarded and the guide directions calculated for the configured angles.
+ */
+void EditorCache::readSettings()
+{
+    m_gridElements       = Configuration::editor_GridElements();
+    m_elementGrouping    = Configuration::editor_ElementGrouping();
+    m_borderSize         = Configuration::editor_BorderSize();
+    m_preferredSizeColor = Configuration::editor_PreferredSizeColor();
+
+    m_grids.clear();
+
+    QVector<qreal> angles;
+
+    if (Configuration::editor_SimplifiedGuideLines()) {
+        angles << 0 << 45 << 90 << 135;
+    } else {
+        angles << 0 << 15 << 30 << 45 << 60 << 75 << 90 << 105 << 120 << 135 << 150 << 165;
+    }
+
+    m_guideDirections.clear();
+
+    // the y axis of the editor points down, so positive angles are counter clockwise as with QLineF::setAngle
+    foreach (qreal angle, angles) {
+        qreal radians = angle * M_PI / 180.0;
+        m_guideDirections.append(QPointF(cos(radians), -sin(radians)));
+    }
+}
+
+
+/**
+ * Get the grid for an editor.
+ * The grid is drawn on a white background with the lines of each group of elements darker than the
+ * others, and a rectangle representing the preferred symbol size allowing for some white space. The
+ * pixmap is drawn the first time it is requested for a size and taken from the cache after that.
+ *
+ * @param size the width and height of the editor in device independent pixels
+ * @param devicePixelRatio the device pixel ratio of the editor
+ *
+ * @return a QPixmap containing the grid
+ */
+QPixmap EditorCache::grid(int size, qreal devicePixelRatio)
+{
+    QPair<int, qreal> key(size, devicePixelRatio);
+
+    if (QPixmap *pixmap = m_grids.object(key)) {
+        return *pixmap;
+    }
+
+    QPixmap pixmap(QSize(size, size) * devicePixelRatio);
+    pixmap.setDevicePixelRatio(devicePixelRatio);
+    pixmap.fill(Qt::white);
+
+    QPainter p(&pixmap);
+    p.setRenderHint(QPainter::Antialiasing, true);
+
+    QPen lightGray(Qt::lightGray);
+    lightGray.setCosmetic(true);
+
+    QPen darkGray(Qt::darkGray);
+    darkGray.setCosmetic(true);
+
+    // scale the painter to suit the number of elements in the grid
+    p.setWindow(0, 0, m_gridElements, m_gridElements);
+
+    // draw vertical grid
+    for (int x = 0 ; x <= m_gridElements ; ++x) {
+        p.setPen((x % m_elementGrouping) ? lightGray : darkGray);
+        p.drawLine(x, 0, x, m_gridElements);
+    }
+
+    // draw horizontal grid
+    for (int y = 0 ; y <= m_gridElements ; ++y) {
+        p.setPen((y % m_elementGrouping) ? lightGray : darkGray);
+        p.drawLine(0, y, m_gridElements, y);
+    }
+
+    // draw a rectangle representing the preferred symbol size allowing for some white space
+    QRectF preferredSizeRect = QRectF(0, 0, m_gridElements, m_gridElements).adjusted(m_borderSize, m_borderSize, -m_borderSize, -m_borderSize);
+
+    QColor preferredSizeColor(m_preferredSizeColor);
+    preferredSizeColor.setAlpha(128);
+
+    QPen preferredSizeColorPen(preferredSizeColor);
+    preferredSizeColorPen.setCosmetic(true);
+
+    p.setPen(preferredSizeColorPen);
+    p.setBrush(Qt::NoBrush);
+    p.drawRect(preferredSizeRect);
+    p.end();
+
+    m_grids.insert(key, new QPixmap(pixmap), static_cast<int>(pixmap.width() * pixmap.height() * pixmap.depth() / 8));
+
+    return pixmap;
+}
+
+
+/**
+ * Get the directions of the guide lines.
+ * Each direction is a unit vector at one of the configured angles, a guide line through a point
+ * being the line from the point to the point plus the direction.
+ *
+ * @return a const reference to a QVector of QPointF
+ */
+const QVector<QPointF> &EditorCache::guideDirections() const
+{
+    return m_guideDirections;
+}
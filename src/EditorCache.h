@@ -0,0 +1,63 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Header file for the EditorCache class.
+ */
+
+
+#ifndef EditorCache_H
+#define EditorCache_H
+
+
+#include <QCache>
+#include <QColor>
+#include <QPair>
+#include <QPixmap>
+#include <QPointF>
+#include <QVector>
+
+
+/**
+ * @brief Holds the drawing resources shared by the editor panes.
+ *
+ * The grid drawn behind the symbol only depends on the configuration and the size of the editor,
+ * so it is drawn once into a pixmap for each size and shared by all the panes rather than being
+ * drawn line by line on each paint. The directions of the guide lines are calculated once from the
+ * configured angles rather than for each point as the guides are constructed.
+ *
+ * The cached resources are rebuilt when readSettings() is called after the configuration changes.
+ */
+class EditorCache
+{
+public:
+    EditorCache();
+
+    void readSettings();
+
+    QPixmap grid(int size, qreal devicePixelRatio);
+    const QVector<QPointF> &guideDirections() const;
+
+private:
+    static const int cachedGridBytes = 16 << 20;    /**< the total size of the grid pixmaps kept in the cache */
+
+    int     m_gridElements;                         /**< The number of grid elements (Configuration::editor_GridElements) */
+    int     m_elementGrouping;                      /**< The number of cells in a group (Configuration::editor_ElementGrouping) */
+    int     m_borderSize;                           /**< The number of cell elements used for the border (Configuration::editor_BorderSize) */
+    QColor  m_preferredSizeColor;                   /**< The color of the preferred size square (Configuration::editor_PreferredSizeColor) */
+
+    QVector<QPointF>                        m_guideDirections;  /**< unit vectors at the angles allowed for constructing guide lines */
+    QCache<QPair<int, qreal>, QPixmap>      m_grids;            /**< cache of the grid pixmaps keyed by the size and device pixel ratio */
+};
+
+
+#endif
@@ -116,3 +116,16 @@ InvalidSymbolVersion::InvalidSymbolVersion(qint32 v)
     :   version(v)
 {
 }
+
+
+/**
+ * Constructor
+ *
+ * @param f the name of the file that was being accessed
+ * @param e the description of the error
+ */
+FailedFileAccess::FailedFileAccess(const QString &f, const QString &e)
+    :   fileName(f),
+        errorString(e)
+{
+}
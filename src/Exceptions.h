@@ -20,6 +20,7 @@
 
 
 #include <QDataStream>
+#include <QString>
 #include <QtGlobal>
 
 
@@ -97,4 +98,19 @@ public:
 };
 
 
+/**
+ * @brief Failed to access a file exception class.
+ *
+ * This is thrown when a file of a library collection could not be opened or committed.
+ */
+class FailedFileAccess
+{
+public:
+    FailedFileAccess(const QString &f, const QString &e);
+
+    QString fileName;               /**< the name of the file being accessed */
+    QString errorString;            /**< the description of the error */
+};
+
+
 #endif
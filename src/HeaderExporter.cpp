@@ -0,0 +1,256 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Implement the HeaderExporter class.
+ */
+
+
+/**
+ * @page header_export C++ Header Export
+ * File->Export C++ Header writes the symbols of the library as a C++17 header for applications that embed a fixed
+ * set of symbols and would otherwise read a library file when they start. All the declarations are placed in a
+ * namespace named after the header file.
+ *
+ * Each symbol is written as an inline constexpr array of Element, each element having a type and a coordinate.
+ * The types follow QPainterPath::ElementType, a CurveTo element being followed by two CurveToData elements giving
+ * the second control point and the end point. The symbols array holds a SymbolData for each symbol with its
+ * index, its elements, whether it is filled, its fill rule, its line width, its cap style and its join style.
+ * The integer attributes hold the values of the corresponding Qt enumerations. Symbols using components are
+ * written with the components merged into their path.
+ *
+ * The header has no dependencies. The toPath() function template builds a path from a SymbolData using the
+ * moveTo, lineTo, cubicTo and setFillRule functions of the path type, so it can be instantiated with QPainterPath
+ * or with another type providing the same functions. The find() function returns the SymbolData for an index and
+ * can be evaluated at compile time.
+ */
+
+
+#include "HeaderExporter.h"
+
+#include <QFileInfo>
+#include <QPainterPath>
+#include <QSaveFile>
+#include <QTextStream>
+
+#include <KLocalizedString>
+
+#include "Exceptions.h"
+#include "Symbol.h"
+#include "SymbolLibrary.h"
+
+
+/**
+ * Write the symbols of a library to a header file.
+ * The namespace is derived from the base name of the file. The file is written with a QSaveFile so
+ * that an existing header is only replaced if the new one is written completely.
+ *
+ * @param library a pointer to the SymbolLibrary to export
+ * @param fileName the name of the header file
+ */
+void HeaderExporter::write(SymbolLibrary *library, const QString &fileName)
+{
+    QString name = identifier(QFileInfo(fileName).completeBaseName());
+    QString guard = name.toUpper() + QLatin1String("_H");
+
+    QSaveFile file(fileName);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        throw FailedFileAccess(fileName, file.errorString());
+    }
+
+    QTextStream stream(&file);
+
+    stream << "// Generated by SymbolEditor, do not edit.\n"
+           << "\n"
+           << "#ifndef " << guard << "\n"
+           << "#define " << guard << "\n"
+           << "\n"
+           << "\n"
+           << "namespace " << name << "\n"
+           << "{\n"
+           << "enum ElementType : unsigned char { MoveTo, LineTo, CurveTo, CurveToData };\n"
+           << "\n"
+           << "struct Element {\n"
+           << "    ElementType type;\n"
+           << "    double x;\n"
+           << "    double y;\n"
+           << "};\n"
+           << "\n"
+           << "struct SymbolData {\n"
+           << "    short index;\n"
+           << "    const Element *elements;\n"
+           << "    int elementCount;\n"
+           << "    bool filled;\n"
+           << "    int fillRule;\n"
+           << "    double lineWidth;\n"
+           << "    int capStyle;\n"
+           << "    int joinStyle;\n"
+           << "};\n"
+           << "\n";
+
+    QList<qint16> indexes = library->indexes();
+    QList<Symbol> symbols;
+
+    foreach (qint16 index, indexes) {
+        Symbol symbol = library->flattenedSymbol(index);
+        symbols.append(symbol);
+
+        if (!symbol.path().isEmpty()) {
+            writeSymbol(stream, index, symbol);
+        }
+    }
+
+    stream << "inline constexpr SymbolData symbols[] = {\n";
+
+    for (int i = 0 ; i < symbols.count() ; ++i) {
+        const Symbol &symbol = symbols.at(i);
+        QPainterPath path = symbol.path();
+
+        stream << "    { " << indexes.at(i) << ", ";
+
+        if (path.isEmpty()) {
+            stream << "nullptr, 0, ";
+        } else {
+            stream << "symbol" << indexes.at(i) << ", " << path.elementCount() << ", ";
+        }
+
+        stream << (symbol.filled() ? "true" : "false") << ", "
+               << static_cast<int>(path.fillRule()) << ", "
+               << number(symbol.lineWidth()) << ", "
+               << static_cast<int>(symbol.capStyle()) << ", "
+               << static_cast<int>(symbol.joinStyle()) << " },\n";
+    }
+
+    if (symbols.isEmpty()) {
+        stream << "    { -1, nullptr, 0, false, 0, 0.0, 0, 0 }\n";
+    }
+
+    stream << "};\n"
+           << "\n"
+           << "inline constexpr int symbolCount = " << symbols.count() << ";\n"
+           << "\n"
+           << "constexpr const SymbolData *find(short index)\n"
+           << "{\n"
+           << "    for (int i = 0 ; i < symbolCount ; ++i) {\n"
+           << "        if (symbols[i].index == index) {\n"
+           << "            return &symbols[i];\n"
+           << "        }\n"
+           << "    }\n"
+           << "\n"
+           << "    return nullptr;\n"
+           << "}\n"
+           << "\n"
+           << "template <typename Path>\n"
+           << "Path toPath(const SymbolData &symbol)\n"
+           << "{\n"
+           << "    Path path;\n"
+           << "\n"
+           << "    for (int i = 0 ; i < symbol.elementCount ; ++i) {\n"
+           << "        const Element &element = symbol.elements[i];\n"
+           << "\n"
+           << "        if (element.type == MoveTo) {\n"
+           << "            path.moveTo(element.x, element.y);\n"
+           << "        } else if (element.type == LineTo) {\n"
+           << "            path.lineTo(element.x, element.y);\n"
+           << "        } else if (element.type == CurveTo && i + 2 < symbol.elementCount) {\n"
+           << "            const Element &control = symbol.elements[i + 1];\n"
+           << "            const Element &end = symbol.elements[i + 2];\n"
+           << "            path.cubicTo(element.x, element.y, control.x, control.y, end.x, end.y);\n"
+           << "            i += 2;\n"
+           << "        }\n"
+           << "    }\n"
+           << "\n"
+           << "    path.setFillRule(static_cast<decltype(path.fillRule())>(symbol.fillRule));\n"
+           << "\n"
+           << "    return path;\n"
+           << "}\n"
+           << "}\n"
+           << "\n"
+           << "\n"
+           << "#endif\n";
+
+    stream.flush();
+
+    if (stream.status() != QTextStream::Ok || !file.commit()) {
+        throw FailedFileAccess(fileName, file.errorString().isEmpty() ? i18n("The header could not be written") : file.errorString());
+    }
+}
+
+
+/**
+ * Convert a name to a valid C++ identifier.
+ * Characters that are not letters, digits or underscores are replaced by underscores and a leading
+ * digit is prefixed by an underscore.
+ *
+ * @param name the name to convert
+ *
+ * @return a QString containing the identifier
+ */
+QString HeaderExporter::identifier(const QString &name)
+{
+    QString result;
+
+    foreach (const QChar &c, name) {
+        result.append((c.isLetterOrNumber() && c.unicode() < 128) ? c : QChar(QLatin1Char('_')));
+    }
+
+    if (result.isEmpty() || result.at(0).isDigit()) {
+        result.prepend(QLatin1Char('_'));
+    }
+
+    return result;
+}
+
+
+/**
+ * Write the array of elements for a symbol.
+ *
+ * @param stream a reference to the QTextStream to write to
+ * @param index the index of the symbol, used to name the array
+ * @param symbol a const reference to the flattened Symbol
+ */
+void HeaderExporter::writeSymbol(QTextStream &stream, qint16 index, const Symbol &symbol)
+{
+    static const char *types[] = {"MoveTo", "LineTo", "CurveTo", "CurveToData"};
+
+    QPainterPath path = symbol.path();
+
+    stream << "inline constexpr Element symbol" << index << "[] = {\n";
+
+    for (int i = 0 ; i < path.elementCount() ; ++i) {
+        const QPainterPath::Element &element = path.elementAt(i);
+        stream << "    { " << types[element.type] << ", " << number(element.x) << ", " << number(element.y) << " },\n";
+    }
+
+    stream << "};\n"
+           << "\n";
+}
+
+
+/**
+ * Format a coordinate so that it is read back exactly.
+ *
+ * @param value the value to format
+ *
+ * @return a QString containing a double literal
+ */
+QString HeaderExporter::number(qreal value)
+{
+    QString text = QString::number(value, 'g', 17);
+
+    if (!text.contains(QLatin1Char('.')) && !text.contains(QLatin1Char('e'))) {
+        text.append(QLatin1String(".0"));
+    }
+
+    return text;
+}
@@ -0,0 +1,52 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Header file for the HeaderExporter class.
+ */
+
+
+#ifndef HeaderExporter_H
+#define HeaderExporter_H
+
+
+#include <QString>
+
+
+class QTextStream;
+
+class Symbol;
+class SymbolLibrary;
+
+
+/**
+ * @brief Exports the symbols of a library as a C++ header.
+ *
+ * The header contains constexpr arrays of the path elements of each symbol together with its
+ * rendering attributes, and a templated function that builds a path from them. Applications
+ * embedding a fixed set of symbols can include the header instead of reading a library file
+ * at run time.
+ */
+class HeaderExporter
+{
+public:
+    static void write(SymbolLibrary *library, const QString &fileName);
+
+    static QString identifier(const QString &name);
+
+private:
+    static void writeSymbol(QTextStream &stream, qint16 index, const Symbol &symbol);
+    static QString number(qreal value);
+};
+
+
+#endif
@@ -0,0 +1,467 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Implement the LatencyHistograms class.
+ */
+
+
+/**
+ * @page latency_histograms Latency Histograms
+ * When enabled in the @ref diagnostics_dialog, the time taken by the operations the user waits for is recorded
+ * in a histogram for each operation. The operations are opening, importing and saving libraries, requesting the
+ * icons of the visible items of the library view, painting an editor pane, constructing the guides and undoing
+ * or redoing a command. Bucket n of a histogram counts the times below 2^n microseconds not counted by the
+ * previous buckets, the last bucket counting all the longer times.
+ *
+ * The histograms are kept separately for each version of the application, so that releases can be compared,
+ * and are stored in latency.dat in the application data directory. The histograms recorded in a session are
+ * added to those in the file when the application exits. The file is read again while holding latency.dat.lock
+ * before the histograms are added and written, so instances of the application exiting at the same time add
+ * to each other's histograms rather than replacing them. Exiting waits only briefly for the lock, the session
+ * histograms being lost rather than delaying the exit if another instance holds it. The file is written with a QDataStream with its
+ * version set to QDataStream::Qt_5_0 as
+ * - the raw bytes "SymbolLatency"
+ * - qint32 the version of the file, currently 100
+ * - QString a description of the computer the histograms were recorded on
+ * - QMap<QString, QVector<QVector<quint64> > > the histograms of each operation for each application version
+ *
+ * A file with a different description of the computer is replaced rather than added to, so the histograms
+ * always describe a single computer. The description is made of the type of the operating system kernel, the
+ * processor architecture and the number of threads, so it does not change when the operating system is updated.
+ */
+
+
+#include "LatencyHistograms.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QSysInfo>
+#include <QThread>
+#include <QtAlgorithms>
+
+#include <KLocalizedString>
+
+#include <atomic>
+
+
+namespace
+{
+const qint32 version = 100;                 /**< version of the latency file */
+const int lockTimeout = 250;                /**< time in milliseconds to wait for another instance to release the lock of the latency file */
+
+std::atomic<bool> enabled(false);           /**< true if the times are being recorded */
+std::atomic<quint64> counts[LatencyHistograms::OperationCount][LatencyHistograms::bucketCount];  /**< the histograms recorded in this session */
+
+QMutex mutex;                               /**< protects the stored histograms */
+QMap<QString, QVector<QVector<quint64> > > stored;  /**< the histograms read from the file for each application version */
+
+
+/**
+ * Read the histograms from a latency file.
+ *
+ * @param fileName a const reference to a QString containing the path of the file
+ * @param machine a const reference to a QString containing the description of this computer
+ * @param histograms a reference to a QMap to receive the histograms of each application version
+ *
+ * @return true if the histograms were read, false for a missing, unreadable or foreign file
+ */
+bool readHistograms(const QString &fileName, const QString &machine, QMap<QString, QVector<QVector<quint64> > > &histograms)
+{
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    char magic[13];
+    qint32 fileVersion;
+    QString fileMachine;
+
+    if (stream.readRawData(magic, 13) != 13 || qstrncmp(magic, "SymbolLatency", 13) != 0) {
+        return false;
+    }
+
+    stream >> fileVersion;
+
+    if (fileVersion != version) {
+        return false;
+    }
+
+    stream >> fileMachine >> histograms;
+
+    if (stream.status() != QDataStream::Ok || fileMachine != machine) {
+        histograms.clear();
+        return false;
+    }
+
+    for (QMap<QString, QVector<QVector<quint64> > >::iterator i = histograms.begin() ; i != histograms.end() ; ++i) {
+        i.value().resize(LatencyHistograms::OperationCount);
+    }
+
+    return true;
+}
+}
+
+
+/**
+ * Check if the times are being recorded.
+ *
+ * @return true if recording is enabled
+ */
+bool LatencyHistograms::isEnabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+
+/**
+ * Enable or disable recording the times.
+ *
+ * @param enable true to record the times, false to stop recording them
+ */
+void LatencyHistograms::setEnabled(bool enable)
+{
+    enabled.store(enable, std::memory_order_relaxed);
+}
+
+
+/**
+ * Record the time taken by an operation.
+ * The time is counted in the bucket of the histogram of the operation that covers it.
+ *
+ * @param operation the LatencyHistograms::Operation timed
+ * @param nsecs the time in nanoseconds
+ */
+void LatencyHistograms::record(Operation operation, qint64 nsecs)
+{
+    quint64 usecs = static_cast<quint64>(qMax(nsecs, qint64(0))) / 1000;
+    int bucket = qMin(64 - static_cast<int>(qCountLeadingZeroBits(usecs)), bucketCount - 1);
+
+    counts[operation][bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+
+/**
+ * Get the name of an operation for display.
+ *
+ * @param operation the LatencyHistograms::Operation
+ *
+ * @return a QString containing the translated name
+ */
+QString LatencyHistograms::operationName(Operation operation)
+{
+    switch (operation) {
+    case Open:
+        return i18n("Open library");
+
+    case Import:
+        return i18n("Import libraries");
+
+    case Save:
+        return i18n("Save library");
+
+    case IconBatch:
+        return i18n("Icon batch");
+
+    case EditorFrame:
+        return i18n("Editor frame");
+
+    case GuideBuild:
+        return i18n("Guide build");
+
+    case UndoRedo:
+        return i18n("Undo or redo");
+
+    default:
+        return QString();
+    }
+}
+
+
+/**
+ * Get a description of the computer the histograms are recorded on.
+ *
+ * This is used to recognize the file of another computer, so it only includes what does not change when
+ * the operating system is updated.
+ *
+ * @return a QString containing the kernel type, the processor architecture and the number of threads
+ */
+QString LatencyHistograms::machine()
+{
+    return QStringLiteral("%1 %2 %3").arg(QSysInfo::kernelType()).arg(QSysInfo::currentCpuArchitecture()).arg(QThread::idealThreadCount());
+}
+
+
+/**
+ * Get the application versions that there are histograms for.
+ * This includes the version running, whether or not anything has been recorded for it.
+ *
+ * @return a QStringList of the versions
+ */
+QStringList LatencyHistograms::versions()
+{
+    QMutexLocker locker(&mutex);
+
+    QStringList versions = stored.keys();
+
+    if (!versions.contains(QCoreApplication::applicationVersion())) {
+        versions.append(QCoreApplication::applicationVersion());
+    }
+
+    return versions;
+}
+
+
+/**
+ * Get the histogram of an operation for an application version.
+ * For the version running the times recorded in this session are included.
+ *
+ * @param applicationVersion a const reference to a QString containing the application version
+ * @param operation the LatencyHistograms::Operation
+ *
+ * @return a QVector of the count of each bucket
+ */
+QVector<quint64> LatencyHistograms::histogram(const QString &applicationVersion, Operation operation)
+{
+    QVector<quint64> histogram(bucketCount, 0);
+
+    QMutexLocker locker(&mutex);
+
+    if (stored.contains(applicationVersion)) {
+        const QVector<quint64> &saved = stored[applicationVersion].at(operation);
+
+        for (int bucket = 0 ; bucket < bucketCount && bucket < saved.count() ; ++bucket) {
+            histogram[bucket] = saved.at(bucket);
+        }
+    }
+
+    if (applicationVersion == QCoreApplication::applicationVersion()) {
+        for (int bucket = 0 ; bucket < bucketCount ; ++bucket) {
+            histogram[bucket] += counts[operation][bucket].load(std::memory_order_relaxed);
+        }
+    }
+
+    return histogram;
+}
+
+
+/**
+ * Get the upper limit of the times counted in a bucket.
+ *
+ * @param bucket the index of the bucket
+ *
+ * @return the limit in microseconds, the times counted are below this, -1 for the last bucket which has no limit
+ */
+qint64 LatencyHistograms::bucketLimit(int bucket)
+{
+    return (bucket < bucketCount - 1) ? (qint64(1) << bucket) : -1;
+}
+
+
+/**
+ * Find the bucket limit below which a fraction of the times fall.
+ *
+ * @param histogram a const reference to a QVector of the bucket counts
+ * @param fraction the fraction of the times, between 0 and 1
+ *
+ * @return the limit in microseconds as returned by bucketLimit(), 0 if the histogram is empty
+ */
+qint64 LatencyHistograms::percentile(const QVector<quint64> &histogram, double fraction)
+{
+    quint64 total = 0;
+
+    foreach (quint64 count, histogram) {
+        total += count;
+    }
+
+    if (total == 0) {
+        return 0;
+    }
+
+    quint64 threshold = qMax(quint64(1), static_cast<quint64>(fraction * total + 0.5));
+    quint64 cumulative = 0;
+
+    for (int bucket = 0 ; bucket < histogram.count() ; ++bucket) {
+        cumulative += histogram.at(bucket);
+
+        if (cumulative >= threshold) {
+            return bucketLimit(bucket);
+        }
+    }
+
+    return bucketLimit(bucketCount - 1);
+}
+
+
+/**
+ * Read the stored histograms from the latency file.
+ * A missing, unreadable or foreign file leaves no histograms stored.
+ */
+void LatencyHistograms::load()
+{
+    QMutexLocker locker(&mutex);
+
+    stored.clear();
+    readHistograms(fileName(), machine(), stored);
+}
+
+
+/**
+ * Add the histograms recorded in this session to the histograms in the latency file and write them back.
+ * The file is locked and read again first, so the histograms written by other instances of the application
+ * since it was loaded are kept. Once the file has been written the counts written are taken from the session
+ * histograms, so they are not added again while times recorded meanwhile are kept. Nothing is written if
+ * nothing has been recorded. If the lock can't be taken within lockTimeout, or the file can't be written, the
+ * session histograms are kept.
+ */
+void LatencyHistograms::save()
+{
+    QMutexLocker locker(&mutex);
+
+    bool recorded = false;
+
+    for (int operation = 0 ; operation < OperationCount && !recorded ; ++operation) {
+        for (int bucket = 0 ; bucket < bucketCount && !recorded ; ++bucket) {
+            recorded = counts[operation][bucket].load(std::memory_order_relaxed);
+        }
+    }
+
+    if (!recorded) {
+        return;
+    }
+
+    QDir().mkpath(QFileInfo(fileName()).absolutePath());
+
+    QLockFile lock(fileName() + QStringLiteral(".lock"));
+
+    if (!lock.tryLock(lockTimeout)) {
+        return;
+    }
+
+    QMap<QString, QVector<QVector<quint64> > > histograms;
+    readHistograms(fileName(), machine(), histograms);
+
+    QVector<QVector<quint64> > &current = histograms[QCoreApplication::applicationVersion()];
+    QVector<QVector<quint64> > written(OperationCount, QVector<quint64>(bucketCount));
+    current.resize(OperationCount);
+
+    for (int operation = 0 ; operation < OperationCount ; ++operation) {
+        current[operation].resize(bucketCount);
+
+        for (int bucket = 0 ; bucket < bucketCount ; ++bucket) {
+            written[operation][bucket] = counts[operation][bucket].load(std::memory_order_relaxed);
+            current[operation][bucket] += written[operation][bucket];
+        }
+    }
+
+    QSaveFile file(fileName());
+
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream.writeRawData("SymbolLatency", 13);
+    stream << version << machine() << histograms;
+
+    if (stream.status() != QDataStream::Ok) {
+        file.cancelWriting();
+        return;
+    }
+
+    if (!file.commit()) {
+        return;
+    }
+
+    for (int operation = 0 ; operation < OperationCount ; ++operation) {
+        for (int bucket = 0 ; bucket < bucketCount ; ++bucket) {
+            counts[operation][bucket].fetch_sub(written[operation][bucket], std::memory_order_relaxed);
+        }
+    }
+
+    stored = histograms;
+}
+
+
+/**
+ * Discard all the histograms, both those recorded in this session and those stored, and remove the latency file.
+ */
+void LatencyHistograms::reset()
+{
+    QMutexLocker locker(&mutex);
+
+    for (int operation = 0 ; operation < OperationCount ; ++operation) {
+        for (int bucket = 0 ; bucket < bucketCount ; ++bucket) {
+            counts[operation][bucket].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    stored.clear();
+
+    QLockFile lock(fileName() + QStringLiteral(".lock"));
+
+    if (lock.lock()) {
+        QFile::remove(fileName());
+    }
+}
+
+
+/**
+ * Get the name of the file used to store the histograms.
+ *
+ * @return a QString containing the absolute path of the latency file
+ */
+QString LatencyHistograms::fileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + QStringLiteral("/latency.dat");
+}
+
+
+/**
+ * Constructor.
+ * The timer is only started if recording is enabled.
+ *
+ * @param operation the LatencyHistograms::Operation to record the elapsed time for
+ */
+LatencyTimer::LatencyTimer(LatencyHistograms::Operation operation)
+    :   m_operation(operation)
+{
+    if (LatencyHistograms::isEnabled()) {
+        m_timer.start();
+    }
+}
+
+
+/**
+ * Destructor.
+ * Record the elapsed time if the timer was started.
+ */
+LatencyTimer::~LatencyTimer()
+{
+    if (m_timer.isValid()) {
+        LatencyHistograms::record(m_operation, m_timer.nsecsElapsed());
+    }
+}
@@ -0,0 +1,89 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Header file for the LatencyHistograms class.
+ */
+
+
+#ifndef LatencyHistograms_H
+#define LatencyHistograms_H
+
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+
+/**
+ * @brief Histograms of the time taken by the operations the user waits for.
+ *
+ * Recording is enabled by the user in the DiagnosticsDialog and is off by default. The times are
+ * accumulated in histograms with buckets doubling in width, so each recording only increments a
+ * counter, and the histograms are added to those of the same application version in a file in the
+ * application data directory when the application exits. Nothing leaves the computer.
+ */
+class LatencyHistograms
+{
+public:
+    enum Operation {
+        Open,                       /**< opening a library or collection */
+        Import,                     /**< importing libraries */
+        Save,                       /**< saving the library */
+        IconBatch,                  /**< drawing the icons of the visible items of the library view, from requesting them until the last is received */
+        EditorFrame,                /**< painting an editor pane */
+        GuideBuild,                 /**< constructing the guides of an editor pane */
+        UndoRedo,                   /**< undoing or redoing a command */
+        OperationCount              /**< number of operations, must be last */
+    };
+
+    static const int bucketCount = 26;  /**< number of buckets in each histogram, bucket n counts times below 2^n microseconds */
+
+    static bool isEnabled();
+    static void setEnabled(bool enable);
+    static void record(Operation operation, qint64 nsecs);
+
+    static QString operationName(Operation operation);
+    static QString machine();
+    static QStringList versions();
+    static QVector<quint64> histogram(const QString &version, Operation operation);
+    static qint64 bucketLimit(int bucket);
+    static qint64 percentile(const QVector<quint64> &histogram, double fraction);
+
+    static void load();
+    static void save();
+    static void reset();
+
+private:
+    static QString fileName();
+};
+
+
+/**
+ * @brief Scoped timer recording its lifetime in a latency histogram.
+ *
+ * Nothing is timed if recording is not enabled when the timer is created.
+ */
+class LatencyTimer
+{
+public:
+    explicit LatencyTimer(LatencyHistograms::Operation operation);
+    ~LatencyTimer();
+
+private:
+    LatencyHistograms::Operation    m_operation;    /**< the operation the elapsed time is recorded for */
+    QElapsedTimer                   m_timer;        /**< timer started on construction if recording is enabled */
+};
+
+
+#endif
@@ -0,0 +1,605 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Implement the LibraryCatalog class.
+ */
+
+
+/**
+ * @page library_catalog Library Catalog
+ * When a large number of symbol libraries are kept in one or more directories, finding a particular symbol
+ * would mean opening each library in turn. The library catalog keeps an index of all the symbols in the
+ * libraries found in a set of directories, recording for each symbol the file and index it was found at,
+ * a hash of its content, its bounds and a small thumbnail rendering.
+ *
+ * The catalog is kept in the application data directory and is updated by rescanning the directories. Only
+ * the files that have been added or changed since the last scan are read again, the modification time and
+ * size of the file being used to determine this. The changed files are read in parallel on worker threads
+ * so the user interface is not blocked while the catalog is updated.
+ *
+ * The catalog can be searched by file name, for symbols identical to the one in the editor or for symbols
+ * that look similar to the one in the editor. Selecting a symbol found in the catalog opens its library and
+ * places the symbol in the editor.
+ */
+
+
+#include "LibraryCatalog.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cstring>
+
+#include "CoverageRasterizer.h"
+#include "Exceptions.h"
+#include "Symbol.h"
+#include "SymbolLibrary.h"
+#include "TaskScheduler.h"
+
+#include "SymbolEditor.h"
+
+
+/**
+ * Constructor
+ */
+CatalogEntry::CatalogEntry()
+    :   index(0),
+        filled(true)
+{
+}
+
+
+/**
+ * Constructor
+ */
+CatalogFile::CatalogFile()
+    :   modified(0),
+        size(0),
+        valid(false)
+{
+}
+
+
+/**
+ * Construct the LibraryCatalog.
+ * The directories are read from the configuration and any previously saved catalog is loaded.
+ *
+ * @param parent a pointer to the parent QObject
+ */
+LibraryCatalog::LibraryCatalog(QObject *parent)
+    :   QObject(parent),
+        m_remaining(0),
+        m_rescanPending(false)
+{
+    m_directories = Configuration::catalog_Directories();
+    load();
+}
+
+
+/**
+ * Destructor
+ * Cancel any indexing that has not started, files being indexed are left to finish as their
+ * results will be discarded.
+ */
+LibraryCatalog::~LibraryCatalog()
+{
+    foreach (TaskToken token, m_tokens) {
+        token.cancel();
+    }
+}
+
+
+/**
+ * Get the directories that are scanned for library files.
+ *
+ * @return a QStringList of directory paths
+ */
+QStringList LibraryCatalog::directories() const
+{
+    return m_directories;
+}
+
+
+/**
+ * Set the directories that are scanned for library files.
+ * The directories are saved in the configuration. The catalog entries are updated the next
+ * time the directories are rescanned.
+ *
+ * @param directories a const reference to a QStringList of directory paths
+ */
+void LibraryCatalog::setDirectories(const QStringList &directories)
+{
+    m_directories = directories;
+    Configuration::setCatalog_Directories(m_directories);
+    Configuration::self()->save();
+}
+
+
+/**
+ * Test if the directories are currently being scanned.
+ *
+ * @return @c true if indexing is in progress, @c false otherwise
+ */
+bool LibraryCatalog::isScanning() const
+{
+    return (m_remaining != 0);
+}
+
+
+/**
+ * Get all the entries in the catalog.
+ * The entries are sorted by file path and index.
+ *
+ * @return a QList of CatalogEntry
+ */
+QList<CatalogEntry> LibraryCatalog::entries() const
+{
+    return entries(QString());
+}
+
+
+/**
+ * Get the entries in files whose path contains the text.
+ * The entries are sorted by file path and index.
+ *
+ * @param text the text to find in the file path, an empty string matches all files
+ *
+ * @return a QList of CatalogEntry
+ */
+QList<CatalogEntry> LibraryCatalog::entries(const QString &text) const
+{
+    QList<CatalogEntry> found;
+
+    foreach (const CatalogFile &file, m_files) {
+        if (text.isEmpty() || file.path.contains(text, Qt::CaseInsensitive)) {
+            found.append(file.entries);
+        }
+    }
+
+    return found;
+}
+
+
+/**
+ * Get the entries that are identical to a symbol.
+ *
+ * @param symbol a const reference to the Symbol to find
+ *
+ * @return a QList of CatalogEntry having the same content hash as the symbol
+ */
+QList<CatalogEntry> LibraryCatalog::identical(const Symbol &symbol) const
+{
+    QList<CatalogEntry> found;
+    QByteArray hash = symbol.hash();
+
+    foreach (const CatalogFile &file, m_files) {
+        foreach (const CatalogEntry &entry, file.entries) {
+            if (entry.hash == hash) {
+                found.append(entry);
+            }
+        }
+    }
+
+    return found;
+}
+
+
+/**
+ * Get the entries that look most like a symbol.
+ * The thumbnail of the symbol is compared with the thumbnails of the entries and the entries with
+ * the smallest total difference in coverage are returned with the most similar first.
+ *
+ * @param symbol a const reference to the Symbol to compare with
+ * @param count the maximum number of entries to return
+ *
+ * @return a QList of CatalogEntry
+ */
+QList<CatalogEntry> LibraryCatalog::similar(const Symbol &symbol, int count) const
+{
+    QByteArray features = thumbnail(symbol);
+    QList<QPair<int, const CatalogEntry *> > ranked;
+
+    for (const CatalogFile &file : m_files) {
+        for (const CatalogEntry &entry : file.entries) {
+            if (entry.thumbnail.size() != features.size()) {
+                continue;
+            }
+
+            int difference = 0;
+
+            for (int i = 0 ; i < features.size() ; ++i) {
+                difference += qAbs(static_cast<uchar>(features.at(i)) - static_cast<uchar>(entry.thumbnail.at(i)));
+            }
+
+            ranked.append(qMakePair(difference, &entry));
+        }
+    }
+
+    count = std::min(count, static_cast<int>(ranked.count()));
+    std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(),
+                      [](const QPair<int, const CatalogEntry *> &a, const QPair<int, const CatalogEntry *> &b) {
+                          return a.first < b.first;
+                      });
+
+    QList<CatalogEntry> found;
+
+    for (int i = 0 ; i < count ; ++i) {
+        found.append(*ranked.at(i).second);
+    }
+
+    return found;
+}
+
+
+/**
+ * Render a thumbnail of a symbol.
+ * The symbol is rendered by the CoverageRasterizer into an 8 bit coverage image of thumbnailSize pixels square.
+ * This is safe to call from worker threads.
+ *
+ * @param symbol a const reference to the Symbol to render
+ *
+ * @return a QByteArray containing thumbnailSize * thumbnailSize coverage values
+ */
+QByteArray LibraryCatalog::thumbnail(const Symbol &symbol)
+{
+    QImage image = CoverageRasterizer::coverage(symbol, thumbnailSize);
+
+    QByteArray data;
+    data.reserve(thumbnailSize * thumbnailSize);
+
+    for (int y = 0 ; y < thumbnailSize ; ++y) {
+        data.append(reinterpret_cast<const char *>(image.constScanLine(y)), thumbnailSize);
+    }
+
+    return data;
+}
+
+
+/**
+ * Create a displayable image from a thumbnail.
+ *
+ * @param thumbnail a const reference to a QByteArray of coverage values created by thumbnail()
+ * @param color the color to draw the symbol in
+ *
+ * @return a QImage, this will be a null image if the thumbnail is not valid
+ */
+QImage LibraryCatalog::thumbnailImage(const QByteArray &thumbnail, const QColor &color)
+{
+    if (thumbnail.size() != thumbnailSize * thumbnailSize) {
+        return QImage();
+    }
+
+    QImage image(thumbnailSize, thumbnailSize, QImage::Format_ARGB32_Premultiplied);
+
+    for (int y = 0 ; y < thumbnailSize ; ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+
+        for (int x = 0 ; x < thumbnailSize ; ++x) {
+            int alpha = static_cast<uchar>(thumbnail.at(y * thumbnailSize + x));
+            line[x] = qPremultiply(qRgba(color.red(), color.green(), color.blue(), alpha));
+        }
+    }
+
+    return image;
+}
+
+
+/**
+ * Rescan the directories for library files.
+ * Files that are no longer found are removed from the catalog. Files that are new or have a
+ * different modification time or size from when they were indexed are indexed in parallel on
+ * worker threads by the TaskScheduler at the Analysis priority. If a scan is already in progress,
+ * another scan will be started when it finishes.
+ */
+void LibraryCatalog::rescan()
+{
+    if (isScanning()) {
+        m_rescanPending = true;
+        return;
+    }
+
+    QStringList changed;
+    QSet<QString> found;
+
+    foreach (const QString &directory, m_directories) {
+        QDirIterator it(directory, QStringList(QStringLiteral("*.sym")), QDir::Files, QDirIterator::Subdirectories);
+
+        while (it.hasNext()) {
+            QFileInfo info(it.next());
+            QString path = info.absoluteFilePath();
+            found.insert(path);
+
+            QMap<QString, CatalogFile>::const_iterator i = m_files.constFind(path);
+
+            if (i == m_files.constEnd() || i->modified != info.lastModified().toMSecsSinceEpoch() || i->size != info.size()) {
+                changed.append(path);
+            }
+        }
+    }
+
+    bool removed = false;
+
+    foreach (const QString &path, m_files.keys()) {
+        if (!found.contains(path)) {
+            m_files.remove(path);
+            removed = true;
+        }
+    }
+
+    if (changed.isEmpty()) {
+        if (removed) {
+            save();
+        }
+
+        emit scanFinished();
+        return;
+    }
+
+    emit scanStarted(changed.count());
+
+    m_remaining = changed.count();
+    m_indexed.clear();
+    m_tokens.clear();
+
+    foreach (const QString &path, changed) {
+        m_tokens.append(TaskScheduler::instance()->schedule<CatalogFile>(TaskScheduler::Analysis, "catalog/" + path.toUtf8(),
+            [path](const TaskToken &) {
+                return indexFile(path);
+            },
+            this,
+            [this](const CatalogFile &file) {
+                fileIndexed(file);
+            }));
+    }
+}
+
+
+/**
+ * Called on the GUI thread as each file is indexed.
+ *
+ * @param file a const reference to the CatalogFile for the indexed file
+ */
+void LibraryCatalog::fileIndexed(const CatalogFile &file)
+{
+    m_indexed.append(file);
+    emit scanProgress(m_indexed.count());
+
+    if (--m_remaining == 0) {
+        indexingFinished();
+    }
+}
+
+
+/**
+ * Called when the indexing of the changed files has finished.
+ * The new entries replace the existing entries for the files and the catalog is saved.
+ */
+void LibraryCatalog::indexingFinished()
+{
+    foreach (const CatalogFile &file, m_indexed) {
+        m_files.insert(file.path, file);
+    }
+
+    m_indexed.clear();
+    m_tokens.clear();
+    save();
+
+    emit scanFinished();
+
+    if (m_rescanPending) {
+        m_rescanPending = false;
+        rescan();
+    }
+}
+
+
+/**
+ * Index a library file.
+ * This is called on a worker thread for each file that needs indexing. The file is read into a
+ * temporary SymbolLibrary and an entry is created for each of the symbols with its components
+ * flattened. Files that can not be read as a symbol library are marked invalid so they are not
+ * read again until they change.
+ *
+ * @param path the absolute path of the library file
+ *
+ * @return a CatalogFile containing the entries
+ */
+CatalogFile LibraryCatalog::indexFile(const QString &path)
+{
+    QFileInfo info(path);
+
+    CatalogFile catalogFile;
+    catalogFile.path = path;
+    catalogFile.modified = info.lastModified().toMSecsSinceEpoch();
+    catalogFile.size = info.size();
+
+    QFile file(path);
+
+    if (file.open(QIODevice::ReadOnly)) {
+        QDataStream stream(&file);
+        SymbolLibrary library;
+
+        try {
+            stream >> library;
+
+            foreach (qint16 index, library.indexes()) {
+                Symbol symbol = library.flattenedSymbol(index);
+
+                CatalogEntry entry;
+                entry.path = path;
+                entry.index = index;
+                entry.hash = symbol.hash();
+                entry.bounds = symbol.path().boundingRect();
+                entry.filled = symbol.filled();
+                entry.thumbnail = thumbnail(symbol);
+                catalogFile.entries.append(entry);
+            }
+
+            catalogFile.valid = true;
+        } catch (const InvalidFile &e) {
+            // not a symbol library, leave the file marked invalid
+        } catch (const InvalidFileVersion &e) {
+        } catch (const InvalidSymbolVersion &e) {
+        } catch (const FailedReadLibrary &e) {
+        }
+    }
+
+    return catalogFile;
+}
+
+
+/**
+ * Load the catalog from the application data directory.
+ * A missing, unreadable or out of date catalog is ignored and will be rebuilt on the next scan.
+ */
+void LibraryCatalog::load()
+{
+    QFile file(fileName());
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    char magic[13];
+    qint32 catalogVersion;
+
+    if (stream.readRawData(magic, 13) != 13 || strncmp(magic, "SymbolCatalog", 13) != 0) {
+        return;
+    }
+
+    stream >> catalogVersion;
+
+    if (catalogVersion != version) {
+        return;
+    }
+
+    QList<CatalogFile> files;
+    stream >> files;
+
+    if (stream.status() == QDataStream::Ok) {
+        for (const CatalogFile &catalogFile : files) {
+            m_files.insert(catalogFile.path, catalogFile);
+        }
+    }
+}
+
+
+/**
+ * Save the catalog to the application data directory.
+ * The file is written with a QSaveFile so an interrupted save does not corrupt the existing catalog.
+ */
+void LibraryCatalog::save() const
+{
+    QDir().mkpath(QFileInfo(fileName()).absolutePath());
+
+    QSaveFile file(fileName());
+
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream.writeRawData("SymbolCatalog", 13);
+    stream << version;
+    stream << m_files.values();
+
+    if (stream.status() == QDataStream::Ok) {
+        file.commit();
+    } else {
+        file.cancelWriting();
+    }
+}
+
+
+/**
+ * Get the name of the file used to store the catalog.
+ *
+ * @return a QString containing the absolute path of the catalog file
+ */
+QString LibraryCatalog::fileName() const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + QStringLiteral("/catalog.dat");
+}
+
+
+/**
+ * Stream out a CatalogEntry.
+ *
+ * @param stream a reference to the QDataStream to write to
+ * @param entry a const reference to the CatalogEntry to stream
+ *
+ * @return a reference to the stream
+ */
+QDataStream &operator<<(QDataStream &stream, const CatalogEntry &entry)
+{
+    stream << entry.path << entry.index << entry.hash << entry.bounds << entry.filled << entry.thumbnail;
+    return stream;
+}
+
+
+/**
+ * Stream in a CatalogEntry.
+ *
+ * @param stream a reference to the QDataStream to read from
+ * @param entry a reference to the CatalogEntry to stream
+ *
+ * @return a reference to the stream
+ */
+QDataStream &operator>>(QDataStream &stream, CatalogEntry &entry)
+{
+    stream >> entry.path >> entry.index >> entry.hash >> entry.bounds >> entry.filled >> entry.thumbnail;
+    return stream;
+}
+
+
+/**
+ * Stream out a CatalogFile.
+ *
+ * @param stream a reference to the QDataStream to write to
+ * @param file a const reference to the CatalogFile to stream
+ *
+ * @return a reference to the stream
+ */
+QDataStream &operator<<(QDataStream &stream, const CatalogFile &file)
+{
+    stream << file.path << file.modified << file.size << file.valid << file.entries;
+    return stream;
+}
+
+
+/**
+ * Stream in a CatalogFile.
+ *
+ * @param stream a reference to the QDataStream to read from
+ * @param file a reference to the CatalogFile to stream
+ *
+ * @return a reference to the stream
+ */
+QDataStream &operator>>(QDataStream &stream, CatalogFile &file)
+{
+    stream >> file.path >> file.modified >> file.size >> file.valid >> file.entries;
+    return stream;
+}
+
+#include "moc_LibraryCatalog.cpp"
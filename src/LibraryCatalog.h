@@ -0,0 +1,144 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Header file for the LibraryCatalog class.
+ */
+
+
+#ifndef LibraryCatalog_H
+#define LibraryCatalog_H
+
+
+#include <QByteArray>
+#include <QImage>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QRectF>
+#include <QStringList>
+
+#include "TaskScheduler.h"
+
+
+class QDataStream;
+
+class Symbol;
+
+
+/**
+ * @brief A catalog entry describing one symbol in a library file.
+ */
+class CatalogEntry
+{
+public:
+    CatalogEntry();
+
+    QString     path;               /**< absolute path of the library file containing the symbol */
+    qint16      index;              /**< index of the symbol in the library */
+    QByteArray  hash;               /**< content hash of the symbol, see Symbol::hash() */
+    QRectF      bounds;             /**< bounding rectangle of the symbol path */
+    bool        filled;             /**< true if the symbol is drawn filled */
+    QByteArray  thumbnail;          /**< coverage values of a small rendering of the symbol */
+};
+
+
+/**
+ * @brief The catalog entries for one library file.
+ *
+ * The modification time and size of the file when it was indexed are used to decide if the
+ * file needs to be indexed again.
+ */
+class CatalogFile
+{
+public:
+    CatalogFile();
+
+    QString             path;       /**< absolute path of the library file */
+    qint64              modified;   /**< modification time of the file in milliseconds since the epoch */
+    qint64              size;       /**< size of the file in bytes */
+    bool                valid;      /**< false if the file could not be read as a symbol library */
+    QList<CatalogEntry> entries;    /**< the entries for the symbols in the file */
+};
+
+
+/**
+ * @brief Maintains a persistent catalog of the symbols in directories of library files.
+ *
+ * The catalog holds an entry for each symbol found in the library files of a set of directories.
+ * Rescanning the directories only indexes the files that have been added or changed since the
+ * last scan, judged by the file modification time and size, and the indexing is done in parallel
+ * on worker threads. The catalog is saved in the application data directory so it is available
+ * immediately the next time the application is started.
+ *
+ * The entries allow searching across all the libraries without loading them.
+ */
+class LibraryCatalog : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LibraryCatalog(QObject *parent = nullptr);
+    ~LibraryCatalog();
+
+    QStringList directories() const;
+    void setDirectories(const QStringList &directories);
+
+    bool isScanning() const;
+
+    QList<CatalogEntry> entries() const;
+    QList<CatalogEntry> entries(const QString &text) const;
+    QList<CatalogEntry> identical(const Symbol &symbol) const;
+    QList<CatalogEntry> similar(const Symbol &symbol, int count) const;
+
+    static const int thumbnailSize = 24;    /**< the width and height of the thumbnails */
+
+    static QByteArray thumbnail(const Symbol &symbol);
+    static QImage thumbnailImage(const QByteArray &thumbnail, const QColor &color);
+
+public slots:
+    void rescan();
+
+signals:
+    void scanStarted(int files);
+    void scanProgress(int files);
+    void scanFinished();
+
+private:
+    void fileIndexed(const CatalogFile &file);
+    void indexingFinished();
+
+    static CatalogFile indexFile(const QString &path);
+
+    void load();
+    void save() const;
+    QString fileName() const;
+
+    static const qint32 version = 102;      /**< stream version of the catalog file */
+
+    QStringList                 m_directories;      /**< the directories that are scanned for library files */
+    QMap<QString, CatalogFile>  m_files;            /**< map of the library file paths to their catalog entries */
+
+    QList<TaskToken>            m_tokens;           /**< tokens for the files being indexed */
+    QList<CatalogFile>          m_indexed;          /**< the files indexed so far in the current scan */
+    int                         m_remaining;        /**< the number of files still to be indexed in the current scan */
+    bool                        m_rescanPending;    /**< true if a rescan was requested while indexing */
+};
+
+
+QDataStream &operator<<(QDataStream &stream, const CatalogEntry &entry);
+QDataStream &operator>>(QDataStream &stream, CatalogEntry &entry);
+QDataStream &operator<<(QDataStream &stream, const CatalogFile &file);
+QDataStream &operator>>(QDataStream &stream, CatalogFile &file);
+
+
+#endif
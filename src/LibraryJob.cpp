@@ -0,0 +1,442 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Implement the LibraryJob class.
+ */
+
+
+/**
+ * @page library_jobs Library Jobs
+ * Operations applied to every symbol of a library, such as @ref tools_simplify_symbols, can take minutes on
+ * large libraries. They are run as library jobs in the background while the progress is shown in the status
+ * bar, where the job can also be cancelled. The symbols are processed in batches on worker threads, identical
+ * symbols only being processed once.
+ *
+ * The result for each symbol is kept against the content hash of the symbol it was produced from, a symbol left
+ * unchanged by the job only being recorded by its hash. The results are appended to a checkpoint file in the
+ * jobs directory of the application data directory every few seconds, when the job is cancelled and when the
+ * application exits, each write only adding the results produced since the previous one. Starting the job
+ * again with the same parameters continues from the checkpoint, so a job that was cancelled, or interrupted by
+ * the application exiting or crashing, does not start again from the beginning. As the results are keyed by the content of the
+ * symbols rather than their indexes, the checkpoint remains valid if the library is edited, reopened or even
+ * replaced by another library containing the same symbols. The checkpoint file is written with a QDataStream
+ * with its version set to QDataStream::Qt_5_0 as
+ * - the raw bytes "SymbolJob"
+ * - qint32 the version of the file, currently 101
+ * - QByteArray the parameters of the job, a checkpoint for different parameters is discarded
+ *
+ * followed by a record for each write of
+ * - QHash<QByteArray, Symbol> the results of the symbols changed by the job by the hash of the symbol they were produced from
+ * - QList<QByteArray> the hashes of the symbols left unchanged by the job
+ *
+ * A record left incomplete by the application crashing while writing it is removed when the checkpoint is read.
+ *
+ * When all the symbols have been processed, the symbols that were changed by the job are replaced in the library
+ * as a single change that can be undone in one step, and the checkpoint file is removed. Symbols that have been
+ * changed or removed since the job was started are left as they are.
+ */
+
+
+#include "LibraryJob.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QStandardPaths>
+
+#include "Commands.h"
+#include "Exceptions.h"
+#include "SymbolLibrary.h"
+
+
+/**
+ * Constructor.
+ *
+ * @param library a pointer to the SymbolLibrary the job runs over
+ * @param name the name identifying the job, this is used for the name of the checkpoint file
+ * @param text a description of the job shown to the user and used for the undo command
+ * @param parameters the parameters of the job, the checkpoint is only used if these are the same
+ * @param work the operation applied to each symbol, this is called on worker threads so must not use objects belonging to other threads
+ * @param parent a pointer to the parent QObject
+ */
+LibraryJob::LibraryJob(SymbolLibrary *library, const QString &name, const QString &text, const QByteArray &parameters, std::function<Symbol(const Symbol &)> work, QObject *parent)
+    :   QObject(parent),
+        m_library(library),
+        m_name(name),
+        m_text(text),
+        m_parameters(parameters),
+        m_work(work),
+        m_count(0),
+        m_processed(0),
+        m_remaining(0)
+{
+}
+
+
+/**
+ * Destructor.
+ * Any batches still being processed are cancelled and the results not yet written are written to the
+ * checkpoint file, so that the job can be continued later.
+ */
+LibraryJob::~LibraryJob()
+{
+    foreach (TaskToken token, m_tokens) {
+        token.cancel();
+    }
+
+    saveCheckpoint();
+}
+
+
+/**
+ * Get the description of the job.
+ *
+ * @return a QString containing the description
+ */
+QString LibraryJob::text() const
+{
+    return m_text;
+}
+
+
+/**
+ * Get the number of symbols the job runs over.
+ * Identical symbols are counted once.
+ *
+ * @return the number of symbols
+ */
+int LibraryJob::count() const
+{
+    return m_count;
+}
+
+
+/**
+ * Get the number of symbols processed.
+ * This includes the symbols whose results were read from the checkpoint file.
+ *
+ * @return the number of symbols processed
+ */
+int LibraryJob::processed() const
+{
+    return m_processed;
+}
+
+
+/**
+ * Start the job.
+ * Any unread shards of a collection are read so that the job runs over all the symbols. The results of
+ * an earlier run are read from the checkpoint file and the remaining symbols are scheduled in batches at
+ * the TaskScheduler::Analysis priority. If there are no remaining symbols the job completes immediately.
+ */
+void LibraryJob::start()
+{
+    m_library->loadAllShards();
+    loadCheckpoint();
+
+    m_hashes.clear();
+    m_tokens.clear();
+    m_count = 0;
+    m_processed = 0;
+    m_remaining = 0;
+    m_sinceCheckpoint.start();
+
+    QSet<QByteArray> counted;
+    Results pending;
+
+    foreach (qint16 index, m_library->indexes()) {
+        Symbol symbol = m_library->symbol(index);
+        QByteArray hash = symbol.hash();
+        m_hashes.insert(index, hash);
+
+        if (counted.contains(hash)) {
+            continue;
+        }
+
+        counted.insert(hash);
+        ++m_count;
+
+        if (m_results.contains(hash) || m_unchanged.contains(hash)) {
+            ++m_processed;
+        } else {
+            pending.append(qMakePair(hash, symbol));
+        }
+    }
+
+    std::function<Symbol(const Symbol &)> work = m_work;
+
+    for (int first = 0 ; first < pending.count() ; first += batchSize) {
+        Results batch = pending.mid(first, batchSize);
+        ++m_remaining;
+
+        m_tokens.append(TaskScheduler::instance()->schedule<BatchResults>(TaskScheduler::Analysis, QByteArray(),
+            [batch, work](const TaskToken &token) {
+                BatchResults results;
+
+                foreach (const auto &pair, batch) {
+                    if (token.isCancelled()) {
+                        break;
+                    }
+
+                    Symbol result = work(pair.second);
+
+                    if (result.hash() == pair.first) {
+                        results.unchanged.append(pair.first);
+                    } else {
+                        results.changed.append(qMakePair(pair.first, result));
+                    }
+                }
+
+                return results;
+            },
+            this,
+            [this](const BatchResults &results) {
+                batchProcessed(results);
+            }));
+    }
+
+    emit progress(m_processed, m_count);
+
+    if (m_remaining == 0) {
+        complete();
+    }
+}
+
+
+/**
+ * Cancel the job.
+ * The batches being processed are cancelled and the results so far are written to the checkpoint
+ * file, so that starting the job again continues from where it was cancelled.
+ */
+void LibraryJob::cancel()
+{
+    foreach (TaskToken token, m_tokens) {
+        token.cancel();
+    }
+
+    m_tokens.clear();
+    m_remaining = 0;
+
+    saveCheckpoint();
+
+    emit cancelled();
+}
+
+
+/**
+ * Called on the GUI thread as each batch is processed.
+ * The results are added to those of the job and the results not yet written are appended to the
+ * checkpoint file if it has not been written for a while. When the last batch has been processed
+ * the job is completed.
+ *
+ * @param results a const reference to the BatchResults of the batch
+ */
+void LibraryJob::batchProcessed(const BatchResults &results)
+{
+    if (m_remaining == 0) {
+        return;     // the job was cancelled
+    }
+
+    foreach (const auto &pair, results.changed) {
+        m_results.insert(pair.first, pair.second);
+        m_unsavedResults.insert(pair.first, pair.second);
+        ++m_processed;
+    }
+
+    foreach (const QByteArray &hash, results.unchanged) {
+        m_unchanged.insert(hash);
+        m_unsavedUnchanged.append(hash);
+        ++m_processed;
+    }
+
+    if (m_sinceCheckpoint.elapsed() >= checkpointInterval) {
+        saveCheckpoint();
+    }
+
+    emit progress(m_processed, m_count);
+
+    if (--m_remaining == 0) {
+        m_tokens.clear();
+        complete();
+    }
+}
+
+
+/**
+ * Complete the job.
+ * The symbols changed by the job are replaced in the library with a single UpdateSymbolsCommand,
+ * skipping any symbols that have been changed or removed since the job was started. The checkpoint
+ * file is no longer needed and is removed.
+ */
+void LibraryJob::complete()
+{
+    QMap<qint16, Symbol> changed;
+
+    for (QMap<qint16, QByteArray>::const_iterator i = m_hashes.constBegin() ; i != m_hashes.constEnd() ; ++i) {
+        if (m_library->symbol(i.key()).hash() != i.value()) {
+            continue;
+        }
+
+        if (m_results.contains(i.value())) {
+            changed.insert(i.key(), m_results.value(i.value()));
+        }
+    }
+
+    if (!changed.isEmpty()) {
+        m_library->undoStack()->push(new UpdateSymbolsCommand(m_library, m_text, changed));
+    }
+
+    m_results.clear();
+    m_unchanged.clear();
+    m_unsavedResults.clear();
+    m_unsavedUnchanged.clear();
+    QFile::remove(fileName(m_name));
+
+    emit finished(changed.count());
+}
+
+
+/**
+ * Read the results of an earlier run of the job from the checkpoint file.
+ * A missing or unreadable file leaves no results, a file for different parameters or of another
+ * version is removed so that a new one is started. The records are read in turn and an incomplete
+ * record at the end of the file, left by the application crashing while writing it, is removed so
+ * that the following records can be appended.
+ */
+void LibraryJob::loadCheckpoint()
+{
+    m_results.clear();
+    m_unchanged.clear();
+    m_unsavedResults.clear();
+    m_unsavedUnchanged.clear();
+
+    QFile file(fileName(m_name));
+
+    if (!file.open(QIODevice::ReadWrite)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    char magic[9];
+    qint32 checkpointVersion;
+    QByteArray parameters;
+
+    if (stream.readRawData(magic, 9) != 9 || qstrncmp(magic, "SymbolJob", 9) != 0) {
+        file.remove();
+        return;
+    }
+
+    stream >> checkpointVersion;
+
+    if (checkpointVersion != version) {
+        file.remove();
+        return;
+    }
+
+    stream >> parameters;
+
+    if (stream.status() != QDataStream::Ok || parameters != m_parameters) {
+        file.remove();
+        return;
+    }
+
+    qint64 end = file.pos();
+
+    while (!stream.atEnd()) {
+        QHash<QByteArray, Symbol> results;
+        QList<QByteArray> unchanged;
+
+        try {
+            stream >> results >> unchanged;
+        } catch (const InvalidSymbolVersion &e) {
+            break;
+        }
+
+        if (stream.status() != QDataStream::Ok) {
+            break;
+        }
+
+        m_results.insert(results);
+
+        foreach (const QByteArray &hash, unchanged) {
+            m_unchanged.insert(hash);
+        }
+
+        end = file.pos();
+    }
+
+    if (end < file.size()) {
+        file.resize(end);
+    }
+}
+
+
+/**
+ * Append the results not yet written to the checkpoint file.
+ * The header is written first if the file is new. If the record can't be written completely the
+ * file is truncated to remove it and the results are kept to be written the next time.
+ */
+void LibraryJob::saveCheckpoint()
+{
+    m_sinceCheckpoint.restart();
+
+    if (m_unsavedResults.isEmpty() && m_unsavedUnchanged.isEmpty()) {
+        return;
+    }
+
+    QDir().mkpath(QFileInfo(fileName(m_name)).absolutePath());
+
+    QFile file(fileName(m_name));
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        return;
+    }
+
+    qint64 end = file.size();
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    if (end == 0) {
+        stream.writeRawData("SymbolJob", 9);
+        stream << version << m_parameters;
+    }
+
+    stream << m_unsavedResults << m_unsavedUnchanged;
+
+    if (stream.status() == QDataStream::Ok && file.flush()) {
+        m_unsavedResults.clear();
+        m_unsavedUnchanged.clear();
+    } else {
+        file.resize(end);
+    }
+}
+
+
+/**
+ * Get the name of the checkpoint file of a job.
+ *
+ * @param name the name identifying the job
+ *
+ * @return a QString containing the absolute path of the checkpoint file
+ */
+QString LibraryJob::fileName(const QString &name)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + QStringLiteral("/jobs/") + name + QStringLiteral(".dat");
+}
+
+#include "moc_LibraryJob.cpp"
@@ -0,0 +1,120 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Header file for the LibraryJob class.
+ */
+
+
+#ifndef LibraryJob_H
+#define LibraryJob_H
+
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QPair>
+#include <QSet>
+#include <QString>
+
+#include "Symbol.h"
+#include "TaskScheduler.h"
+
+#include <functional>
+
+
+class SymbolLibrary;
+
+
+/**
+ * @brief Runs an operation over every symbol of the library in the background.
+ *
+ * The symbols are processed in batches on the TaskScheduler. The result for each symbol is kept
+ * against the content hash of the symbol it was produced from, only the symbols that were changed
+ * being kept in full, and the results are appended to a checkpoint file in the application data
+ * directory as the job progresses. A job that is
+ * cancelled, or interrupted by the application exiting or crashing, continues from the checkpoint
+ * the next time it is started with the same name and parameters, only the symbols without a
+ * result being processed again.
+ *
+ * When all the symbols have been processed, the symbols that were changed are replaced in the
+ * library by a single UpdateSymbolsCommand and the checkpoint is removed.
+ */
+class LibraryJob : public QObject
+{
+    Q_OBJECT
+
+public:
+    LibraryJob(SymbolLibrary *library, const QString &name, const QString &text, const QByteArray &parameters, std::function<Symbol(const Symbol &)> work, QObject *parent = nullptr);
+    ~LibraryJob();
+
+    QString text() const;
+    int count() const;
+    int processed() const;
+
+    void start();
+
+public slots:
+    void cancel();
+
+signals:
+    void progress(int processed, int count);
+    void finished(int changed);
+    void cancelled();
+
+private:
+    typedef QList<QPair<QByteArray, Symbol> > Results;     /**< hashes of symbols and the symbols, or the results produced from them */
+
+    /**
+     * @brief The results of a batch of symbols.
+     */
+    class BatchResults
+    {
+    public:
+        Results             changed;    /**< the hashes of the symbols changed by the job and their results */
+        QList<QByteArray>   unchanged;  /**< the hashes of the symbols left unchanged by the job */
+    };
+
+    void batchProcessed(const BatchResults &results);
+    void complete();
+
+    void loadCheckpoint();
+    void saveCheckpoint();
+    static QString fileName(const QString &name);
+
+    static const qint32 version = 101;      /**< stream version of the checkpoint file */
+    static const int batchSize = 32;        /**< the number of symbols processed by each task */
+    static const int checkpointInterval = 2000; /**< minimum milliseconds between writing the checkpoint file */
+
+    SymbolLibrary                       *m_library;     /**< pointer to the SymbolLibrary the job runs over */
+    QString                             m_name;         /**< name identifying the job, used for the checkpoint file */
+    QString                             m_text;         /**< description of the job shown to the user and used for the undo command */
+    QByteArray                          m_parameters;   /**< parameters of the job, a checkpoint with different parameters is discarded */
+    std::function<Symbol(const Symbol &)>   m_work;     /**< the operation applied to each symbol, called on worker threads */
+
+    QMap<qint16, QByteArray>            m_hashes;       /**< the content hashes of the library symbols when the job was started */
+    QHash<QByteArray, Symbol>           m_results;      /**< the results of the symbols changed by the job, by the hash of the symbol they were produced from */
+    QSet<QByteArray>                    m_unchanged;    /**< the hashes of the symbols processed and left unchanged by the job */
+    QHash<QByteArray, Symbol>           m_unsavedResults;   /**< the entries of m_results not yet written to the checkpoint file */
+    QList<QByteArray>                   m_unsavedUnchanged; /**< the entries of m_unchanged not yet written to the checkpoint file */
+    QList<TaskToken>                    m_tokens;       /**< tokens for the batches being processed */
+    int                                 m_count;        /**< the number of distinct symbols the job runs over */
+    int                                 m_processed;    /**< the number of distinct symbols processed, including those read from the checkpoint */
+    int                                 m_remaining;    /**< the number of batches still to be processed */
+    QElapsedTimer                       m_sinceCheckpoint;  /**< time since the checkpoint file was last written */
+};
+
+
+#endif
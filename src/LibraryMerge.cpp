@@ -0,0 +1,227 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Implement the LibraryMerge class.
+ */
+
+
+/**
+ * @page library_merge Merging Libraries
+ * A library file may be changed by another instance of the SymbolEditor while it is open. When the library is
+ * saved the file is locked for the time it takes to save it, and if the file has changed since it was read or
+ * last saved it is read again and merged with the library before it is written, so the changes made elsewhere
+ * are kept.
+ *
+ * The merge compares each symbol with the version read from the file originally. Symbols changed, added or
+ * removed in only one of the library or the file take that change. Symbols changed in both to the same content
+ * are unchanged. Symbols changed in both to different content are conflicts, the user is asked whether to keep
+ * the symbols of the library or those of the file for all of them. New symbols added only to the file keep their
+ * index, only new symbols added to both with the same index are given a new index for the one from the file, so
+ * both are kept.
+ *
+ * The symbols taken from the file keep their history from the file, and the symbols new to the library are placed
+ * after the symbol they follow in the display order of the file. The order of the other symbols is unchanged.
+ *
+ * The merge is added to the library undo stack so that it can be undone, the file then being overwritten with
+ * the library as it was on the next save.
+ */
+
+
+#include "LibraryMerge.h"
+
+#include <QSet>
+#include <QVector>
+#include <QtConcurrent>
+
+#include "Profiling.h"
+
+
+namespace
+{
+/**
+ * @brief The content hashes of a symbol in each version of the library.
+ */
+class SymbolHashes
+{
+public:
+    qint16      index;                      /**< index of the symbol */
+    QByteArray  base;                       /**< hash of the symbol in the base, empty if it is not there */
+    QByteArray  mine;                       /**< hash of the symbol in the library, empty if it is not there */
+    QByteArray  theirs;                     /**< hash of the symbol in the file, empty if it is not there */
+};
+}
+
+
+/**
+ * Constructor.
+ * The hashes of the symbols are calculated in parallel, which is where most of the time is spent
+ * for a large library, and the changes are then sorted into those to apply and the conflicts.
+ *
+ * @param base a const reference to a QMap of the symbols as they were read from the file
+ * @param mine a const reference to a QMap of the symbols in the library now
+ * @param theirs a const reference to a QMap of the symbols in the file now
+ * @param theirHistories a const reference to a QMap of the histories of the symbols in the file
+ * @param theirOrder a const reference to a QList of the indexes of the symbols in the file in the order they are shown
+ */
+LibraryMerge::LibraryMerge(const QMap<qint16, Symbol> &base, const QMap<qint16, Symbol> &mine, const QMap<qint16, Symbol> &theirs, const QMap<qint16, SymbolHistory> &theirHistories, const QList<qint16> &theirOrder)
+    :   m_order(theirOrder)
+{
+    PROFILE_COUNT(LibraryMerges);
+    PROFILE_TIMER(LibraryMerges);
+
+    QSet<qint16> indexSet;
+
+    foreach (qint16 index, base.keys() + mine.keys() + theirs.keys()) {
+        indexSet.insert(index);
+    }
+
+    QVector<qint16> indexes(indexSet.constBegin(), indexSet.constEnd());
+    std::sort(indexes.begin(), indexes.end());
+
+    QVector<SymbolHashes> hashes = QtConcurrent::blockingMapped<QVector<SymbolHashes> >(indexes, [&base, &mine, &theirs](qint16 index) {
+        SymbolHashes h;
+        h.index = index;
+        h.base = base.contains(index) ? base.value(index).hash() : QByteArray();
+        h.mine = mine.contains(index) ? mine.value(index).hash() : QByteArray();
+        h.theirs = theirs.contains(index) ? theirs.value(index).hash() : QByteArray();
+        return h;
+    });
+
+    foreach (const SymbolHashes &h, hashes) {
+        if (h.mine == h.theirs || h.theirs == h.base) {
+            continue;                           // unchanged or only changed in the library
+        }
+
+        if (h.base.isEmpty() && h.mine.isEmpty()) {
+            m_updates.insert(h.index, theirs.value(h.index));       // added only in the file, keeping its index
+        } else if (h.mine == h.base) {
+            if (h.theirs.isEmpty()) {
+                m_removals.append(h.index);
+            } else {
+                m_updates.insert(h.index, theirs.value(h.index));
+            }
+        } else if (h.base.isEmpty()) {
+            m_additions.append(theirs.value(h.index));              // added in both at the same index
+            m_additionIndexes.append(h.index);
+        } else if (h.theirs.isEmpty()) {
+            m_conflictRemovals.append(h.index);
+        } else {
+            m_conflictUpdates.insert(h.index, theirs.value(h.index));
+        }
+
+        if (!h.theirs.isEmpty() && theirHistories.contains(h.index)) {
+            m_histories.insert(h.index, theirHistories.value(h.index));
+        }
+    }
+}
+
+
+/**
+ * Get the symbols changed differently in the library and the file.
+ *
+ * @return a QList of the indexes of the conflicting symbols
+ */
+QList<qint16> LibraryMerge::conflicts() const
+{
+    return m_conflictUpdates.keys() + m_conflictRemovals;
+}
+
+
+/**
+ * Get the symbols in the file to set in the library.
+ *
+ * @param keepTheirs true if the conflicts are resolved by keeping the symbols in the file
+ *
+ * @return a QMap of the indexes to the symbols
+ */
+QMap<qint16, Symbol> LibraryMerge::updates(bool keepTheirs) const
+{
+    QMap<qint16, Symbol> updates = m_updates;
+
+    if (keepTheirs) {
+        updates.insert(m_conflictUpdates);
+    }
+
+    return updates;
+}
+
+
+/**
+ * Get the symbols to remove from the library.
+ *
+ * @param keepTheirs true if the conflicts are resolved by keeping the symbols in the file
+ *
+ * @return a QList of the indexes of the symbols
+ */
+QList<qint16> LibraryMerge::removals(bool keepTheirs) const
+{
+    return keepTheirs ? m_removals + m_conflictRemovals : m_removals;
+}
+
+
+/**
+ * Get the symbols added to the file to add to the library with new indexes.
+ *
+ * @return a QList of the symbols
+ */
+QList<Symbol> LibraryMerge::additions() const
+{
+    return m_additions;
+}
+
+
+/**
+ * Get the indexes that the symbols added to the file have in the file.
+ *
+ * @return a QList of the indexes in the order of additions()
+ */
+QList<qint16> LibraryMerge::additionIndexes() const
+{
+    return m_additionIndexes;
+}
+
+
+/**
+ * Get the histories in the file of the symbols that may be taken from it.
+ * These are keyed by the index in the file, the additions being given new indexes in the library.
+ *
+ * @return a QMap of the indexes to the histories
+ */
+QMap<qint16, SymbolHistory> LibraryMerge::histories() const
+{
+    return m_histories;
+}
+
+
+/**
+ * Get the display order of the file.
+ *
+ * @return a QList of the indexes of the symbols in the file in the order they are shown
+ */
+QList<qint16> LibraryMerge::order() const
+{
+    return m_order;
+}
+
+
+/**
+ * Get the number of changes that the merge makes to the library.
+ *
+ * @param keepTheirs true if the conflicts are resolved by keeping the symbols in the file
+ *
+ * @return the number of symbols updated, removed and added
+ */
+int LibraryMerge::changes(bool keepTheirs) const
+{
+    return updates(keepTheirs).count() + removals(keepTheirs).count() + m_additions.count();
+}
@@ -0,0 +1,69 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Header file for the LibraryMerge class.
+ */
+
+
+#ifndef LibraryMerge_H
+#define LibraryMerge_H
+
+
+#include <QList>
+#include <QMap>
+
+#include "Symbol.h"
+#include "SymbolHistory.h"
+
+
+/**
+ * @brief A three way merge of the symbols of a library with those of its file.
+ *
+ * The symbols of the library as they were read from the file, the base, are compared with the
+ * symbols of the library now and the symbols in the file now, which may have been saved by another
+ * application. Symbols are compared by their content hashes, index by index. A symbol changed
+ * in only one of them takes that change, and a symbol changed in both to different content is a
+ * conflict to be resolved by keeping one or the other. A new symbol added only in the file keeps
+ * its index. New symbols added in both at the same index are not conflicts, the symbol from the
+ * file is added with a new index.
+ *
+ * The histories of the symbols taken from the file and the display order of the file are kept
+ * with the merge, so the symbols keep their revisions and are placed as they are in the file.
+ */
+class LibraryMerge
+{
+public:
+    LibraryMerge(const QMap<qint16, Symbol> &base, const QMap<qint16, Symbol> &mine, const QMap<qint16, Symbol> &theirs, const QMap<qint16, SymbolHistory> &theirHistories, const QList<qint16> &theirOrder);
+
+    QList<qint16> conflicts() const;
+    QMap<qint16, Symbol> updates(bool keepTheirs) const;
+    QList<qint16> removals(bool keepTheirs) const;
+    QList<Symbol> additions() const;
+    QList<qint16> additionIndexes() const;
+    QMap<qint16, SymbolHistory> histories() const;
+    QList<qint16> order() const;
+    int changes(bool keepTheirs) const;
+
+private:
+    QMap<qint16, Symbol>    m_updates;          /**< symbols changed or added only in the file */
+    QList<qint16>           m_removals;         /**< indexes of the symbols removed only from the file */
+    QMap<qint16, Symbol>    m_conflictUpdates;  /**< the symbols in the file for the conflicts where they exist */
+    QList<qint16>           m_conflictRemovals; /**< indexes of the conflicts where the symbol was removed from the file */
+    QList<Symbol>           m_additions;        /**< symbols added to the file at an index also added to the library */
+    QList<qint16>           m_additionIndexes;  /**< indexes of the additions in the file */
+    QMap<qint16, SymbolHistory> m_histories;    /**< histories in the file of the symbols that may be taken from it, by their index in the file */
+    QList<qint16>           m_order;            /**< indexes of the symbols of the file in the order they are shown */
+};
+
+
+#endif
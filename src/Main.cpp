@@ -42,12 +42,16 @@
  *  - @ref rendering_menu
  *  - @ref tools_menu
  *   - @ref tools_toolbar
+ *  - @ref settings_menu
  * - @ref editor_window
  *  - @ref editor_tools
  *  - @ref path_rendering
  *  - @ref points
  *  - @ref editing_symbols
  * - @ref symbol_library
+ * - @ref render_service
+ * - @ref latency_histograms
+ * - @ref library_jobs
  *
  * @section license_section License
  * SymbolEditor is provided as free software; you can redistribute it and/or modify it under the terms of the
@@ -63,16 +67,21 @@
 #include <KAboutData>
 #include <KLocalizedString>
 
+#include "LatencyHistograms.h"
 #include "MainWindow.h"
+#include "Profiling.h"
+#include "RenderService.h"
 #include "Version.h"
 
+#include "SymbolEditor.h"
+
 
 /**
  * The main function creates an instance of a KAboutData object and populates it with any information necessary
  * for the application.
  *
- * A QCommandLineParser object is created to manage any arguments passed on the command line. At this time these are not
- * used.
+ * A QCommandLineParser object is created to manage any arguments passed on the command line. The --render-service
+ * option starts a RenderService with the given name instead of the MainWindow, see @ref render_service.
  *
  * A QApplication object is created to manage the application and a new MainWindow is created and shown on the desktop.
  *
@@ -102,12 +111,38 @@ int main(int argc, char *argv[])
     app.setWindowIcon(QIcon::fromTheme(QStringLiteral("symboleditor")));
 
     QCommandLineParser parser;
+    QCommandLineOption renderServiceOption(QStringLiteral("render-service"), i18n("Run as a symbol rendering service listening on the local socket <name>."), i18n("name"));
+    parser.addOption(renderServiceOption);
     aboutData.setupCommandLine(&parser);
 
     parser.process(app);
 
-    MainWindow *mainWindow = new MainWindow();
-    mainWindow->show();
+    int result;
+
+    if (parser.isSet(renderServiceOption)) {
+        RenderService service;
+
+        if (!service.listen(parser.value(renderServiceOption))) {
+            qCritical("Failed to start the render service: %s", qPrintable(service.errorString()));
+            return 1;
+        }
+
+        result = app.exec();
+    } else {
+        LatencyHistograms::setEnabled(Configuration::diagnostics_RecordLatency());
+        LatencyHistograms::load();
+
+        MainWindow *mainWindow = new MainWindow();
+        mainWindow->show();
+
+        result = app.exec();
+
+        LatencyHistograms::save();
+    }
+
+#if defined(WITH_PROFILING)
+    Profiling::dump();
+#endif
 
-    return app.exec();
+    return result;
 }
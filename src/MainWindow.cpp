@@ -47,7 +47,8 @@
  * Save the current library to a file. If this is a new library the user will be prompted to enter a file name.
  *
  * @subsection file_save_as Save As
- * Save the current library using a different name. The user will be prompted to enter a file name.
+ * Save the current library using a different name. The user will be prompted to enter a file name. A file name
+ * ending in .symc saves the library as a collection of shard files, see @ref symbol_collection.
  *
  * @subsection file_save_symbol Save Symbol
  * Save the current symbol being edited to the current library. This does not save the symbol library to disk, this
@@ -60,8 +61,35 @@
  * and subsequent saves will continue to add new symbols to the library. This can be used to create new symbols based
  * on an existing library symbol.
  *
+ * @subsection file_new_from_default New from Default Library
+ * Replace the current library with a copy of the default library built into SymbolEditor. If the current symbol
+ * and library need to be saved the user is prompted to do so. The new library is untitled, so saving it will ask
+ * for a file name.
+ *
+ * @subsection file_new_editor_pane New Editor Pane
+ * Add an editor beside the existing ones so that several symbols can be edited at the same time. Each editor has its
+ * own undo history. The actions apply to the active editor, which is the one last clicked and is highlighted with a
+ * frame. A symbol can also be opened in a new editor from the context menu of the library.
+ *
+ * @subsection file_close_editor_pane Close Editor Pane
+ * Close the active editor. If the symbol in it has been changed the user is prompted to save it. The last editor can
+ * not be closed.
+ *
  * @subsection file_import_library Import Library
- * Import an existing symbol library and append the symbols in it to the current library.
+ * Import one or more existing symbol libraries and append the symbols in them to the current library. The files are
+ * read in parallel and the symbols from all of them are added as a single change that can be undone in one step.
+ * Symbols that are identical to ones already in the library, or to others being imported, can be skipped.
+ *
+ * @subsection file_symbol_catalog Symbol Catalog
+ * Open the @ref catalog_dialog to search the symbols in all the libraries found in a set of directories.
+ * Opening a symbol from the catalog opens its library and places the symbol in the editor.
+ *
+ * @subsection file_export_distance_fields Export Distance Field Atlas
+ * Export the symbols of the library as a @ref distance_field_atlas. The size in pixels of each symbol in the atlas
+ * is requested before choosing the name of the image file.
+ *
+ * @subsection file_export_header Export C++ Header
+ * Export the symbols of the library as a @ref header_export for applications that embed a fixed set of symbols.
  *
  * @subsection file_close Close
  * Close the current library. The editor and the library are cleared leaving an empty library ready for new symbols
@@ -139,6 +167,19 @@
  * - @ref scale_preferred
  * - @ref snap_grid
  * - @ref guide_lines
+ *
+ * @subsection tools_simplify_symbols Simplify Library Symbols
+ * Remove the points joining straight lines that lie within a tolerance of the straight line replacing them, in
+ * every symbol of the library, using the Douglas-Peucker algorithm on each run of straight lines. The tolerance is
+ * asked for in grid elements. The symbols are simplified as a @ref library_jobs "library job" in the background,
+ * the progress being shown in the status bar where the job can be cancelled. Simplifying again with the same tolerance continues from where the job stopped, and the changes
+ * are made to the library as a single change that can be undone in one step.
+ *
+ * @section settings_menu Settings Menu
+ *
+ * @subsection settings_diagnostics Diagnostics
+ * Open the @ref diagnostics_dialog to enable the recording of the @ref latency_histograms and to see how long the
+ * operations have taken on this computer in this and earlier versions.
  */
 
 
@@ -146,14 +187,29 @@
 
 #include <QAction>
 #include <QActionGroup>
+#include <QApplication>
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QFutureWatcher>
 #include <QIcon>
+#include <QInputDialog>
+#include <QLineEdit>
 #include <QVBoxLayout>
 #include <QListWidgetItem>
+#include <QLocale>
+#include <QLockFile>
 #include <QMenu>
+#include <QPainterPath>
+#include <QProgressBar>
+#include <QProgressDialog>
+#include <QSaveFile>
+#include <QSet>
+#include <QSplitter>
 #include <QStatusBar>
 #include <QTabWidget>
 #include <QTemporaryFile>
+#include <QToolButton>
+#include <QtConcurrent>
 
 #include <kwidgetsaddons_version.h>
 #include <KActionCollection>
@@ -164,24 +220,83 @@
 #include <KMessageBox>
 #include <KRecentFilesAction>
 
+#include "CatalogDialog.h"
 #include "ConfigurationDialogs.h"
+#include "DiagnosticsDialog.h"
+#include "DistanceFieldAtlas.h"
 #include "Editor.h"
 #include "Exceptions.h"
+#include "HeaderExporter.h"
+#include "LatencyHistograms.h"
+#include "LibraryCatalog.h"
+#include "LibraryJob.h"
+#include "LibraryMerge.h"
+#include "Profiling.h"
 #include "SymbolListWidget.h"
 #include "SymbolLibrary.h"
+#include "SymbolQuery.h"
 
 #include "ui_EditorConfigPage.h"
 
 #include "SymbolEditor.h"
 
 
+namespace
+{
+/**
+ * @brief The symbols read from a library file being imported.
+ */
+class ImportedFile
+{
+public:
+    QList<Symbol>       symbols;    /**< the flattened symbols in index order */
+    QList<QByteArray>   hashes;     /**< the content hashes of the symbols */
+    QString             error;      /**< a description of the error if the file could not be read */
+};
+
+
+/**
+ * Read a library file being imported.
+ * This is called on a worker thread for each of the files.
+ *
+ * @param fileName the name of the local file
+ *
+ * @return an ImportedFile containing the symbols or the error
+ */
+ImportedFile readImportedFile(const QString &fileName)
+{
+    ImportedFile file;
+
+    try {
+        file.symbols = SymbolLibrary::readFlattenedSymbols(fileName);
+
+        foreach (const Symbol &symbol, file.symbols) {
+            file.hashes.append(symbol.hash());
+        }
+    } catch (const InvalidFile &e) {
+        file.error = i18n("This doesn't appear to be a valid symbol file");
+    } catch (const InvalidFileVersion &e) {
+        file.error = i18n("Version %1 of the library file is not supported in this version of SymbolEditor", e.version);
+    } catch (const InvalidSymbolVersion &e) {
+        file.error = i18n("Version %1 of a symbol is not supported in this version of SymbolEditor", e.version);
+    } catch (const FailedReadLibrary &e) {
+        file.error = i18n("Failed to read the library\n%1", e.statusMessage());
+    } catch (const FailedFileAccess &e) {
+        file.error = e.errorString;
+    }
+
+    return file;
+}
+}
+
+
 /**
  * Construct the MainWindow.
  * Create an instance of a symbol file.
- * Create the tab widget, editor, list widget and the symbol file. The tab widget is then set as
- * the central widget and will contain the editor and list widgets. The Editor is added to a
- * layout to allow it to be centralized in the main window.
- * Set up the actions, add the two undo stacks to the undo group and connect any signal slots required.
+ * Create the tab widget, editor splitter, list widget and the symbol file. The tab widget is then set as
+ * the central widget and will contain the editor splitter and list widgets. The splitter holds the Editor
+ * panes, the first of which is created once the actions exist so that they can be connected to it.
+ * Set up the actions, add the undo stacks to the undo group and connect any signal slots required.
  * Set up the GUI from the applications rc file.
  * The editor page is selected in the tab widget which should also initialise the undo redo buttons.
  * The moveTo tool action is triggered to enable the moveTo tool as the initial one.
@@ -189,11 +304,20 @@
  */
 MainWindow::MainWindow()
     :   m_tabWidget(new QTabWidget(this)),
-        m_editor(new Editor),
+        m_editorSplitter(new QSplitter(m_tabWidget)),
+        m_editor(nullptr),
         m_listWidget(new SymbolListWidget(m_tabWidget)),
+        m_queryEdit(new QLineEdit(m_tabWidget)),
         m_symbolLibrary(new SymbolLibrary(m_listWidget)),
+        m_catalog(new LibraryCatalog(this)),
+        m_catalogDialog(nullptr),
+        m_diagnosticsDialog(nullptr),
+        m_job(nullptr),
+        m_jobProgress(new QProgressBar(this)),
+        m_jobCancel(new QToolButton(this)),
         m_item(nullptr),
-        m_menu(nullptr)
+        m_menu(nullptr),
+        m_revisionsMenu(nullptr)
 {
     m_listWidget->loadFromLibrary(m_symbolLibrary);
     m_url = QUrl(i18n("Untitled"));
@@ -205,29 +329,45 @@ MainWindow::MainWindow()
     m_listWidget->setIconSize(48);
     m_listWidget->setContextMenuPolicy(Qt::CustomContextMenu);
 
-    m_tabWidget->addTab(m_editor, i18nc("The editor tab title", "Editor"));
-    m_tabWidget->addTab(m_listWidget, i18nc("The library tab title", "Library"));
+    m_tabWidget->addTab(m_editorSplitter, i18nc("The editor tab title", "Editor"));
+    m_queryEdit->setPlaceholderText(i18n("Query the symbols, for example: stroked elements>200"));
+    m_queryEdit->setClearButtonEnabled(true);
+
+    QWidget *libraryPage = new QWidget(m_tabWidget);
+    QVBoxLayout *libraryLayout = new QVBoxLayout(libraryPage);
+    libraryLayout->setContentsMargins(0, 0, 0, 0);
+    libraryLayout->addWidget(m_queryEdit);
+    libraryLayout->addWidget(m_listWidget);
+
+    m_tabWidget->addTab(libraryPage, i18nc("The library tab title", "Library"));
 
     setCentralWidget(m_tabWidget);
 
+    m_jobProgress->setMaximumWidth(300);
+    m_jobProgress->hide();
+    m_jobCancel->setIcon(QIcon::fromTheme(QStringLiteral("process-stop")));
+    m_jobCancel->setToolTip(i18n("Cancel"));
+    m_jobCancel->setAutoRaise(true);
+    m_jobCancel->hide();
+    statusBar()->addPermanentWidget(m_jobProgress);
+    statusBar()->addPermanentWidget(m_jobCancel);
+
     setupActions();
 
-    m_undoGroup.addStack(m_editor->undoStack());
     m_undoGroup.addStack(m_symbolLibrary->undoStack());
+    addEditorPane();
+
     connect(m_tabWidget, SIGNAL(currentChanged(int)), this, SLOT(currentChanged(int)));
-    connect(m_editor, SIGNAL(message(QString)), statusBar(), SLOT(showMessage(QString)));
-    connect(m_editor, SIGNAL(minLineWidth(bool)), actions->action(QStringLiteral("decreaseLineWidth")), SLOT(setDisabled(bool)));
-    connect(m_editor, SIGNAL(maxLineWidth(bool)), actions->action(QStringLiteral("increaseLineWidth")), SLOT(setDisabled(bool)));
     connect(&m_undoGroup, SIGNAL(canUndoChanged(bool)), actions->action(QStringLiteral("edit_undo")), SLOT(setEnabled(bool)));
     connect(&m_undoGroup, SIGNAL(canRedoChanged(bool)), actions->action(QStringLiteral("edit_redo")), SLOT(setEnabled(bool)));
     connect(&m_undoGroup, SIGNAL(undoTextChanged(QString)), this, SLOT(undoTextChanged(QString)));
     connect(&m_undoGroup, SIGNAL(redoTextChanged(QString)), this, SLOT(redoTextChanged(QString)));
     connect(&m_undoGroup, SIGNAL(cleanChanged(bool)), this, SLOT(cleanChanged(bool)));
-    connect(m_editor->undoStack(), SIGNAL(cleanChanged(bool)), actions->action(QStringLiteral("saveSymbol")), SLOT(setDisabled(bool)));
-    connect(m_editor->undoStack(), SIGNAL(cleanChanged(bool)), actions->action(QStringLiteral("saveSymbolAsNew")), SLOT(setDisabled(bool)));
     connect(m_symbolLibrary->undoStack(), SIGNAL(cleanChanged(bool)), actions->action(QStringLiteral("file_save")), SLOT(setDisabled(bool)));
     connect(m_listWidget, SIGNAL(itemClicked(QListWidgetItem*)), this, SLOT(itemSelected(QListWidgetItem*)));
     connect(m_listWidget, SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(listWidgetContextMenuRequested(QPoint)));
+    connect(m_queryEdit, SIGNAL(textChanged(QString)), this, SLOT(applyQuery()));
+    connect(m_symbolLibrary->undoStack(), SIGNAL(indexChanged(int)), this, SLOT(applyQuery()));
 
     setupGUI(KXmlGuiWindow::Default, QStringLiteral("SymbolEditorui.rc"));
 
@@ -262,20 +402,29 @@ MainWindow::~MainWindow()
  */
 bool MainWindow::queryClose()
 {
-    return (editorClean() && libraryClean());
+    return (editorsClean() && libraryClean());
 }
 
 
 /**
- * Check if it ok to close the currently edited symbol.
+ * Check if it ok to close the symbol edited in an editor pane.
+ * If the symbol has been changed the pane is made the active one so that the user can see which
+ * symbol is being asked about, and so that saving it saves the symbol from that pane.
+ *
+ * @param editor a pointer to the Editor
  *
  * @return true if is ok to close the symbol, false otherwise
  */
-bool MainWindow::editorClean()
+bool MainWindow::editorClean(Editor *editor)
 {
-    bool clean = m_editor->undoStack()->isClean();
+    bool clean = editor->undoStack()->isClean();
 
     if (!clean) {
+        if (editor != m_editor) {
+            setActiveEditor(editor);
+            m_tabWidget->setCurrentIndex(0);
+        }
+
 #if KWIDGETSADDONS_VERSION >= QT_VERSION_CHECK(5, 100, 0)
         int messageBoxResult = KMessageBox::warningTwoActionsCancel(this,
 #else
@@ -315,6 +464,23 @@ bool MainWindow::editorClean()
 }
 
 
+/**
+ * Check if it is ok to close the symbols edited in all the editor panes.
+ *
+ * @return true if it is ok to close all the symbols, false otherwise
+ */
+bool MainWindow::editorsClean()
+{
+    foreach (Editor *editor, m_editors) {
+        if (!editorClean(editor)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
 /**
  * Check if it is ok to close the library.
  *
@@ -369,7 +535,7 @@ bool MainWindow::libraryClean()
  */
 void MainWindow::fileOpen()
 {
-    QUrl url = QFileDialog::getOpenFileUrl(this, i18n("Open file"), QUrl::fromLocalFile(QDir::homePath()), i18n("Cross Stitch Symbols (*.sym)"));
+    QUrl url = QFileDialog::getOpenFileUrl(this, i18n("Open file"), QUrl::fromLocalFile(QDir::homePath()), i18n("Cross Stitch Symbols (*.sym);;Symbol Collections (*.symc)"));
 
     if (!url.isEmpty()) {
         fileOpen(url);
@@ -386,17 +552,23 @@ void MainWindow::fileOpen()
  * The url of the file is set in the symbol file object only if there were no errors. This will avoid
  * writing to a corrupt file or to a file that isn't a symbol file. The url is added to the recent file
  * list.
+ * Local collection manifests are opened in place so that their shards can be read as they are needed.
  */
 void MainWindow::fileOpen(const QUrl &url)
 {
-    if (!editorClean() || !libraryClean()) {
+    if (!editorsClean() || !libraryClean()) {
         return;
     }
 
+    LatencyTimer latency(LatencyHistograms::Open);
+
     m_symbolLibrary->clear();
-    m_editor->clear();
+    m_queryEdit->clear();
+    clearEditors();
 
-    if (url.isValid()) {
+    if (url.isLocalFile() && SymbolLibrary::isCollectionFile(url.toLocalFile())) {
+        openCollection(url);
+    } else if (url.isValid()) {
         QTemporaryFile tmpFile;
 
         if (tmpFile.open()) {
@@ -412,7 +584,9 @@ void MainWindow::fileOpen(const QUrl &url)
 
                     try {
                         stream >> *m_symbolLibrary;
+                        m_symbolLibrary->setBaseSymbols();
                         m_url = url;
+                        m_fileModified = url.isLocalFile() ? QFileInfo(url.toLocalFile()).lastModified() : QDateTime();
                         KRecentFilesAction *action = static_cast<KRecentFilesAction *>(actionCollection()->action(QStringLiteral("file_open_recent")));
                         action->addUrl(url);
                         action->saveEntries(KConfigGroup(KSharedConfig::openConfig(), QStringLiteral("RecentFiles")));
@@ -442,31 +616,105 @@ void MainWindow::fileOpen(const QUrl &url)
 }
 
 
+/**
+ * Open a library collection from its manifest.
+ * This is protected in a try-catch block to intercept any exceptions that may be thrown by the
+ * loading routines. If there were any errors, the symbol library will be cleared and a suitable
+ * error message will be displayed. Otherwise the url is set and added to the recent file list.
+ *
+ * @param url the url of the local manifest file
+ */
+void MainWindow::openCollection(const QUrl &url)
+{
+    try {
+        m_symbolLibrary->openCollection(url.toLocalFile());
+        m_url = url;
+        KRecentFilesAction *action = static_cast<KRecentFilesAction *>(actionCollection()->action(QStringLiteral("file_open_recent")));
+        action->addUrl(url);
+        action->saveEntries(KConfigGroup(KSharedConfig::openConfig(), QStringLiteral("RecentFiles")));
+        m_tabWidget->setCurrentIndex(1);
+    } catch (const InvalidFile &e) {
+        KMessageBox::error(nullptr, i18n("This doesn't appear to be a valid symbol collection"));
+    } catch (const InvalidFileVersion &e) {
+        KMessageBox::error(nullptr, i18n("Version %1 of the collection file is not supported in this version of SymbolEditor", e.version));
+    } catch (const FailedReadLibrary &e) {
+        KMessageBox::error(nullptr, i18n("Failed to read the collection\n%1", e.statusMessage()));
+        m_symbolLibrary->clear();
+    } catch (const FailedFileAccess &e) {
+        KMessageBox::error(nullptr, i18n("Failed to open the file %1\n%2", e.fileName, e.errorString));
+        m_symbolLibrary->clear();
+    }
+}
+
+
 /**
  * Save the library using its url, if this is Untitled than call saveAs to get a valid url.
- * Open the file and write to the stream. This is protected in a try-catch block to intercept
- * any exceptions thrown by the writing routines. If there were any exceptions thrown or the
- * file could not be opened a suitable error message is shown.
+ * The file is locked while it is saved so that other instances of the SymbolEditor saving the same
+ * file wait for it. If the file has been changed since it was read or last written, the changes are
+ * merged into the library first. Write the file with a QSaveFile so that it is replaced as a whole.
+ * This is protected in a try-catch block to intercept any exceptions thrown by the writing routines.
+ * If there were any exceptions thrown or the file could not be written a suitable error message is
+ * shown and the library is left unsaved.
+ * A url ending in .symc saves the library as a collection, only writing the shards that have
+ * changed. Otherwise any unread shards of a collection are read so the whole library is written.
+ * A shard of a collection that could not be read is never written, the error reading it being shown.
  */
 void MainWindow::save()
 {
     if (m_url == QUrl(i18n("Untitled"))) {
         saveAs();
-    } else {
-        QFile file(m_url.path());
+        return;
+    }
+
+    if (!m_url.isLocalFile()) {
+        KMessageBox::error(nullptr, i18n("Symbol libraries can only be saved to local files"));
+        return;
+    }
+
+    LatencyTimer latency(LatencyHistograms::Save);
 
-        if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    QString fileName = m_url.toLocalFile();
+    QLockFile lock(fileName + QLatin1String(".lock"));
+
+    if (!lock.tryLock(lockTimeout)) {
+        KMessageBox::error(nullptr, i18n("The file %1 is being saved by another application", m_url.fileName()));
+        return;
+    }
+
+    if (m_url.fileName().endsWith(QLatin1String(".symc"))) {
+        try {
+            m_symbolLibrary->saveCollection(fileName);
+            m_symbolLibrary->undoStack()->setClean();
+        } catch (const FailedWriteLibrary &e) {
+            KMessageBox::error(nullptr, i18n("Failed to write the library\n%1", e.statusMessage()));
+        } catch (const FailedFileAccess &e) {
+            KMessageBox::error(nullptr, i18n("Failed to write the file %1\n%2", e.fileName, e.errorString));
+        }
+    } else if (mergeFile(fileName)) {
+        QSaveFile file(fileName);
+
+        if (file.open(QIODevice::WriteOnly)) {
             QDataStream stream(&file);
             stream.setVersion(QDataStream::Qt_4_0);
 
             try {
+                m_symbolLibrary->loadAllShards();
+                m_symbolLibrary->checkShards(true);
                 stream << *m_symbolLibrary;
+
+                if (file.commit()) {
+                    m_fileModified = QFileInfo(fileName).lastModified();
+                    m_symbolLibrary->setBaseSymbols();
+                    m_symbolLibrary->undoStack()->setClean();
+                } else {
+                    KMessageBox::error(nullptr, i18n("Failed to write the file %1\n%2", m_url.fileName(), file.errorString()));
+                }
             } catch (const FailedWriteLibrary &e) {
                 KMessageBox::error(nullptr, i18n("Failed to write the library\n%1", e.statusMessage()));
+            } catch (const FailedFileAccess &e) {
+                file.cancelWriting();
+                KMessageBox::error(nullptr, i18n("Failed to read the file %1\n%2", e.fileName, e.errorString));
             }
-
-            file.close();
-            m_symbolLibrary->undoStack()->setClean();
         } else {
             KMessageBox::error(nullptr, i18n("Failed to open the file %1\n%2", m_url.fileName(), file.errorString()));
         }
@@ -474,6 +722,116 @@ void MainWindow::save()
 }
 
 
+/**
+ * Merge the changes made to the library file by another application.
+ * If the file has not changed since it was read or last written there is nothing to merge. Otherwise the
+ * file is read and merged with the library. If any symbols have been changed in both, the user is asked
+ * whether to keep the symbols of the library or those of the file. The changes are applied with a
+ * MergeLibraryCommand so they can be undone. A file that can not be read can be overwritten if the user
+ * agrees. This is called with the file locked.
+ *
+ * @param fileName the name of the library file
+ *
+ * @return true if the library can be written to the file, false if the save was cancelled
+ */
+bool MainWindow::mergeFile(const QString &fileName)
+{
+    QFileInfo info(fileName);
+
+    if (!info.exists() || info.lastModified() == m_fileModified) {
+        return true;
+    }
+
+    QString error;
+    SymbolLibrary theirs;
+    QFile file(fileName);
+
+    if (file.open(QIODevice::ReadOnly)) {
+        QDataStream stream(&file);
+
+        try {
+            stream >> theirs;
+        } catch (const InvalidFile &e) {
+            error = i18n("This doesn't appear to be a valid symbol file");
+        } catch (const InvalidFileVersion &e) {
+            error = i18n("Version %1 of the library file is not supported in this version of SymbolEditor", e.version);
+        } catch (const InvalidSymbolVersion &e) {
+            error = i18n("Version %1 of the symbol is not supported in this version of SymbolEditor", e.version);
+        } catch (const FailedReadLibrary &e) {
+            error = i18n("Failed to read the library\n%1", e.statusMessage());
+        }
+    } else {
+        error = file.errorString();
+    }
+
+    if (!error.isEmpty()) {
+        return (KMessageBox::warningContinueCancel(this,
+                                                   i18n("The file %1 has been changed by another application but the changes can not be merged.\n%2\nOverwrite the file?", info.fileName(), error),
+                                                   i18n("Merge Library"),
+                                                   KStandardGuiItem::overwrite()) == KMessageBox::Continue);
+    }
+
+    LibraryMerge merge = m_symbolLibrary->merge(theirs);
+    QList<qint16> conflicts = merge.conflicts();
+    bool keepTheirs = false;
+
+    if (!conflicts.isEmpty()) {
+        QStringList indexes;
+
+        foreach (qint16 index, conflicts.mid(0, 20)) {
+            indexes.append(QString::number(index));
+        }
+
+        if (conflicts.count() > 20) {
+            indexes.append(QStringLiteral("..."));
+        }
+
+#if KWIDGETSADDONS_VERSION >= QT_VERSION_CHECK(5, 100, 0)
+        int messageBoxResult = KMessageBox::warningTwoActionsCancel(this,
+#else
+        int messageBoxResult = KMessageBox::warningYesNoCancel(this,
+#endif
+                                                               i18np("Symbol %2 has been changed both in this library and in the file by another application.",
+                                                                     "%1 symbols have been changed both in this library and in the file by another application: %2",
+                                                                     conflicts.count(), indexes.join(QStringLiteral(", "))),
+                                                               i18n("Merge Library"),
+                                                               KGuiItem(i18n("Keep Library Symbols")),
+                                                               KGuiItem(i18n("Keep File Symbols")),
+                                                               KStandardGuiItem::cancel());
+
+        switch (messageBoxResult) {
+#if KWIDGETSADDONS_VERSION >= QT_VERSION_CHECK(5, 100, 0)
+        case KMessageBox::PrimaryAction:
+#else
+        case KMessageBox::Yes:
+#endif
+            keepTheirs = false;
+            break;
+
+#if KWIDGETSADDONS_VERSION >= QT_VERSION_CHECK(5, 100, 0)
+        case KMessageBox::SecondaryAction:
+#else
+        case KMessageBox::No:
+#endif
+            keepTheirs = true;
+            break;
+
+        case KMessageBox::Cancel:
+            return false;
+        }
+    }
+
+    int changes = merge.changes(keepTheirs);
+
+    if (changes) {
+        m_symbolLibrary->undoStack()->push(new MergeLibraryCommand(m_symbolLibrary, merge, keepTheirs));
+        statusBar()->showMessage(i18np("Merged one change from the file", "Merged %1 changes from the file", changes));
+    }
+
+    return true;
+}
+
+
 /**
  * Save the library using a different url.
  * This is also called from save when the assigned url is Untitled.
@@ -481,10 +839,11 @@ void MainWindow::save()
  */
 void MainWindow::saveAs()
 {
-    QUrl url = QFileDialog::getSaveFileUrl(this, i18n("Save As..."), QUrl::fromLocalFile(QDir::homePath()), i18n("Cross Stitch Symbols (*.sym)"));
+    QUrl url = QFileDialog::getSaveFileUrl(this, i18n("Save As..."), QUrl::fromLocalFile(QDir::homePath()), i18n("Cross Stitch Symbols (*.sym);;Symbol Collections (*.symc)"));
 
     if (url.isValid()) {
         m_url = url;
+        m_fileModified = QFileInfo(url.toLocalFile()).lastModified();    // overwriting the file was confirmed, so nothing is merged
         save();
         KRecentFilesAction *action = static_cast<KRecentFilesAction *>(actionCollection()->action(QStringLiteral("file_open_recent")));
         action->addUrl(url);
@@ -502,7 +861,7 @@ void MainWindow::saveAs()
  */
 void MainWindow::newSymbol()
 {
-    if (editorClean()) {
+    if (editorClean(m_editor)) {
         m_editor->clear();
         setActionsFromSymbol(m_editor->symbol().second);
         actionCollection()->action(QStringLiteral("moveTo"))->trigger();   // Select move tool
@@ -510,6 +869,23 @@ void MainWindow::newSymbol()
 }
 
 
+/**
+ * Start a new library from the default library.
+ * Check if the current symbols and library have been saved or can be discarded, then clear the editors
+ * and replace the library with the default one. The library tab is selected to show the symbols.
+ */
+void MainWindow::newFromDefaultLibrary()
+{
+    if (editorsClean() && libraryClean()) {
+        clearEditors();
+        m_queryEdit->clear();
+        m_symbolLibrary->loadDefault();
+        m_url = QUrl(i18n("Untitled"));
+        m_tabWidget->setCurrentIndex(1);
+    }
+}
+
+
 /**
  * Save the current symbol.
  * Store the symbol currently in the editor into the symbol library object. If it is a
@@ -541,62 +917,356 @@ void MainWindow::saveSymbolAsNew()
 
 
 /**
- * Import a library of symbols into the current library.
- * Get a url for the library file and try and download it in case it comes from a remote source.
- * Open the file and read the contents into a new SymbolLibrary object. The read is protected by
- * a try-catch block to intercept any exceptions thrown by the read routines. If there were no
- * errors an ImportLibraryCommand is created and pushed onto the symbol library undo stack.
- * This will copy all the symbols from the imported library into the current library.
- * Any errors will display a suitable error message.
+ * Add a new editor pane.
+ * The new pane is empty and becomes the active one, the editor tab being selected to show it.
+ */
+void MainWindow::newEditorPane()
+{
+    addEditorPane();
+    m_tabWidget->setCurrentIndex(0);
+    m_editor->setFocus();
+}
+
+
+/**
+ * Close the active editor pane.
+ * The last pane can not be closed. If the symbol in the pane has been changed the user is asked
+ * to save it first. The pane following the closed one, or the one before it if it was the last,
+ * becomes the active pane.
+ */
+void MainWindow::closeEditorPane()
+{
+    if (m_editors.count() < 2 || !editorClean(m_editor)) {
+        return;
+    }
+
+    Editor *editor = m_editor;
+    int index = m_editors.indexOf(editor);
+
+    disconnectEditor(editor);
+    m_editor = nullptr;
+    m_editors.removeAt(index);
+    m_undoGroup.removeStack(editor->undoStack());
+    editor->deleteLater();
+
+    action(QStringLiteral("closeEditorPane"))->setEnabled(m_editors.count() > 1);
+    setActiveEditor(m_editors.at(std::min(index, static_cast<int>(m_editors.count()) - 1)));
+}
+
+
+/**
+ * Import libraries of symbols into the current library.
+ * Get the urls for one or more library files, remote files being downloaded to temporary files.
+ * The files are read concurrently on worker threads while a progress dialog is shown, each symbol
+ * being flattened and hashed. The symbols already in the library are hashed on another worker at the
+ * same time, only those that have changed since the attribute table was last updated, or are in
+ * unread shards of a collection, need flattening and hashing. If any of the symbols are identical to symbols already in the library,
+ * or to other symbols being imported, the user is asked if they should be skipped. A single
+ * ImportLibraryCommand is then pushed onto the symbol library undo stack which adds all the symbols
+ * in one pass. Files that could not be read are listed in an error message.
  */
 void MainWindow::importLibrary()
 {
-    QUrl url = QFileDialog::getOpenFileUrl(this, i18n("Import library"), QUrl::fromLocalFile(QDir::homePath()), i18n("Cross Stitch Symbols (*.sym)"));
+    QList<QUrl> urls = QFileDialog::getOpenFileUrls(this, i18n("Import libraries"), QUrl::fromLocalFile(QDir::homePath()), i18n("Cross Stitch Symbols (*.sym)"));
 
-    if (url.isEmpty()) {
+    if (urls.isEmpty()) {
         return;
     }
 
-    if (url.isValid()) {
-        QTemporaryFile tmpFile;
+    LatencyTimer latency(LatencyHistograms::Import);
 
-        if (tmpFile.open()) {
-            KIO::FileCopyJob *job = KIO::file_copy(url, QUrl::fromLocalFile(tmpFile.fileName()), -1, KIO::Overwrite);
+    QStringList errors;
+    QStringList fileNames;
+    QStringList names;
+    QList<QTemporaryFile *> tmpFiles;
+
+    foreach (const QUrl &url, urls) {
+        if (!url.isValid()) {
+            errors.append(i18n("The url %1 is invalid", url.fileName()));
+        } else if (url.isLocalFile()) {
+            fileNames.append(url.toLocalFile());
+            names.append(url.fileName());
+        } else {
+            QTemporaryFile *tmpFile = new QTemporaryFile;
+            tmpFiles.append(tmpFile);
+
+            if (!tmpFile->open()) {
+                errors.append(i18n("%1: %2", url.fileName(), tmpFile->errorString()));
+                continue;
+            }
+
+            KIO::FileCopyJob *job = KIO::file_copy(url, QUrl::fromLocalFile(tmpFile->fileName()), -1, KIO::Overwrite);
 
             if (job->exec()) {
-                SymbolLibrary *lib = new SymbolLibrary;
-                QDataStream stream(&tmpFile);
-
-                try {
-                    stream >> *lib;
-                    m_symbolLibrary->undoStack()->push(new ImportLibraryCommand(m_symbolLibrary, lib));
-                } catch (const InvalidFile &e) {
-                    KMessageBox::error(nullptr, i18n("This doesn't appear to be a valid symbol file"));
-                } catch (const InvalidFileVersion &e) {
-                    KMessageBox::error(nullptr, i18n("Version %1 of the library file is not supported in this version of SymbolEditor", e.version));
-                }
+                fileNames.append(tmpFile->fileName());
+                names.append(url.fileName());
             } else {
-                KMessageBox::error(nullptr, job->errorString());
+                errors.append(i18n("%1: %2", url.fileName(), job->errorString()));
             }
-        } else {
-            KMessageBox::error(nullptr, tmpFile.errorString());
         }
-    } else {
-        KMessageBox::error(nullptr, i18n("The url %1 is invalid", url.fileName()));
     }
+
+    QFutureWatcher<ImportedFile> watcher;
+    QFutureWatcher<QSet<QByteArray> > hashWatcher;
+    QProgressDialog progress(i18n("Reading libraries..."), i18n("Cancel"), 0, fileNames.count(), this);
+    progress.setWindowModality(Qt::WindowModal);
+    auto finished = [&watcher, &hashWatcher, &progress]() {
+        if (watcher.isFinished() && hashWatcher.isFinished()) {
+            progress.reset();
+        }
+    };
+    connect(&watcher, SIGNAL(progressValueChanged(int)), &progress, SLOT(setValue(int)));
+    connect(&watcher, &QFutureWatcherBase::finished, &progress, finished);
+    connect(&hashWatcher, &QFutureWatcherBase::finished, &progress, finished);
+    connect(&progress, SIGNAL(canceled()), &watcher, SLOT(cancel()));
+    hashWatcher.setFuture(QtConcurrent::run(&SymbolLibrary::flattenedHashes, m_symbolLibrary->hashSource()));
+    watcher.setFuture(QtConcurrent::mapped(fileNames, &readImportedFile));
+    progress.exec();
+    watcher.waitForFinished();
+    qDeleteAll(tmpFiles);
+
+    if (watcher.isCanceled()) {
+        return;
+    }
+
+    const QList<ImportedFile> files = watcher.future().results();
+    QList<Symbol> symbols;
+    QList<Symbol> uniqueSymbols;
+    QSet<QByteArray> hashes = hashWatcher.result();
+    int libraries = 0;
+
+    for (int i = 0 ; i < files.count() ; ++i) {
+        const ImportedFile &file = files.at(i);
+
+        if (!file.error.isEmpty()) {
+            errors.append(i18n("%1: %2", names.at(i), file.error));
+            continue;
+        }
+
+        ++libraries;
+
+        for (int s = 0 ; s < file.symbols.count() ; ++s) {
+            symbols.append(file.symbols.at(s));
+
+            if (!hashes.contains(file.hashes.at(s))) {
+                hashes.insert(file.hashes.at(s));
+                uniqueSymbols.append(file.symbols.at(s));
+            }
+        }
+    }
+
+    if (uniqueSymbols.count() < symbols.count()) {
+        int duplicates = symbols.count() - uniqueSymbols.count();
+#if KWIDGETSADDONS_VERSION >= QT_VERSION_CHECK(5, 100, 0)
+        int messageBoxResult = KMessageBox::questionTwoActions(this,
+#else
+        int messageBoxResult = KMessageBox::questionYesNo(this,
+#endif
+                                                               i18np("One imported symbol is identical to another symbol in the library.",
+                                                                     "%1 imported symbols are identical to other symbols in the library.", duplicates),
+                                                               i18n("Import Library"),
+                                                               KGuiItem(i18n("Skip Duplicates")),
+                                                               KGuiItem(i18n("Import All")));
+
+#if KWIDGETSADDONS_VERSION >= QT_VERSION_CHECK(5, 100, 0)
+        if (messageBoxResult == KMessageBox::PrimaryAction) {
+#else
+        if (messageBoxResult == KMessageBox::Yes) {
+#endif
+            symbols = uniqueSymbols;
+        }
+    }
+
+    if (!symbols.isEmpty()) {
+        m_symbolLibrary->undoStack()->push(new ImportLibraryCommand(m_symbolLibrary, symbols, libraries));
+    }
+
+    if (!errors.isEmpty()) {
+        KMessageBox::errorList(this, i18n("Some of the files could not be imported."), errors);
+    }
+}
+
+
+/**
+ * Show the symbol catalog dialog, creating it if necessary.
+ * The catalog directories are rescanned in the background each time the dialog is shown so
+ * that any changed libraries are indexed again.
+ */
+void MainWindow::libraryCatalog()
+{
+    if (m_catalogDialog == nullptr) {
+        m_catalogDialog = new CatalogDialog(m_catalog, m_editor, this);
+        connect(m_catalogDialog, SIGNAL(openSymbol(QString,qint16)), this, SLOT(openLibrarySymbol(QString,qint16)));
+    }
+
+    m_catalogDialog->show();
+    m_catalogDialog->raise();
+    m_catalog->rescan();
+}
+
+
+/**
+ * Export the symbols of the library as a distance field atlas.
+ * The user is asked for the size of each symbol in the atlas, defaulting to the last size used, and
+ * the name of the image file. Any unread shards of a collection are read so that all the symbols are
+ * exported. The atlas is made in the background as a job, its progress being shown in the status bar.
+ * An atlas too large to be created and errors writing the files display a suitable error message.
+ */
+void MainWindow::exportDistanceFields()
+{
+    bool ok;
+    int size = QInputDialog::getInt(this, i18n("Export Distance Field Atlas"), i18n("Symbol size in pixels"), Configuration::export_DistanceFieldSize(), 16, 256, 1, &ok);
+
+    if (!ok) {
+        return;
+    }
+
+    QString fileName = QFileDialog::getSaveFileName(this, i18n("Export Distance Field Atlas"), QDir::homePath(), i18n("PNG Images (*.png)"));
+
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    Configuration::setExport_DistanceFieldSize(size);
+    Configuration::self()->save();
+
+    m_symbolLibrary->loadAllShards();
+    reportShardErrors();
+
+    DistanceFieldAtlas *atlas = new DistanceFieldAtlas(m_symbolLibrary, fileName, size, this);
+    showJob(atlas, atlas->text());
+
+    connect(atlas, SIGNAL(finished()), this, SLOT(atlasExported()));
+    connect(atlas, SIGNAL(failed(QString,QString)), this, SLOT(atlasFailed(QString,QString)));
+    connect(atlas, SIGNAL(cancelled()), this, SLOT(atlasCancelled()));
+
+    try {
+        atlas->start();
+    } catch (const FailedFileAccess &e) {
+        endJob();
+        KMessageBox::error(nullptr, i18n("Failed to write the file %1\n%2", e.fileName, e.errorString));
+    }
+}
+
+
+/**
+ * Called when the distance field atlas has been written.
+ */
+void MainWindow::atlasExported()
+{
+    statusBar()->showMessage(i18n("%1 finished", m_jobText));
+    endJob();
+}
+
+
+/**
+ * Called when the files of the distance field atlas could not be written.
+ *
+ * @param fileName the name of the file that could not be written
+ * @param error a description of the error
+ */
+void MainWindow::atlasFailed(const QString &fileName, const QString &error)
+{
+    endJob();
+    KMessageBox::error(nullptr, i18n("Failed to write the file %1\n%2", fileName, error));
+}
+
+
+/**
+ * Called when the export of the distance field atlas has been cancelled.
+ */
+void MainWindow::atlasCancelled()
+{
+    statusBar()->showMessage(i18n("%1 cancelled", m_jobText));
+    endJob();
+}
+
+
+/**
+ * Show the errors of the shards of a collection that could not be read, if there are any.
+ * The symbols of these shards are missing from anything that uses all the symbols of the library.
+ */
+void MainWindow::reportShardErrors()
+{
+    QStringList errors = m_symbolLibrary->shardErrors();
+
+    if (!errors.isEmpty()) {
+        KMessageBox::errorList(this, i18n("Some shards of the collection could not be read, their symbols are missing"), errors);
+    }
+}
+
+
+/**
+ * Export the symbols of the library as a C++ header.
+ * The user is asked for the name of the header file, the namespace in the header being derived from it.
+ * Any unread shards of a collection are read so that all the symbols are exported. Errors writing the
+ * file display a suitable error message.
+ */
+void MainWindow::exportHeader()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, i18n("Export C++ Header"), QDir::homePath(), i18n("C++ Headers (*.h)"));
+
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    try {
+        m_symbolLibrary->loadAllShards();
+        reportShardErrors();
+        HeaderExporter::write(m_symbolLibrary, fileName);
+    } catch (const FailedFileAccess &e) {
+        KMessageBox::error(nullptr, i18n("Failed to write the file %1\n%2", e.fileName, e.errorString));
+    }
+}
+
+
+/**
+ * Open a library at a symbol.
+ * If the library is not the current one it is opened, which will check if the current symbol and
+ * library need saving. The symbol is then placed in the editor and selected in the library view.
+ *
+ * @param path the path of the library file
+ * @param index the index of the symbol in the library
+ */
+void MainWindow::openLibrarySymbol(const QString &path, qint16 index)
+{
+    QUrl url = QUrl::fromLocalFile(path);
+
+    if (m_url != url) {
+        fileOpen(url);
+
+        if (m_url != url) {
+            return;     // the open was cancelled or failed
+        }
+    } else if (!editorClean(m_editor)) {
+        return;
+    }
+
+    if (!m_symbolLibrary->indexes().contains(index)) {
+        KMessageBox::error(nullptr, i18n("Symbol %1 was not found in the library, the catalog may need to be rescanned", index));
+        return;
+    }
+
+    QPair<qint16, Symbol> pair(index, m_symbolLibrary->symbol(index));
+    m_editor->clear();
+    m_editor->setSymbol(pair);
+    setActionsFromSymbol(pair.second);
+    m_listWidget->selectSymbol(index);
+    m_tabWidget->setCurrentIndex(0);
 }
 
 
 /**
  * Close the current library.
- * Check if the current symbol and the symbol library need to be saved and then clear
- * the library and the editor.
+ * Check if the current symbols and the symbol library need to be saved and then clear
+ * the library and the editors.
  */
 void MainWindow::close()
 {
-    if (editorClean() && libraryClean()) {
-        m_editor->clear();
+    if (editorsClean() && libraryClean()) {
+        clearEditors();
         m_symbolLibrary->clear();
+        m_queryEdit->clear();
         m_url = QUrl(i18n("Untitled"));
     }
 }
@@ -619,6 +1289,10 @@ void MainWindow::quit()
  */
 void MainWindow::undo()
 {
+    PROFILE_COUNT(UndoCommandsReplayed);
+    PROFILE_TIMER(UndoCommandsReplayed);
+    LatencyTimer latency(LatencyHistograms::UndoRedo);
+
     m_undoGroup.undo();
 }
 
@@ -630,6 +1304,10 @@ void MainWindow::undo()
  */
 void MainWindow::redo()
 {
+    PROFILE_COUNT(UndoCommandsReplayed);
+    PROFILE_TIMER(UndoCommandsReplayed);
+    LatencyTimer latency(LatencyHistograms::UndoRedo);
+
     m_undoGroup.redo();
 }
 
@@ -698,6 +1376,20 @@ void MainWindow::currentChanged(int index)
 }
 
 
+/**
+ * Make the editor pane that has been given the focus the active one.
+ * This is connected to the Editor::activated() signal of each of the panes.
+ */
+void MainWindow::editorActivated()
+{
+    Editor *editor = qobject_cast<Editor *>(sender());
+
+    if (editor && editor != m_editor) {
+        setActiveEditor(editor);
+    }
+}
+
+
 /**
  * Edit an existing symbol from the symbol library.
  * Check if the current symbol being edited has been changed. If yes, ask if it should be
@@ -711,7 +1403,7 @@ void MainWindow::itemSelected(QListWidgetItem *item)
 {
     QPair<qint16, Symbol> pair;
 
-    if (editorClean()) {
+    if (editorClean(m_editor)) {
         m_editor->clear();
         pair.first = static_cast<qint16>(item->data(Qt::UserRole).toInt());
         pair.second = m_symbolLibrary->symbol(pair.first);
@@ -726,6 +1418,9 @@ void MainWindow::itemSelected(QListWidgetItem *item)
  * Display a context menu for the list widget.
  * Options:
  *  Delete Symbol
+ *  Use as Component
+ *  Edit in New Pane
+ *  Revisions, listing the earlier revisions of the symbol newest first
  *
  * @param pos a const reference to a QPoint representing the cursor position
  */
@@ -735,6 +1430,25 @@ void MainWindow::listWidgetContextMenuRequested(const QPoint &pos)
         if (!m_menu) {
             m_menu = new QMenu;
             m_menu->addAction(i18n("Delete Symbol"), this, SLOT(deleteSymbol()));
+            m_menu->addAction(i18n("Use as Component"), this, SLOT(useAsComponent()));
+            m_menu->addAction(i18n("Edit in New Pane"), this, SLOT(openInNewPane()));
+            m_revisionsMenu = m_menu->addMenu(i18n("Revisions"));
+            connect(m_revisionsMenu, SIGNAL(triggered(QAction*)), this, SLOT(openRevision(QAction*)));
+        }
+
+        qint16 index = static_cast<qint16>(m_item->data(Qt::UserRole).toInt());
+        SymbolHistory history = m_symbolLibrary->history(index);
+
+        m_revisionsMenu->clear();
+        m_revisionsMenu->setEnabled(!history.isEmpty());
+
+        for (int revision = history.count() - 1 ; revision >= 0 ; --revision) {
+            Symbol symbol = history.revision(revision);
+            QPainterPath path = symbol.path();
+            path.addPath(m_symbolLibrary->componentsPath(symbol));
+            symbol.setPath(path);
+            QAction *action = m_revisionsMenu->addAction(SymbolListWidget::createIcon(symbol, 32), QLocale().toString(history.timestamp(revision).toLocalTime(), QLocale::ShortFormat));
+            action->setData(revision);
         }
 
         m_menu->popup(QCursor::pos());
@@ -751,6 +1465,222 @@ void MainWindow::deleteSymbol()
 }
 
 
+/**
+ * Add the symbol pointed to by m_item to the symbol in the editor as a component.
+ * The component is refused if it already depends on the symbol being edited as this would create
+ * a cycle. The editor tab is selected to show the result.
+ */
+void MainWindow::useAsComponent()
+{
+    qint16 index = static_cast<qint16>(m_item->data(Qt::UserRole).toInt());
+    QPair<qint16, Symbol> pair = m_editor->symbol();
+
+    if (pair.first && m_symbolLibrary->dependsOn(index, pair.first)) {
+        KMessageBox::error(nullptr, i18n("Symbol %1 uses the symbol being edited so it can not be one of its components", index));
+        return;
+    }
+
+    QList<SymbolComponent> components = pair.second.components();
+    components.append(SymbolComponent(index, QTransform()));
+    m_editor->undoStack()->push(new ChangeComponentsCommand(m_editor, components));
+    m_tabWidget->setCurrentIndex(0);
+}
+
+
+/**
+ * Edit the symbol pointed to by m_item in a new editor pane.
+ * The symbols in the other panes are left as they are, so no check for changes is needed.
+ */
+void MainWindow::openInNewPane()
+{
+    QPair<qint16, Symbol> pair;
+    pair.first = static_cast<qint16>(m_item->data(Qt::UserRole).toInt());
+    pair.second = m_symbolLibrary->symbol(pair.first);
+
+    Editor *editor = addEditorPane();
+    editor->setSymbol(pair);
+    setActionsFromSymbol(pair.second);
+    m_tabWidget->setCurrentIndex(0);
+    editor->setFocus();
+}
+
+
+/**
+ * Open a revision of the symbol pointed to by m_item in a new editor pane.
+ * The revision is edited with the index of the symbol, so saving it restores it to the library
+ * and adds the current symbol to the history.
+ *
+ * @param action a pointer to the QAction of the Revisions menu holding the revision number
+ */
+void MainWindow::openRevision(QAction *action)
+{
+    QPair<qint16, Symbol> pair;
+    pair.first = static_cast<qint16>(m_item->data(Qt::UserRole).toInt());
+    pair.second = m_symbolLibrary->history(pair.first).revision(action->data().toInt());
+
+    Editor *editor = addEditorPane();
+    editor->setSymbol(pair);
+    setActionsFromSymbol(pair.second);
+    m_tabWidget->setCurrentIndex(0);
+    editor->setFocus();
+}
+
+
+/**
+ * Filter the library view with the query.
+ * This is called as the query is typed and when the library changes. An empty query shows all the
+ * symbols. A query that can not be parsed, which is usual while it is being typed, leaves the view
+ * as it is and shows the reason in the status bar.
+ */
+void MainWindow::applyQuery()
+{
+    QString text = m_queryEdit->text().trimmed();
+
+    if (text.isEmpty()) {
+        m_listWidget->clearFilter();
+        return;
+    }
+
+    qreal border = static_cast<qreal>(Configuration::editor_BorderSize()) / Configuration::editor_GridElements();
+    SymbolQuery query(text, QRectF(border, border, 1.0 - 2 * border, 1.0 - 2 * border));
+
+    if (!query.isValid()) {
+        statusBar()->showMessage(query.errorString());
+        return;
+    }
+
+    QList<qint16> indexes = m_symbolLibrary->query(query);
+    m_listWidget->filterSymbols(indexes);
+    statusBar()->showMessage(i18np("%1 symbol matches the query", "%1 symbols match the query", indexes.count()));
+}
+
+
+/**
+ * Simplify all the symbols of the library.
+ * The user is asked for the tolerance in grid elements, defaulting to the last tolerance used. The
+ * symbols are simplified by a LibraryJob, continuing from any earlier run with the same tolerance
+ * that was cancelled or interrupted.
+ */
+void MainWindow::simplifySymbols()
+{
+    bool ok;
+    double tolerance = QInputDialog::getDouble(this, i18n("Simplify Library Symbols"), i18n("Tolerance in grid elements"), Configuration::jobs_SimplifyTolerance(), 0.01, 1.0, 2, &ok);
+
+    if (!ok) {
+        return;
+    }
+
+    Configuration::setJobs_SimplifyTolerance(tolerance);
+    Configuration::self()->save();
+
+    qreal distance = tolerance / Configuration::editor_GridElements();
+
+    // the parameters name the algorithm so that checkpoints of the earlier simplification are not continued
+    startJob(new LibraryJob(m_symbolLibrary, QStringLiteral("simplify"), i18n("Simplify Symbols"), QByteArray("douglas-peucker ") + QByteArray::number(distance, 'g', 17),
+        [distance](const Symbol &symbol) {
+            return symbol.simplified(distance);
+        },
+        this));
+}
+
+
+/**
+ * Start a library job, showing its progress in the status bar.
+ * If the job continues from an earlier run the user is told how much of it had already been done.
+ *
+ * @param job a pointer to the LibraryJob, this is deleted when the job ends
+ */
+void MainWindow::startJob(LibraryJob *job)
+{
+    showJob(job, job->text());
+
+    connect(job, SIGNAL(finished(int)), this, SLOT(jobFinished(int)));
+    connect(job, SIGNAL(cancelled()), this, SLOT(jobCancelled()));
+
+    job->start();
+
+    if (m_job == job && job->processed()) {
+        statusBar()->showMessage(i18n("%1 continues from an earlier run, %2 of %3 symbols are already done", job->text(), job->processed(), job->count()));
+    }
+}
+
+
+/**
+ * Show the progress of a job in the status bar.
+ * Only one job runs at a time, the actions starting jobs being disabled until it ends. The job
+ * must have a progress(int,int) signal and a cancel() slot.
+ *
+ * @param job a pointer to the QObject of the job, this is deleted when the job ends
+ * @param text a description of the job shown with its progress
+ */
+void MainWindow::showJob(QObject *job, const QString &text)
+{
+    m_job = job;
+    m_jobText = text;
+    actionCollection()->action(QStringLiteral("simplifySymbols"))->setEnabled(false);
+    actionCollection()->action(QStringLiteral("exportDistanceFields"))->setEnabled(false);
+
+    m_jobProgress->setFormat(i18nc("%p is replaced by the percentage done", "%1: %p%", text));
+    m_jobProgress->reset();
+    m_jobProgress->show();
+    m_jobCancel->show();
+
+    connect(job, SIGNAL(progress(int,int)), this, SLOT(jobProgress(int,int)));
+    connect(m_jobCancel, SIGNAL(clicked()), job, SLOT(cancel()));
+}
+
+
+/**
+ * Update the progress of the job in the status bar.
+ *
+ * @param processed the number of symbols processed
+ * @param count the number of symbols the job runs over
+ */
+void MainWindow::jobProgress(int processed, int count)
+{
+    m_jobProgress->setMaximum(count);
+    m_jobProgress->setValue(processed);
+}
+
+
+/**
+ * Called when the library job has processed all the symbols and its changes have been made to the library.
+ *
+ * @param changed the number of symbols changed by the job
+ */
+void MainWindow::jobFinished(int changed)
+{
+    statusBar()->showMessage(i18np("%2 changed one symbol", "%2 changed %1 symbols", changed, m_jobText));
+    endJob();
+}
+
+
+/**
+ * Called when the library job has been cancelled, the symbols already processed being kept for
+ * the next time the job is started.
+ */
+void MainWindow::jobCancelled()
+{
+    statusBar()->showMessage(i18n("%1 cancelled, it will continue from where it stopped when it is started again", m_jobText));
+    endJob();
+}
+
+
+/**
+ * Remove the progress of the job from the status bar and delete the job.
+ */
+void MainWindow::endJob()
+{
+    m_jobProgress->hide();
+    m_jobCancel->hide();
+    actionCollection()->action(QStringLiteral("simplifySymbols"))->setEnabled(true);
+    actionCollection()->action(QStringLiteral("exportDistanceFields"))->setEnabled(true);
+
+    m_job->deleteLater();
+    m_job = nullptr;
+}
+
+
 /**
  * Configure the application.
  * Display the configuration dialog, creating it if necessary.
@@ -767,12 +1697,53 @@ void MainWindow::preferences()
     dialog->addPage(new EditorConfigPage(nullptr, QStringLiteral("EditorConfigPage")), i18nc("The Editor configuration page", "Editor"), QStringLiteral("preferences-desktop"));
 //    dialog->setHelp("ConfigurationDialog");
 
-    connect(dialog, SIGNAL(settingsChanged(QString)), m_editor, SLOT(readSettings()));
+    connect(dialog, SIGNAL(settingsChanged(QString)), this, SLOT(settingsChanged()));
 
     dialog->show();
 }
 
 
+/**
+ * Apply the changed settings.
+ * The shared editor cache is read first so that the editors use the new grid and guides.
+ */
+void MainWindow::settingsChanged()
+{
+    m_editorCache.readSettings();
+
+    foreach (Editor *editor, m_editors) {
+        editor->readSettings();
+        editor->update();
+    }
+}
+
+
+/**
+ * Show the diagnostics dialog, creating it if necessary.
+ */
+void MainWindow::diagnostics()
+{
+    if (m_diagnosticsDialog == nullptr) {
+        m_diagnosticsDialog = new DiagnosticsDialog(this);
+    }
+
+    m_diagnosticsDialog->show();
+    m_diagnosticsDialog->raise();
+}
+
+
+/**
+ * Write the profiling counters to the standard error output.
+ * The action is always created so that it can be listed in the ui.rc file, but it is only
+ * enabled in builds configured with WITH_PROFILING.
+ */
+void MainWindow::dumpProfiling()
+{
+    Profiling::dump();
+    statusBar()->showMessage(i18n("Profiling counters written to the standard error output"));
+}
+
+
 /**
  * Set up the applications actions.
  * Create standard actions.
@@ -794,12 +1765,53 @@ void MainWindow::setupActions()
     KStandardAction::save(this, SLOT(save()), actions);
     KStandardAction::saveAs(this, SLOT(saveAs()), actions);
 
+    action = new QAction(this);
+    action->setText(i18n("New from Default Library"));
+    action->setWhatsThis(i18n("Start a new library containing the symbols of the default library."));
+    action->setIcon(QIcon::fromTheme(QStringLiteral("document-new")));
+    connect(action, SIGNAL(triggered()), this, SLOT(newFromDefaultLibrary()));
+    actions->addAction(QStringLiteral("newFromDefaultLibrary"), action);
+
+    action = new QAction(this);
+    action->setText(i18n("New Editor Pane"));
+    action->setWhatsThis(i18n("Add an editor beside the existing ones so that several symbols can be edited at the same time. Each editor has its own undo history."));
+    action->setIcon(QIcon::fromTheme(QStringLiteral("view-split-left-right")));
+    connect(action, SIGNAL(triggered()), this, SLOT(newEditorPane()));
+    actions->addAction(QStringLiteral("newEditorPane"), action);
+
+    action = new QAction(this);
+    action->setText(i18n("Close Editor Pane"));
+    action->setWhatsThis(i18n("Close the active editor, asking to save the symbol in it if it has been changed. The last editor can not be closed."));
+    action->setIcon(QIcon::fromTheme(QStringLiteral("view-close")));
+    action->setEnabled(false);
+    connect(action, SIGNAL(triggered()), this, SLOT(closeEditorPane()));
+    actions->addAction(QStringLiteral("closeEditorPane"), action);
+
     action = new QAction(this);
     action->setText(i18n("Import Library"));
     action->setWhatsThis(i18n("Imports another library appending the symbols it contains to the current library."));
     connect(action, SIGNAL(triggered()), this, SLOT(importLibrary()));
     actions->addAction(QStringLiteral("importLibrary"), action);
 
+    action = new QAction(this);
+    action->setText(i18n("Symbol Catalog..."));
+    action->setWhatsThis(i18n("Search the symbols in all the libraries found in a set of directories and open a library at a symbol."));
+    action->setIcon(QIcon::fromTheme(QStringLiteral("edit-find")));
+    connect(action, SIGNAL(triggered()), this, SLOT(libraryCatalog()));
+    actions->addAction(QStringLiteral("libraryCatalog"), action);
+
+    action = new QAction(this);
+    action->setText(i18n("Export Distance Field Atlas..."));
+    action->setWhatsThis(i18n("Export the symbols of the library as signed distance fields packed into a single image, allowing them to be drawn at any scale."));
+    connect(action, SIGNAL(triggered()), this, SLOT(exportDistanceFields()));
+    actions->addAction(QStringLiteral("exportDistanceFields"), action);
+
+    action = new QAction(this);
+    action->setText(i18n("Export C++ Header..."));
+    action->setWhatsThis(i18n("Export the symbols of the library as a C++ header containing constant arrays of the symbol paths and their rendering attributes."));
+    connect(action, SIGNAL(triggered()), this, SLOT(exportHeader()));
+    actions->addAction(QStringLiteral("exportHeader"), action);
+
     action = new QAction(this);
     action->setText(i18n("Save Symbol"));
     action->setWhatsThis(i18n("Save the symbol to the library. If this is a new symbol, subsequent saves will create additional symbols in the library. If the symbol was selected from the library to edit then saving will update that symbol in the library."));
@@ -826,7 +1838,6 @@ void MainWindow::setupActions()
     action->setWhatsThis(i18n("Enable path filling. The path defines the closed boundary of the shape and the path is filled with the selected fill method."));
     action->setIcon(QIcon::fromTheme(QStringLiteral("format-fill-color")));
     action->setCheckable(true);
-    connect(action, SIGNAL(triggered(bool)), m_editor, SLOT(selectFilled(bool)));
     actions->addAction(QStringLiteral("fillPath"), action);
 
     actionGroup = new QActionGroup(this);
@@ -850,7 +1861,6 @@ void MainWindow::setupActions()
     actions->addAction(QStringLiteral("windingFill"), action);
     actionGroup->addAction(action);
 
-    connect(actionGroup, SIGNAL(triggered(QAction*)), m_editor, SLOT(selectFillRule(QAction*)));
 
     actionGroup = new QActionGroup(this);
     actionGroup->setExclusive(true);
@@ -882,7 +1892,6 @@ void MainWindow::setupActions()
     actions->addAction(QStringLiteral("roundCap"), action);
     actionGroup->addAction(action);
 
-    connect(actionGroup, SIGNAL(triggered(QAction*)), m_editor, SLOT(selectCapStyle(QAction*)));
 
     actionGroup = new QActionGroup(this);
     actionGroup->setExclusive(true);
@@ -914,20 +1923,17 @@ void MainWindow::setupActions()
     actions->addAction(QStringLiteral("roundJoin"), action);
     actionGroup->addAction(action);
 
-    connect(actionGroup, SIGNAL(triggered(QAction*)), m_editor, SLOT(selectJoinStyle(QAction*)));
 
     action = new QAction(this);
     action->setText(i18n("Increase Line Width"));
     action->setWhatsThis(i18n("Increases the line width.\n\nThis is only applicable to non-filled paths."));
     action->setIcon(QIcon::fromTheme(QStringLiteral("symboleditor-increase-line-width")));
-    connect(action, SIGNAL(triggered()), m_editor, SLOT(increaseLineWidth()));
     actions->addAction(QStringLiteral("increaseLineWidth"), action);
 
     action = new QAction(this);
     action->setText(i18n("Decrease Line Width"));
     action->setWhatsThis(i18n("Decreases the line width.\n\nThis is only applicable to non-filled paths."));
     action->setIcon(QIcon::fromTheme(QStringLiteral("symboleditor-decrease-line-width")));
-    connect(action, SIGNAL(triggered()), m_editor, SLOT(decreaseLineWidth()));
     actions->addAction(QStringLiteral("decreaseLineWidth"), action);
 
     // Tools Menu
@@ -988,49 +1994,53 @@ void MainWindow::setupActions()
     actions->addAction(QStringLiteral("character"), action);
     actionGroup->addAction(action);
 
-    connect(actionGroup, SIGNAL(triggered(QAction*)), m_editor, SLOT(selectTool(QAction*)));
 
     action = new QAction(this);
     action->setText(i18n("Rotate Left"));
     action->setWhatsThis(i18n("Rotate all the points of a path counter-clockwise 90 degrees around the center of the editor."));
     action->setIcon(QIcon::fromTheme(QStringLiteral("object-rotate-left")));
-    connect(action, SIGNAL(triggered()), m_editor, SLOT(rotateLeft()));
     actions->addAction(QStringLiteral("rotateLeft"), action);
 
     action = new QAction(this);
     action->setText(i18n("Rotate Right"));
     action->setWhatsThis(i18n("Rotate all the points of a path clockwise 90 degrees around the center point of the editor."));
     action->setIcon(QIcon::fromTheme(QStringLiteral("object-rotate-right")));
-    connect(action, SIGNAL(triggered()), m_editor, SLOT(rotateRight()));
     actions->addAction(QStringLiteral("rotateRight"), action);
 
     action = new QAction(this);
     action->setText(i18n("Flip Horizontal"));
     action->setWhatsThis(i18n("Flip all the points of the path horizontally about the vertical center of the editor."));
     action->setIcon(QIcon::fromTheme(QStringLiteral("object-flip-horizontal")));
-    connect(action, SIGNAL(triggered()), m_editor, SLOT(flipHorizontal()));
     actions->addAction(QStringLiteral("flipHorizontal"), action);
 
     action = new QAction(this);
     action->setText(i18n("Flip Vertical"));
     action->setWhatsThis(i18n("Flip all the points of the path vertically about the horizontal center of the editor."));
     action->setIcon(QIcon::fromTheme(QStringLiteral("object-flip-vertical")));
-    connect(action, SIGNAL(triggered()), m_editor, SLOT(flipVertical()));
     actions->addAction(QStringLiteral("flipVertical"), action);
 
     action = new QAction(this);
     action->setText(i18n("Scale to Preferred Size"));
     action->setWhatsThis(i18n("Scale the current symbol so that it fits within the preferred size of a symbol."));
     action->setIcon(QIcon::fromTheme(QStringLiteral("symboleditor-scale-preferred")));
-    connect(action, SIGNAL(triggered()), m_editor, SLOT(scalePreferred()));
     actions->addAction(QStringLiteral("scalePreferred"), action);
 
+    action = new QAction(this);
+    action->setText(i18n("Remove Components"));
+    action->setWhatsThis(i18n("Remove the other library symbols that have been added to the current symbol as components."));
+    actions->addAction(QStringLiteral("removeComponents"), action);
+
+    action = new QAction(this);
+    action->setText(i18n("Simplify Library Symbols..."));
+    action->setWhatsThis(i18n("Remove the points of straight lines that lie on the line joining their neighbours in every symbol of the library. The symbols are simplified in the background and the job continues from where it stopped if it is cancelled or interrupted."));
+    connect(action, SIGNAL(triggered()), this, SLOT(simplifySymbols()));
+    actions->addAction(QStringLiteral("simplifySymbols"), action);
+
     action = new QAction(this);
     action->setText(i18n("Enable Snap"));
     action->setWhatsThis(i18n("Enable snapping of points to guide intersections or to the grid."));
     action->setIcon(QIcon::fromTheme(QStringLiteral("snap-orthogonal")));
     action->setCheckable(true);
-    connect(action, SIGNAL(toggled(bool)), m_editor, SLOT(enableSnap(bool)));
     actions->addAction(QStringLiteral("enableSnap"), action);
 
     action = new QAction(this);
@@ -1038,11 +2048,162 @@ void MainWindow::setupActions()
     action->setWhatsThis(i18n("Enable the generation of guide intersections."));
     action->setIcon(QIcon::fromTheme(QStringLiteral("snap-intersection")));
     action->setCheckable(true);
-    connect(action, SIGNAL(toggled(bool)), m_editor, SLOT(enableGuides(bool)));
     actions->addAction(QStringLiteral("enableGuides"), action);
 
     // Settings Menu
     KStandardAction::preferences(this, SLOT(preferences()), actions);
+
+    action = new QAction(this);
+    action->setText(i18n("Diagnostics..."));
+    action->setWhatsThis(i18n("Record and show how long operations take on this computer."));
+    action->setIcon(QIcon::fromTheme(QStringLiteral("view-statistics")));
+    connect(action, SIGNAL(triggered()), this, SLOT(diagnostics()));
+    actions->addAction(QStringLiteral("diagnostics"), action);
+
+    action = new QAction(this);
+    action->setText(i18n("Dump Profiling Counters"));
+    action->setWhatsThis(i18n("Write the current values of the profiling counters and timers to the standard error output."));
+#if !defined(WITH_PROFILING)
+    action->setEnabled(false);
+#endif
+    connect(action, SIGNAL(triggered()), this, SLOT(dumpProfiling()));
+    actions->addAction(QStringLiteral("dumpProfiling"), action);
+}
+
+
+/**
+ * Clear the symbols from all the editor panes.
+ */
+void MainWindow::clearEditors()
+{
+    foreach (Editor *editor, m_editors) {
+        editor->clear();
+    }
+}
+
+
+/**
+ * Add an editor pane.
+ * The editor uses the shared cache and the library, its undo stack is added to the undo group and
+ * it is made the active pane.
+ *
+ * @return a pointer to the new Editor
+ */
+Editor *MainWindow::addEditorPane()
+{
+    Editor *editor = new Editor(&m_editorCache);
+    editor->setLibrary(m_symbolLibrary);
+    m_editorSplitter->addWidget(editor);
+    m_editors.append(editor);
+    m_undoGroup.addStack(editor->undoStack());
+
+    connect(editor, SIGNAL(activated()), this, SLOT(editorActivated()));
+    connect(m_symbolLibrary->undoStack(), SIGNAL(indexChanged(int)), editor, SLOT(updateComponents()));
+
+    action(QStringLiteral("closeEditorPane"))->setEnabled(m_editors.count() > 1);
+    setActiveEditor(editor);
+
+    return editor;
+}
+
+
+/**
+ * Make an editor pane the active one.
+ * The actions are moved from the previous pane to the new one and set from its symbol and tool. The
+ * snap and guide settings are shared by the panes and are applied to the new one. When there are
+ * several panes the active one is highlighted.
+ *
+ * @param editor a pointer to the Editor
+ */
+void MainWindow::setActiveEditor(Editor *editor)
+{
+    if (m_editor) {
+        disconnectEditor(m_editor);
+    }
+
+    m_editor = editor;
+    connectEditor(editor);
+
+    foreach (Editor *pane, m_editors) {
+        pane->setActive(pane == editor && m_editors.count() > 1);
+    }
+
+    if (m_tabWidget->currentIndex() == 0) {
+        m_undoGroup.setActiveStack(editor->undoStack());
+        editor->updateStatusMessage();
+    }
+
+    bool clean = editor->undoStack()->isClean();
+    action(QStringLiteral("saveSymbol"))->setDisabled(clean);
+    action(QStringLiteral("saveSymbolAsNew"))->setDisabled(clean);
+    setActionsFromSymbol(editor->symbol().second);
+
+    editor->enableSnap(action(QStringLiteral("enableSnap"))->isChecked());
+    editor->enableGuides(action(QStringLiteral("enableGuides"))->isChecked());
+
+    foreach (QAction *tool, action(QStringLiteral("moveTo"))->actionGroup()->actions()) {
+        if (tool->data().toInt() == editor->toolMode()) {
+            tool->setChecked(true);
+        }
+    }
+
+    if (m_catalogDialog) {
+        m_catalogDialog->setEditor(editor);
+    }
+}
+
+
+/**
+ * Connect the actions to an editor pane and the signals from it to the actions and the status bar.
+ *
+ * @param editor a pointer to the Editor
+ */
+void MainWindow::connectEditor(Editor *editor)
+{
+    connect(action(QStringLiteral("fillPath")), SIGNAL(triggered(bool)), editor, SLOT(selectFilled(bool)));
+    connect(action(QStringLiteral("windingFill"))->actionGroup(), SIGNAL(triggered(QAction*)), editor, SLOT(selectFillRule(QAction*)));
+    connect(action(QStringLiteral("flatCap"))->actionGroup(), SIGNAL(triggered(QAction*)), editor, SLOT(selectCapStyle(QAction*)));
+    connect(action(QStringLiteral("bevelJoin"))->actionGroup(), SIGNAL(triggered(QAction*)), editor, SLOT(selectJoinStyle(QAction*)));
+    connect(action(QStringLiteral("increaseLineWidth")), SIGNAL(triggered()), editor, SLOT(increaseLineWidth()));
+    connect(action(QStringLiteral("decreaseLineWidth")), SIGNAL(triggered()), editor, SLOT(decreaseLineWidth()));
+    connect(action(QStringLiteral("moveTo"))->actionGroup(), SIGNAL(triggered(QAction*)), editor, SLOT(selectTool(QAction*)));
+    connect(action(QStringLiteral("rotateLeft")), SIGNAL(triggered()), editor, SLOT(rotateLeft()));
+    connect(action(QStringLiteral("rotateRight")), SIGNAL(triggered()), editor, SLOT(rotateRight()));
+    connect(action(QStringLiteral("flipHorizontal")), SIGNAL(triggered()), editor, SLOT(flipHorizontal()));
+    connect(action(QStringLiteral("flipVertical")), SIGNAL(triggered()), editor, SLOT(flipVertical()));
+    connect(action(QStringLiteral("scalePreferred")), SIGNAL(triggered()), editor, SLOT(scalePreferred()));
+    connect(action(QStringLiteral("removeComponents")), SIGNAL(triggered()), editor, SLOT(removeComponents()));
+    connect(action(QStringLiteral("enableSnap")), SIGNAL(toggled(bool)), editor, SLOT(enableSnap(bool)));
+    connect(action(QStringLiteral("enableGuides")), SIGNAL(toggled(bool)), editor, SLOT(enableGuides(bool)));
+
+    connect(editor, SIGNAL(message(QString)), statusBar(), SLOT(showMessage(QString)));
+    connect(editor, SIGNAL(minLineWidth(bool)), action(QStringLiteral("decreaseLineWidth")), SLOT(setDisabled(bool)));
+    connect(editor, SIGNAL(maxLineWidth(bool)), action(QStringLiteral("increaseLineWidth")), SLOT(setDisabled(bool)));
+    connect(editor->undoStack(), SIGNAL(cleanChanged(bool)), action(QStringLiteral("saveSymbol")), SLOT(setDisabled(bool)));
+    connect(editor->undoStack(), SIGNAL(cleanChanged(bool)), action(QStringLiteral("saveSymbolAsNew")), SLOT(setDisabled(bool)));
+}
+
+
+/**
+ * Disconnect the actions from an editor pane that is no longer the active one.
+ * The connections made by connectEditor() are removed, leaving those between the pane, the library
+ * and the main window.
+ *
+ * @param editor a pointer to the Editor
+ */
+void MainWindow::disconnectEditor(Editor *editor)
+{
+    foreach (QAction *action, actionCollection()->actions()) {
+        action->disconnect(editor);
+        editor->disconnect(action);
+        editor->undoStack()->disconnect(action);
+
+        if (action->actionGroup()) {
+            action->actionGroup()->disconnect(editor);
+        }
+    }
+
+    editor->disconnect(statusBar());
 }
 
 
@@ -19,16 +19,29 @@
 #define MainWindow_H
 
 
+#include <QDateTime>
+#include <QList>
 #include <QUndoGroup>
 #include <QUrl>
 
 #include <KXmlGuiWindow>
 
+#include "EditorCache.h"
+
+class QAction;
+class QLineEdit;
 class QListWidgetItem;
+class QProgressBar;
 
+class QSplitter;
 class QTabWidget;
+class QToolButton;
 
+class CatalogDialog;
+class DiagnosticsDialog;
 class Editor;
+class LibraryCatalog;
+class LibraryJob;
 class Symbol;
 class SymbolLibrary;
 class SymbolListWidget;
@@ -39,7 +52,8 @@ class SymbolListWidget;
  *
  * The MainWindow class is based on the KXmlGuiWindow class which provides the basis for KDE applications.
  * It creates instances of the Editor class and the QListWidget class that is used to show the existing
- * symbols in the library.
+ * symbols in the library. Several editors can be shown side by side in panes, the actions applying to
+ * the active pane which is the one that last had the focus.
  *
  * It creates all the actions that are associated with the application connecting various signals to the
  * relevant slots to allow the interaction between the gui elements.
@@ -62,9 +76,16 @@ protected slots:
     void save();
     void saveAs();
     void newSymbol();
+    void newFromDefaultLibrary();
     void saveSymbol();
     void saveSymbolAsNew();
+    void newEditorPane();
+    void closeEditorPane();
     void importLibrary();
+    void libraryCatalog();
+    void exportDistanceFields();
+    void exportHeader();
+    void openLibrarySymbol(const QString &path, qint16 index);
     void close();
     void quit();
 
@@ -76,31 +97,77 @@ protected slots:
     void cleanChanged(bool clean);
 
     void currentChanged(int index);
+    void editorActivated();
     void itemSelected(QListWidgetItem *item);
     void listWidgetContextMenuRequested(const QPoint &pos);
     void deleteSymbol();
+    void useAsComponent();
+    void openInNewPane();
+    void openRevision(QAction *action);
+    void applyQuery();
+
+    // Tools menu
+    void simplifySymbols();
+    void jobProgress(int processed, int count);
+    void jobFinished(int changed);
+    void jobCancelled();
+    void atlasExported();
+    void atlasFailed(const QString &fileName, const QString &error);
+    void atlasCancelled();
 
     // Settings menu
     void preferences();
+    void settingsChanged();
+    void diagnostics();
+    void dumpProfiling();
 
 private:
-    bool editorClean();
+    bool editorClean(Editor *editor);
+    bool editorsClean();
     bool libraryClean();
+    void clearEditors();
+    Editor *addEditorPane();
+    void setActiveEditor(Editor *editor);
+    void connectEditor(Editor *editor);
+    void disconnectEditor(Editor *editor);
+    void openCollection(const QUrl &url);
+    bool mergeFile(const QString &fileName);
+    void reportShardErrors();
     void setupActions();
+    void startJob(LibraryJob *job);
+    void showJob(QObject *job, const QString &text);
+    void endJob();
     void setActionsFromSymbol(const Symbol &symbol);
 
+    static const int lockTimeout = 5000;    /**< milliseconds to wait for another application saving the library file */
+
     QUrl                m_url;          /**< url of the loaded library */
+    QDateTime           m_fileModified; /**< modification time of the library file when it was last read or written */
 
     QTabWidget          *m_tabWidget;   /**< pointer to the QTabWidget containing the editor and library tabs */
-    Editor              *m_editor;      /**< pointer to the Editor */
+    QSplitter           *m_editorSplitter;  /**< pointer to the QSplitter containing the editor panes */
+    Editor              *m_editor;      /**< pointer to the active Editor, the actions apply to this one */
+    QList<Editor *>     m_editors;      /**< the Editor panes in the order they were created */
     SymbolListWidget    *m_listWidget;  /**< pointer to the SymbolListWidget containing icons for the library symbols */
+    QLineEdit           *m_queryEdit;   /**< pointer to the QLineEdit holding the query filtering the library symbols */
 
     SymbolLibrary   *m_symbolLibrary;   /**< pointer to a SymbolLibrary */
 
+    LibraryCatalog  *m_catalog;         /**< pointer to the LibraryCatalog of symbols in the library directories */
+    CatalogDialog   *m_catalogDialog;   /**< pointer to the CatalogDialog, created when first required */
+    DiagnosticsDialog   *m_diagnosticsDialog;   /**< pointer to the DiagnosticsDialog, created when first required */
+
+    QObject         *m_job;             /**< pointer to the LibraryJob or DistanceFieldAtlas running, null if there is none */
+    QString         m_jobText;          /**< description of the job running */
+    QProgressBar    *m_jobProgress;     /**< pointer to the QProgressBar in the status bar showing the progress of the job */
+    QToolButton     *m_jobCancel;       /**< pointer to the QToolButton in the status bar cancelling the job */
+
     QListWidgetItem *m_item;            /**< pointer to a QListWidgetItem in m_listWidget found for the context menu */
     QMenu           *m_menu;            /**< pointer to a popup context menu */
+    QMenu           *m_revisionsMenu;   /**< pointer to the submenu of the context menu listing the revisions of the symbol */
 
-    QUndoGroup  m_undoGroup;            /**< the QUndoGroup has the QUndoStacks for the Editor and the SymbolLibrary added to it */
+    QUndoGroup  m_undoGroup;            /**< the QUndoGroup has the QUndoStacks for each Editor and the SymbolLibrary added to it */
+    EditorCache m_editorCache;          /**< the grid and guide directions shared by the Editor panes */
 };
 
 
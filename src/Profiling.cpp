@@ -0,0 +1,173 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Implement the Profiling counter and timer registry.
+ */
+
+
+/**
+ * @page profiling Profiling
+ * Building with build.sh -p configures the application with WITH_PROFILING enabled. This keeps the frame
+ * pointers and adds debug information to an otherwise optimized build so that tools such as perf and
+ * heaptrack can produce useful call graphs, and compiles in a set of counters and timers on the hot paths
+ * of the application.
+ *
+ * The counters cover the symbols decoded from files, the icons rasterized for the library view, the guide
+ * lines generated and intersections tested by the editor, the rebuilds of the editor path and the commands
+ * undone or redone. Where a timer is attached the total and maximum times are also recorded.
+ *
+ * The editor constructs its guides into buffers that keep their capacity, so moving the mouse does not
+ * allocate once they are large enough. The guide buffer growths counter records the moves that did have to
+ * grow them, it should stop increasing while the mouse is moved over a symbol whose points are unchanged.
+ *
+ * The counters are written to the standard error output when the application exits and can be written at
+ * any time using Settings->Dump Profiling Counters, which is disabled in builds without profiling.
+ */
+
+
+#include "Profiling.h"
+
+#include <atomic>
+#include <cstdio>
+
+#include <QStringList>
+
+
+namespace
+{
+const char *counterNames[Profiling::CounterCount] = {
+    "Symbols decoded",
+    "Icons rasterized",
+    "Guide lines generated",
+    "Intersections tested",
+    "Path rebuilds",
+    "Undo commands replayed",
+    "Library loads",
+    "Tasks scheduled",
+    "Tasks coalesced",
+    "Path layers rendered",
+    "Queries evaluated",
+    "Library merges",
+    "Guide buffer growths"
+};
+
+std::atomic<quint64> eventCounts[Profiling::CounterCount];  /**< number of events for each counter */
+std::atomic<qint64> totalTime[Profiling::CounterCount];     /**< accumulated nanoseconds for each counter */
+std::atomic<qint64> maximumTime[Profiling::CounterCount];   /**< longest single timing for each counter */
+}
+
+
+/**
+ * Add a number of events to a counter.
+ *
+ * @param counter the Profiling::Counter to update
+ * @param events the number of events to add
+ */
+void Profiling::count(Counter counter, quint64 events)
+{
+    eventCounts[counter].fetch_add(events, std::memory_order_relaxed);
+}
+
+
+/**
+ * Add a timing to a counter.
+ * The total time is accumulated and the maximum time updated if this timing is longer.
+ *
+ * @param counter the Profiling::Counter to update
+ * @param nsecs the time in nanoseconds
+ */
+void Profiling::addTime(Counter counter, qint64 nsecs)
+{
+    totalTime[counter].fetch_add(nsecs, std::memory_order_relaxed);
+
+    qint64 maximum = maximumTime[counter].load(std::memory_order_relaxed);
+
+    while (nsecs > maximum && !maximumTime[counter].compare_exchange_weak(maximum, nsecs, std::memory_order_relaxed)) {
+    }
+}
+
+
+/**
+ * Reset all the counters and timers to zero.
+ */
+void Profiling::reset()
+{
+    for (int i = 0 ; i < CounterCount ; ++i) {
+        eventCounts[i] = 0;
+        totalTime[i] = 0;
+        maximumTime[i] = 0;
+    }
+}
+
+
+/**
+ * Create a report of the current values of the counters.
+ * Counters that have timings also show the total, mean and maximum times in milliseconds.
+ *
+ * @return a QString containing one line per counter
+ */
+QString Profiling::report()
+{
+    QStringList lines;
+
+    for (int i = 0 ; i < CounterCount ; ++i) {
+        quint64 count = eventCounts[i].load(std::memory_order_relaxed);
+        qint64 total = totalTime[i].load(std::memory_order_relaxed);
+        QString line = QStringLiteral("%1: %2").arg(QLatin1String(counterNames[i]), -24).arg(count, 10);
+
+        if (total) {
+            double mean = count ? double(total) / count : 0.0;
+            line += QStringLiteral("  total %1 ms  mean %2 ms  max %3 ms")
+                    .arg(total / 1.0e6, 0, 'f', 3)
+                    .arg(mean / 1.0e6, 0, 'f', 4)
+                    .arg(maximumTime[i].load(std::memory_order_relaxed) / 1.0e6, 0, 'f', 3);
+        }
+
+        lines.append(line);
+    }
+
+    return lines.join(QLatin1Char('\n'));
+}
+
+
+/**
+ * Write the report to the standard error output.
+ */
+void Profiling::dump()
+{
+    fprintf(stderr, "SymbolEditor profiling counters\n%s\n", qPrintable(report()));
+    fflush(stderr);
+}
+
+
+/**
+ * Constructor
+ * Start the timer.
+ *
+ * @param counter the Profiling::Counter the elapsed time will be added to
+ */
+ProfilingTimer::ProfilingTimer(Profiling::Counter counter)
+    :   m_counter(counter)
+{
+    m_timer.start();
+}
+
+
+/**
+ * Destructor
+ * Add the elapsed time to the counter.
+ */
+ProfilingTimer::~ProfilingTimer()
+{
+    Profiling::addTime(m_counter, m_timer.nsecsElapsed());
+}
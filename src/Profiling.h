@@ -0,0 +1,92 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Header file for the Profiling counter and timer registry.
+ */
+
+
+#ifndef Profiling_H
+#define Profiling_H
+
+
+#include <QElapsedTimer>
+#include <QString>
+
+
+/**
+ * @brief Registry of hot path counters and timers for profiling builds.
+ *
+ * The registry is only compiled in when the application is configured with WITH_PROFILING,
+ * otherwise the PROFILE_COUNT, PROFILE_COUNT_N and PROFILE_TIMER macros expand to nothing and
+ * no code is generated for them.
+ *
+ * Each counter records the number of events and, when it is used with a PROFILE_TIMER, the
+ * accumulated and maximum time spent. The counters are updated atomically so they can be used
+ * from worker threads.
+ */
+class Profiling
+{
+public:
+    enum Counter {
+        SymbolsDecoded,             /**< Symbol objects read from a QDataStream */
+        IconsRasterized,            /**< icons created by SymbolListWidget::createIcon */
+        GuideLinesGenerated,        /**< projected guide lines constructed by the Editor */
+        IntersectionsTested,        /**< guide line and guide circle intersections tested */
+        PathRebuilds,               /**< Editor paths constructed from the commands and points */
+        UndoCommandsReplayed,       /**< commands undone or redone through the undo group */
+        LibraryLoads,               /**< SymbolLibrary objects read from a QDataStream */
+        TasksScheduled,             /**< tasks queued by the TaskScheduler */
+        TasksCoalesced,             /**< tasks combined with a waiting or running task by the TaskScheduler */
+        PathLayersRendered,         /**< Editor path layers rendered on a worker thread */
+        QueriesEvaluated,           /**< symbol queries evaluated against the attribute table */
+        LibraryMerges,              /**< libraries merged with their changed file by LibraryMerge */
+        GuideBufferGrowths,         /**< Editor guide constructions that had to grow a guide buffer */
+        CounterCount                /**< number of counters, must be last */
+    };
+
+    static void count(Counter counter, quint64 events = 1);
+    static void addTime(Counter counter, qint64 nsecs);
+    static void reset();
+
+    static QString report();
+    static void dump();
+};
+
+
+/**
+ * @brief Scoped timer adding its lifetime to a Profiling counter.
+ */
+class ProfilingTimer
+{
+public:
+    explicit ProfilingTimer(Profiling::Counter counter);
+    ~ProfilingTimer();
+
+private:
+    Profiling::Counter  m_counter;      /**< the counter the elapsed time is added to */
+    QElapsedTimer       m_timer;        /**< timer started on construction */
+};
+
+
+#if defined(WITH_PROFILING)
+#define PROFILE_COUNT(counter) Profiling::count(Profiling::counter)
+#define PROFILE_COUNT_N(counter, events) Profiling::count(Profiling::counter, (events))
+#define PROFILE_TIMER(counter) ProfilingTimer profilingTimer##counter(Profiling::counter)
+#else
+#define PROFILE_COUNT(counter)
+#define PROFILE_COUNT_N(counter, events)
+#define PROFILE_TIMER(counter)
+#endif
+
+
+#endif
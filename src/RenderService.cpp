@@ -0,0 +1,370 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Implement the RenderService class.
+ */
+
+
+/**
+ * @page render_service Render Service
+ * Running SymbolEditor with the --render-service option starts a service that renders the symbols of library files
+ * for other applications on the same machine, instead of showing the main window. The option takes the name of a
+ * QLocalServer that clients connect to with a QLocalSocket. As no window is shown, the service can be run with the
+ * offscreen platform plugin, for example with -platform offscreen.
+ *
+ * The clients send batches of requests and receive a reply for each batch. All values are written with a
+ * QDataStream with its version set to QDataStream::Qt_4_0. A batch is written as
+ * - quint32 an identifier chosen by the client, returned in the reply
+ * - qint32 the number of requests, up to 4096
+ * - for each request
+ *  - QString the absolute path of the library file or collection manifest
+ *  - qint16 the index of the symbol
+ *  - qint32 the width and height of the image, up to 1024
+ *  - quint32 the QRgb color, or 0 for a coverage mask
+ *
+ * The reply is written as
+ * - quint32 the identifier of the batch
+ * - qint32 the number of images
+ * - for each image, in the order of the requests
+ *  - qint32 the width of the image, 0 if the symbol could not be rendered
+ *  - qint32 the height of the image
+ *  - qint32 the number of bytes for each pixel
+ *  - QByteArray the pixels without any padding between the rows
+ *
+ * Coverage masks have one byte for each pixel, colored images have four bytes for each pixel holding the
+ * premultiplied QRgb value in the byte order of the machine. A client may send further batches before the
+ * replies to earlier ones are received. The replies are sent as each batch is completed and so may arrive in
+ * a different order to the batches.
+ *
+ * The requests in each batch are rendered in parallel. The symbols of the libraries read and the images rendered
+ * are cached by the service, the cache being shared by all the clients. A library is read again if its file is
+ * changed.
+ */
+
+
+#include "RenderService.h"
+
+#include <QColor>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMutexLocker>
+#include <QtConcurrent>
+
+#include <cstring>
+
+#include "CoverageRasterizer.h"
+#include "Exceptions.h"
+#include "SymbolLibrary.h"
+
+
+/**
+ * Constructor.
+ *
+ * @param parent a pointer to the parent QObject
+ */
+RenderService::RenderService(QObject *parent)
+    :   QObject(parent),
+        m_server(new QLocalServer(this)),
+        m_libraries(cachedLibraries),
+        m_images(cachedImageBytes)
+{
+    connect(m_server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+
+/**
+ * Destructor.
+ * Wait for any batches still being rendered as they use the caches.
+ */
+RenderService::~RenderService()
+{
+    QThreadPool::globalInstance()->waitForDone();
+}
+
+
+/**
+ * Start listening for clients.
+ * Any stale socket left by a service that was not shut down cleanly is removed first.
+ *
+ * @param name the name of the local server
+ *
+ * @return true if the server is listening, false otherwise
+ */
+bool RenderService::listen(const QString &name)
+{
+    QLocalServer::removeServer(name);
+
+    return m_server->listen(name);
+}
+
+
+/**
+ * Get the reason the server failed to listen.
+ *
+ * @return a QString containing the error
+ */
+QString RenderService::errorString() const
+{
+    return m_server->errorString();
+}
+
+
+/**
+ * Accept the pending connections from clients.
+ */
+void RenderService::newConnection()
+{
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readRequests()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+
+/**
+ * Read the complete batches of requests received from a client.
+ * Each batch is read in a transaction so that a partly received batch is left until the rest
+ * arrives. The requests of the batch are rendered in parallel, the reply being sent when they
+ * have all completed. A client sending a batch that is too large is disconnected.
+ */
+void RenderService::readRequests()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+
+    if (socket == nullptr) {
+        return;
+    }
+
+    QDataStream stream(socket);
+    stream.setVersion(QDataStream::Qt_4_0);
+
+    forever {
+        stream.startTransaction();
+
+        quint32 id;
+        qint32 count;
+        stream >> id >> count;
+
+        if (stream.status() == QDataStream::Ok && (count < 0 || count > maximumBatch)) {
+            socket->abort();
+            return;
+        }
+
+        QList<RenderRequest> requests;
+
+        for (int i = 0 ; i < count && stream.status() == QDataStream::Ok ; ++i) {
+            RenderRequest request;
+            quint32 color;
+            stream >> request.path >> request.index >> request.size >> color;
+            request.color = color;
+            requests.append(request);
+        }
+
+        if (!stream.commitTransaction()) {
+            return;
+        }
+
+        QFutureWatcher<QImage> *watcher = new QFutureWatcher<QImage>(socket);
+        watcher->setProperty("id", id);
+        connect(watcher, SIGNAL(finished()), this, SLOT(batchFinished()));
+        watcher->setFuture(QtConcurrent::mapped(requests, [this](const RenderRequest &request) {
+            return render(request);
+        }));
+    }
+}
+
+
+/**
+ * Send the reply for a batch that has been rendered.
+ * The reply is written to a buffer first so that it is sent to the client in one write.
+ */
+void RenderService::batchFinished()
+{
+    QFutureWatcher<QImage> *watcher = static_cast<QFutureWatcher<QImage> *>(sender());
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(watcher->parent());
+    const QList<QImage> images = watcher->future().results();
+
+    QByteArray reply;
+    QDataStream stream(&reply, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_0);
+    stream << watcher->property("id").toUInt() << static_cast<qint32>(images.count());
+
+    for (const QImage &image : images) {
+        writeImage(stream, image);
+    }
+
+    if (socket->state() == QLocalSocket::ConnectedState) {
+        socket->write(reply);
+    }
+
+    watcher->deleteLater();
+}
+
+
+/**
+ * Render a request.
+ * This is called on the worker threads. Images are taken from the cache where possible, otherwise
+ * the symbol is taken from the cached library, rendered and added to the cache.
+ *
+ * @param request a const reference to the RenderRequest
+ *
+ * @return a QImage containing the symbol, a null QImage if the request could not be rendered
+ */
+QImage RenderService::render(const RenderRequest &request)
+{
+    if (request.size < 1 || request.size > maximumSize) {
+        return QImage();
+    }
+
+    qint64 modified = QFileInfo(request.path).lastModified().toMSecsSinceEpoch();
+    QString key = QStringLiteral("%1\n%2\n%3\n%4\n%5").arg(request.path).arg(request.index).arg(request.size).arg(request.color).arg(modified);
+
+    {
+        QMutexLocker locker(&m_mutex);
+
+        if (QImage *image = m_images.object(key)) {
+            return *image;
+        }
+    }
+
+    QHash<qint16, Symbol> symbols = librarySymbols(request.path, modified);
+
+    if (!symbols.contains(request.index)) {
+        return QImage();
+    }
+
+    QImage image = CoverageRasterizer::coverage(symbols.value(request.index), request.size);
+
+    if (request.color != 0) {
+        image = CoverageRasterizer::colorized(image, QColor::fromRgba(request.color));
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_images.insert(key, new QImage(image), static_cast<int>(image.sizeInBytes()));
+
+    return image;
+}
+
+
+/**
+ * Get the flattened symbols of a library.
+ * The library is taken from the cache if it is there and has not changed, otherwise it is read
+ * and added to the cache. The library is read without holding the lock so that other requests
+ * can be rendered at the same time.
+ *
+ * @param path the absolute path of the library file
+ * @param modified the modification time of the file in milliseconds since the epoch
+ *
+ * @return a QHash of the indexes to the flattened symbols, empty if the library could not be read
+ */
+QHash<qint16, Symbol> RenderService::librarySymbols(const QString &path, qint64 modified)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        CachedLibrary *library = m_libraries.object(path);
+
+        if (library && library->modified == modified) {
+            return library->symbols;
+        }
+    }
+
+    CachedLibrary *library = new CachedLibrary;
+    library->modified = modified;
+    library->symbols = readLibrary(path);
+    QHash<qint16, Symbol> symbols = library->symbols;
+
+    QMutexLocker locker(&m_mutex);
+    m_libraries.insert(path, library);
+
+    return symbols;
+}
+
+
+/**
+ * Read the flattened symbols of a library file or collection.
+ * Errors reading the library are reported and an empty set of symbols returned.
+ *
+ * @param path the absolute path of the library file or collection manifest
+ *
+ * @return a QHash of the indexes to the flattened symbols
+ */
+QHash<qint16, Symbol> RenderService::readLibrary(const QString &path)
+{
+    QHash<qint16, Symbol> symbols;
+    SymbolLibrary library;
+
+    try {
+        if (SymbolLibrary::isCollectionFile(path)) {
+            library.openCollection(path);
+            library.loadAllShards();
+        } else {
+            QFile file(path);
+
+            if (!file.open(QIODevice::ReadOnly)) {
+                throw FailedFileAccess(path, file.errorString());
+            }
+
+            QDataStream stream(&file);
+            stream >> library;
+        }
+
+        foreach (qint16 index, library.indexes()) {
+            symbols.insert(index, library.flattenedSymbol(index));
+        }
+    } catch (const InvalidFile &e) {
+        qWarning("The file %s is not a valid symbol file", qPrintable(path));
+    } catch (const InvalidFileVersion &e) {
+        qWarning("Version %d of the file %s is not supported", e.version, qPrintable(path));
+    } catch (const InvalidSymbolVersion &e) {
+        qWarning("Version %d of a symbol in the file %s is not supported", e.version, qPrintable(path));
+    } catch (const FailedReadLibrary &e) {
+        qWarning("Failed to read the file %s: %s", qPrintable(path), qPrintable(e.statusMessage()));
+    } catch (const FailedFileAccess &e) {
+        qWarning("Failed to open the file %s: %s", qPrintable(e.fileName), qPrintable(e.errorString));
+    }
+
+    return symbols;
+}
+
+
+/**
+ * Write an image to a reply.
+ * The rows of the image are written without the padding QImage may have at the end of each row.
+ *
+ * @param stream a reference to the QDataStream of the reply
+ * @param image a const reference to the QImage, a null image is written with a width of 0
+ */
+void RenderService::writeImage(QDataStream &stream, const QImage &image)
+{
+    if (image.isNull()) {
+        stream << qint32(0) << qint32(0) << qint32(0) << QByteArray();
+        return;
+    }
+
+    qint32 depth = image.depth() / 8;
+    qint32 rowBytes = image.width() * depth;
+    QByteArray pixels(rowBytes * image.height(), Qt::Uninitialized);
+
+    for (int y = 0 ; y < image.height() ; ++y) {
+        memcpy(pixels.data() + y * rowBytes, image.constScanLine(y), rowBytes);
+    }
+
+    stream << qint32(image.width()) << qint32(image.height()) << depth << pixels;
+}
+
+#include "moc_RenderService.cpp"
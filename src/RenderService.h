@@ -0,0 +1,104 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Header file for the RenderService class.
+ */
+
+
+#ifndef RenderService_H
+#define RenderService_H
+
+
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QRgb>
+#include <QString>
+
+#include "Symbol.h"
+
+
+class QLocalServer;
+class QLocalSocket;
+
+
+/**
+ * @brief A request for the rendering of one symbol.
+ */
+class RenderRequest
+{
+public:
+    QString path;           /**< absolute path of the library file or collection manifest */
+    qint16  index;          /**< index of the symbol in the library */
+    qint32  size;           /**< width and height of the image in pixels */
+    QRgb    color;          /**< color to render the symbol in, fully transparent for a coverage mask */
+};
+
+
+/**
+ * @brief Renders library symbols for other applications over a local socket.
+ *
+ * The service listens on a QLocalServer and accepts batches of RenderRequest from its clients.
+ * The requests of each batch are rendered in parallel on worker threads with the CoverageRasterizer
+ * and the images returned together in a single reply. The libraries read and the images rendered
+ * are cached and shared by all the clients, a library being read again when its file changes.
+ */
+class RenderService : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RenderService(QObject *parent = nullptr);
+    ~RenderService();
+
+    bool listen(const QString &name);
+    QString errorString() const;
+
+private slots:
+    void newConnection();
+    void readRequests();
+    void batchFinished();
+
+private:
+    /**
+     * @brief The flattened symbols of a library file.
+     */
+    class CachedLibrary
+    {
+    public:
+        qint64                  modified;   /**< modification time of the file when it was read */
+        QHash<qint16, Symbol>   symbols;    /**< map of the indexes to the flattened symbols */
+    };
+
+    QImage render(const RenderRequest &request);
+    QHash<qint16, Symbol> librarySymbols(const QString &path, qint64 modified);
+
+    static QHash<qint16, Symbol> readLibrary(const QString &path);
+    static void writeImage(QDataStream &stream, const QImage &image);
+
+    static const qint32 maximumBatch = 4096;        /**< the largest number of requests accepted in a batch */
+    static const qint32 maximumSize = 1024;         /**< the largest image size accepted in a request */
+    static const int cachedLibraries = 32;          /**< the number of libraries kept in the cache */
+    static const int cachedImageBytes = 64 << 20;   /**< the total size of the images kept in the cache */
+
+    QLocalServer    *m_server;                      /**< pointer to the server accepting the client connections */
+
+    QMutex                          m_mutex;        /**< protects the caches which are used from the worker threads */
+    QCache<QString, CachedLibrary>  m_libraries;    /**< cache of the libraries keyed by their path */
+    QCache<QString, QImage>         m_images;       /**< cache of the rendered images keyed by the request */
+};
+
+
+#endif
@@ -20,14 +20,49 @@
  * The Symbol encapsulates the QPainterPath with an attribute @ref Symbol::filled() defining if the path is drawn filled
  * or not. If the path is drawn as an outline, the @ref Symbol::lineWidth() attribute is used to initialize the pen for
  * drawing the path. The end cap style and join style can be set which are added to the pen when drawing the path.
+ *
+ * A symbol can include other symbols from the same library as components, each drawn with its own transform. The
+ * components are drawn with the rendering attributes of the symbol using them. This allows parts that are common
+ * to many symbols, such as a frame with different inner marks, to be defined once. Changing the component symbol
+ * changes every symbol that uses it. The components are stored from version 101 of the symbol stream, symbols
+ * without components are still written as version 100 so that they can be read by applications that do not
+ * support components, such as KXStitch and earlier versions of SymbolEditor.
  */
 
 
 #include "Symbol.h"
 
+#include <QCryptographicHash>
 #include <QDataStream>
+#include <QIODevice>
+#include <QLineF>
+#include <QPair>
 
 #include "Exceptions.h"
+#include "Profiling.h"
+
+
+/**
+ * Constructor
+ * The component is initialized with no index and an identity transform.
+ */
+SymbolComponent::SymbolComponent()
+    :   index(0)
+{
+}
+
+
+/**
+ * Constructor
+ *
+ * @param i the index of the component symbol in the library
+ * @param t a const reference to the QTransform applied to the component
+ */
+SymbolComponent::SymbolComponent(qint16 i, const QTransform &t)
+    :   index(i),
+        transform(t)
+{
+}
 
 
 /**
@@ -100,6 +135,17 @@ Qt::PenJoinStyle Symbol::joinStyle() const
 }
 
 
+/**
+ * Get the components of the symbol.
+ *
+ * @return a QList of the SymbolComponent drawn as part of the symbol
+ */
+QList<SymbolComponent> Symbol::components() const
+{
+    return m_components;
+}
+
+
 /**
  * Set the QPainterPath for the symbol.
  *
@@ -155,6 +201,17 @@ void Symbol::setJoinStyle(Qt::PenJoinStyle joinStyle)
 }
 
 
+/**
+ * Set the components of the symbol.
+ *
+ * @param components a const reference to a QList of the SymbolComponent to be drawn as part of the symbol
+ */
+void Symbol::setComponents(const QList<SymbolComponent> &components)
+{
+    m_components = components;
+}
+
+
 /**
  * Get a pen based on the parameters of the symbol.
  *
@@ -187,8 +244,173 @@ QBrush Symbol::brush() const
 }
 
 
+/**
+ * Get a copy of the symbol with its path simplified.
+ * This is used by the simplify symbols library job, which calls it on worker threads. Each run of
+ * consecutive straight lines is simplified with the Douglas-Peucker algorithm. The point of the run
+ * furthest from the line joining its ends is kept if it is further than the tolerance, and the two
+ * parts either side of it are simplified in the same way, so every point removed lies within the
+ * tolerance of the line that replaces it. Curves and the points the runs start and end at, which
+ * include the end points of the sub paths, are kept.
+ *
+ * @param tolerance the distance from the line within which points are removed, in symbol coordinates
+ *
+ * @return the simplified Symbol, a copy of the symbol itself if no points were removed
+ */
+Symbol Symbol::simplified(qreal tolerance) const
+{
+    QPainterPath simplified;
+    simplified.setFillRule(m_path.fillRule());
+    QVector<QPointF> run;
+    bool removed = false;
+
+    for (int i = 0 ; i < m_path.elementCount() ; ++i) {
+        QPainterPath::Element element = m_path.elementAt(i);
+
+        if (element.isLineTo()) {
+            run.append(element);
+            continue;
+        }
+
+        removed = addSimplifiedLines(simplified, run, tolerance) || removed;
+
+        switch (element.type) {
+        case QPainterPath::MoveToElement:
+            simplified.moveTo(element);
+            run = QVector<QPointF>() << element;
+            break;
+
+        case QPainterPath::CurveToElement:
+            simplified.cubicTo(element, m_path.elementAt(i + 1), m_path.elementAt(i + 2));
+            run = QVector<QPointF>() << m_path.elementAt(i + 2);
+            i += 2;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    removed = addSimplifiedLines(simplified, run, tolerance) || removed;
+
+    if (!removed) {
+        return *this;
+    }
+
+    Symbol result = *this;
+    result.setPath(simplified);
+
+    return result;
+}
+
+
+/**
+ * Add a simplified run of straight lines to a path.
+ * The spans of the run are taken from a stack rather than by recursion, each span keeping the point
+ * furthest from the line joining its ends when it is outside the tolerance and being split there.
+ *
+ * @param path a reference to the QPainterPath to add the lines to, the first point of the run being its current position
+ * @param run a const reference to a QVector of the point the run starts from followed by the end points of its lines
+ * @param tolerance the distance from the line within which points are removed
+ *
+ * @return true if any points were removed, false otherwise
+ */
+bool Symbol::addSimplifiedLines(QPainterPath &path, const QVector<QPointF> &run, qreal tolerance)
+{
+    if (run.count() < 2) {
+        return false;
+    }
+
+    QVector<bool> keep(run.count(), false);
+    keep.first() = true;
+    keep.last() = true;
+
+    QVector<QPair<int, int> > spans;
+    spans.append(qMakePair(0, static_cast<int>(run.count()) - 1));
+
+    while (!spans.isEmpty()) {
+        QPair<int, int> span = spans.takeLast();
+        int furthest = -1;
+        qreal furthestDistance = tolerance;
+
+        for (int i = span.first + 1 ; i < span.second ; ++i) {
+            qreal distance = lineDistance(run.at(i), run.at(span.first), run.at(span.second));
+
+            if (distance > furthestDistance) {
+                furthest = i;
+                furthestDistance = distance;
+            }
+        }
+
+        if (furthest != -1) {
+            keep[furthest] = true;
+            spans.append(qMakePair(span.first, furthest));
+            spans.append(qMakePair(furthest, span.second));
+        }
+    }
+
+    bool removed = false;
+
+    for (int i = 1 ; i < run.count() ; ++i) {
+        if (keep.at(i)) {
+            path.lineTo(run.at(i));
+        } else {
+            removed = true;
+        }
+    }
+
+    return removed;
+}
+
+
+/**
+ * Get the distance of a point from a straight line.
+ * A point beyond either end of the line is measured to that end.
+ *
+ * @param point a const reference to the QPointF to measure
+ * @param start a const reference to the QPointF at the start of the line
+ * @param end a const reference to the QPointF at the end of the line
+ *
+ * @return the distance
+ */
+qreal Symbol::lineDistance(const QPointF &point, const QPointF &start, const QPointF &end)
+{
+    QPointF direction = end - start;
+    qreal lengthSquared = QPointF::dotProduct(direction, direction);
+    QPointF closest = start;
+
+    if (lengthSquared > 0) {
+        qreal along = qBound(qreal(0), QPointF::dotProduct(point - start, direction) / lengthSquared, qreal(1));
+        closest = start + along * direction;
+    }
+
+    return QLineF(point, closest).length();
+}
+
+
+/**
+ * Get a hash of the symbol content.
+ * The hash is calculated from the streamed form of the symbol so it covers the path, the fill rule,
+ * the rendering attributes and the components. Two symbols with the same hash can be considered
+ * identical.
+ *
+ * @return a QByteArray containing the SHA-1 hash
+ */
+QByteArray Symbol::hash() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_0);
+    stream << *this;
+
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
+
 /**
  * Stream out a Symbol.
+ * A symbol without components is written as version 100, which has no components, so that it
+ * can be read by applications that do not support them.
  *
  * @param stream a reference to the QDataStream to write to
  * @param symbol a const reference to the Symbol to stream
@@ -197,7 +419,17 @@ QBrush Symbol::brush() const
  */
 QDataStream &operator<<(QDataStream &stream, const Symbol &symbol)
 {
-    stream << symbol.version << symbol.m_path << symbol.m_filled << symbol.m_lineWidth << static_cast<qint32>(symbol.m_capStyle) << static_cast<qint32>(symbol.m_joinStyle);
+    qint32 version = symbol.m_components.isEmpty() ? 100 : symbol.version;
+
+    stream << version << symbol.m_path << symbol.m_filled << symbol.m_lineWidth << static_cast<qint32>(symbol.m_capStyle) << static_cast<qint32>(symbol.m_joinStyle);
+
+    if (version >= 101) {
+        stream << static_cast<qint32>(symbol.m_components.count());
+
+        foreach (const SymbolComponent &component, symbol.m_components) {
+            stream << component.index << component.transform;
+        }
+    }
 
     if (stream.status() != QDataStream::Ok) {
         throw FailedWriteLibrary(stream.status());
@@ -220,9 +452,27 @@ QDataStream &operator>>(QDataStream &stream, Symbol &symbol)
     qint32 version;
     qint32 capStyle;
     qint32 joinStyle;
+    qint32 components;
     stream >> version;
 
+    PROFILE_COUNT(SymbolsDecoded);
+
+    symbol.m_components.clear();
+
     switch (version) {
+    case 101:
+        stream >> symbol.m_path >> symbol.m_filled >> symbol.m_lineWidth >> capStyle >> joinStyle >> components;
+        symbol.m_capStyle = static_cast<Qt::PenCapStyle>(capStyle);
+        symbol.m_joinStyle = static_cast<Qt::PenJoinStyle>(joinStyle);
+
+        for (int i = 0 ; i < components && stream.status() == QDataStream::Ok ; ++i) {
+            SymbolComponent component;
+            stream >> component.index >> component.transform;
+            symbol.m_components.append(component);
+        }
+
+        break;
+
     case 100:
         stream >> symbol.m_path >> symbol.m_filled >> symbol.m_lineWidth >> capStyle >> joinStyle;
         symbol.m_capStyle = static_cast<Qt::PenCapStyle>(capStyle);
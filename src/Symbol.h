@@ -19,8 +19,28 @@
 #define Symbol_H
 
 #include <QBrush>
+#include <QList>
 #include <QPainterPath>
 #include <QPen>
+#include <QTransform>
+#include <QVector>
+
+
+/**
+ * @brief A reference to another library symbol drawn as part of a symbol.
+ *
+ * The component is identified by its index in the library and is drawn with the transform
+ * applied, allowing shared parts such as frames to be defined once and used by many symbols.
+ */
+class SymbolComponent
+{
+public:
+    SymbolComponent();
+    SymbolComponent(qint16 i, const QTransform &t);
+
+    qint16      index;                              /**< index of the component symbol in the library */
+    QTransform  transform;                          /**< transform applied to the component path */
+};
 
 
 /**
@@ -30,6 +50,10 @@
  * it should be drawn. Originally the path was drawn filled, the implementation of this
  * Symbol class allows a fill attribute and a pen width attribute for outline paths. In
  * addition the line end style and line join style can be changed.
+ *
+ * A symbol may also have components, which are other symbols in the library that are drawn
+ * as part of this symbol. The components are resolved by the SymbolLibrary which provides
+ * the flattened path for rendering.
  */
 class Symbol
 {
@@ -41,27 +65,36 @@ public:
     qreal lineWidth() const;
     Qt::PenCapStyle capStyle() const;
     Qt::PenJoinStyle joinStyle() const;
+    QList<SymbolComponent> components() const;
 
     void setPath(const QPainterPath &path);
     void setFilled(bool filled);
     void setLineWidth(qreal width);
     void setCapStyle(Qt::PenCapStyle penCapStyle);
     void setJoinStyle(Qt::PenJoinStyle penJoinStyle);
+    void setComponents(const QList<SymbolComponent> &components);
 
     QPen pen() const;
     QBrush brush() const;
 
+    Symbol simplified(qreal tolerance) const;
+    QByteArray hash() const;
+
     friend QDataStream &operator<<(QDataStream &stream, const Symbol &symbol);
     friend QDataStream &operator>>(QDataStream &stream, Symbol &symbol);
 
 private:
-    static const qint32 version = 100;              /**< version of the stream object */
+    static bool addSimplifiedLines(QPainterPath &path, const QVector<QPointF> &run, qreal tolerance);
+    static qreal lineDistance(const QPointF &point, const QPointF &start, const QPointF &end);
+
+    static const qint32 version = 101;              /**< version of the stream object */
 
     QPainterPath        m_path;                     /**< the symbols path, incorporates fill method if m_filled is true */
     bool                m_filled;                   /**< true if the path is filled, false if an outline path */
     qreal               m_lineWidth;                /**< width of the pen, this is scaled with the painter */
     Qt::PenCapStyle     m_capStyle;                 /**< pen cap style, see the QPen documentation for details */
     Qt::PenJoinStyle    m_joinStyle;                /**< pen join style, see the QPen documentation for details */
+    QList<SymbolComponent>  m_components;           /**< the other library symbols drawn as part of this symbol */
 };
 
 
@@ -0,0 +1,258 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Implement the SymbolAttributes class.
+ */
+
+
+#include "SymbolAttributes.h"
+
+#include <QPainterPath>
+
+#include "Symbol.h"
+
+
+/**
+ * Remove all the rows.
+ */
+void SymbolAttributes::clear()
+{
+    m_indexes.clear();
+    m_elementCounts.clear();
+    m_bounds.clear();
+    m_filled.clear();
+    m_fillRules.clear();
+    m_lineWidths.clear();
+    m_capStyles.clear();
+    m_joinStyles.clear();
+    m_hashes.clear();
+    m_rows.clear();
+    m_stale.clear();
+}
+
+
+/**
+ * Mark the row of a symbol as needing to be updated.
+ * This is also used for symbols that do not have a row yet.
+ *
+ * @param index the index of the symbol
+ */
+void SymbolAttributes::invalidate(qint16 index)
+{
+    m_stale.insert(index);
+}
+
+
+/**
+ * Remove the row of a symbol.
+ * The last row is moved into its place so that the columns do not need to be shifted.
+ *
+ * @param index the index of the symbol
+ */
+void SymbolAttributes::remove(qint16 index)
+{
+    m_stale.remove(index);
+
+    int row = m_rows.value(index, -1);
+
+    if (row == -1) {
+        return;
+    }
+
+    int last = m_indexes.count() - 1;
+
+    if (row != last) {
+        m_indexes[row] = m_indexes.at(last);
+        m_elementCounts[row] = m_elementCounts.at(last);
+        m_bounds[row] = m_bounds.at(last);
+        m_filled[row] = m_filled.at(last);
+        m_fillRules[row] = m_fillRules.at(last);
+        m_lineWidths[row] = m_lineWidths.at(last);
+        m_capStyles[row] = m_capStyles.at(last);
+        m_joinStyles[row] = m_joinStyles.at(last);
+        m_hashes[row] = m_hashes.at(last);
+        m_rows.insert(m_indexes.at(row), row);
+    }
+
+    m_indexes.removeLast();
+    m_elementCounts.removeLast();
+    m_bounds.removeLast();
+    m_filled.removeLast();
+    m_fillRules.removeLast();
+    m_lineWidths.removeLast();
+    m_capStyles.removeLast();
+    m_joinStyles.removeLast();
+    m_hashes.removeLast();
+    m_rows.remove(index);
+}
+
+
+/**
+ * Set the attributes of a symbol.
+ * A row is added if the symbol does not have one.
+ *
+ * @param index the index of the symbol
+ * @param symbol a const reference to the flattened Symbol
+ */
+void SymbolAttributes::update(qint16 index, const Symbol &symbol)
+{
+    m_stale.remove(index);
+
+    int row = m_rows.value(index, -1);
+
+    if (row == -1) {
+        row = m_indexes.count();
+        m_rows.insert(index, row);
+        m_indexes.append(index);
+        m_elementCounts.append(0);
+        m_bounds.append(QRectF());
+        m_filled.append(false);
+        m_fillRules.append(0);
+        m_lineWidths.append(0);
+        m_capStyles.append(0);
+        m_joinStyles.append(0);
+        m_hashes.append(QByteArray());
+    }
+
+    QPainterPath path = symbol.path();
+
+    m_elementCounts[row] = path.elementCount();
+    m_bounds[row] = path.boundingRect();
+    m_filled[row] = symbol.filled();
+    m_fillRules[row] = static_cast<qint8>(path.fillRule());
+    m_lineWidths[row] = symbol.lineWidth();
+    m_capStyles[row] = static_cast<qint8>(symbol.capStyle() >> 4);
+    m_joinStyles[row] = static_cast<qint8>(symbol.joinStyle() >> 6);
+    m_hashes[row] = symbol.hash();
+}
+
+
+/**
+ * Get the indexes of the symbols whose rows need updating.
+ *
+ * @return a QList of the indexes
+ */
+QList<qint16> SymbolAttributes::staleIndexes() const
+{
+    return m_stale.values();
+}
+
+
+/**
+ * Get the number of rows.
+ *
+ * @return the number of rows
+ */
+int SymbolAttributes::count() const
+{
+    return m_indexes.count();
+}
+
+
+/**
+ * Get the index of the symbol in each row.
+ *
+ * @return a const reference to the column
+ */
+const QVector<qint16> &SymbolAttributes::indexes() const
+{
+    return m_indexes;
+}
+
+
+/**
+ * Get the number of elements in the path of each row.
+ *
+ * @return a const reference to the column
+ */
+const QVector<qint32> &SymbolAttributes::elementCounts() const
+{
+    return m_elementCounts;
+}
+
+
+/**
+ * Get the bounding rectangle of the path of each row.
+ *
+ * @return a const reference to the column
+ */
+const QVector<QRectF> &SymbolAttributes::bounds() const
+{
+    return m_bounds;
+}
+
+
+/**
+ * Get the filled flag of each row.
+ *
+ * @return a const reference to the column
+ */
+const QVector<bool> &SymbolAttributes::filled() const
+{
+    return m_filled;
+}
+
+
+/**
+ * Get the fill rule of each row.
+ *
+ * @return a const reference to the column of Qt::FillRule values
+ */
+const QVector<qint8> &SymbolAttributes::fillRules() const
+{
+    return m_fillRules;
+}
+
+
+/**
+ * Get the line width of each row.
+ *
+ * @return a const reference to the column
+ */
+const QVector<qreal> &SymbolAttributes::lineWidths() const
+{
+    return m_lineWidths;
+}
+
+
+/**
+ * Get the cap style of each row.
+ *
+ * @return a const reference to the column of Qt::PenCapStyle values shifted right by 4 bits
+ */
+const QVector<qint8> &SymbolAttributes::capStyles() const
+{
+    return m_capStyles;
+}
+
+
+/**
+ * Get the join style of each row.
+ *
+ * @return a const reference to the column of Qt::PenJoinStyle values shifted right by 6 bits
+ */
+const QVector<qint8> &SymbolAttributes::joinStyles() const
+{
+    return m_joinStyles;
+}
+
+
+/**
+ * Get the content hash of each row.
+ *
+ * @return a const reference to the column
+ */
+const QVector<QByteArray> &SymbolAttributes::hashes() const
+{
+    return m_hashes;
+}
@@ -0,0 +1,83 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Header file for the SymbolAttributes class.
+ */
+
+
+#ifndef SymbolAttributes_H
+#define SymbolAttributes_H
+
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QRectF>
+#include <QSet>
+#include <QVector>
+
+
+class Symbol;
+
+
+/**
+ * @brief A table of the geometric and rendering attributes of the symbols of a library.
+ *
+ * The table is held in columns, one vector for each attribute with a row for each symbol, so
+ * that a query testing one attribute only reads the values of that attribute. Rows are added
+ * and updated as symbols change and the last row is moved into the place of a removed row, so
+ * the rows are in no particular order.
+ *
+ * The attributes are those of the flattened symbol, so a symbol using components has the
+ * elements and bounds of the components included. The library marks the rows of the symbols
+ * that change, and of the symbols depending on them, as stale and they are updated before
+ * the table is next queried.
+ */
+class SymbolAttributes
+{
+public:
+    void clear();
+    void invalidate(qint16 index);
+    void remove(qint16 index);
+    void update(qint16 index, const Symbol &symbol);
+
+    QList<qint16> staleIndexes() const;
+    int count() const;
+
+    const QVector<qint16> &indexes() const;
+    const QVector<qint32> &elementCounts() const;
+    const QVector<QRectF> &bounds() const;
+    const QVector<bool> &filled() const;
+    const QVector<qint8> &fillRules() const;
+    const QVector<qreal> &lineWidths() const;
+    const QVector<qint8> &capStyles() const;
+    const QVector<qint8> &joinStyles() const;
+    const QVector<QByteArray> &hashes() const;
+
+private:
+    QVector<qint16>     m_indexes;          /**< the index of the symbol in each row */
+    QVector<qint32>     m_elementCounts;    /**< the number of elements in the flattened path */
+    QVector<QRectF>     m_bounds;           /**< the bounding rectangle of the flattened path */
+    QVector<bool>       m_filled;           /**< true if the symbol is filled, false if it is stroked */
+    QVector<qint8>      m_fillRules;        /**< the Qt::FillRule of the path */
+    QVector<qreal>      m_lineWidths;       /**< the line width of the symbol */
+    QVector<qint8>      m_capStyles;        /**< the Qt::PenCapStyle of the symbol */
+    QVector<qint8>      m_joinStyles;       /**< the Qt::PenJoinStyle of the symbol */
+    QVector<QByteArray> m_hashes;           /**< the content hash of the flattened symbol */
+
+    QHash<qint16, int>  m_rows;             /**< map of the symbol indexes to their rows */
+    QSet<qint16>        m_stale;            /**< indexes of the symbols whose rows need updating */
+};
+
+
+#endif
@@ -0,0 +1,322 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Implement the SymbolHistory class.
+ */
+
+
+/**
+ * @page symbol_history Symbol History
+ * When a symbol in the library is replaced by saving the symbol from the editor, the version being replaced is
+ * added to the history of the symbol.
+ * Undoing the change removes the revision again. The history is saved with the library, so the earlier versions
+ * of a symbol are available in later sessions.
+ *
+ * The Revisions menu of the library context menu lists the revisions of a symbol with the time each one was
+ * replaced. Choosing a revision opens it in a new editor pane where it can be viewed, or restored by saving it.
+ *
+ * Editing a symbol usually changes a few of the elements of its path, so each revision only stores the elements
+ * that differ from the previous keyframe, which is a revision stored in full every eight revisions. The elements
+ * the two paths have in common at the start and at the end are counted rather than stored. A revision is decoded
+ * from its keyframe and its own delta, so showing one revision does not decode any of the others.
+ */
+
+
+#include "SymbolHistory.h"
+
+#include <QDataStream>
+
+#include "Exceptions.h"
+
+
+/**
+ * Get the number of revisions.
+ *
+ * @return the number of revisions
+ */
+int SymbolHistory::count() const
+{
+    return m_revisions.count();
+}
+
+
+/**
+ * Test if there are any revisions.
+ *
+ * @return true if there are no revisions, false otherwise
+ */
+bool SymbolHistory::isEmpty() const
+{
+    return m_revisions.isEmpty();
+}
+
+
+/**
+ * Get the time a revision was replaced.
+ *
+ * @param revision the index of the revision, 0 being the oldest
+ *
+ * @return a QDateTime in UTC
+ */
+QDateTime SymbolHistory::timestamp(int revision) const
+{
+    return QDateTime::fromMSecsSinceEpoch(m_revisions.at(revision).timestamp, Qt::UTC);
+}
+
+
+/**
+ * Get a revision of the symbol.
+ * Only the revision and its keyframe are decoded.
+ *
+ * @param revision the index of the revision, 0 being the oldest
+ *
+ * @return a Symbol
+ */
+Symbol SymbolHistory::revision(int revision) const
+{
+    const Revision &r = m_revisions.at(revision);
+    QVector<QPainterPath::Element> elements = (r.keyframe == -1) ? r.elements : revisionElements(r, m_revisions.at(r.keyframe));
+
+    Symbol symbol = r.attributes;
+    symbol.setPath(elementsPath(elements, static_cast<Qt::FillRule>(r.fillRule)));
+
+    return symbol;
+}
+
+
+/**
+ * Add a revision.
+ * The revision is a keyframe if it is the first in its group of keyframeInterval revisions, otherwise
+ * its path is stored as the difference from the keyframe of the group.
+ *
+ * @param symbol a const reference to the Symbol being replaced
+ * @param timestamp a const reference to the time it was replaced
+ */
+void SymbolHistory::append(const Symbol &symbol, const QDateTime &timestamp)
+{
+    QPainterPath path = symbol.path();
+    QVector<QPainterPath::Element> elements = pathElements(path);
+
+    Revision revision;
+    revision.timestamp = timestamp.toMSecsSinceEpoch();
+    revision.keyframe = -1;
+    revision.prefix = 0;
+    revision.suffix = 0;
+    revision.fillRule = static_cast<qint8>(path.fillRule());
+    revision.attributes = symbol;
+    revision.attributes.setPath(QPainterPath());
+
+    if (m_revisions.count() % keyframeInterval) {
+        revision.keyframe = m_revisions.count() - m_revisions.count() % keyframeInterval;
+
+        const Revision &keyframe = m_revisions.at(revision.keyframe);
+        int common = qMin(keyframe.elements.count(), elements.count());
+
+        auto same = [](const QPainterPath::Element &a, const QPainterPath::Element &b) {
+            return a.type == b.type && a.x == b.x && a.y == b.y;
+        };
+
+        while (revision.prefix < common && same(keyframe.elements.at(revision.prefix), elements.at(revision.prefix))) {
+            revision.prefix++;
+        }
+
+        while (revision.suffix < common - revision.prefix
+                && same(keyframe.elements.at(keyframe.elements.count() - revision.suffix - 1), elements.at(elements.count() - revision.suffix - 1))) {
+            revision.suffix++;
+        }
+
+        elements = elements.mid(revision.prefix, elements.count() - revision.prefix - revision.suffix);
+    }
+
+    revision.elements = elements;
+    m_revisions.append(revision);
+}
+
+
+/**
+ * Remove the newest revision.
+ * This is used when the change that added it is undone.
+ */
+void SymbolHistory::removeLast()
+{
+    m_revisions.removeLast();
+}
+
+
+/**
+ * Get the elements of a path.
+ *
+ * @param path a const reference to the QPainterPath
+ *
+ * @return a QVector of the elements
+ */
+QVector<QPainterPath::Element> SymbolHistory::pathElements(const QPainterPath &path)
+{
+    QVector<QPainterPath::Element> elements;
+    elements.reserve(path.elementCount());
+
+    for (int i = 0 ; i < path.elementCount() ; ++i) {
+        elements.append(path.elementAt(i));
+    }
+
+    return elements;
+}
+
+
+/**
+ * Get the elements of the path of a revision from its delta.
+ *
+ * @param revision a const reference to the delta Revision
+ * @param keyframe a const reference to the keyframe Revision it was made from
+ *
+ * @return a QVector of the elements
+ */
+QVector<QPainterPath::Element> SymbolHistory::revisionElements(const Revision &revision, const Revision &keyframe)
+{
+    QVector<QPainterPath::Element> elements;
+    elements.reserve(revision.prefix + revision.elements.count() + revision.suffix);
+    elements << keyframe.elements.mid(0, revision.prefix);
+    elements << revision.elements;
+    elements << keyframe.elements.mid(keyframe.elements.count() - revision.suffix);
+
+    return elements;
+}
+
+
+/**
+ * Create a path from its elements.
+ * Curve elements are followed by their two data elements, an incomplete curve is ignored.
+ *
+ * @param elements a const reference to a QVector of the elements
+ * @param fillRule the fill rule of the path
+ *
+ * @return a QPainterPath
+ */
+QPainterPath SymbolHistory::elementsPath(const QVector<QPainterPath::Element> &elements, Qt::FillRule fillRule)
+{
+    QPainterPath path;
+    path.setFillRule(fillRule);
+
+    for (int i = 0 ; i < elements.count() ; ++i) {
+        const QPainterPath::Element &element = elements.at(i);
+
+        switch (element.type) {
+        case QPainterPath::MoveToElement:
+            path.moveTo(element.x, element.y);
+            break;
+
+        case QPainterPath::LineToElement:
+            path.lineTo(element.x, element.y);
+            break;
+
+        case QPainterPath::CurveToElement:
+            if (i + 2 < elements.count()) {
+                path.cubicTo(element.x, element.y, elements.at(i + 1).x, elements.at(i + 1).y, elements.at(i + 2).x, elements.at(i + 2).y);
+                i += 2;
+            }
+
+            break;
+
+        case QPainterPath::CurveToDataElement:
+            break;
+        }
+    }
+
+    return path;
+}
+
+
+/**
+ * Stream out a SymbolHistory.
+ *
+ * @param stream a reference to the QDataStream to write to
+ * @param history a const reference to the SymbolHistory to stream
+ *
+ * @return a reference to the stream
+ */
+QDataStream &operator<<(QDataStream &stream, const SymbolHistory &history)
+{
+    stream << history.version << static_cast<qint32>(history.m_revisions.count());
+
+    foreach (const SymbolHistory::Revision &revision, history.m_revisions) {
+        stream << revision.timestamp << revision.keyframe << revision.prefix << revision.suffix << revision.fillRule;
+        stream << static_cast<qint32>(revision.elements.count());
+
+        foreach (const QPainterPath::Element &element, revision.elements) {
+            stream << static_cast<qint8>(element.type) << element.x << element.y;
+        }
+
+        stream << revision.attributes;
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        throw FailedWriteLibrary(stream.status());
+    }
+
+    return stream;
+}
+
+
+/**
+ * Stream in a SymbolHistory.
+ * Revisions referring to a keyframe that is not before them are discarded with the later revisions.
+ *
+ * @param stream a reference to the QDataStream to read from
+ * @param history a reference to the SymbolHistory to stream
+ *
+ * @return a reference to the stream
+ */
+QDataStream &operator>>(QDataStream &stream, SymbolHistory &history)
+{
+    qint32 version;
+    qint32 revisions;
+    bool valid = true;
+    stream >> version;
+
+    history.m_revisions.clear();
+
+    switch (version) {
+    case 100:
+        stream >> revisions;
+
+        for (int i = 0 ; i < revisions && stream.status() == QDataStream::Ok ; ++i) {
+            SymbolHistory::Revision revision;
+            qint32 elements;
+            stream >> revision.timestamp >> revision.keyframe >> revision.prefix >> revision.suffix >> revision.fillRule >> elements;
+
+            for (int e = 0 ; e < elements && stream.status() == QDataStream::Ok ; ++e) {
+                qint8 type;
+                QPainterPath::Element element;
+                stream >> type >> element.x >> element.y;
+                element.type = static_cast<QPainterPath::ElementType>(type);
+                revision.elements.append(element);
+            }
+
+            stream >> revision.attributes;
+
+            valid = valid && revision.keyframe >= -1 && revision.keyframe < i && (revision.keyframe == -1 || history.m_revisions.at(revision.keyframe).keyframe == -1);
+
+            if (valid) {
+                history.m_revisions.append(revision);
+            }
+        }
+
+        break;
+
+    default:
+        throw InvalidSymbolVersion(version);
+        break;
+    }
+
+    return stream;
+}
@@ -0,0 +1,87 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Header file for the SymbolHistory class.
+ */
+
+
+#ifndef SymbolHistory_H
+#define SymbolHistory_H
+
+
+#include <QDateTime>
+#include <QList>
+#include <QPainterPath>
+#include <QVector>
+
+#include "Symbol.h"
+
+
+class QDataStream;
+
+
+/**
+ * @brief The earlier revisions of a library symbol.
+ *
+ * Each time a symbol in the library is replaced the previous version is appended to its history.
+ * The revisions are held as element level deltas of their paths, a revision keeping only the
+ * elements that differ from a keyframe revision between the elements they have in common at the
+ * start and the end of the path. Every keyframeInterval revisions a keyframe is stored with the
+ * complete path, so any revision can be decoded from itself and its keyframe alone.
+ */
+class SymbolHistory
+{
+public:
+    int count() const;
+    bool isEmpty() const;
+    QDateTime timestamp(int revision) const;
+    Symbol revision(int revision) const;
+
+    void append(const Symbol &symbol, const QDateTime &timestamp = QDateTime::currentDateTimeUtc());
+    void removeLast();
+
+    friend QDataStream &operator<<(QDataStream &stream, const SymbolHistory &history);
+    friend QDataStream &operator>>(QDataStream &stream, SymbolHistory &history);
+
+private:
+    /**
+     * @brief One revision of the symbol.
+     */
+    class Revision
+    {
+    public:
+        qint64                      timestamp;  /**< the time the revision was replaced in milliseconds since the epoch, UTC */
+        qint32                      keyframe;   /**< the index of the keyframe the path is a delta of, -1 if this is a keyframe */
+        qint32                      prefix;     /**< the number of elements at the start of the keyframe path that are kept */
+        qint32                      suffix;     /**< the number of elements at the end of the keyframe path that are kept */
+        QVector<QPainterPath::Element>  elements;   /**< the elements replacing those between the prefix and the suffix */
+        qint8                       fillRule;   /**< the Qt::FillRule of the path */
+        Symbol                      attributes; /**< the symbol with an empty path holding the other attributes */
+    };
+
+    static QVector<QPainterPath::Element> pathElements(const QPainterPath &path);
+    static QVector<QPainterPath::Element> revisionElements(const Revision &revision, const Revision &keyframe);
+    static QPainterPath elementsPath(const QVector<QPainterPath::Element> &elements, Qt::FillRule fillRule);
+
+    static const qint32 version = 100;              /**< version of the stream object */
+    static const int keyframeInterval = 8;          /**< number of revisions between keyframes */
+
+    QList<Revision> m_revisions;                    /**< the revisions, oldest first */
+};
+
+
+QDataStream &operator<<(QDataStream &stream, const SymbolHistory &history);
+QDataStream &operator>>(QDataStream &stream, SymbolHistory &history);
+
+
+#endif
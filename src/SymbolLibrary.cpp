@@ -36,7 +36,14 @@
  * affect the library, similarly undoing commands in the library does not affect the editor.
  *
  * A context menu is available for the symbols in the list allowing individual symbols to be deleted. This can be
- * undone if required.
+ * undone if required. The context menu also allows a symbol to be added to the symbol in the editor as a component.
+ *
+ * @section symbol_components Symbol Components
+ * Symbols that use other symbols as components are flattened by the library for rendering, the path of each
+ * component is transformed and added to the path of the symbol using it. The flattened paths are cached and the
+ * library keeps a dependency graph of the symbols using each component. When a symbol is changed or removed the
+ * cached paths of the symbols depending on it, directly or through other components, are discarded and only their
+ * icons are updated. Components that would make a symbol depend on itself are ignored.
  *
  * Using the File->Import Library it is also possible to import symbols from another symbol file into the current
  * symbol library. These will then be appended to the current set of symbols.
@@ -45,20 +52,54 @@
  * want to copy a number of symbols without importing them all, this can be done on an individual basis.
  *
  * File->Close will close the current library leaving a new empty library that new symbols can be added to.
+ *
+ * File->New from Default Library replaces the current library with a copy of the default library that is built
+ * into the application, giving a starting point for new libraries without having to find the library file. The
+ * default library is decoded the first time it is used and the decoded symbols are shared by all the copies made
+ * from it, each copy only making its own copy of the symbols when it is changed.
+ *
+ * @section symbol_collection Symbol Collections
+ * Large libraries, such as those holding the glyphs of a complete font, can be saved as a collection by using
+ * File->Save As with a file name ending in .symc. The library is then divided into shard files of up to 256
+ * symbols which are saved alongside a small manifest file. Each shard is a normal symbol file that can also be
+ * opened or imported on its own.
+ *
+ * Opening the manifest only reads the list of the shards and the indexes of the symbols they contain, so the
+ * library view can show an entry for every symbol immediately. The symbols of a shard are read the first time
+ * one of them is required, for example when its icon is scrolled into view or it is opened from the catalog.
+ * New symbols are added to the last shard, or a new shard once the last one is full, and saving the collection
+ * only writes the shards that have changed. A shard that can't be read is left without its symbols and is never
+ * written, saving a library that would write it fails with the error of the shard so that its symbols are not lost.
+ *
+ * @section symbol_order Symbol Order
+ * The symbols are initially shown in the order they were added to the library. They can be rearranged by dragging
+ * them to a new position in the library view, the symbols dragged being placed before the symbol they are dropped
+ * on, or at the end of the library if they are dropped on an empty part of the view. The library then keeps the
+ * order of the indexes separately from the symbols, so moving symbols does not change the symbols, their indexes
+ * or their icons. The order is saved with the library, or in the manifest of a collection, and reordering can be
+ * undone.
  */
 
 
 #include "SymbolLibrary.h"
 
 #include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QListWidgetItem>
 #include <QPainter>
+#include <QSaveFile>
+#include <QSet>
 #include <QtAlgorithms>
 
 #include <KLocalizedString>
 
 #include "Exceptions.h"
+#include "LibraryMerge.h"
+#include "Profiling.h"
 #include "SymbolListWidget.h"
+#include "SymbolQuery.h"
 
 
 /**
@@ -86,7 +127,7 @@ SymbolLibrary::~SymbolLibrary()
 /**
  * Clear the file of symbols.
  * Clears the undo stack, deletes all the QListWidgetItems and clears the symbol map.
- * The index is reset to 1.
+ * Any collection is forgotten and the index is reset to 1.
  */
 void SymbolLibrary::clear()
 {
@@ -99,13 +140,49 @@ void SymbolLibrary::clear()
     }
 
     m_symbols.clear();
+    m_flattenedPaths.clear();
+    m_dependents.clear();
+    m_order.clear();
+    m_attributes.clear();
+    m_histories.clear();
+    m_baseSymbols.clear();
+    m_collectionFileName.clear();
+    m_shards.clear();
+    m_shardIndexes.clear();
     m_nextIndex = 1;
 }
 
 
+/**
+ * Replace the contents of the library with the default library.
+ * The library is cleared and the symbols of the default library assigned to it. The QMap of the symbols
+ * is implicitly shared with the decoded default library, so no symbols are copied until the library is
+ * changed. The library is left untitled as a new library.
+ */
+void SymbolLibrary::loadDefault()
+{
+    const SymbolLibrary &library = defaultLibrary();
+
+    clear();
+
+    m_symbols = library.m_symbols;
+    m_dependents = library.m_dependents;
+    m_order = library.m_order;
+    m_histories = library.m_histories;
+    m_nextIndex = library.m_nextIndex;
+
+    foreach (qint16 index, m_symbols.keys()) {
+        m_attributes.invalidate(index);
+    }
+
+    generateItems();
+}
+
+
 /**
  * Get the path associated with an index.
  * If the index is not in the library it returns a default constructed Symbol.
+ * For a collection the shard containing the symbol is read if it hasn't been already.
  *
  * @param index a qint16 representing the index to find
  *
@@ -113,7 +190,13 @@ void SymbolLibrary::clear()
  */
 Symbol SymbolLibrary::symbol(qint16 index)
 {
-    return (m_symbols.contains(index) ? m_symbols[index] : Symbol());
+    QMap<qint16, int>::const_iterator shard = m_shardIndexes.constFind(index);
+
+    if (shard != m_shardIndexes.constEnd()) {
+        loadShard(shard.value());
+    }
+
+    return m_symbols.value(index);
 }
 
 
@@ -122,6 +205,7 @@ Symbol SymbolLibrary::symbol(qint16 index)
  * Remove a symbol identified by it's index and return it.
  * The QListWidgetItem associated with the symbol is also removed and deleted.
  * If the index is not in the library it returns a default constructed symbol.
+ * For a collection the shard containing the symbol is read and marked as changed.
  *
  * @param index the index of the Symbol to be removed
  *
@@ -129,14 +213,11 @@ Symbol SymbolLibrary::symbol(qint16 index)
  */
 Symbol SymbolLibrary::takeSymbol(qint16 index)
 {
-    Symbol symbol;
-
-    if (m_symbols.contains(index)) {
-        symbol = m_symbols.take(index);
+    Symbol symbol = removeSymbol(index);
+    m_order.removeOne(index);
 
-        if (m_listWidget) {
-            m_listWidget->removeSymbol(index);
-        }
+    if (m_listWidget) {
+        m_listWidget->removeSymbol(index);
     }
 
     return symbol;
@@ -146,9 +227,12 @@ Symbol SymbolLibrary::takeSymbol(qint16 index)
 /**
  * Update the Symbol for an index in the library.
  * If the index supplied is 0, a new index will be taken from the m_nextIndex value which is
- * then incremented. This value will be returned.
+ * then incremented. This value will be returned. A symbol set with an index that has not been
+ * used yet, as a merge does, advances m_nextIndex past it.
  * When a LibraryListWidget has been linked to the SymbolLibrary the symbol is added to the
- * LibraryListWidget.
+ * LibraryListWidget and the icons of any symbols using it as a component are updated.
+ * For a collection the shard containing the symbol is read and marked as changed, new symbols
+ * are added to the last shard. If the library has been reordered new symbols are shown at the end.
  *
  * @param index a qint16 representing the index
  * @param symbol a const reference to a Symbol
@@ -159,18 +243,233 @@ qint16 SymbolLibrary::setSymbol(qint16 index, const Symbol &symbol)
 {
     if (!index) {
         index = m_nextIndex++;
+    } else if (index >= m_nextIndex) {
+        m_nextIndex = index + 1;
+    }
+
+    if (!m_order.isEmpty() && !m_symbols.contains(index) && !m_shardIndexes.contains(index)) {
+        m_order.append(index);
+    }
+
+    if (isCollection()) {
+        int shard = m_shardIndexes.value(index, -1);
+
+        if (shard == -1) {
+            shard = shardForNewSymbol();
+            m_shardIndexes.insert(index, shard);
+            m_shards[shard].count++;
+        }
+
+        loadShard(shard);
+        m_shards[shard].dirty = true;
+    }
+
+    if (m_symbols.contains(index)) {
+        removeDependencies(index, m_symbols.value(index));
     }
 
     m_symbols.insert(index, symbol);
+    addDependencies(index, symbol);
+    invalidate(index);
 
     if (m_listWidget) {
-        m_listWidget->addSymbol(index, symbol);
+        m_listWidget->addSymbol(index, flattenedSymbol(index));
     }
 
     return index;
 }
 
 
+/**
+ * Add a number of new symbols to the library.
+ * Each symbol is given a new index as setSymbol does for an index of 0, but the items for the symbols
+ * are added to the LibraryListWidget in a single pass with their icons created as they are shown.
+ *
+ * @param symbols a const reference to a QList of the Symbols to add
+ *
+ * @return a QList of the new indexes in the order of the symbols
+ */
+QList<qint16> SymbolLibrary::addSymbols(const QList<Symbol> &symbols)
+{
+    QList<qint16> indexes;
+    indexes.reserve(symbols.count());
+
+    foreach (const Symbol &symbol, symbols) {
+        qint16 index = m_nextIndex++;
+
+        if (isCollection()) {
+            int shard = shardForNewSymbol();
+            m_shardIndexes.insert(index, shard);
+            m_shards[shard].count++;
+            loadShard(shard);
+            m_shards[shard].dirty = true;
+        }
+
+        m_symbols.insert(index, symbol);
+        addDependencies(index, symbol);
+        m_attributes.invalidate(index);
+        indexes.append(index);
+    }
+
+    if (!m_order.isEmpty()) {
+        m_order.append(indexes);
+    }
+
+    if (m_listWidget) {
+        m_listWidget->addSymbols(indexes);
+    }
+
+    return indexes;
+}
+
+
+/**
+ * Remove a number of symbols from the library.
+ * The items for the symbols are removed from the LibraryListWidget, and the indexes from the display
+ * order, in a single pass.
+ *
+ * @param indexes a const reference to a QList of the indexes to remove
+ */
+void SymbolLibrary::takeSymbols(const QList<qint16> &indexes)
+{
+    foreach (qint16 index, indexes) {
+        removeSymbol(index);
+    }
+
+    if (!m_order.isEmpty()) {
+        QSet<qint16> removed(indexes.constBegin(), indexes.constEnd());
+        QList<qint16> order;
+        order.reserve(m_order.count());
+
+        foreach (qint16 index, m_order) {
+            if (!removed.contains(index)) {
+                order.append(index);
+            }
+        }
+
+        m_order = order;
+    }
+
+    if (m_listWidget) {
+        m_listWidget->removeSymbols(indexes);
+    }
+}
+
+
+/**
+ * Remove a symbol from the library without removing its item from the LibraryListWidget or its
+ * index from the display order, the callers remove these as they need. The icons of the symbols using it as a component are marked to be updated.
+ * For a collection the shard containing the symbol is read and marked as changed.
+ *
+ * @param index the index of the Symbol to be removed
+ *
+ * @return the Symbol, a default constructed symbol if the index is not in the library
+ */
+Symbol SymbolLibrary::removeSymbol(qint16 index)
+{
+    Symbol symbol;
+
+    if (m_shardIndexes.contains(index)) {
+        int shard = m_shardIndexes.value(index);
+        loadShard(shard);
+        m_shardIndexes.remove(index);
+        m_shards[shard].count--;
+        m_shards[shard].dirty = true;
+    }
+
+    if (m_symbols.contains(index)) {
+        symbol = m_symbols.take(index);
+        removeDependencies(index, symbol);
+        invalidate(index);
+        m_attributes.remove(index);
+    }
+
+    return symbol;
+}
+
+
+/**
+ * Get a symbol with its components flattened into its path.
+ * This is the form of the symbol used for rendering, the components are removed from the symbol returned.
+ *
+ * @param index a qint16 representing the index to find
+ *
+ * @return a Symbol
+ */
+Symbol SymbolLibrary::flattenedSymbol(qint16 index)
+{
+    Symbol symbol = this->symbol(index);
+
+    if (!symbol.components().isEmpty()) {
+        QSet<qint16> visiting;
+        symbol.setPath(flattenedPath(index, visiting));
+        symbol.setComponents(QList<SymbolComponent>());
+    }
+
+    return symbol;
+}
+
+
+/**
+ * Get the combined path of the components of a symbol.
+ * The symbol does not need to be in the library, this is used by the Editor to draw the components of the
+ * symbol being edited.
+ *
+ * @param symbol a const reference to the Symbol
+ *
+ * @return a QPainterPath of the transformed and flattened components
+ */
+QPainterPath SymbolLibrary::componentsPath(const Symbol &symbol)
+{
+    QPainterPath path;
+    QSet<qint16> visiting;
+
+    foreach (const SymbolComponent &component, symbol.components()) {
+        path.addPath(component.transform.map(flattenedPath(component.index, visiting)));
+    }
+
+    return path;
+}
+
+
+/**
+ * Test if a symbol depends on another, either directly as a component or through its components.
+ * A symbol is considered to depend on itself. This is used to avoid adding components that would
+ * create a cycle.
+ *
+ * @param index the index of the symbol to test
+ * @param component the index of the possible component
+ *
+ * @return true if the symbol depends on the component, false otherwise
+ */
+bool SymbolLibrary::dependsOn(qint16 index, qint16 component)
+{
+    QList<qint16> pending;
+    QSet<qint16> visited;
+    pending.append(index);
+
+    while (!pending.isEmpty()) {
+        qint16 i = pending.takeLast();
+
+        if (i == component) {
+            return true;
+        }
+
+        if (visited.contains(i)) {
+            continue;
+        }
+
+        visited.insert(i);
+
+        foreach (const SymbolComponent &c, symbol(i).components()) {
+            pending.append(c.index);
+        }
+    }
+
+    return false;
+}
+
+
 /**
  * Get the name of the symbol library.
  */
@@ -191,14 +490,40 @@ void SymbolLibrary::setName(const QString &name)
 }
 
 
+/**
+ * Get the index that the next symbol added will be given.
+ *
+ * @return the next index
+ */
+qint16 SymbolLibrary::nextIndex() const
+{
+    return m_nextIndex;
+}
+
+
+/**
+ * Check if the library has a symbol at an index.
+ * For a collection this includes the symbols in the shards that have not been read.
+ *
+ * @param index the index of the symbol
+ *
+ * @return true if there is a symbol at the index, false otherwise
+ */
+bool SymbolLibrary::contains(qint16 index) const
+{
+    return (isCollection() ? m_shardIndexes.contains(index) : m_symbols.contains(index));
+}
+
+
 /**
  * Get a sorted list of symbol indexes
+ * For a collection this includes the symbols in the shards that have not been read.
  *
  * @return a QList<qint16> of sorted indexes
  */
 QList<qint16> SymbolLibrary::indexes() const
 {
-    QList<qint16> keys = m_symbols.keys();
+    QList<qint16> keys = (isCollection() ? m_shardIndexes.keys() : m_symbols.keys());
 #if QT_VERSION > QT_VERSION_CHECK(5, 2, 0)
     std::sort(keys.begin(), keys.end());
 #else
@@ -209,111 +534,1105 @@ QList<qint16> SymbolLibrary::indexes() const
 
 
 /**
- * Get a pointer to the symbol library undo stack.
+ * Get the order the symbols are shown in.
  *
- * @return a pointer to a QUndoStack
+ * @return a QList<qint16> of the indexes in the order they are shown, empty if they are shown in index order
  */
-QUndoStack *SymbolLibrary::undoStack()
+QList<qint16> SymbolLibrary::displayOrder() const
 {
-    return &m_undoStack;
+    return m_order;
 }
 
 
 /**
- * Generate all the items in the library.
- * This will be called when a library file is loaded to generate all the new
- * QListWidgetItems for the symbols in the library and generate an icon for it.
- * A list of sorted QMap keys is retrieved to allow adding items in the correct
- * order.
+ * Get the indexes of the symbols in the order they are shown.
+ *
+ * @return a QList<qint16> of the indexes
  */
-void SymbolLibrary::generateItems()
+QList<qint16> SymbolLibrary::orderedIndexes() const
 {
-    if (!m_listWidget) {
-        return;
+    return (m_order.isEmpty() ? indexes() : m_order);
+}
+
+
+/**
+ * Move symbols to a new position in the order they are shown.
+ * The symbols are placed together in the order given before the symbol with the index before. Only the
+ * order and the items in the LibraryListWidget are changed, the symbols and their icons are unchanged.
+ *
+ * @param indexes a const reference to a QList of the indexes of the symbols to move
+ * @param before the index of the symbol to place them before, 0 or an index that is not in the library
+ * to place them at the end
+ */
+void SymbolLibrary::moveSymbols(const QList<qint16> &indexes, qint16 before)
+{
+    if (m_order.isEmpty()) {
+        m_order = this->indexes();
     }
 
-    m_listWidget->loadFromLibrary(this);
+    // rebuild the order in a single pass rather than searching it for each symbol moved
+    QSet<qint16> moved(indexes.constBegin(), indexes.constEnd());
+    QList<qint16> order;
+    order.reserve(m_order.count());
+    bool placed = false;
+
+    foreach (qint16 index, m_order) {
+        if (moved.contains(index)) {
+            continue;
+        }
+
+        if (index == before) {
+            order.append(indexes);
+            placed = true;
+        }
+
+        order.append(index);
+    }
+
+    if (!placed) {
+        order.append(indexes);
+    }
+
+    m_order = order;
+
+    if (m_listWidget) {
+        m_listWidget->moveSymbols(indexes, before);
+    }
 }
 
 
 /**
- * Stream out the file.
- * Symbol files are indicated with a magic string of KXStitchSymbols. The stream version is set
- * to maintain consistency with the streamed objects.
- * Write the version, current index and the map of symbols.
+ * Set the display order, such as one saved before symbols were moved.
+ * The order is replaced as a whole and the items of the symbols given are placed in their rows in
+ * it. The other items must already be in the order, so the change is made in a single pass.
  *
- * @param stream a reference to a QDataStream
- * @param library a const reference to a SymbolLibrary
+ * @param order a const reference to the display order as from displayOrder(), empty for index order
+ * @param indexes a const reference to a QList of the indexes of the symbols whose positions changed
+ */
+void SymbolLibrary::setDisplayOrder(const QList<qint16> &order, const QList<qint16> &indexes)
+{
+    m_order = order;
+
+    if (m_listWidget) {
+        QSet<qint16> moved(indexes.constBegin(), indexes.constEnd());
+        QList<qint16> ordered = orderedIndexes();
+        QMap<int, qint16> rows;
+
+        for (int row = 0 ; row < ordered.count() ; ++row) {
+            if (moved.contains(ordered.at(row))) {
+                rows.insert(row, ordered.at(row));
+            }
+        }
+
+        m_listWidget->restoreSymbols(rows);
+    }
+}
+
+
+/**
+ * Find the symbols matching a query.
+ * For a collection any unread shards are read so that all the symbols are searched. The attributes
+ * of the symbols that have changed since the last query are updated before the query is evaluated.
  *
- * @return a reference to a QDataStream
+ * @param query a const reference to the SymbolQuery
+ *
+ * @return a QList of the indexes of the matching symbols in no particular order
  */
-QDataStream &operator<<(QDataStream &stream, const SymbolLibrary &library)
+QList<qint16> SymbolLibrary::query(const SymbolQuery &query)
 {
-    qint16 lastIndex = 0;
+    updateAttributes();
 
-    QMapIterator<qint16, Symbol> i(library.m_symbols);
+    return query.select(m_attributes);
+}
 
-    while (i.hasNext()) {
-        i.next();
-        if (i.key() > lastIndex) {
-            lastIndex = i.key();
+
+/**
+ * Get what is needed to hash the flattened symbols of the library on a worker thread.
+ * This only copies what the library already holds, the hashes of the attribute rows that are up to
+ * date, the symbols, which share their data with the library, the indexes of the stale rows and
+ * the files and indexes of the unread shards of a collection. Shards that failed to read are left
+ * out as their symbols are missing.
+ *
+ * @return a HashSource to pass to flattenedHashes()
+ */
+SymbolLibrary::HashSource SymbolLibrary::hashSource() const
+{
+    HashSource source;
+    QList<qint16> stale = m_attributes.staleIndexes();
+    QSet<qint16> staleSet(stale.constBegin(), stale.constEnd());
+    const QVector<qint16> &indexes = m_attributes.indexes();
+    const QVector<QByteArray> &hashes = m_attributes.hashes();
+
+    for (int row = 0 ; row < indexes.count() ; ++row) {
+        if (!staleSet.contains(indexes.at(row))) {
+            source.hashes.insert(hashes.at(row));
         }
     }
 
-    lastIndex++;
+    source.symbols = m_symbols;
 
-    stream.writeRawData("KXStitchSymbols", 15);
-    stream.setVersion(QDataStream::Qt_4_0);
-    stream << library.version;
-    stream << lastIndex;
+    foreach (qint16 index, stale) {
+        if (m_symbols.contains(index)) {
+            source.stale.append(index);
+        }
+    }
 
-    if (stream.status() != QDataStream::Ok) {
-        throw FailedWriteLibrary(stream.status());
+    QDir dir = QFileInfo(m_collectionFileName).absoluteDir();
+
+    QMapIterator<qint16, int> i(m_shardIndexes);
+
+    while (i.hasNext()) {
+        i.next();
+
+        const Shard &shard = m_shards.at(i.value());
+
+        if (!shard.loaded) {
+            source.shards[dir.filePath(shard.fileName)].append(i.key());
+        }
     }
 
-    stream << library.m_symbols;
-    return stream;
+    return source;
 }
 
 
 /**
- * Stream in the file.
- * Initially clear the current contents.
- * Symbol files are indicated with a magic string of KXStitchSymbols. The stream version is set
- * to maintain consistency with the streamed objects. Read and check the magic string. If this
- * is not a symbol file throw an exception.
- * Read in the version.
- * Read the data for the specified version. The stream is checked for errors and an exception is
- * thrown if there was an error.
+ * Get the content hashes of the flattened symbols of a library.
+ * This is safe to call from worker threads as the symbols are flattened in a temporary SymbolLibrary,
+ * the unread shards being read into it. The hashes of the stale and unread symbols are added to
+ * those already known, so the attribute table of the library itself is left unchanged. Shards that
+ * can't be read are skipped, they are reported when the library reads them.
  *
- * @param stream a reference to a QDataStream
- * @param library a reference to a SymbolLibrary
+ * @param source a const reference to the HashSource from hashSource()
  *
- * @return a reference to a QDataStream
+ * @return a QSet of the hashes
  */
-QDataStream &operator>>(QDataStream &stream, SymbolLibrary &library)
+QSet<QByteArray> SymbolLibrary::flattenedHashes(const HashSource &source)
 {
-    library.clear();
+    SymbolLibrary library;
+    library.m_symbols = source.symbols;
 
-    char magic[15];
-    stream.readRawData(magic, 15);
+    QList<qint16> indexes = source.stale;
 
-    if (strncmp(magic, "KXStitchSymbols", 15) == 0) {
-        stream.setVersion(QDataStream::Qt_4_0);
-        qint32 version;
-        QMap<qint16, QPainterPath> paths_v100;
-        QList<qint16> paths_v100_keys;
-        stream >> version;
+    QMapIterator<QString, QList<qint16> > i(source.shards);
 
-        switch (version) {
-        case 101:
-            stream >> library.m_nextIndex;
+    while (i.hasNext()) {
+        i.next();
 
-            if (stream.status() != QDataStream::Ok) {
-                throw FailedReadLibrary(stream.status());
-            }
+        QFile file(i.key());
+
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+
+        QDataStream stream(&file);
+        SymbolLibrary shard;
+
+        try {
+            stream >> shard;
+        } catch (const InvalidFile &) {
+            continue;
+        } catch (const InvalidFileVersion &) {
+            continue;
+        } catch (const InvalidSymbolVersion &) {
+            continue;
+        } catch (const FailedReadLibrary &) {
+            continue;
+        }
+
+        foreach (qint16 index, i.value()) {
+            if (shard.m_symbols.contains(index)) {
+                library.m_symbols.insert(index, shard.m_symbols.value(index));
+                indexes.append(index);
+            }
+        }
+    }
+
+    QSet<QByteArray> hashes = source.hashes;
+
+    foreach (qint16 index, indexes) {
+        hashes.insert(library.flattenedSymbol(index).hash());
+    }
+
+    return hashes;
+}
+
+
+/**
+ * Bring the attribute table up to date.
+ * For a collection any unread shards are read so that the table includes all the symbols. The
+ * attributes of the symbols that have changed since the table was last used are updated.
+ */
+void SymbolLibrary::updateAttributes()
+{
+    loadAllShards();
+
+    foreach (qint16 index, m_attributes.staleIndexes()) {
+        if (m_symbols.contains(index)) {
+            m_attributes.update(index, flattenedSymbol(index));
+        } else {
+            m_attributes.remove(index);
+        }
+    }
+}
+
+
+/**
+ * Get the earlier revisions of a symbol.
+ * For a collection the shard containing the symbol is read if it hasn't been already.
+ *
+ * @param index the index of the symbol
+ *
+ * @return a SymbolHistory, this is empty if the symbol has not been replaced
+ */
+SymbolHistory SymbolLibrary::history(qint16 index)
+{
+    if (m_shardIndexes.contains(index)) {
+        loadShard(m_shardIndexes.value(index));
+    }
+
+    return m_histories.value(index);
+}
+
+
+/**
+ * Add a revision to the history of a symbol.
+ * This is called with the symbol being replaced before the new symbol is set, which marks the shard of a
+ * collection as changed so that the history is written with it.
+ *
+ * @param index the index of the symbol
+ * @param symbol a const reference to the Symbol being replaced
+ */
+void SymbolLibrary::addRevision(qint16 index, const Symbol &symbol)
+{
+    if (m_shardIndexes.contains(index)) {
+        loadShard(m_shardIndexes.value(index));
+    }
+
+    m_histories[index].append(symbol);
+}
+
+
+/**
+ * Replace the history of a symbol.
+ * This is used when a merge takes the symbol and its history from the file, and to undo it.
+ *
+ * @param index the index of the symbol
+ * @param history a const reference to the SymbolHistory, an empty history removes it
+ */
+void SymbolLibrary::setHistory(qint16 index, const SymbolHistory &history)
+{
+    if (m_shardIndexes.contains(index)) {
+        loadShard(m_shardIndexes.value(index));
+    }
+
+    if (history.isEmpty()) {
+        m_histories.remove(index);
+    } else {
+        m_histories.insert(index, history);
+    }
+}
+
+
+/**
+ * Remove the newest revision from the history of a symbol.
+ * This is called when the replacement of the symbol is undone.
+ *
+ * @param index the index of the symbol
+ */
+void SymbolLibrary::removeRevision(qint16 index)
+{
+    if (!m_histories.contains(index)) {
+        return;
+    }
+
+    m_histories[index].removeLast();
+
+    if (m_histories.value(index).isEmpty()) {
+        m_histories.remove(index);
+    }
+}
+
+
+/**
+ * Set the base of a merge to the current symbols.
+ * This is called when the library has been read from or written to its file. The base shares the
+ * data of the symbols so this does not copy them.
+ */
+void SymbolLibrary::setBaseSymbols()
+{
+    m_baseSymbols = m_symbols;
+}
+
+
+/**
+ * Merge the symbols of the library file, which has been changed by another application, with the
+ * symbols of the library.
+ * The changes are not applied, this is done with a MergeLibraryCommand.
+ *
+ * @param theirs a const reference to a SymbolLibrary read from the file
+ *
+ * @return a LibraryMerge holding the changes made to the file and the conflicts
+ */
+LibraryMerge SymbolLibrary::merge(const SymbolLibrary &theirs) const
+{
+    return LibraryMerge(m_baseSymbols, m_symbols, theirs.m_symbols, theirs.m_histories, theirs.orderedIndexes());
+}
+
+
+/**
+ * Get a pointer to the symbol library undo stack.
+ *
+ * @return a pointer to a QUndoStack
+ */
+QUndoStack *SymbolLibrary::undoStack()
+{
+    return &m_undoStack;
+}
+
+
+/**
+ * Test if the library is a collection.
+ *
+ * @return true if the library was opened or saved as a collection, false otherwise
+ */
+bool SymbolLibrary::isCollection() const
+{
+    return !m_collectionFileName.isEmpty();
+}
+
+
+/**
+ * Get the file name of the collection manifest.
+ *
+ * @return a QString containing the absolute path of the manifest, empty if this is not a collection
+ */
+QString SymbolLibrary::collectionFileName() const
+{
+    return m_collectionFileName;
+}
+
+
+/**
+ * Test if a file is a collection manifest.
+ * Collection manifests are indicated with a magic string of KXStitchCollection.
+ *
+ * @param fileName the name of the file to test
+ *
+ * @return true if the file is a collection manifest, false otherwise
+ */
+bool SymbolLibrary::isCollectionFile(const QString &fileName)
+{
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    char magic[18];
+    return (file.read(magic, 18) == 18 && strncmp(magic, "KXStitchCollection", 18) == 0);
+}
+
+
+/**
+ * Read the symbols of a library file with their components flattened.
+ * This is used to import libraries and is safe to call from worker threads as the file is read into a
+ * temporary SymbolLibrary. Exceptions thrown reading the file are passed to the caller.
+ *
+ * @param fileName the name of the library file
+ *
+ * @return a QList of the flattened Symbols in index order
+ */
+QList<Symbol> SymbolLibrary::readFlattenedSymbols(const QString &fileName)
+{
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw FailedFileAccess(fileName, file.errorString());
+    }
+
+    QDataStream stream(&file);
+    SymbolLibrary library;
+    stream >> library;
+
+    QList<Symbol> symbols;
+
+    foreach (qint16 index, library.orderedIndexes()) {
+        symbols.append(library.flattenedSymbol(index));
+    }
+
+    return symbols;
+}
+
+
+/**
+ * Open a collection.
+ * Initially clear the current contents.
+ * Read the manifest which has the magic string of KXStitchCollection, the version, the next index,
+ * the list of shards with the indexes of the symbols each contains and, from version 101, the order
+ * the symbols are shown in. None of the shards are read, but
+ * they are checked to exist. The items are generated for all the symbols in the collection, their
+ * icons being created as they are shown.
+ *
+ * @param fileName the name of the manifest file
+ */
+void SymbolLibrary::openCollection(const QString &fileName)
+{
+    clear();
+
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw FailedFileAccess(fileName, file.errorString());
+    }
+
+    QDataStream stream(&file);
+
+    char magic[18];
+    stream.readRawData(magic, 18);
+
+    if (strncmp(magic, "KXStitchCollection", 18) != 0) {
+        throw InvalidFile();
+    }
+
+    stream.setVersion(QDataStream::Qt_4_0);
+    qint32 version;
+    qint16 nextIndex;
+    qint32 shards;
+    QList<Shard> shardList;
+    QMap<qint16, int> shardIndexes;
+    QList<qint16> order;
+    stream >> version;
+
+    switch (version) {
+    case 101:
+    case 100:
+        stream >> nextIndex;
+        stream >> shards;
+
+        for (int i = 0 ; i < shards && stream.status() == QDataStream::Ok ; ++i) {
+            Shard shard;
+            QList<qint16> indexes;
+            stream >> shard.fileName;
+            stream >> indexes;
+            shard.count = indexes.count();
+            shard.loaded = false;
+            shard.dirty = false;
+            shardList.append(shard);
+
+            foreach (qint16 index, indexes) {
+                shardIndexes.insert(index, i);
+            }
+        }
+
+        if (version >= 101) {
+            stream >> order;
+        }
+
+        if (stream.status() != QDataStream::Ok) {
+            throw FailedReadLibrary(stream.status());
+        }
+
+        break;
+
+    default:
+        throw InvalidFileVersion(version);
+        break;
+    }
+
+    QDir directory = QFileInfo(fileName).absoluteDir();
+
+    foreach (const Shard &shard, shardList) {
+        if (!directory.exists(shard.fileName)) {
+            throw FailedFileAccess(directory.filePath(shard.fileName), i18n("The shard file does not exist"));
+        }
+    }
+
+    m_collectionFileName = QFileInfo(fileName).absoluteFilePath();
+    m_nextIndex = nextIndex;
+    m_shards = shardList;
+    m_shardIndexes = shardIndexes;
+    m_order = order;
+    validateOrder();
+    generateItems();
+}
+
+
+/**
+ * Save the library as a collection.
+ * If the library is not already a collection with this manifest, all the symbols are read and the
+ * library is divided into new shards which are named after the manifest file and saved in the same
+ * directory. Otherwise only the shards that have changed are written. The manifest is then written.
+ * The files are written with QSaveFile so that a failure leaves the existing files intact. Nothing is
+ * written if a shard that would be written could not be read, see checkShards().
+ *
+ * @param fileName the name of the manifest file
+ */
+void SymbolLibrary::saveCollection(const QString &fileName)
+{
+    QString path = QFileInfo(fileName).absoluteFilePath();
+
+    if (path != m_collectionFileName) {
+        loadAllShards();
+        checkShards(true);
+        m_collectionFileName = path;
+        m_shards.clear();
+        m_shardIndexes.clear();
+
+        foreach (qint16 index, m_symbols.keys()) {
+            int shard = shardForNewSymbol();
+            m_shardIndexes.insert(index, shard);
+            m_shards[shard].count++;
+        }
+    }
+
+    checkShards(false);
+
+    QList<QList<qint16> > shardIndexes;
+    QList<QMap<qint16, Symbol> > shardSymbols;
+
+    for (int i = 0 ; i < m_shards.count() ; ++i) {
+        shardIndexes.append(QList<qint16>());
+        shardSymbols.append(QMap<qint16, Symbol>());
+    }
+
+    QMapIterator<qint16, int> i(m_shardIndexes);
+
+    while (i.hasNext()) {
+        i.next();
+        shardIndexes[i.value()].append(i.key());
+
+        if (m_shards.at(i.value()).dirty) {
+            shardSymbols[i.value()].insert(i.key(), m_symbols.value(i.key()));
+        }
+    }
+
+    QDir directory = QFileInfo(path).absoluteDir();
+
+    for (int shard = 0 ; shard < m_shards.count() ; ++shard) {
+        if (m_shards.at(shard).dirty) {
+            QSaveFile file(directory.filePath(m_shards.at(shard).fileName));
+
+            if (!file.open(QIODevice::WriteOnly)) {
+                throw FailedFileAccess(file.fileName(), file.errorString());
+            }
+
+            QDataStream stream(&file);
+            writeSymbols(stream, m_nextIndex, shardSymbols.at(shard), QList<qint16>(), m_histories);
+
+            if (stream.status() != QDataStream::Ok) {
+                throw FailedWriteLibrary(stream.status());
+            }
+
+            if (!file.commit()) {
+                throw FailedFileAccess(file.fileName(), file.errorString());
+            }
+        }
+    }
+
+    QSaveFile file(path);
+
+    if (!file.open(QIODevice::WriteOnly)) {
+        throw FailedFileAccess(path, file.errorString());
+    }
+
+    QDataStream stream(&file);
+    stream.writeRawData("KXStitchCollection", 18);
+    stream.setVersion(QDataStream::Qt_4_0);
+    stream << collectionVersion;
+    stream << m_nextIndex;
+    stream << qint32(m_shards.count());
+
+    for (int shard = 0 ; shard < m_shards.count() ; ++shard) {
+        stream << m_shards.at(shard).fileName;
+        stream << shardIndexes.at(shard);
+    }
+
+    stream << m_order;
+
+    if (stream.status() != QDataStream::Ok) {
+        throw FailedWriteLibrary(stream.status());
+    }
+
+    if (!file.commit()) {
+        throw FailedFileAccess(path, file.errorString());
+    }
+
+    for (int shard = 0 ; shard < m_shards.count() ; ++shard) {
+        m_shards[shard].dirty = false;
+    }
+}
+
+
+/**
+ * Read all the shards of a collection that have not been read.
+ * This is required before the library is streamed out as a single file.
+ */
+void SymbolLibrary::loadAllShards()
+{
+    for (int shard = 0 ; shard < m_shards.count() ; ++shard) {
+        loadShard(shard);
+    }
+}
+
+
+/**
+ * Get the errors of the shards of a collection that could not be read.
+ *
+ * @return a QStringList with a description of the error of each shard that failed, empty if none did
+ */
+QStringList SymbolLibrary::shardErrors() const
+{
+    QStringList errors;
+
+    foreach (const Shard &shard, m_shards) {
+        if (!shard.error.isEmpty()) {
+            errors.append(i18n("%1: %2", shard.fileName, shard.error));
+        }
+    }
+
+    return errors;
+}
+
+
+/**
+ * Check that the shards of a collection about to be written could all be read.
+ * A shard that could not be read has none of its symbols, so writing it, or writing the library as a
+ * whole, would lose them.
+ *
+ * @param all true if all the shards are to be written, false if only the changed shards are written
+ *
+ * @exception FailedFileAccess for the first shard that could not be read and would be written
+ */
+void SymbolLibrary::checkShards(bool all) const
+{
+    foreach (const Shard &shard, m_shards) {
+        if (!shard.error.isEmpty() && (all || shard.dirty)) {
+            throw FailedFileAccess(QFileInfo(m_collectionFileName).absoluteDir().filePath(shard.fileName),
+                                   i18n("%1\nThe shard could not be read, so it is not written to keep the symbols it holds", shard.error));
+        }
+    }
+}
+
+
+/**
+ * Read the symbols of a shard if it has not been read.
+ * The shard is a normal library file which is read into a temporary SymbolLibrary and the symbols
+ * that the manifest lists for the shard are copied into this library. A shard that fails to read is
+ * marked with the error and treated as read to avoid repeatedly trying to read it, its symbols are
+ * missing and checkShards() refuses to write it. The errors are reported by shardErrors().
+ *
+ * @param shard the index of the shard in m_shards
+ */
+void SymbolLibrary::loadShard(int shard)
+{
+    if (m_shards.at(shard).loaded) {
+        return;
+    }
+
+    m_shards[shard].loaded = true;
+
+    QString path = QFileInfo(m_collectionFileName).absoluteDir().filePath(m_shards.at(shard).fileName);
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_shards[shard].error = file.errorString();
+        return;
+    }
+
+    QDataStream stream(&file);
+    SymbolLibrary library;
+
+    try {
+        stream >> library;
+    } catch (const InvalidFile &e) {
+        m_shards[shard].error = i18n("This doesn't appear to be a valid symbol file");
+    } catch (const InvalidFileVersion &e) {
+        m_shards[shard].error = i18n("Version %1 of the library file is not supported in this version of SymbolEditor", e.version);
+    } catch (const InvalidSymbolVersion &e) {
+        m_shards[shard].error = i18n("Version %1 of a symbol is not supported in this version of SymbolEditor", e.version);
+    } catch (const FailedReadLibrary &e) {
+        m_shards[shard].error = i18n("Failed to read the library\n%1", e.statusMessage());
+    }
+
+    if (!m_shards.at(shard).error.isEmpty()) {
+        qWarning("Failed to read the shard %s: %s", qPrintable(path), qPrintable(m_shards.at(shard).error));
+        return;
+    }
+
+    QMapIterator<qint16, Symbol> i(library.m_symbols);
+
+    while (i.hasNext()) {
+        i.next();
+
+        if (m_shardIndexes.value(i.key(), -1) == shard) {
+            m_symbols.insert(i.key(), i.value());
+            addDependencies(i.key(), i.value());
+            m_attributes.invalidate(i.key());
+
+            if (library.m_histories.contains(i.key())) {
+                m_histories.insert(i.key(), library.m_histories.value(i.key()));
+            }
+        }
+    }
+}
+
+
+/**
+ * Get the flattened path of a symbol.
+ * The path of the symbol has the flattened paths of its components added with their transforms
+ * applied. The result is cached until the symbol or one of its components changes. Components that
+ * are already being flattened would cause a cycle and are ignored.
+ *
+ * @param index the index of the symbol
+ * @param visiting a reference to a QSet of the indexes of the symbols being flattened
+ *
+ * @return a QPainterPath
+ */
+QPainterPath SymbolLibrary::flattenedPath(qint16 index, QSet<qint16> &visiting)
+{
+    if (m_flattenedPaths.contains(index)) {
+        return m_flattenedPaths.value(index);
+    }
+
+    if (visiting.contains(index)) {
+        return QPainterPath();
+    }
+
+    visiting.insert(index);
+
+    Symbol symbol = this->symbol(index);
+    QPainterPath path = symbol.path();
+
+    foreach (const SymbolComponent &component, symbol.components()) {
+        path.addPath(component.transform.map(flattenedPath(component.index, visiting)));
+    }
+
+    visiting.remove(index);
+
+    if (m_symbols.contains(index)) {
+        m_flattenedPaths.insert(index, path);
+    }
+
+    return path;
+}
+
+
+/**
+ * Add a symbol to the dependency graph of the components it uses.
+ *
+ * @param index the index of the symbol
+ * @param symbol a const reference to the Symbol
+ */
+void SymbolLibrary::addDependencies(qint16 index, const Symbol &symbol)
+{
+    foreach (const SymbolComponent &component, symbol.components()) {
+        m_dependents.insert(component.index, index);
+    }
+}
+
+
+/**
+ * Remove a symbol from the dependency graph of the components it uses.
+ *
+ * @param index the index of the symbol
+ * @param symbol a const reference to the Symbol
+ */
+void SymbolLibrary::removeDependencies(qint16 index, const Symbol &symbol)
+{
+    foreach (const SymbolComponent &component, symbol.components()) {
+        m_dependents.remove(component.index, index);
+    }
+}
+
+
+/**
+ * Discard the flattened paths of a symbol and of all the symbols depending on it.
+ * The icons of the dependent symbols are marked to be updated, the icon of the symbol itself
+ * is updated by the caller.
+ *
+ * @param index the index of the changed symbol
+ */
+void SymbolLibrary::invalidate(qint16 index)
+{
+    QList<qint16> pending;
+    QSet<qint16> visited;
+    pending.append(index);
+
+    while (!pending.isEmpty()) {
+        qint16 i = pending.takeLast();
+
+        if (visited.contains(i)) {
+            continue;
+        }
+
+        visited.insert(i);
+        m_flattenedPaths.remove(i);
+        m_attributes.invalidate(i);
+
+        if (i != index && m_listWidget) {
+            m_listWidget->invalidateIcon(i);
+        }
+
+        pending.append(m_dependents.values(i));
+    }
+}
+
+
+/**
+ * Check that the order read from a file holds each of the indexes in the library once.
+ * An order that does not is discarded so that the symbols are shown in index order.
+ */
+void SymbolLibrary::validateOrder()
+{
+    QList<qint16> sorted = m_order;
+    std::sort(sorted.begin(), sorted.end());
+
+    if (sorted != indexes()) {
+        m_order.clear();
+    }
+}
+
+
+/**
+ * Get the shard that a new symbol should be added to.
+ * This is the last shard unless it is full or could not be read, in which case a new shard is created
+ * that is named after the manifest. A new shard has nothing to read and is marked as changed so that
+ * it will be written.
+ *
+ * @return the index of the shard in m_shards
+ */
+int SymbolLibrary::shardForNewSymbol()
+{
+    if (m_shards.isEmpty() || m_shards.last().count >= shardSize || !m_shards.last().error.isEmpty()) {
+        QString baseName = QFileInfo(m_collectionFileName).completeBaseName();
+        QStringList fileNames;
+
+        foreach (const Shard &shard, m_shards) {
+            fileNames.append(shard.fileName);
+        }
+
+        int number = m_shards.count();
+        QString fileName;
+
+        do {
+            fileName = QStringLiteral("%1-%2.sym").arg(baseName).arg(++number, 4, 10, QLatin1Char('0'));
+        } while (fileNames.contains(fileName));
+
+        Shard shard;
+        shard.fileName = fileName;
+        shard.count = 0;
+        shard.loaded = true;
+        shard.dirty = true;
+        m_shards.append(shard);
+    }
+
+    return m_shards.count() - 1;
+}
+
+
+/**
+ * Generate all the items in the library.
+ * This will be called when a library file is loaded to generate all the new
+ * QListWidgetItems for the symbols in the library and generate an icon for it.
+ * A list of sorted QMap keys is retrieved to allow adding items in the correct
+ * order.
+ */
+void SymbolLibrary::generateItems()
+{
+    if (!m_listWidget) {
+        return;
+    }
+
+    m_listWidget->loadFromLibrary(this);
+}
+
+
+/**
+ * Get the default library built into the application.
+ * The library is read from the application resources the first time it is required and kept for
+ * the life of the application. Failure to read the resource is reported and an empty library is
+ * returned.
+ *
+ * @return a const reference to the decoded default SymbolLibrary
+ */
+const SymbolLibrary &SymbolLibrary::defaultLibrary()
+{
+    static const SymbolLibrary *library = [] {
+        SymbolLibrary *decoded = new SymbolLibrary;
+        QFile file(QStringLiteral(":/libraries/kxstitch.sym"));
+
+        if (file.open(QIODevice::ReadOnly)) {
+            QDataStream stream(&file);
+
+            try {
+                stream >> *decoded;
+            } catch (const InvalidFile &e) {
+                qWarning("The default library is not a valid symbol file");
+            } catch (const InvalidFileVersion &e) {
+                qWarning("Version %d of the default library is not supported", e.version);
+            } catch (const InvalidSymbolVersion &e) {
+                qWarning("Version %d of a symbol in the default library is not supported", e.version);
+            } catch (const FailedReadLibrary &e) {
+                qWarning("Failed to read the default library: %s", qPrintable(e.statusMessage()));
+                decoded->clear();
+            }
+        } else {
+            qWarning("Failed to open the default library: %s", qPrintable(file.errorString()));
+        }
+
+        return decoded;
+    }();
+
+    return *library;
+}
+
+
+/**
+ * Write a map of symbols in the library file format.
+ * This is used to write library files and the shards of a collection. The next index is written
+ * rather than one more than the highest index in the map, so that the indexes of symbols removed
+ * from the end of the library are not used again after the library is read.
+ * The oldest version of the file able to hold the symbols is written, so that libraries not using
+ * components, a custom order or revision histories can still be read by applications that only
+ * support version 101, such as KXStitch. Version 102 is written when a symbol has components,
+ * version 103 when the symbols have a custom order and version 104 when there are histories.
+ *
+ * @param stream a reference to a QDataStream
+ * @param nextIndex the index the next symbol added to the library will be given
+ * @param symbols a const reference to the QMap of indexes to Symbols to write
+ * @param order a const reference to a QList of the indexes in the order they are shown, empty for index order
+ * @param histories a const reference to a QMap of indexes to SymbolHistory, only those of the symbols written are included
+ */
+void SymbolLibrary::writeSymbols(QDataStream &stream, qint16 nextIndex, const QMap<qint16, Symbol> &symbols, const QList<qint16> &order, const QMap<qint16, SymbolHistory> &histories)
+{
+    QMap<qint16, SymbolHistory> symbolHistories;
+
+    for (QMap<qint16, SymbolHistory>::const_iterator h = histories.constBegin() ; h != histories.constEnd() ; ++h) {
+        if (symbols.contains(h.key())) {
+            symbolHistories.insert(h.key(), h.value());
+        }
+    }
+
+    qint32 fileVersion = 101;
+
+    if (!symbolHistories.isEmpty()) {
+        fileVersion = version;
+    } else if (!order.isEmpty()) {
+        fileVersion = 103;
+    } else {
+        for (QMap<qint16, Symbol>::const_iterator i = symbols.constBegin() ; i != symbols.constEnd() ; ++i) {
+            if (!i.value().components().isEmpty()) {
+                fileVersion = 102;
+                break;
+            }
+        }
+    }
+
+    stream.writeRawData("KXStitchSymbols", 15);
+    stream.setVersion(QDataStream::Qt_4_0);
+    stream << fileVersion;
+    stream << nextIndex;
+
+    if (stream.status() != QDataStream::Ok) {
+        throw FailedWriteLibrary(stream.status());
+    }
+
+    stream << symbols;
+
+    if (fileVersion >= 103) {
+        stream << order;
+    }
+
+    if (fileVersion >= 104) {
+        stream << symbolHistories;
+    }
+}
+
+
+/**
+ * Stream out the file.
+ * Symbol files are indicated with a magic string of KXStitchSymbols. The stream version is set
+ * to maintain consistency with the streamed objects.
+ * Write the version, current index, the map of symbols, the order the symbols are shown in and the
+ * histories of the symbols.
+ * For a collection, SymbolLibrary::loadAllShards() should be called first so that all the symbols
+ * are written.
+ *
+ * @param stream a reference to a QDataStream
+ * @param library a const reference to a SymbolLibrary
+ *
+ * @return a reference to a QDataStream
+ */
+QDataStream &operator<<(QDataStream &stream, const SymbolLibrary &library)
+{
+    SymbolLibrary::writeSymbols(stream, library.m_nextIndex, library.m_symbols, library.m_order, library.m_histories);
+    return stream;
+}
+
+
+/**
+ * Stream in the file.
+ * Initially clear the current contents.
+ * Symbol files are indicated with a magic string of KXStitchSymbols. The stream version is set
+ * to maintain consistency with the streamed objects. Read and check the magic string. If this
+ * is not a symbol file throw an exception.
+ * Read in the version.
+ * Read the data for the specified version. The stream is checked for errors and an exception is
+ * thrown if there was an error.
+ *
+ * @param stream a reference to a QDataStream
+ * @param library a reference to a SymbolLibrary
+ *
+ * @return a reference to a QDataStream
+ */
+QDataStream &operator>>(QDataStream &stream, SymbolLibrary &library)
+{
+    PROFILE_COUNT(LibraryLoads);
+    PROFILE_TIMER(LibraryLoads);
+
+    library.clear();
+
+    char magic[15];
+    stream.readRawData(magic, 15);
+
+    if (strncmp(magic, "KXStitchSymbols", 15) == 0) {
+        stream.setVersion(QDataStream::Qt_4_0);
+        qint32 version;
+        QMap<qint16, QPainterPath> paths_v100;
+        QList<qint16> paths_v100_keys;
+        stream >> version;
+
+        switch (version) {
+        case 104:
+        case 103:
+        case 102:
+        case 101:
+            stream >> library.m_nextIndex;
+
+            if (stream.status() != QDataStream::Ok) {
+                throw FailedReadLibrary(stream.status());
+            }
 
             stream >> library.m_symbols;
+
+            for (QMap<qint16, Symbol>::const_iterator i = library.m_symbols.constBegin() ; i != library.m_symbols.constEnd() ; ++i) {
+                library.addDependencies(i.key(), i.value());
+                library.m_attributes.invalidate(i.key());
+            }
+
+            if (version >= 103) {
+                stream >> library.m_order;
+                library.validateOrder();
+            }
+
+            if (version >= 104) {
+                stream >> library.m_histories;
+            }
+
+            if (stream.status() != QDataStream::Ok) {
+                throw FailedReadLibrary(stream.status());
+            }
+
             library.generateItems();
             break;
 
@@ -327,6 +1646,7 @@ QDataStream &operator>>(QDataStream &stream, SymbolLibrary &library)
                 Symbol symbol;
                 symbol.setPath(paths_v100[index]);
                 library.m_symbols.insert(index, symbol);
+                library.m_attributes.invalidate(index);
             }
 
             library.generateItems();
@@ -20,16 +20,23 @@
 
 
 #include <QMap>
+#include <QMultiMap>
+#include <QSet>
 #include <QPainterPath>
+#include <QStringList>
 #include <QUndoStack>
 
 #include "Symbol.h"
+#include "SymbolAttributes.h"
+#include "SymbolHistory.h"
 
 
 class QDataStream;
 class QListWidgetItem;
 
+class LibraryMerge;
 class SymbolListWidget;
+class SymbolQuery;
 
 
 /**
@@ -40,33 +47,128 @@ class SymbolListWidget;
  * When a SymbolListWidget is assigned to the SymbolLibrary each of the symbols is added to
  * the SymbolListWidget which will create a QListWidgetItem which is assigned the QIcon that
  * is generated from the QPainterPath associated with the index.
+ *
+ * A library can also be a collection, where a manifest file lists a number of shard files that
+ * are each a normal library file. The manifest holds the indexes of the symbols in each shard so
+ * the shards are only read when one of their symbols is required, and only the shards that have
+ * changed are written when the collection is saved.
+ *
+ * The symbols are shown in the order of their indexes until they are reordered, the library then holds
+ * a permutation of the indexes giving the order they are shown in. Moving symbols only changes this
+ * permutation, the symbols themselves are unchanged, and it is saved with the library.
+ *
+ * The library keeps a SymbolAttributes table of the symbols that can be searched with a SymbolQuery.
+ * The rows of the symbols changed by the undo commands, and of those depending on them, are marked
+ * as stale and only these are updated before the next query.
+ *
+ * The library also keeps a SymbolHistory of each symbol that has been replaced by the UpdateSymbolCommand
+ * holding its earlier revisions, which is saved with the symbols from version 104 of the library file.
+ *
+ * The symbols as they were last read from or written to the library file are kept as the base of a
+ * LibraryMerge, so that changes made to the file by another application can be merged before it is
+ * overwritten. The base shares its data with the symbols until they are changed.
  */
 class SymbolLibrary
 {
 public:
+    /**
+     * @brief The data needed to hash the flattened symbols of a library away from the library.
+     */
+    class HashSource
+    {
+    public:
+        QSet<QByteArray>                hashes;     /**< hashes of the attribute rows that are up to date */
+        QMap<qint16, Symbol>            symbols;    /**< the symbols read into the library */
+        QList<qint16>                   stale;      /**< indexes of the symbols whose rows are stale */
+        QMap<QString, QList<qint16> >   shards;     /**< map of the paths of the unread shards to the indexes they hold */
+    };
+
     explicit SymbolLibrary(SymbolListWidget *listWidget = nullptr);
     ~SymbolLibrary();
 
     void clear();
+    void loadDefault();
 
     Symbol symbol(qint16 index);
+    Symbol flattenedSymbol(qint16 index);
+    QPainterPath componentsPath(const Symbol &symbol);
+    bool dependsOn(qint16 index, qint16 component);
     Symbol takeSymbol(qint16 index);
     qint16 setSymbol(qint16 index, const Symbol &symbol);
+    QList<qint16> addSymbols(const QList<Symbol> &symbols);
+    void takeSymbols(const QList<qint16> &indexes);
 
     QString name() const;
     void setName(const QString &name);
 
+    qint16 nextIndex() const;
+
+    bool contains(qint16 index) const;
     QList<qint16> indexes() const;
+    QList<qint16> displayOrder() const;
+    QList<qint16> orderedIndexes() const;
+    void moveSymbols(const QList<qint16> &indexes, qint16 before);
+    void setDisplayOrder(const QList<qint16> &order, const QList<qint16> &indexes);
+
+    QList<qint16> query(const SymbolQuery &query);
+    HashSource hashSource() const;
+
+    SymbolHistory history(qint16 index);
+    void addRevision(qint16 index, const Symbol &symbol);
+    void removeRevision(qint16 index);
+    void setHistory(qint16 index, const SymbolHistory &history);
+
+    void setBaseSymbols();
+    LibraryMerge merge(const SymbolLibrary &theirs) const;
 
     QUndoStack *undoStack();
 
+    bool isCollection() const;
+    QString collectionFileName() const;
+    void openCollection(const QString &fileName);
+    void saveCollection(const QString &fileName);
+    void loadAllShards();
+    QStringList shardErrors() const;
+    void checkShards(bool all) const;
+
+    static bool isCollectionFile(const QString &fileName);
+    static QList<Symbol> readFlattenedSymbols(const QString &fileName);
+    static QSet<QByteArray> flattenedHashes(const HashSource &source);
+
     friend QDataStream &operator<<(QDataStream &stream, const SymbolLibrary &library);
     friend QDataStream &operator>>(QDataStream &stream, SymbolLibrary &library);
 
 private:
-    void generateItems();
+    /**
+     * @brief One of the library files making up a collection.
+     */
+    class Shard
+    {
+    public:
+        QString fileName;                           /**< name of the shard file relative to the manifest */
+        int     count;                              /**< number of symbols in the shard */
+        bool    loaded;                             /**< true if the symbols in the shard have been read */
+        bool    dirty;                              /**< true if the shard has changed since it was read or written */
+        QString error;                              /**< description of the error if the shard could not be read, its symbols are then missing */
+    };
 
-    static const qint32 version = 101;              /**< stream version of this file */
+    void generateItems();
+    Symbol removeSymbol(qint16 index);
+    void updateAttributes();
+    void loadShard(int shard);
+    QPainterPath flattenedPath(qint16 index, QSet<qint16> &visiting);
+    void addDependencies(qint16 index, const Symbol &symbol);
+    void removeDependencies(qint16 index, const Symbol &symbol);
+    void invalidate(qint16 index);
+    void validateOrder();
+    int shardForNewSymbol();
+
+    static void writeSymbols(QDataStream &stream, qint16 nextIndex, const QMap<qint16, Symbol> &symbols, const QList<qint16> &order, const QMap<qint16, SymbolHistory> &histories);
+    static const SymbolLibrary &defaultLibrary();
+
+    static const qint32 version = 104;              /**< latest stream version of this file, older versions are written when they can hold the symbols */
+    static const qint32 collectionVersion = 101;    /**< stream version of the collection manifest */
+    static const int shardSize = 256;               /**< number of symbols in each new shard of a collection */
 
     QUndoStack m_undoStack;                         /**< holds the commands that have made changes to this library */
 
@@ -75,7 +177,17 @@ private:
     SymbolListWidget *m_listWidget;                 /**< pointer to a QListWidget containing the QListWidgetItems for the QIcons, this may be null for an imported file */
 
     qint16                          m_nextIndex;    /**< index for the next symbol added */
-    QMap<qint16, Symbol>            m_symbols;      /**< map of the Symbol to indexes */
+    QMap<qint16, Symbol>            m_symbols;      /**< map of the Symbol to indexes, for a collection only the loaded shards are included */
+    QMap<qint16, QPainterPath>      m_flattenedPaths;       /**< cache of the flattened paths of the symbols, see flattenedPath() */
+    QMultiMap<qint16, qint16>       m_dependents;           /**< map of the component indexes to the indexes of the symbols using them */
+    QList<qint16>                   m_order;                /**< indexes of all the symbols in the order they are shown, empty if they are shown in index order */
+    SymbolAttributes                m_attributes;           /**< table of the attributes of the flattened symbols for queries */
+    QMap<qint16, SymbolHistory>     m_histories;            /**< map of the indexes to the earlier revisions of the symbols */
+    QMap<qint16, Symbol>            m_baseSymbols;          /**< the symbols as they were last read from or written to the file */
+
+    QString                         m_collectionFileName;   /**< absolute path of the collection manifest, empty if this is not a collection */
+    QList<Shard>                    m_shards;               /**< the shards of the collection */
+    QMap<qint16, int>               m_shardIndexes;         /**< map of the indexes of all the symbols in the collection to their shard */
 };
 
 
@@ -22,6 +22,19 @@
  * with a data item representing the Symbol identifier in the library and an icon at a given size that
  * is generated from the Symbol path.
  *
+ * The icons are only created for the items that are visible, the remaining items are given their icons
+ * as they are scrolled into view. This keeps opening large libraries fast and allows the shards of a
+ * library collection to be read only when their symbols are shown. The items scrolled into view are first
+ * given draft icons, rendered with fewer samples, and the draft icons still visible when the scrolling
+ * stops are refined. The refined icons are cached by the content of their symbols, so scrolling back to
+ * them does not render them again. The cache is limited by the memory used by the icons rather than
+ * their number, so it holds fewer icons when they are large.
+ *
+ * Symbols dragged within the widget are moved rather than copied. The move is made with a command on the
+ * undo stack of the library, which changes the display order of the library and moves the existing items,
+ * so their icons are kept. Symbols dropped from another instance of the SymbolEditor on the same machine
+ * are passed through shared memory, see @ref symbol_mime_data.
+ *
  * The widget is intended to be used in a dialog or main window and allows selection of a symbol to be
  * used for some purpose in the application.
  *
@@ -32,15 +45,23 @@
 #include "SymbolListWidget.h"
 
 #include <QApplication>
-#include <QIODevice>
+#include <QDropEvent>
 #include <QMimeData>
-#include <QPainter>
 #include <QPalette>
-#include <QPen>
+#include <QPixmap>
+
+#include <algorithm>
+#include <functional>
 
 #include "Commands.h"
+#include "CoverageRasterizer.h"
+#include "Exceptions.h"
+#include "LatencyHistograms.h"
+#include "Profiling.h"
 #include "Symbol.h"
 #include "SymbolLibrary.h"
+#include "SymbolMimeData.h"
+#include "TaskScheduler.h"
 
 
 /**
@@ -49,10 +70,22 @@
 SymbolListWidget::SymbolListWidget(QWidget *parent)
     :   QListWidget(parent),
         m_library(nullptr),
-        m_lastIndex(0)
+        m_filtered(false)
 {
     setResizeMode(QListView::Adjust);
     setViewMode(QListView::IconMode);
+    setDefaultDropAction(Qt::CopyAction);
+
+    m_iconTimer.setSingleShot(true);
+    m_iconTimer.setInterval(0);
+    connect(&m_iconTimer, SIGNAL(timeout()), this, SLOT(updateVisibleIcons()));
+
+    m_refineTimer.setSingleShot(true);
+    m_refineTimer.setInterval(refineDelay);
+    connect(&m_refineTimer, SIGNAL(timeout()), this, SLOT(refineVisibleIcons()));
+
+    m_refinedIcons.setMaxCost(refinedIconsBytes);
+
     setIconSize(48);
 }
 
@@ -75,7 +108,8 @@ void SymbolListWidget::setIconSize(int size)
 
 /**
  * Populate the QListWidget with the QListWidgetItems for each Symbol in the SymbolLibrary.
- * An icon is created for each Symbol.
+ * The items are created in the display order of the library and the icons are created when
+ * the items are shown.
  *
  * @param library a pointer to the SymbolLibrary containing the Symbols
  */
@@ -87,9 +121,12 @@ void SymbolListWidget::loadFromLibrary(SymbolLibrary *library)
 
     m_library = library;
 
-    foreach (qint16 index, library->indexes()) {
-        addSymbol(index, library->symbol(index));
+    foreach (qint16 index, library->orderedIndexes()) {
+        createItem(index, true);
+        m_pendingIcons.insert(index);
     }
+
+    m_iconTimer.start();
 }
 
 
@@ -103,6 +140,53 @@ void SymbolListWidget::addSymbol(qint16 index, const Symbol &symbol)
 {
     QListWidgetItem *item = createItem(index);
     item->setIcon(createIcon(symbol, m_size));
+    m_pendingIcons.remove(index);
+    m_draftIcons.remove(index);
+    endIconRequest(index);
+}
+
+
+/**
+ * Add the items for a number of Symbols to the view.
+ * The view is not updated until all the items have been added and the icons are created
+ * when the items are shown. With a display order the positions of the symbols are found once
+ * and the items are created from the last in the order, so each is inserted before an item
+ * that already exists.
+ *
+ * @param indexes a const reference to a QList of the indexes of the Symbols
+ */
+void SymbolListWidget::addSymbols(const QList<qint16> &indexes)
+{
+    QList<qint16> order = (m_library ? m_library->displayOrder() : QList<qint16>());
+    QHash<qint16, int> positions;
+    QList<qint16> added = indexes;
+
+    if (!order.isEmpty()) {
+        // create the items from the last in the display order, so the item each one is inserted before already exists
+        positions.reserve(order.count());
+
+        for (int i = 0 ; i < order.count() ; ++i) {
+            positions.insert(order.at(i), i);
+        }
+
+        std::sort(added.begin(), added.end(), [&positions](qint16 a, qint16 b) {
+            return positions.value(a, -1) > positions.value(b, -1);
+        });
+    }
+
+    setUpdatesEnabled(false);
+
+    foreach (qint16 index, added) {
+        if (!m_items.contains(index)) {
+            insertItemBefore(index, order.isEmpty() ? followingItem(index) : followingItem(order, positions.value(index, -1)));
+        }
+
+        m_pendingIcons.insert(index);
+        endIconRequest(index);
+    }
+
+    setUpdatesEnabled(true);
+    m_iconTimer.start();
 }
 
 
@@ -116,7 +200,194 @@ void SymbolListWidget::removeSymbol(qint16 index)
     if (m_items.contains(index)) {
         removeItemWidget(m_items.value(index));
         delete m_items.take(index);
+        m_pendingIcons.remove(index);
+        m_draftIcons.remove(index);
+        endIconRequest(index);
+    }
+}
+
+
+/**
+ * Remove the items for a number of symbols from the view.
+ * The view is not updated until all the items have been removed.
+ *
+ * @param indexes a const reference to a QList of the indexes of the items to remove
+ */
+void SymbolListWidget::removeSymbols(const QList<qint16> &indexes)
+{
+    setUpdatesEnabled(false);
+
+    foreach (qint16 index, indexes) {
+        removeSymbol(index);
+    }
+
+    setUpdatesEnabled(true);
+}
+
+
+/**
+ * Move the items for a number of symbols to a new position.
+ * The items are taken from the view and inserted together before the item of another symbol, keeping
+ * their icons. The items moved are selected.
+ *
+ * @param indexes a const reference to a QList of the indexes of the items to move
+ * @param before the index of the item to insert them before, if there is no item for the index they are
+ * moved to the end
+ */
+void SymbolListWidget::moveSymbols(const QList<qint16> &indexes, qint16 before)
+{
+    QListWidgetItem *following = m_items.value(before);
+    QList<QListWidgetItem *> items;
+    QList<int> rows;
+
+    foreach (qint16 index, indexes) {
+        QListWidgetItem *item = m_items.value(index);
+
+        if (item && item != following) {
+            items.append(item);
+            rows.append(row(item));
+        }
+    }
+
+    // take the items from the highest row down so the rows of the others are unchanged
+    std::sort(rows.begin(), rows.end(), std::greater<int>());
+
+    setUpdatesEnabled(false);
+    clearSelection();
+
+    foreach (int r, rows) {
+        takeItem(r);
+    }
+
+    int position = (following ? row(following) : count());
+
+    foreach (QListWidgetItem *item, items) {
+        insertItem(position++, item);
+        item->setSelected(true);
     }
+
+    setUpdatesEnabled(true);
+    m_iconTimer.start();
+}
+
+
+/**
+ * Return the items for a number of moved symbols to their rows.
+ * The items are taken from the view and inserted at their rows in increasing order, so the rows
+ * before each are already in place when it is inserted. The items moved are selected.
+ *
+ * @param rows a const reference to a QMap of the rows to the indexes of the items to place in them
+ */
+void SymbolListWidget::restoreSymbols(const QMap<int, qint16> &rows)
+{
+    QList<int> taken;
+
+    foreach (qint16 index, rows) {
+        if (m_items.contains(index)) {
+            taken.append(row(m_items.value(index)));
+        }
+    }
+
+    // take the items from the highest row down so the rows of the others are unchanged
+    std::sort(taken.begin(), taken.end(), std::greater<int>());
+
+    setUpdatesEnabled(false);
+    clearSelection();
+
+    foreach (int r, taken) {
+        takeItem(r);
+    }
+
+    for (QMap<int, qint16>::const_iterator i = rows.constBegin() ; i != rows.constEnd() ; ++i) {
+        QListWidgetItem *item = m_items.value(i.value());
+
+        if (item) {
+            insertItem(std::min(i.key(), count()), item);
+            item->setSelected(true);
+        }
+    }
+
+    setUpdatesEnabled(true);
+    m_iconTimer.start();
+}
+
+
+/**
+ * Mark the icon of a symbol to be created again.
+ * This is used when a component of the symbol has changed, the icon is updated when it is visible.
+ *
+ * @param index the index of the item to update
+ */
+void SymbolListWidget::invalidateIcon(qint16 index)
+{
+    if (m_items.contains(index)) {
+        m_pendingIcons.insert(index);
+        m_iconTimer.start();
+    }
+}
+
+
+/**
+ * Make the item for a symbol the current item and scroll the view to show it.
+ *
+ * @param index the index of the Symbol to select
+ */
+void SymbolListWidget::selectSymbol(qint16 index)
+{
+    if (m_items.contains(index)) {
+        QListWidgetItem *item = m_items.value(index);
+        setCurrentItem(item);
+        scrollToItem(item);
+    }
+}
+
+
+/**
+ * Show only the items for a set of symbols.
+ * The other items are hidden until the filter is changed or cleared.
+ *
+ * @param indexes a const reference to a QList of the indexes of the symbols to show
+ */
+void SymbolListWidget::filterSymbols(const QList<qint16> &indexes)
+{
+    QSet<qint16> shown(indexes.constBegin(), indexes.constEnd());
+
+    setUpdatesEnabled(false);
+
+    for (QMap<qint16, QListWidgetItem *>::const_iterator i = m_items.constBegin() ; i != m_items.constEnd() ; ++i) {
+        bool hidden = !shown.contains(i.key());
+
+        if (i.value()->isHidden() != hidden) {
+            i.value()->setHidden(hidden);
+        }
+    }
+
+    setUpdatesEnabled(true);
+    m_filtered = true;
+    m_iconTimer.start();
+}
+
+
+/**
+ * Show all the items hidden by filterSymbols().
+ */
+void SymbolListWidget::clearFilter()
+{
+    if (!m_filtered) {
+        return;
+    }
+
+    m_filtered = false;
+    setUpdatesEnabled(false);
+
+    foreach (QListWidgetItem *item, m_items) {
+        if (item->isHidden()) {
+            item->setHidden(false);
+        }
+    }
+
+    setUpdatesEnabled(true);
+    m_iconTimer.start();
 }
 
 
@@ -124,41 +395,95 @@ void SymbolListWidget::removeSymbol(qint16 index)
  * If an item for the index currently exists return it otherwise create
  * an item to be inserted into the QListWidget.
  * The item created has a data entry added representing the index.
- * The items are inserted so that the Symbols are sorted by their index.
+ * The items are inserted so that the Symbols are sorted by their index, or
+ * by the display order of the library if it has been reordered.
  *
  * @param index an index in the SymbolLibrary
+ * @param append true if the items are being created in order so a new item is added at the end
  *
  * @return a pointer to the QListWidgetItem created
  */
-QListWidgetItem *SymbolListWidget::createItem(qint16 index)
+QListWidgetItem *SymbolListWidget::createItem(qint16 index, bool append)
 {
     if (m_items.contains(index)) {
         return m_items.value(index);
     }
 
+    return insertItemBefore(index, append ? nullptr : followingItem(index));
+}
+
+
+/**
+ * Create the item for an index and insert it into the QListWidget.
+ * The item created has a data entry added representing the index.
+ *
+ * @param index an index in the SymbolLibrary that has no item
+ * @param following a pointer to the QListWidgetItem to insert the item before, null to add it at the end
+ *
+ * @return a pointer to the QListWidgetItem created
+ */
+QListWidgetItem *SymbolListWidget::insertItemBefore(qint16 index, QListWidgetItem *following)
+{
     QListWidgetItem *item = new QListWidgetItem;
     item->setData(Qt::UserRole, index);
     m_items.insert(index, item);
-    int i = index;
-
-    while (++i < m_lastIndex)
-        if (m_items.contains(i)) {
-            break;
-        }
 
-    if (i >= m_lastIndex) {
-        addItem(item);
-        m_lastIndex = index;
+    if (following) {
+        insertItem(row(following), item);
     } else {
-        insertItem(row(m_items[i]), item);
+        addItem(item);
     }
 
     return item;
 }
 
 
+/**
+ * Find the existing item that the item for an index should be inserted before.
+ * Without a display order this is the item with the next higher index. With a display order
+ * it is the first item following the index in the order, the search starting from the end of
+ * the order as new symbols are added there.
+ *
+ * @param index an index in the SymbolLibrary
+ *
+ * @return a pointer to the QListWidgetItem, null if the item should be added at the end
+ */
+QListWidgetItem *SymbolListWidget::followingItem(qint16 index) const
+{
+    QList<qint16> order = (m_library ? m_library->displayOrder() : QList<qint16>());
+
+    if (order.isEmpty()) {
+        QMap<qint16, QListWidgetItem *>::const_iterator i = m_items.upperBound(index);
+        return (i == m_items.constEnd()) ? nullptr : i.value();
+    }
+
+    return followingItem(order, order.lastIndexOf(index));
+}
+
+
+/**
+ * Find the first existing item following a position in the display order.
+ *
+ * @param order a const reference to the display order of the library
+ * @param position the position in the order, -1 if the index is not in the order
+ *
+ * @return a pointer to the QListWidgetItem, null if the item should be added at the end
+ */
+QListWidgetItem *SymbolListWidget::followingItem(const QList<qint16> &order, int position) const
+{
+    for (int i = position + 1 ; i > 0 && i < order.count() ; ++i) {
+        if (m_items.contains(order.at(i))) {
+            return m_items.value(order.at(i));
+        }
+    }
+
+    return nullptr;
+}
+
+
 /**
  * Create a QIcon for the supplied Symbol.
+ * The symbol is drawn in the palette text color using the CoverageRasterizer.
  *
  * @param symbol a const reference to a Symbol
  * @param size a size for the icon
@@ -169,25 +494,27 @@ QIcon SymbolListWidget::createIcon(const Symbol &symbol, int size)
 {
     QPalette pal = QApplication::palette();
 
-    QPixmap icon(size, size);
-    icon.fill(Qt::transparent);
-
-    QPainter p(&icon);
-    p.setRenderHint(QPainter::Antialiasing, true);
-    p.scale(size, size);
-
-    QBrush brush = symbol.brush();
-    QPen pen = symbol.pen();
+    return QIcon(QPixmap::fromImage(iconImage(symbol, size, pal.color(QPalette::WindowText))));
+}
 
-    brush.setColor(pal.color(QPalette::WindowText));
-    pen.setColor(pal.color(QPalette::WindowText));
 
-    p.setBrush(brush);
-    p.setPen(pen);
-    p.drawPath(symbol.path());
-    p.end();
+/**
+ * Render the image for an icon.
+ * This is safe to call from worker threads.
+ *
+ * @param symbol a const reference to a Symbol
+ * @param size a size for the icon
+ * @param color the color to draw the symbol in
+ * @param quality the CoverageRasterizer::Quality of the image
+ *
+ * @return a QImage in QImage::Format_ARGB32_Premultiplied
+ */
+QImage SymbolListWidget::iconImage(const Symbol &symbol, int size, const QColor &color, CoverageRasterizer::Quality quality)
+{
+    PROFILE_COUNT(IconsRasterized);
+    PROFILE_TIMER(IconsRasterized);
 
-    return QIcon(icon);
+    return CoverageRasterizer::colorized(CoverageRasterizer::coverage(symbol, size, quality), color);
 }
 
 
@@ -204,14 +531,22 @@ QStringList SymbolListWidget::mimeTypes() const
 }
 
 
+/**
+ * Get the drop actions supported by the view.
+ * Symbols are copied from other instances of the SymbolEditor and moved within the view.
+ *
+ * @return the Qt::DropActions supported
+ */
 Qt::DropActions SymbolListWidget::supportedDropActions() const
 {
-    return Qt::CopyAction;
+    return Qt::CopyAction | Qt::MoveAction;
 }
 
 
 /**
  * Called when dragging items from one QListWidget to another to provide the serialised data.
+ * The symbols are flattened as their components will not be available in the other library. They
+ * are only encoded if the items are dropped somewhere that asks for them, see @ref symbol_mime_data.
  *
  * @param items a reference to a QList of pointers to the QListWidgetItems to provide data for
  *
@@ -219,42 +554,68 @@ Qt::DropActions SymbolListWidget::supportedDropActions() const
  */
 QMimeData *SymbolListWidget::mimeData(const QList<QListWidgetItem *> &items) const
 {
-    QMimeData *mimeData = new QMimeData;
-
-    QByteArray data;
-    QDataStream stream(&data, QIODevice::WriteOnly);
+    QList<Symbol> symbols;
 
     foreach (QListWidgetItem * item, items) {
         qint16 index = static_cast<qint16>(item->data(Qt::UserRole).toInt());
-        Symbol symbol = m_library->symbol(index);
-        stream << symbol;
+        symbols.append(m_library->flattenedSymbol(index));
     }
 
-    mimeData->setData(QStringLiteral("application/kxstitchsymbol"), data);
-    return mimeData;
+    return new SymbolMimeData(symbols);
 }
 
 
 /**
- * Called when QListWidgetItems are dragged from one QListWidget to another.
- *
- * @param index the position index of the dropped item
- * @param mimeData a pointer to the serialised data from the source
- * @param action the requested drop action, only copying will be implemented
+ * Called when QListWidgetItems are dropped on the view.
+ * Items dragged from this view are moved before the item they are dropped on, or to the end if
+ * they are dropped on an empty part of the view. Items dragged from another instance of the
+ * SymbolEditor are copied into the library. Both are done with commands on the library undo
+ * stack. The symbols copied are decoded before the command is created, a drop from another
+ * application that can't be decoded, or has no symbols, is ignored. The drop is otherwise always
+ * accepted as a copy so that the view the items were dragged from does not remove them itself.
  *
- * @return @c true if the action is handled, @c false otherwise
+ * @param e a pointer to the QDropEvent
  */
-bool SymbolListWidget::dropMimeData(int index, const QMimeData *mimeData, Qt::DropAction action)
+void SymbolListWidget::dropEvent(QDropEvent *e)
 {
-    Q_UNUSED(index);
-    Q_UNUSED(action);
+    if (m_library == nullptr || !e->mimeData()->hasFormat(QStringLiteral("application/kxstitchsymbol"))) {
+        e->ignore();
+        return;
+    }
+
+    if (e->source() == this) {
+        QListWidgetItem *target = itemAt(e->position().toPoint());
+        qint16 before = (target ? static_cast<qint16>(target->data(Qt::UserRole).toInt()) : 0);
+        QList<qint16> indexes;
+
+        foreach (QListWidgetItem *item, selectedItems()) {
+            indexes.append(static_cast<qint16>(item->data(Qt::UserRole).toInt()));
+        }
 
-    if (mimeData->hasFormat(QStringLiteral("application/kxstitchsymbol"))) {
-        m_library->undoStack()->push(new DragAndDropCommand(m_library, mimeData));
-        return true;
+        if (!indexes.isEmpty() && !indexes.contains(before)) {
+            m_library->undoStack()->push(new MoveSymbolsCommand(m_library, indexes, before));
+        }
+    } else {
+        QList<Symbol> symbols;
+
+        try {
+            symbols = SymbolMimeData::symbols(e->mimeData());
+        } catch (const InvalidSymbolVersion &error) {
+            qWarning("Ignored a drop with version %d of a symbol", error.version);
+        } catch (const FailedReadLibrary &error) {
+            qWarning("Ignored a drop that could not be read: %s", qPrintable(error.statusMessage()));
+        }
+
+        if (symbols.isEmpty()) {
+            e->ignore();
+            return;
+        }
+
+        m_library->undoStack()->push(new DragAndDropCommand(m_library, symbols));
     }
 
-    return false;
+    e->setDropAction(Qt::CopyAction);
+    e->accept();
 }
 
 
@@ -279,7 +640,51 @@ bool SymbolListWidget::event(QEvent *e)
 
 
 /**
- * Generate the icons for all the QListWidgetItems stored in m_items.
+ * Called when the view is scrolled, the icons for the items scrolled into view are created.
+ * The draft icons are not refined until the scrolling has stopped.
+ *
+ * @param dx the horizontal distance scrolled
+ * @param dy the vertical distance scrolled
+ */
+void SymbolListWidget::scrollContentsBy(int dx, int dy)
+{
+    QListWidget::scrollContentsBy(dx, dy);
+    m_iconTimer.start();
+
+    if (!m_draftIcons.isEmpty()) {
+        m_refineTimer.start();
+    }
+}
+
+
+/**
+ * Called when the view is resized, the icons for the items that become visible are created.
+ *
+ * @param e a pointer to the QResizeEvent
+ */
+void SymbolListWidget::resizeEvent(QResizeEvent *e)
+{
+    QListWidget::resizeEvent(e);
+    m_iconTimer.start();
+}
+
+
+/**
+ * Called when the view is shown, the icons for the visible items are created.
+ *
+ * @param e a pointer to the QShowEvent
+ */
+void SymbolListWidget::showEvent(QShowEvent *e)
+{
+    QListWidget::showEvent(e);
+    m_iconTimer.start();
+}
+
+
+/**
+ * Mark the icons for all the QListWidgetItems stored in m_items to be generated again.
+ * The icons for the visible items are generated immediately the event loop is entered,
+ * the others when they are shown.
  */
 void SymbolListWidget::updateIcons()
 {
@@ -287,6 +692,268 @@ void SymbolListWidget::updateIcons()
 
     while (i.hasNext()) {
         i.next();
-        i.value()->setIcon(createIcon(m_library->symbol(i.key()), m_size));
+        m_pendingIcons.insert(i.key());
     }
+
+    m_iconTimer.start();
 }
+
+
+/**
+ * Request the icons for the visible items that don't have one.
+ * The icons of the visible items are requested at the Interactive priority and the icons of the
+ * same number of items following them are prefetched. The requests for the items that have been
+ * scrolled out of view are cancelled, the items being requested again when they are shown.
+ *
+ * When latency is being recorded the visible items still waiting for their draft icons form the icon
+ * batch, which is timed from when the first of them was requested until the last icon is received,
+ * so the time recorded is the time the user waits for the view to be drawn. Items requested while a
+ * batch is outstanding join it. A batch that only needed cached icons is recorded immediately.
+ */
+void SymbolListWidget::updateVisibleIcons()
+{
+    if ((m_pendingIcons.isEmpty() && m_iconRequests.isEmpty()) || m_library == nullptr || !isVisible()) {
+        return;
+    }
+
+    bool timing = LatencyHistograms::isEnabled();
+    bool requested = false;
+
+    if (timing && m_iconBatch.isEmpty()) {
+        m_iconBatchTimer.start();
+    }
+
+    QPair<int, int> rows = visibleRows();
+    QRect visible = viewport()->rect();
+    int shown = 0;
+
+    for (int r = rows.first ; r < rows.second ; ++r) {
+        QListWidgetItem *listItem = item(r);
+
+        if (visualItemRect(listItem).intersects(visible)) {
+            qint16 index = static_cast<qint16>(listItem->data(Qt::UserRole).toInt());
+            requested = m_pendingIcons.contains(index) || requested;
+            requestIcon(listItem, TaskScheduler::Interactive);
+            ++shown;
+
+            if (timing && m_iconRequests.value(index).endsWith("/draft")) {
+                m_iconBatch.insert(index);
+            }
+        }
+    }
+
+    if (timing && requested && m_iconBatch.isEmpty()) {
+        LatencyHistograms::record(LatencyHistograms::IconBatch, m_iconBatchTimer.nsecsElapsed());
+    }
+
+    int end = rows.second;
+
+    for (int prefetch = 0 ; prefetch < shown && end < count() ; ++prefetch, ++end) {
+        requestIcon(item(end), TaskScheduler::Prefetch);
+    }
+
+    foreach (qint16 index, m_iconRequests.keys()) {
+        int r = row(m_items.value(index));
+
+        if (r >= rows.first && r < end) {
+            continue;
+        }
+
+        if (m_iconRequests.value(index).endsWith("/draft")) {
+            m_pendingIcons.insert(index);
+        } else {
+            m_draftIcons.insert(index);
+        }
+
+        endIconRequest(index);
+    }
+}
+
+
+/**
+ * Refine the draft icons of the visible items.
+ * This is called when the scrolling has stopped, the refined icons being rendered at the Prefetch
+ * priority so that the draft icons of any items scrolled into view are rendered first.
+ */
+void SymbolListWidget::refineVisibleIcons()
+{
+    if (m_draftIcons.isEmpty() || m_library == nullptr || !isVisible()) {
+        return;
+    }
+
+    QPair<int, int> rows = visibleRows();
+    QRect visible = viewport()->rect();
+
+    for (int r = rows.first ; r < rows.second ; ++r) {
+        QListWidgetItem *listItem = item(r);
+
+        if (visualItemRect(listItem).intersects(visible)) {
+            refineIcon(listItem);
+        }
+    }
+}
+
+
+/**
+ * Find the rows of the items that may be visible.
+ * The items are in the display order of the library and laid out in rows left to right and top to
+ * bottom, so whatever the order the search starts at the item in the top left corner of the
+ * viewport and stops at the first item below the viewport. Hidden items within the rows are not visible.
+ *
+ * @return a QPair of the first row and the row following the last
+ */
+QPair<int, int> SymbolListWidget::visibleRows()
+{
+    executeDelayedItemsLayout();
+
+    QRect visible = viewport()->rect();
+    QListWidgetItem *first = itemAt(visible.topLeft());
+    int begin = (first ? row(first) : 0);
+    int end = begin;
+
+    while (end < count() && visualItemRect(item(end)).top() <= visible.bottom()) {
+        ++end;
+    }
+
+    return QPair<int, int>(begin, end);
+}
+
+
+/**
+ * Get the key of the icon of a symbol.
+ * The key is made from the content hash of the symbol, the size and the color, so identical
+ * symbols share their icons.
+ *
+ * @param symbol a const reference to the flattened Symbol
+ *
+ * @return a QByteArray of the key
+ */
+QByteArray SymbolListWidget::iconKey(const Symbol &symbol) const
+{
+    QColor color = QApplication::palette().color(QPalette::WindowText);
+
+    return symbol.hash() + '/' + QByteArray::number(m_size) + '/' + QByteArray::number(color.rgba());
+}
+
+
+/**
+ * Request the icon for an item to be rendered in the background if it doesn't have one.
+ * If the refined icon is cached it is set immediately, otherwise a draft icon is rendered, the
+ * request being keyed by the icon key so identical symbols are only rendered once. The icon is
+ * set when the image is received unless the item has been removed or updated in the meantime.
+ *
+ * @param item a pointer to the QListWidgetItem
+ * @param priority the TaskScheduler::Priority of the request
+ */
+void SymbolListWidget::requestIcon(QListWidgetItem *item, TaskScheduler::Priority priority)
+{
+    qint16 index = static_cast<qint16>(item->data(Qt::UserRole).toInt());
+
+    if (!m_pendingIcons.remove(index)) {
+        return;
+    }
+
+    Symbol symbol = m_library->flattenedSymbol(index);
+    QByteArray key = iconKey(symbol);
+
+    if (QPixmap *pixmap = m_refinedIcons.object(key)) {
+        m_draftIcons.remove(index);
+        endIconRequest(index);
+        item->setIcon(QIcon(*pixmap));
+        return;
+    }
+
+    int size = m_size;
+    QColor color = QApplication::palette().color(QPalette::WindowText);
+    QByteArray draftKey = key + "/draft";
+
+    endIconRequest(index);
+    m_iconRequests.insert(index, draftKey);
+    m_iconTokens.insert(index, TaskScheduler::instance()->schedule<QImage>(priority, draftKey,
+        [symbol, size, color](const TaskToken &) {
+            return iconImage(symbol, size, color, CoverageRasterizer::Draft);
+        },
+        this,
+        [this, index, draftKey](const QImage &image) {
+            if (m_iconRequests.value(index) == draftKey) {
+                m_items.value(index)->setIcon(QIcon(QPixmap::fromImage(image)));
+                m_draftIcons.insert(index);
+                endIconRequest(index);
+
+                if (!m_refineTimer.isActive()) {
+                    m_refineTimer.start();
+                }
+            }
+        }));
+}
+
+
+/**
+ * Request the refined icon for an item showing a draft icon.
+ * If the refined icon is cached it is set immediately, otherwise the refined icon is added to the cache when it is received and set unless the item has been
+ * removed or updated in the meantime.
+ *
+ * @param item a pointer to the QListWidgetItem
+ */
+void SymbolListWidget::refineIcon(QListWidgetItem *item)
+{
+    qint16 index = static_cast<qint16>(item->data(Qt::UserRole).toInt());
+
+    if (m_pendingIcons.contains(index) || !m_draftIcons.remove(index)) {
+        return;
+    }
+
+    Symbol symbol = m_library->flattenedSymbol(index);
+    QByteArray key = iconKey(symbol);
+
+    if (QPixmap *pixmap = m_refinedIcons.object(key)) {
+        endIconRequest(index);
+        item->setIcon(QIcon(*pixmap));
+        return;
+    }
+
+    int size = m_size;
+    QColor color = QApplication::palette().color(QPalette::WindowText);
+
+    endIconRequest(index);
+    m_iconRequests.insert(index, key);
+    m_iconTokens.insert(index, TaskScheduler::instance()->schedule<QImage>(TaskScheduler::Prefetch, key,
+        [symbol, size, color](const TaskToken &) {
+            return iconImage(symbol, size, color);
+        },
+        this,
+        [this, index, key](const QImage &image) {
+            QPixmap pixmap = QPixmap::fromImage(image);
+            m_refinedIcons.insert(key, new QPixmap(pixmap), pixmap.width() * pixmap.height() * pixmap.depth() / 8);
+
+            if (m_iconRequests.value(index) == key) {
+                m_items.value(index)->setIcon(QIcon(pixmap));
+                endIconRequest(index);
+            }
+        }));
+}
+
+
+/**
+ * End the background request for the icon of an item, if there is one, either because the icon has
+ * been received or because it is no longer wanted. A request still running is cancelled, the icon
+ * still being rendered if other items with identical symbols are waiting for it. If the item was the
+ * last one the icon batch being timed was waiting for, the time since the batch was requested is
+ * recorded.
+ *
+ * @param index the index of the item
+ */
+void SymbolListWidget::endIconRequest(qint16 index)
+{
+    if (m_iconTokens.contains(index)) {
+        m_iconTokens.take(index).cancel();
+    }
+
+    m_iconRequests.remove(index);
+
+    if (m_iconBatch.remove(index) && m_iconBatch.isEmpty()) {
+        LatencyHistograms::record(LatencyHistograms::IconBatch, m_iconBatchTimer.nsecsElapsed());
+    }
+}
+
+#include "moc_SymbolListWidget.cpp"
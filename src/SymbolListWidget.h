@@ -19,9 +19,21 @@
 #define SymbolListWidget_H
 
 
+#include <QCache>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QListWidget>
+#include <QMap>
+#include <QPair>
+#include <QPixmap>
+#include <QSet>
+#include <QTimer>
 
+#include "CoverageRasterizer.h"
+#include "TaskScheduler.h"
 
+
+class QColor;
 class QMimeData;
 
 class SymbolLibrary;
@@ -36,12 +48,23 @@ class Symbol;
  * of the Symbols for further processing.
  *
  * Additional Symbols can be added individually and all Symbols will be sorted
- * in the view by their index value.
+ * in the view by their index value, or in the display order of the SymbolLibrary
+ * if it has been reordered. Symbols dragged within the view are moved to the
+ * position they are dropped at.
  *
  * Symbols can be removed by their index value.
+ *
+ * The icons for Symbols loaded from a SymbolLibrary are created when their items are
+ * scrolled into view, so that large libraries and collections are shown without
+ * rendering, or reading, every Symbol. The icons are rendered in the background by the
+ * TaskScheduler, those just below the view being prefetched at a lower priority. Draft icons
+ * are rendered first and the visible ones refined once scrolling stops, the refined icons
+ * being cached by the content of their symbols.
  */
 class SymbolListWidget : public QListWidget
 {
+    Q_OBJECT
+
 public:
     explicit SymbolListWidget(QWidget *parent);
     ~SymbolListWidget() = default;
@@ -49,27 +72,62 @@ public:
     void setIconSize(int size);
     void loadFromLibrary(SymbolLibrary *library);
     void addSymbol(qint16 index, const Symbol &symbol);
+    void addSymbols(const QList<qint16> &indexes);
     void removeSymbol(qint16 index);
+    void removeSymbols(const QList<qint16> &indexes);
+    void moveSymbols(const QList<qint16> &indexes, qint16 before);
+    void restoreSymbols(const QMap<int, qint16> &rows);
+    void invalidateIcon(qint16 index);
+    void selectSymbol(qint16 index);
+    void filterSymbols(const QList<qint16> &indexes);
+    void clearFilter();
 
     static QIcon createIcon(const Symbol &symbol, int size);
+    static QImage iconImage(const Symbol &symbol, int size, const QColor &color, CoverageRasterizer::Quality quality = CoverageRasterizer::Refined);
 
 protected:
     virtual QStringList mimeTypes() const Q_DECL_OVERRIDE;
     virtual Qt::DropActions supportedDropActions() const Q_DECL_OVERRIDE;
     virtual QMimeData *mimeData(const QList<QListWidgetItem *> &items) const Q_DECL_OVERRIDE;
-    virtual bool dropMimeData(int index, const QMimeData *mimeData, Qt::DropAction action) Q_DECL_OVERRIDE;
+    virtual void dropEvent(QDropEvent *e) Q_DECL_OVERRIDE;
     virtual bool event(QEvent *e) Q_DECL_OVERRIDE;
+    virtual void scrollContentsBy(int dx, int dy) Q_DECL_OVERRIDE;
+    virtual void resizeEvent(QResizeEvent *e) Q_DECL_OVERRIDE;
+    virtual void showEvent(QShowEvent *e) Q_DECL_OVERRIDE;
+
+private slots:
+    void updateVisibleIcons();
+    void refineVisibleIcons();
 
 private:
-    QListWidgetItem *createItem(qint16 index);
+    QListWidgetItem *createItem(qint16 index, bool append = false);
+    QListWidgetItem *insertItemBefore(qint16 index, QListWidgetItem *following);
+    QListWidgetItem *followingItem(qint16 index) const;
+    QListWidgetItem *followingItem(const QList<qint16> &order, int position) const;
     void updateIcons();
+    QPair<int, int> visibleRows();
+    QByteArray iconKey(const Symbol &symbol) const;
+    void requestIcon(QListWidgetItem *item, TaskScheduler::Priority priority);
+    void refineIcon(QListWidgetItem *item);
+    void endIconRequest(qint16 index);
+
+    static const int refineDelay = 150;         /**< the time in milliseconds scrolling must stop for before the draft icons are refined */
+    static const int refinedIconsBytes = 32 << 20;  /**< the total size in bytes of the refined icons kept in m_refinedIcons */
 
     int             m_size;                     /**< size of icons generated in the view */
     SymbolLibrary   *m_library;                 /**< pointer to the library the items belong to */
-
-    qint16          m_lastIndex;                /**< the last index in the list */
+    bool            m_filtered;                 /**< true if items have been hidden by filterSymbols() */
 
     QMap<qint16, QListWidgetItem*>  m_items;    /**< map of index to QListWidgetItem */
+    QSet<qint16>    m_pendingIcons;             /**< indexes of the items that have not had an icon created */
+    QHash<qint16, QByteArray>   m_iconRequests; /**< keys of the icons being rendered in the background for each index */
+    QHash<qint16, TaskToken>    m_iconTokens;   /**< tokens of the requests for the icons being rendered in the background for each index */
+    QTimer          m_iconTimer;                /**< single shot timer to create the icons for the visible items */
+    QSet<qint16>    m_draftIcons;               /**< indexes of the items showing a draft icon */
+    QTimer          m_refineTimer;              /**< single shot timer to refine the draft icons of the visible items */
+    QSet<qint16>    m_iconBatch;                /**< indexes of the visible items whose icons are being waited for while latency is recorded */
+    QElapsedTimer   m_iconBatchTimer;           /**< time since the icons of m_iconBatch were first requested */
+    QCache<QByteArray, QPixmap> m_refinedIcons; /**< cache of the refined icons keyed by the content hash of the symbol, the size and the color, the cost of each being its size in bytes */
 };
 
 
@@ -0,0 +1,230 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Implement the SymbolMimeData class.
+ */
+
+
+/**
+ * @page symbol_mime_data Dragging Symbols
+ * Symbols dragged from the library view are offered in two formats. The application/kxstitchsymbol format holds
+ * the flattened symbols streamed one after the other with a QDataStream and is understood by other applications.
+ * The application/x-symboleditor-shared format holds a handle to a QSharedMemory segment holding the same data,
+ * written with a QDataStream with its version set to QDataStream::Qt_4_0 as
+ * - QByteArray the unique id of the machine, from QSysInfo::machineUniqueId()
+ * - QString the native key of the segment
+ * - qint32 the number of bytes of symbol data in the segment
+ *
+ * Neither format is encoded until it is asked for, and the segment is only created when the handle is asked for.
+ * A SymbolEditor the symbols are dropped on asks for the handle and copies the data out of the segment if it is on
+ * the same machine, so a large drag between two instances only passes the handle through the windowing system. If
+ * the segment can not be used the symbols are asked for in the application/kxstitchsymbol format instead. The
+ * segment is removed when the drag is finished.
+ */
+
+
+#include "SymbolMimeData.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QIODevice>
+#include <QSysInfo>
+#include <QVariant>
+
+#include <string.h>
+
+#include "Exceptions.h"
+
+
+namespace
+{
+const QString symbolFormat = QStringLiteral("application/kxstitchsymbol");              /**< format of the encoded symbols */
+const QString sharedFormat = QStringLiteral("application/x-symboleditor-shared");       /**< format of the shared memory handle */
+}
+
+
+/**
+ * Constructor.
+ *
+ * @param symbols a const reference to a QList of the flattened Symbols dragged
+ */
+SymbolMimeData::SymbolMimeData(const QList<Symbol> &symbols)
+    :   m_symbols(symbols)
+{
+}
+
+
+/**
+ * Get the formats the symbols are offered in.
+ *
+ * @return a QStringList of the shared memory handle and the encoded symbol formats
+ */
+QStringList SymbolMimeData::formats() const
+{
+    return QStringList() << sharedFormat << symbolFormat;
+}
+
+
+/**
+ * Get the encoded symbols dropped from a QMimeData.
+ * If the mime data has a valid handle to a shared memory segment on this machine the symbols are
+ * copied from the segment, otherwise they are taken from the encoded symbol format. A handle with
+ * a negative size, or a size larger than the segment, is not used.
+ *
+ * @param mimeData a const pointer to the QMimeData dropped
+ *
+ * @return a QByteArray of the streamed symbols
+ */
+QByteArray SymbolMimeData::symbolData(const QMimeData *mimeData)
+{
+    QByteArray handle = mimeData->data(sharedFormat);
+
+    if (!handle.isEmpty()) {
+        QDataStream stream(handle);
+        stream.setVersion(QDataStream::Qt_4_0);
+
+        QByteArray machine;
+        QString key;
+        qint32 size;
+        stream >> machine >> key >> size;
+
+        if (stream.status() == QDataStream::Ok && size >= 0 && machine == QSysInfo::machineUniqueId()) {
+            QSharedMemory sharedMemory;
+            sharedMemory.setNativeKey(key);
+
+            if (sharedMemory.attach(QSharedMemory::ReadOnly)) {
+                QByteArray data;
+
+                if (size <= sharedMemory.size() && sharedMemory.lock()) {
+                    data = QByteArray(static_cast<const char *>(sharedMemory.constData()), size);
+                    sharedMemory.unlock();
+                }
+
+                sharedMemory.detach();
+
+                if (!data.isEmpty()) {
+                    return data;
+                }
+            }
+        }
+    }
+
+    return mimeData->data(symbolFormat);
+}
+
+
+/**
+ * Get the symbols dropped from a QMimeData.
+ * The symbols are decoded from symbolData() when they are dropped, so that data from another
+ * application that is not valid is found before anything is added to the library. Data that
+ * ends part way through a symbol, or is otherwise not a valid stream, throws a FailedReadLibrary
+ * exception. A symbol of an unknown version throws an InvalidSymbolVersion exception.
+ * @param mimeData a const pointer to the QMimeData dropped
+ * @return a QList of the Symbols in the order they were dragged
+ */
+QList<Symbol> SymbolMimeData::symbols(const QMimeData *mimeData)
+{
+    QByteArray data = symbolData(mimeData);
+    QDataStream stream(&data, QIODevice::ReadOnly);
+    QList<Symbol> symbols;
+
+    while (!stream.atEnd()) {
+        Symbol symbol;
+        stream >> symbol;
+
+        if (stream.status() != QDataStream::Ok) {
+            throw FailedReadLibrary(stream.status());
+        }
+
+        symbols.append(symbol);
+    }
+
+    return symbols;
+}
+
+
+/**
+ * Get the data for a format.
+ * This is called when the data is asked for, so the symbols are only encoded, and the segment only
+ * created, when they are needed.
+ *
+ * @param mimeType a const reference to the format asked for
+ * @param type the type of the QVariant to return
+ *
+ * @return a QVariant holding a QByteArray of the data, invalid if the format can not be provided
+ */
+QVariant SymbolMimeData::retrieveData(const QString &mimeType, QMetaType type) const
+{
+    if (mimeType == symbolFormat) {
+        return encodedSymbols();
+    }
+
+    if (mimeType == sharedFormat) {
+        QByteArray handle = sharedMemoryHandle();
+        return handle.isEmpty() ? QVariant() : QVariant(handle);
+    }
+
+    return QMimeData::retrieveData(mimeType, type);
+}
+
+
+/**
+ * Get the encoded symbols.
+ * The symbols are encoded the first time this is called.
+ *
+ * @return a QByteArray of the streamed symbols
+ */
+QByteArray SymbolMimeData::encodedSymbols() const
+{
+    if (m_encoded.isEmpty()) {
+        QDataStream stream(&m_encoded, QIODevice::WriteOnly);
+
+        foreach (const Symbol &symbol, m_symbols) {
+            stream << symbol;
+        }
+    }
+
+    return m_encoded;
+}
+
+
+/**
+ * Get the handle of the shared memory segment holding the encoded symbols.
+ * The segment is created and the symbols copied into it the first time this is called. The key is
+ * made unique with the process id and the address of this object.
+ *
+ * @return a QByteArray holding the handle, empty if the segment could not be created
+ */
+QByteArray SymbolMimeData::sharedMemoryHandle() const
+{
+    QByteArray data = encodedSymbols();
+
+    if (!m_sharedMemory.isAttached()) {
+        m_sharedMemory.setNativeKey(QStringLiteral("symboleditor-drag-%1-%2").arg(QCoreApplication::applicationPid()).arg(reinterpret_cast<quintptr>(this), 0, 16));
+
+        if (data.isEmpty() || !m_sharedMemory.create(data.size())) {
+            return QByteArray();
+        }
+
+        m_sharedMemory.lock();
+        memcpy(m_sharedMemory.data(), data.constData(), data.size());
+        m_sharedMemory.unlock();
+    }
+
+    QByteArray handle;
+    QDataStream stream(&handle, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_0);
+    stream << QSysInfo::machineUniqueId() << m_sharedMemory.nativeKey() << static_cast<qint32>(data.size());
+
+    return handle;
+}
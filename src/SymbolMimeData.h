@@ -0,0 +1,62 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Header file for the SymbolMimeData class.
+ */
+
+
+#ifndef SymbolMimeData_H
+#define SymbolMimeData_H
+
+
+#include <QByteArray>
+#include <QList>
+#include <QMimeData>
+#include <QSharedMemory>
+
+#include "Symbol.h"
+
+
+/**
+ * @brief The data of symbols dragged from the library view.
+ *
+ * The symbols are only encoded when another application asks for them. Instances of the SymbolEditor
+ * on the same machine ask for a handle to a QSharedMemory segment that the encoded symbols are copied
+ * into, so only the handle passes through the windowing system. Other applications, or a SymbolEditor
+ * that can not attach to the segment, ask for the encoded symbols themselves.
+ */
+class SymbolMimeData : public QMimeData
+{
+public:
+    explicit SymbolMimeData(const QList<Symbol> &symbols);
+    virtual ~SymbolMimeData() = default;
+
+    virtual QStringList formats() const Q_DECL_OVERRIDE;
+
+    static QByteArray symbolData(const QMimeData *mimeData);
+    static QList<Symbol> symbols(const QMimeData *mimeData);
+
+protected:
+    virtual QVariant retrieveData(const QString &mimeType, QMetaType type) const Q_DECL_OVERRIDE;
+
+private:
+    QByteArray encodedSymbols() const;
+    QByteArray sharedMemoryHandle() const;
+
+    QList<Symbol>           m_symbols;          /**< the flattened symbols dragged */
+    mutable QByteArray      m_encoded;          /**< the encoded symbols, empty until they are first asked for */
+    mutable QSharedMemory   m_sharedMemory;     /**< the segment holding the encoded symbols, created when the handle is first asked for */
+};
+
+
+#endif
@@ -0,0 +1,326 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Implement the SymbolQuery class.
+ */
+
+
+/**
+ * @page symbol_query Symbol Queries
+ * The query box above the library view shows only the symbols matching a query. A query is a number of terms
+ * separated by spaces, a symbol matching the query if it matches all of the terms. The terms are tested against the
+ * symbols with their components merged into their paths, and are not case sensitive.
+ *
+ * - filled, stroked for symbols that are filled or drawn as an outline
+ * - winding, oddeven for symbols using the winding or the odd even fill rule
+ * - oversize for symbols whose bounds extend outside the preferred size square of the editor
+ * - elements, width, height, linewidth, index followed by one of <, <=, =, !=, >=, > and a number compares the
+ *   number of elements in the path, the width or height of its bounds as a fraction of the editor, the line width
+ *   or the index of the symbol
+ * - cap= followed by flat, square or round, and join= followed by bevel, miter or round, for the pen attributes
+ * - hash= followed by the start of the content hash in hexadecimal
+ *
+ * A term prefixed with ! matches the symbols not matching the term. For example "stroked elements>200" shows the
+ * outline symbols with more than 200 elements and "!filled oversize" the outline symbols that are too large.
+ *
+ * The attributes of the symbols are held in a SymbolAttributes table which is kept by the library and updated as
+ * the symbols change, so a query only reads the attributes it tests.
+ */
+
+
+#include "SymbolQuery.h"
+
+#include <QRegularExpression>
+#include <QStringList>
+#include <QVector>
+
+#include <KLocalizedString>
+
+#include "Profiling.h"
+#include "SymbolAttributes.h"
+
+
+namespace
+{
+/**
+ * Keep the rows for which a predicate is true.
+ *
+ * @param rows a const reference to the QVector of the rows to test
+ * @param column a const reference to the column tested
+ * @param negated true if the rows for which the predicate is false are kept
+ * @param predicate the function testing a value of the column
+ *
+ * @return a QVector of the rows kept
+ */
+template <typename T, typename Predicate>
+QVector<int> filterRows(const QVector<int> &rows, const QVector<T> &column, bool negated, Predicate predicate)
+{
+    QVector<int> kept;
+    kept.reserve(rows.count());
+
+    for (int row : rows) {
+        if (predicate(column.at(row)) != negated) {
+            kept.append(row);
+        }
+    }
+
+    return kept;
+}
+}
+
+
+/**
+ * Constructor.
+ * Parse the text of the query. If any of the terms can not be parsed the query is invalid and
+ * matches no symbols.
+ *
+ * @param text the text of the query
+ * @param preferred a const reference to the preferred size square in symbol coordinates
+ */
+SymbolQuery::SymbolQuery(const QString &text, const QRectF &preferred)
+    :   m_preferred(preferred)
+{
+    foreach (const QString &term, text.toLower().split(QRegularExpression(QStringLiteral("\\s+")), Qt::SkipEmptyParts)) {
+        if (!parseTerm(term)) {
+            m_errorString = i18n("The query term %1 is not recognized", term);
+            m_terms.clear();
+            break;
+        }
+    }
+}
+
+
+/**
+ * Check if the query was parsed.
+ *
+ * @return true if all the terms were recognized, false otherwise
+ */
+bool SymbolQuery::isValid() const
+{
+    return m_errorString.isEmpty();
+}
+
+
+/**
+ * Get a description of the term that could not be parsed.
+ *
+ * @return a QString containing the error, empty if the query is valid
+ */
+QString SymbolQuery::errorString() const
+{
+    return m_errorString;
+}
+
+
+/**
+ * Parse one term of the query.
+ *
+ * @param text the text of the term in lower case
+ *
+ * @return true if the term was recognized, false otherwise
+ */
+bool SymbolQuery::parseTerm(const QString &text)
+{
+    static const QRegularExpression comparison(QStringLiteral("^([a-z]+)(<=|>=|!=|<|>|=)(.+)$"));
+
+    Term term;
+    term.comparison = Equal;
+    term.value = 1;
+    term.negated = text.startsWith(QLatin1Char('!'));
+
+    QString body = term.negated ? text.mid(1) : text;
+
+    if (body == QLatin1String("filled") || body == QLatin1String("stroked")) {
+        term.column = Filled;
+        term.value = (body == QLatin1String("filled")) ? 1 : 0;
+    } else if (body == QLatin1String("winding") || body == QLatin1String("oddeven")) {
+        term.column = FillRule;
+        term.value = (body == QLatin1String("winding")) ? Qt::WindingFill : Qt::OddEvenFill;
+    } else if (body == QLatin1String("oversize")) {
+        term.column = Oversize;
+    } else {
+        QRegularExpressionMatch match = comparison.match(body);
+
+        if (!match.hasMatch()) {
+            return false;
+        }
+
+        static const QStringList comparisons = {QStringLiteral("<"), QStringLiteral("<="), QStringLiteral("="), QStringLiteral("!="), QStringLiteral(">="), QStringLiteral(">")};
+        static const QStringList numeric = {QStringLiteral("index"), QStringLiteral("elements"), QStringLiteral("width"), QStringLiteral("height"), QStringLiteral("linewidth")};
+        static const QStringList caps = {QStringLiteral("flat"), QStringLiteral("square"), QStringLiteral("round")};
+        static const QStringList joins = {QStringLiteral("miter"), QStringLiteral("bevel"), QStringLiteral("round")};
+
+        QString name = match.captured(1);
+        QString value = match.captured(3);
+        term.comparison = static_cast<Comparison>(comparisons.indexOf(match.captured(2)));
+
+        if (numeric.contains(name)) {
+            static const Column columns[] = {Index, Elements, Width, Height, LineWidth};
+            bool ok;
+            term.column = columns[numeric.indexOf(name)];
+            term.value = value.toDouble(&ok);
+
+            if (!ok) {
+                return false;
+            }
+        } else if (term.comparison != Equal && term.comparison != NotEqual) {
+            return false;
+        } else if (name == QLatin1String("cap") && caps.contains(value)) {
+            term.column = CapStyle;
+            term.value = caps.indexOf(value);   // the Qt::PenCapStyle shifted as in SymbolAttributes
+        } else if (name == QLatin1String("join") && joins.contains(value)) {
+            term.column = JoinStyle;
+            term.value = joins.indexOf(value);  // the Qt::PenJoinStyle shifted as in SymbolAttributes
+        } else if (name == QLatin1String("hash") && QRegularExpression(QStringLiteral("^[0-9a-f]+$")).match(value).hasMatch()) {
+            term.column = Hash;
+            term.hash = QByteArray::fromHex(value.left(value.length() & ~1).toLatin1());
+            term.value = (value.length() & 1) ? value.right(1).toInt(nullptr, 16) : -1;
+        } else {
+            return false;
+        }
+
+        if (term.comparison == NotEqual && (term.column == CapStyle || term.column == JoinStyle || term.column == Hash)) {
+            term.comparison = Equal;
+            term.negated = !term.negated;
+        }
+    }
+
+    m_terms.append(term);
+
+    return true;
+}
+
+
+/**
+ * Select the symbols matching the query.
+ * Starting with all the rows of the table, each term removes the rows it does not match so that
+ * the later terms test fewer rows. An invalid query matches nothing.
+ *
+ * @param attributes a const reference to the SymbolAttributes, this must be up to date
+ *
+ * @return a QList of the indexes of the matching symbols in no particular order
+ */
+QList<qint16> SymbolQuery::select(const SymbolAttributes &attributes) const
+{
+    PROFILE_COUNT(QueriesEvaluated);
+    PROFILE_TIMER(QueriesEvaluated);
+
+    QList<qint16> indexes;
+
+    if (!isValid()) {
+        return indexes;
+    }
+
+    QVector<int> rows(attributes.count());
+
+    for (int row = 0 ; row < rows.count() ; ++row) {
+        rows[row] = row;
+    }
+
+    foreach (const Term &term, m_terms) {
+        Comparison comparison = term.comparison;
+        qreal value = term.value;
+
+        auto compare = [comparison, value](qreal v) {
+            switch (comparison) {
+            case Less:
+                return v < value;
+
+            case LessOrEqual:
+                return v <= value;
+
+            case Equal:
+                return v == value;
+
+            case NotEqual:
+                return v != value;
+
+            case GreaterOrEqual:
+                return v >= value;
+
+            case Greater:
+                return v > value;
+            }
+
+            return false;
+        };
+
+        switch (term.column) {
+        case Index:
+            rows = filterRows(rows, attributes.indexes(), term.negated, compare);
+            break;
+
+        case Elements:
+            rows = filterRows(rows, attributes.elementCounts(), term.negated, compare);
+            break;
+
+        case Width:
+            rows = filterRows(rows, attributes.bounds(), term.negated, [&compare](const QRectF &bounds) {
+                return compare(bounds.width());
+            });
+            break;
+
+        case Height:
+            rows = filterRows(rows, attributes.bounds(), term.negated, [&compare](const QRectF &bounds) {
+                return compare(bounds.height());
+            });
+            break;
+
+        case LineWidth:
+            rows = filterRows(rows, attributes.lineWidths(), term.negated, compare);
+            break;
+
+        case Filled:
+            rows = filterRows(rows, attributes.filled(), term.negated, [value](bool filled) {
+                return filled == (value != 0);
+            });
+            break;
+
+        case FillRule:
+            rows = filterRows(rows, attributes.fillRules(), term.negated, compare);
+            break;
+
+        case CapStyle:
+            rows = filterRows(rows, attributes.capStyles(), term.negated, compare);
+            break;
+
+        case JoinStyle:
+            rows = filterRows(rows, attributes.joinStyles(), term.negated, compare);
+            break;
+
+        case Oversize:
+            rows = filterRows(rows, attributes.bounds(), term.negated, [this](const QRectF &bounds) {
+                return !bounds.isNull() && !m_preferred.contains(bounds);
+            });
+            break;
+
+        case Hash: {
+            const QByteArray &prefix = term.hash;
+            int nibble = static_cast<int>(value);
+
+            rows = filterRows(rows, attributes.hashes(), term.negated, [&prefix, nibble](const QByteArray &hash) {
+                return hash.startsWith(prefix) && (nibble < 0 || (hash.size() > prefix.size() && (static_cast<uchar>(hash.at(prefix.size())) >> 4) == nibble));
+            });
+            break;
+        }
+        }
+    }
+
+    indexes.reserve(rows.count());
+
+    for (int row : rows) {
+        indexes.append(attributes.indexes().at(row));
+    }
+
+    return indexes;
+}
@@ -0,0 +1,74 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Header file for the SymbolQuery class.
+ */
+
+
+#ifndef SymbolQuery_H
+#define SymbolQuery_H
+
+
+#include <QByteArray>
+#include <QList>
+#include <QRectF>
+#include <QString>
+
+
+class SymbolAttributes;
+
+
+/**
+ * @brief A query over the attributes of the symbols of a library.
+ *
+ * The query text is parsed into a list of terms which must all be true for a symbol to match,
+ * see @ref symbol_query for the terms. Each term is tested against one column of a
+ * SymbolAttributes table, the rows remaining after one term being the only ones tested by the
+ * next.
+ */
+class SymbolQuery
+{
+public:
+    SymbolQuery(const QString &text, const QRectF &preferred);
+
+    bool isValid() const;
+    QString errorString() const;
+
+    QList<qint16> select(const SymbolAttributes &attributes) const;
+
+private:
+    enum Column {Index, Elements, Width, Height, LineWidth, Filled, FillRule, CapStyle, JoinStyle, Oversize, Hash};
+    enum Comparison {Less, LessOrEqual, Equal, NotEqual, GreaterOrEqual, Greater};
+
+    /**
+     * @brief One condition of a query.
+     */
+    class Term
+    {
+    public:
+        Column      column;         /**< the attribute tested */
+        Comparison  comparison;     /**< the comparison made */
+        qreal       value;          /**< the value compared with */
+        QByteArray  hash;           /**< the hex prefix of the hash compared with, for the Hash column */
+        bool        negated;        /**< true if the result of the comparison is inverted */
+    };
+
+    bool parseTerm(const QString &text);
+
+    QRectF      m_preferred;        /**< the preferred size square for the oversize term */
+    QList<Term> m_terms;            /**< the terms of the query */
+    QString     m_errorString;      /**< a description of the first term that could not be parsed */
+};
+
+
+#endif
@@ -0,0 +1,393 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Implement the TaskScheduler class.
+ */
+
+
+/**
+ * @page task_scheduler Task Scheduler
+ * The work done in the background, such as rendering the icons of the library view and indexing the libraries of
+ * the catalog, is run by a single scheduler so that the different kinds of work do not compete for the processor.
+ * Each task is given one of four priority classes.
+ * - Interactive for the work the user is waiting to see, such as the icons of the visible symbols.
+ * - Prefetch for work the user is likely to need next, such as the icons just outside the view.
+ * - Analysis for longer running work, such as indexing the catalog.
+ * - Idle for work that can wait until nothing else is being done.
+ *
+ * Waiting tasks are started in order of their class as threads become free, and one thread is always kept free
+ * of the lower classes so that interactive work can start immediately. A task that is scheduled while the same
+ * work is already waiting or running, identified by a key such as the hash of the symbol it is for, is combined
+ * with the existing task and the result delivered to both requesters. The key is qualified by the type of the
+ * result, so work producing different kinds of result is never combined. Each requester is given its own token
+ * when the task is scheduled. A requester that cancels is no longer given the result, and the task itself is
+ * only cancelled once all of its requesters have cancelled, a waiting task that is cancelled is never started.
+ * The library view cancels the requests for the icons of the items that have been scrolled out of view, so
+ * the icons of the items the user has moved to are not left waiting behind them.
+ *
+ * The results are posted to an object the scheduler keeps in the thread of each receiver, rather than to the
+ * receiver itself, and the receiver is only checked on its own thread when the result arrives. A receiver
+ * deleted while its result is on the way is then simply skipped.
+ */
+
+
+#include "TaskScheduler.h"
+
+#include <QMetaObject>
+
+#include "Profiling.h"
+
+
+/**
+ * Constructor.
+ */
+TaskToken::TaskToken()
+    :   m_state(new State)
+{
+}
+
+
+/**
+ * Cancel the task.
+ * For the token of a request, the result is no longer delivered to the requester and the task is
+ * cancelled if this was the last of its requesters not to have cancelled. A waiting task that is
+ * cancelled will not be started and a running task will not deliver its result.
+ */
+void TaskToken::cancel()
+{
+    if (!m_state->cancelled.testAndSetOrdered(0, 1) || m_state->task.isNull()) {
+        return;
+    }
+
+    QAtomicInt &requesters = m_state->task->requesters;
+
+    forever {
+        int count = requesters.loadAcquire();
+
+        if (count <= 0) {
+            return;
+        }
+
+        if (requesters.testAndSetOrdered(count, (count == 1) ? -1 : count - 1)) {
+            if (count == 1) {
+                m_state->task->cancelled.storeRelease(1);
+            }
+
+            return;
+        }
+    }
+}
+
+
+/**
+ * Check if the task has been cancelled.
+ * The token of a request is also cancelled when the task has been cancelled.
+ *
+ * @return true if the task has been cancelled, false otherwise
+ */
+bool TaskToken::isCancelled() const
+{
+    return m_state->cancelled.loadAcquire() != 0 || (!m_state->task.isNull() && m_state->task->cancelled.loadAcquire() != 0);
+}
+
+
+/**
+ * Add a requester to the token of a task.
+ * This fails once all the earlier requesters have cancelled, the task then being cancelled.
+ *
+ * @return true if the requester was added, false if the task has been cancelled
+ */
+bool TaskToken::addRequester()
+{
+    forever {
+        int count = m_state->requesters.loadAcquire();
+
+        if (count < 0 || m_state->cancelled.loadAcquire() != 0) {
+            return false;
+        }
+
+        if (m_state->requesters.testAndSetOrdered(count, count + 1)) {
+            return true;
+        }
+    }
+}
+
+
+/**
+ * Create the token of a request for a task.
+ * The requester must have been added with addRequester().
+ *
+ * @return a new TaskToken linked to this token of the task
+ */
+TaskToken TaskToken::requester() const
+{
+    TaskToken token;
+    token.m_state->task = m_state;
+
+    return token;
+}
+
+
+/**
+ * Get the scheduler used by the application.
+ *
+ * @return a pointer to the TaskScheduler
+ */
+TaskScheduler *TaskScheduler::instance()
+{
+    static TaskScheduler scheduler;
+    return &scheduler;
+}
+
+
+/**
+ * Constructor.
+ */
+TaskScheduler::TaskScheduler()
+    :   QObject()
+{
+    for (int priority = 0 ; priority < PriorityCount ; ++priority) {
+        m_running[priority] = 0;
+    }
+}
+
+
+/**
+ * Destructor.
+ * Cancel the waiting tasks and wait for the running tasks to finish.
+ */
+TaskScheduler::~TaskScheduler()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+
+        for (int priority = 0 ; priority < PriorityCount ; ++priority) {
+            m_queues[priority].clear();
+        }
+
+        foreach (const QSharedPointer<Task> &task, m_tasks) {
+            task->token.cancel();
+        }
+    }
+
+    m_pool.waitForDone();
+
+    qDeleteAll(m_contexts);
+}
+
+
+/**
+ * Find a waiting or running task with a key and add a requester to it.
+ * A waiting task is raised to the priority if that is higher than its own. A task whose requesters
+ * have all cancelled is not used.
+ * This must be called with the mutex locked.
+ *
+ * @param priority the priority of the new task
+ * @param key the key of the new task
+ *
+ * @return a QSharedPointer to the existing Task, null if there is none
+ */
+QSharedPointer<TaskScheduler::Task> TaskScheduler::coalesce(Priority priority, const QByteArray &key)
+{
+    if (key.isEmpty()) {
+        return QSharedPointer<Task>();
+    }
+
+    QSharedPointer<Task> task = m_tasks.value(key);
+
+    if (task.isNull() || !task->token.addRequester()) {
+        return QSharedPointer<Task>();
+    }
+
+    PROFILE_COUNT(TasksCoalesced);
+
+    if (!task->running && priority < task->priority) {
+        m_queues[task->priority].removeOne(task);
+        task->priority = priority;
+        m_queues[priority].append(task);
+    }
+
+    return task;
+}
+
+
+/**
+ * Add a new task to the queue for its priority.
+ * This must be called with the mutex locked.
+ *
+ * @param task a const reference to the QSharedPointer to the Task
+ */
+void TaskScheduler::enqueue(const QSharedPointer<Task> &task)
+{
+    PROFILE_COUNT(TasksScheduled);
+
+    m_queues[task->priority].append(task);
+
+    if (!task->key.isEmpty()) {
+        m_tasks.insert(task->key, task);
+    }
+}
+
+
+/**
+ * Start as many waiting tasks as the priority rules allow.
+ * This must be called with the mutex locked.
+ */
+void TaskScheduler::dispatch()
+{
+    forever {
+        QSharedPointer<Task> task = next();
+
+        if (task.isNull()) {
+            return;
+        }
+
+        task->running = true;
+        m_running[task->priority]++;
+
+        m_pool.start([this, task]() {
+            if (!task->token.isCancelled()) {
+                task->run();
+            }
+
+            finished(task);
+        });
+    }
+}
+
+
+/**
+ * Take the next task to start from the queues.
+ * Cancelled tasks are discarded. The first task of the highest priority class with waiting tasks
+ * is taken if the threads allow it. Interactive tasks may use all the threads, the Prefetch and
+ * Analysis classes all but one, and Idle tasks are only started when nothing else is running.
+ * This must be called with the mutex locked.
+ *
+ * @return a QSharedPointer to the Task to start, null if no task can be started
+ */
+QSharedPointer<TaskScheduler::Task> TaskScheduler::next()
+{
+    int threads = m_pool.maxThreadCount();
+    int running = 0;
+
+    for (int priority = 0 ; priority < PriorityCount ; ++priority) {
+        running += m_running[priority];
+    }
+
+    for (int priority = 0 ; priority < PriorityCount ; ++priority) {
+        QList<QSharedPointer<Task> > &queue = m_queues[priority];
+
+        while (!queue.isEmpty() && queue.first()->token.isCancelled()) {
+            QSharedPointer<Task> task = queue.takeFirst();
+
+            if (m_tasks.value(task->key) == task) {
+                m_tasks.remove(task->key);
+            }
+        }
+
+        if (queue.isEmpty()) {
+            continue;
+        }
+
+        bool allowed;
+
+        switch (priority) {
+        case Interactive:
+            allowed = (running < threads);
+            break;
+
+        case Idle:
+            allowed = (running == 0);
+            break;
+
+        default:
+            allowed = (running < threads && running - m_running[Interactive] < qMax(1, threads - 1));
+            break;
+        }
+
+        return allowed ? queue.takeFirst() : QSharedPointer<Task>();
+    }
+
+    return QSharedPointer<Task>();
+}
+
+
+/**
+ * Make sure there is a context object living in a thread that results are delivered to.
+ * The results are posted to the context object rather than to the receiver, as the receiver may be
+ * deleted on its own thread at any time, whereas the context object is only deleted while holding
+ * the mutex, when its thread finishes. The receiver is then tested on its own thread before the
+ * result is delivered. This is called with the mutex locked.
+ *
+ * @param thread a pointer to the QThread of a receiver
+ */
+void TaskScheduler::addContext(QThread *thread)
+{
+    if (m_contexts.contains(thread)) {
+        return;
+    }
+
+    QObject *context = new QObject;
+    context->moveToThread(thread);
+    m_contexts.insert(thread, context);
+
+    connect(thread, &QThread::finished, this, [this, thread]() {
+        QMutexLocker locker(&m_mutex);
+        delete m_contexts.take(thread);
+    }, Qt::DirectConnection);
+}
+
+
+/**
+ * Called on the worker thread when a task has finished.
+ * The result is posted to the context objects of the threads of the receivers that have not cancelled
+ * their requests, unless the task was cancelled, and waiting tasks are started on the thread that has
+ * become free. Whether the receiver still exists is only tested on its own thread, as it may be deleted
+ * there at any time, the result being delivered if it does and the request is still not cancelled.
+ *
+ * @param task a const reference to the QSharedPointer to the Task
+ */
+void TaskScheduler::finished(const QSharedPointer<Task> &task)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_running[task->priority]--;
+
+    if (!task->key.isEmpty() && m_tasks.value(task->key) == task) {
+        m_tasks.remove(task->key);
+    }
+
+    dispatch();
+
+    if (task->token.isCancelled()) {
+        return;
+    }
+
+    for (const Receiver &receiver : task->receivers) {
+        QObject *context = m_contexts.value(receiver.thread);
+
+        if (context && !receiver.requester.isCancelled()) {
+            QPointer<QObject> object = receiver.object;
+            TaskToken requester = receiver.requester;
+            std::function<void()> deliver = receiver.deliver;
+
+            QMetaObject::invokeMethod(context, [object, requester, deliver]() {
+                if (object && !requester.isCancelled()) {
+                    deliver();
+                }
+            }, Qt::QueuedConnection);
+        }
+    }
+}
+
+#include "moc_TaskScheduler.cpp"
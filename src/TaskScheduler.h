@@ -0,0 +1,220 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Header file for the TaskScheduler class.
+ */
+
+
+#ifndef TaskScheduler_H
+#define TaskScheduler_H
+
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QObject>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QThread>
+#include <QThreadPool>
+
+#include <functional>
+#include <memory>
+#include <typeinfo>
+
+
+/**
+ * @brief Allows a scheduled task to be cancelled.
+ *
+ * Copies of a token share the same state, so a task can check the token it was given to find
+ * out if it has been cancelled by the code that scheduled it.
+ *
+ * Each request for a task is given its own requester token linked to the token of the task, so
+ * a task coalesced from several requests is only cancelled when all of the requesters have
+ * cancelled, a requester that cancels no longer being given the result.
+ */
+class TaskToken
+{
+public:
+    TaskToken();
+
+    void cancel();
+    bool isCancelled() const;
+
+private:
+    friend class TaskScheduler;
+
+    /**
+     * @brief The state shared by the copies of a token.
+     */
+    class State
+    {
+    public:
+        QAtomicInt              cancelled;      /**< set to 1 when the token is cancelled */
+        QAtomicInt              requesters;     /**< for a task token, the number of requesters not cancelled, -1 once they have all cancelled */
+        QSharedPointer<State>   task;           /**< for a requester token, the state of the token of the task */
+    };
+
+    bool addRequester();
+    TaskToken requester() const;
+
+    QSharedPointer<State>   m_state;        /**< the shared state of the token */
+};
+
+
+/**
+ * @brief Runs the background work of the application on a thread pool in order of priority.
+ *
+ * Tasks are scheduled with a priority class and are started in order of their class, the tasks
+ * in each class being started in the order they were scheduled. One thread is kept for the
+ * Interactive class, so the work the user is waiting for can start even while the other threads
+ * are busy with heavier tasks. Idle tasks are only started when no other tasks are waiting or
+ * running.
+ *
+ * A task scheduled with the key of a task that is waiting or running is coalesced with it rather
+ * than run again, the existing task being raised to the higher of the two priorities. The result
+ * of the task is delivered to each of the receivers on their own threads.
+ */
+class TaskScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Priority {
+        Interactive,                /**< work the user is waiting for, such as the visible icons */
+        Prefetch,                   /**< work the user is likely to need soon */
+        Analysis,                   /**< indexing and analysis of libraries */
+        Idle,                       /**< work only done when nothing else is waiting or running */
+        PriorityCount               /**< number of priority classes, must be last */
+    };
+
+    static TaskScheduler *instance();
+
+    template <typename Result>
+    TaskToken schedule(Priority priority, const QByteArray &key, std::function<Result(const TaskToken &)> work, QObject *receiver, std::function<void(const Result &)> done);
+
+private:
+    /**
+     * @brief A requester of the result of a task.
+     */
+    class Receiver
+    {
+    public:
+        TaskToken               requester;      /**< the token of the request, the result is not delivered once it is cancelled */
+        QPointer<QObject>       object;         /**< the QObject the result is delivered to, only tested on its own thread */
+        QThread                 *thread;        /**< the thread of the receiver, the result is posted to the context object of this thread */
+        std::function<void()>   deliver;        /**< delivers the result to the receiver */
+    };
+
+    /**
+     * @brief A scheduled unit of work.
+     */
+    class Task
+    {
+    public:
+        QByteArray              key;            /**< key used to coalesce duplicate tasks, empty if the task is not coalesced */
+        Priority                priority;       /**< the priority class of the task */
+        bool                    running;        /**< true once the task has been started */
+        TaskToken               token;          /**< token allowing the task to be cancelled */
+        std::function<void()>   run;            /**< runs the work, storing the result */
+        std::shared_ptr<void>   result;         /**< holds the result of the work */
+        QList<Receiver>         receivers;      /**< the receivers of the result */
+    };
+
+    TaskScheduler();
+    ~TaskScheduler();
+
+    QSharedPointer<Task> coalesce(Priority priority, const QByteArray &key);
+    void addContext(QThread *thread);
+    void enqueue(const QSharedPointer<Task> &task);
+    void dispatch();
+    QSharedPointer<Task> next();
+    void finished(const QSharedPointer<Task> &task);
+
+    QThreadPool                             m_pool;                     /**< the threads running the tasks */
+    QMutex                                  m_mutex;                    /**< protects the queues, the tasks are finished on the worker threads */
+    QList<QSharedPointer<Task> >            m_queues[PriorityCount];    /**< the waiting tasks for each priority class */
+    QHash<QByteArray, QSharedPointer<Task> >    m_tasks;                /**< the waiting and running tasks by key */
+    int                                     m_running[PriorityCount];   /**< the number of running tasks in each priority class */
+    QHash<QThread *, QObject *>             m_contexts;                 /**< an object living in each thread results are delivered to, deleted when the thread finishes */
+};
+
+
+/**
+ * Schedule a task.
+ * If a task with the same key and result type is waiting or running the work is not scheduled
+ * again, instead the receiver will be given the result of the existing task. The key is qualified
+ * by the result type, so requests using the same key for different results are never coalesced.
+ * The work is run on a worker thread and must not use objects belonging to other threads. The done
+ * function is called on the thread of the receiver when the work has completed, unless the request
+ * has been cancelled or the receiver has been deleted.
+ *
+ * @param priority the priority class of the task
+ * @param key a key identifying the work, such as a hash of the symbol it is for, an empty key is never coalesced
+ * @param work the function doing the work, it may check the token to stop early when cancelled
+ * @param receiver a pointer to the QObject the result is delivered to, this may be null if no result is wanted
+ * @param done the function receiving the result
+ *
+ * @return the TaskToken of the request, cancelling it cancels the task once no other requests are waiting for it
+ */
+template <typename Result>
+TaskToken TaskScheduler::schedule(Priority priority, const QByteArray &key, std::function<Result(const TaskToken &)> work, QObject *receiver, std::function<void(const Result &)> done)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QByteArray taskKey = (key.isEmpty() ? key : QByteArray(typeid(Result).name()) + ':' + key);
+    QSharedPointer<Task> task = coalesce(priority, taskKey);
+
+    if (task.isNull()) {
+        std::shared_ptr<Result> result = std::make_shared<Result>();
+        TaskToken token;
+        token.addRequester();
+
+        task = QSharedPointer<Task>(new Task);
+        task->key = taskKey;
+        task->priority = priority;
+        task->running = false;
+        task->token = token;
+        task->result = result;
+        task->run = [work, result, token]() {
+            *result = work(token);
+        };
+
+        enqueue(task);
+    }
+
+    TaskToken requester = task->token.requester();
+
+    if (receiver && done) {
+        std::shared_ptr<Result> result = std::static_pointer_cast<Result>(task->result);
+        Receiver delivery;
+        delivery.requester = requester;
+        delivery.object = receiver;
+        delivery.thread = receiver->thread();
+        delivery.deliver = [done, result]() {
+            done(*result);
+        };
+        task->receivers.append(delivery);
+        addContext(delivery.thread);
+    }
+
+    dispatch();
+
+    return requester;
+}
+
+
+#endif
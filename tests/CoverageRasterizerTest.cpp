@@ -0,0 +1,239 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Golden tests comparing the CoverageRasterizer with an antialiased QPainter.
+ *
+ * Each symbol is drawn by the CoverageRasterizer and by a QPainter with antialiasing, using the
+ * pen and brush of the symbol as the library view did before the rasterizer was added, and the
+ * coverage is compared with the alpha channel of the QPainter image. The two rasterizers sample
+ * the edges differently, so rather than requiring identical pixels the comparison allows
+ * - a mean absolute difference of at most 16 out of 255, or 40 for Draft quality, over the pixels
+ *   covered by either image
+ * - a total coverage within 6% of that of the QPainter, or 15% for Draft quality
+ */
+
+
+#include <QImage>
+#include <QPainter>
+#include <QPainterPath>
+#include <QTest>
+
+#include "CoverageRasterizer.h"
+#include "Symbol.h"
+
+
+class CoverageRasterizerTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void coverage_data();
+    void coverage();
+    void emptySymbol();
+
+private:
+    enum Shape {
+        FilledSquareWithHole,       /**< a filled square with a square hole, using the odd even fill rule */
+        FilledCircle,               /**< a filled circle, using the winding fill rule */
+        OutlineTriangle,            /**< a closed outline triangle with round caps and joins */
+        OutlineCross,               /**< two open outline lines with flat caps */
+        OutlineCurve                /**< an open outline cubic curve with square caps */
+    };
+
+    static Symbol symbol(Shape shape);
+    static QImage reference(const Symbol &symbol, int size);
+};
+
+
+/**
+ * Create the symbol drawn for a shape.
+ *
+ * @param shape the Shape
+ *
+ * @return the Symbol
+ */
+Symbol CoverageRasterizerTest::symbol(Shape shape)
+{
+    Symbol symbol;
+    QPainterPath path;
+
+    switch (shape) {
+    case FilledSquareWithHole:
+        path.addRect(0.1, 0.1, 0.8, 0.8);
+        path.addRect(0.3, 0.3, 0.4, 0.4);
+        path.setFillRule(Qt::OddEvenFill);
+        symbol.setFilled(true);
+        break;
+
+    case FilledCircle:
+        path.addEllipse(QPointF(0.5, 0.5), 0.4, 0.4);
+        path.setFillRule(Qt::WindingFill);
+        symbol.setFilled(true);
+        break;
+
+    case OutlineTriangle:
+        path.moveTo(0.5, 0.1);
+        path.lineTo(0.9, 0.85);
+        path.lineTo(0.1, 0.85);
+        path.closeSubpath();
+        symbol.setFilled(false);
+        symbol.setLineWidth(0.06);
+        symbol.setCapStyle(Qt::RoundCap);
+        symbol.setJoinStyle(Qt::RoundJoin);
+        break;
+
+    case OutlineCross:
+        path.moveTo(0.15, 0.15);
+        path.lineTo(0.85, 0.85);
+        path.moveTo(0.85, 0.15);
+        path.lineTo(0.15, 0.85);
+        symbol.setFilled(false);
+        symbol.setLineWidth(0.08);
+        symbol.setCapStyle(Qt::FlatCap);
+        symbol.setJoinStyle(Qt::MiterJoin);
+        break;
+
+    case OutlineCurve:
+        path.moveTo(0.15, 0.8);
+        path.cubicTo(0.3, 0.1, 0.7, 0.1, 0.85, 0.8);
+        symbol.setFilled(false);
+        symbol.setLineWidth(0.05);
+        symbol.setCapStyle(Qt::SquareCap);
+        symbol.setJoinStyle(Qt::BevelJoin);
+        break;
+    }
+
+    symbol.setPath(path);
+
+    return symbol;
+}
+
+
+/**
+ * Draw a symbol with an antialiased QPainter.
+ *
+ * @param symbol a const reference to the Symbol
+ * @param size the width and height of the image in pixels
+ *
+ * @return a QImage in QImage::Format_ARGB32_Premultiplied whose alpha channel is the coverage
+ */
+QImage CoverageRasterizerTest::reference(const Symbol &symbol, int size)
+{
+    QImage image(size, size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.scale(size, size);
+    painter.setPen(symbol.pen());
+    painter.setBrush(symbol.brush());
+    painter.drawPath(symbol.path());
+    painter.end();
+
+    return image;
+}
+
+
+void CoverageRasterizerTest::coverage_data()
+{
+    QTest::addColumn<int>("shape");
+    QTest::addColumn<int>("size");
+    QTest::addColumn<int>("quality");
+    QTest::addColumn<double>("meanTolerance");
+    QTest::addColumn<double>("totalTolerance");
+
+    const char *names[] = {"filled square with hole", "filled circle", "outline triangle", "outline cross", "outline curve"};
+    const int sizes[] = {16, 24, 48, 96};
+
+    for (int shape = FilledSquareWithHole ; shape <= OutlineCurve ; ++shape) {
+        for (int size : sizes) {
+            QTest::addRow("%s %d refined", names[shape], size) << shape << size << int(CoverageRasterizer::Refined) << 16.0 << 0.06;
+            QTest::addRow("%s %d draft", names[shape], size) << shape << size << int(CoverageRasterizer::Draft) << 40.0 << 0.15;
+        }
+    }
+}
+
+
+/**
+ * Compare the coverage of a symbol with the alpha channel of the QPainter rendering.
+ */
+void CoverageRasterizerTest::coverage()
+{
+    QFETCH(int, shape);
+    QFETCH(int, size);
+    QFETCH(int, quality);
+    QFETCH(double, meanTolerance);
+    QFETCH(double, totalTolerance);
+
+    Symbol symbol = CoverageRasterizerTest::symbol(static_cast<Shape>(shape));
+    QImage coverage = CoverageRasterizer::coverage(symbol, size, static_cast<CoverageRasterizer::Quality>(quality));
+    QImage expected = reference(symbol, size);
+
+    QCOMPARE(coverage.size(), QSize(size, size));
+    QCOMPARE(coverage.format(), QImage::Format_Alpha8);
+
+    qint64 difference = 0;
+    qint64 covered = 0;
+    qint64 total = 0;
+    qint64 expectedTotal = 0;
+
+    for (int y = 0 ; y < size ; ++y) {
+        const uchar *line = coverage.constScanLine(y);
+        const QRgb *expectedLine = reinterpret_cast<const QRgb *>(expected.constScanLine(y));
+
+        for (int x = 0 ; x < size ; ++x) {
+            int value = line[x];
+            int expectedValue = qAlpha(expectedLine[x]);
+
+            if (value || expectedValue) {
+                ++covered;
+                difference += qAbs(value - expectedValue);
+            }
+
+            total += value;
+            expectedTotal += expectedValue;
+        }
+    }
+
+    QVERIFY(expectedTotal > 0);
+
+    double mean = double(difference) / double(covered);
+    double totalError = qAbs(double(total - expectedTotal)) / double(expectedTotal);
+
+    QVERIFY2(mean <= meanTolerance, qPrintable(QStringLiteral("mean difference %1 exceeds %2").arg(mean).arg(meanTolerance)));
+    QVERIFY2(totalError <= totalTolerance, qPrintable(QStringLiteral("total coverage differs by %1% which exceeds %2%").arg(totalError * 100).arg(totalTolerance * 100)));
+}
+
+
+/**
+ * A symbol without a path covers nothing.
+ */
+void CoverageRasterizerTest::emptySymbol()
+{
+    for (int quality = CoverageRasterizer::Draft ; quality <= CoverageRasterizer::Refined ; ++quality) {
+        QImage coverage = CoverageRasterizer::coverage(Symbol(), 24, static_cast<CoverageRasterizer::Quality>(quality));
+
+        for (int y = 0 ; y < coverage.height() ; ++y) {
+            const uchar *line = coverage.constScanLine(y);
+
+            for (int x = 0 ; x < coverage.width() ; ++x) {
+                QCOMPARE(int(line[x]), 0);
+            }
+        }
+    }
+}
+
+
+QTEST_GUILESS_MAIN(CoverageRasterizerTest)
+
+#include "CoverageRasterizerTest.moc"
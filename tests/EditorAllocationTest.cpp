@@ -0,0 +1,289 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Tests that moving the mouse over the editor does not allocate memory.
+ *
+ * The global operator new is replaced, and with glibc so are malloc, calloc and realloc, to count the
+ * allocations made by the test thread while counting is enabled. Qt containers allocate with malloc
+ * rather than operator new, so without glibc only the allocations made with operator new are counted.
+ *
+ * The mouse events are created before counting starts, as creating a QMouseEvent allocates, and they
+ * are given to the Editor directly. The editor is not shown so that no paint events are posted. A few
+ * moves are made first so that the guide buffers grow to the size needed and any shared data is
+ * detached, the following moves must not allocate at all.
+ */
+
+
+#include <QMouseEvent>
+#include <QPainterPath>
+#include <QResizeEvent>
+#include <QScopedPointer>
+#include <QTest>
+
+#include <cstdlib>
+#include <new>
+
+#include "Editor.h"
+#include "EditorCache.h"
+#include "Symbol.h"
+
+
+namespace
+{
+thread_local bool counting = false;     /**< true while the allocations of this thread are counted */
+int allocations = 0;                    /**< the number of allocations counted */
+
+void countAllocation()
+{
+    if (counting) {
+        ++allocations;
+    }
+}
+}
+
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+
+void *malloc(size_t size)
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+    countAllocation();
+    return __libc_realloc(pointer, size);
+}
+}
+#endif
+
+
+void *operator new(std::size_t size)
+{
+    countAllocation();
+
+    if (void *pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    countAllocation();
+    return std::malloc(size ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    countAllocation();
+    return std::malloc(size ? size : 1);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+
+/**
+ * @brief An Editor allowing the mouse events to be given to it directly.
+ */
+class TestEditor : public Editor
+{
+public:
+    using Editor::Editor;
+    using Editor::mouseMoveEvent;
+    using Editor::mousePressEvent;
+    using Editor::mouseReleaseEvent;
+};
+
+
+class EditorAllocationTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void hover();
+    void dragPoint();
+
+private:
+    QMouseEvent *mouseEvent(QEvent::Type type, const QPointF &point, Qt::MouseButton button, Qt::MouseButtons buttons);
+    int countMoves(const QList<QMouseEvent *> &events);
+
+    static const int warmUpMoves = 16;      /**< the number of moves made before counting */
+    static const int countedMoves = 256;    /**< the number of moves counted */
+
+    EditorCache     *m_cache;               /**< the cache used by the editor */
+    TestEditor      *m_editor;              /**< the editor being tested */
+    int             m_size;                 /**< the size of the editor in pixels */
+};
+
+
+/**
+ * Create an editor showing a symbol with a move, a line and a curve.
+ */
+void EditorAllocationTest::init()
+{
+    m_cache = new EditorCache;
+    m_editor = new TestEditor(m_cache);
+
+    QResizeEvent resize(QSize(400, 400), QSize());
+    QCoreApplication::sendEvent(m_editor, &resize);
+    m_size = m_editor->width();
+
+    QPainterPath path;
+    path.moveTo(0.2, 0.2);
+    path.lineTo(0.8, 0.2);
+    path.cubicTo(0.8, 0.8, 0.2, 0.8, 0.2, 0.5);
+
+    Symbol symbol;
+    symbol.setPath(path);
+    m_editor->setSymbol(qMakePair(qint16(0), symbol));
+}
+
+
+void EditorAllocationTest::cleanup()
+{
+    delete m_editor;
+    delete m_cache;
+}
+
+
+/**
+ * Create a mouse event at a point of the symbol.
+ *
+ * @param type the QEvent::Type of the event
+ * @param point a const reference to the QPointF in symbol coordinates
+ * @param button the Qt::MouseButton causing the event
+ * @param buttons the Qt::MouseButtons pressed
+ *
+ * @return a pointer to the QMouseEvent, owned by the caller
+ */
+QMouseEvent *EditorAllocationTest::mouseEvent(QEvent::Type type, const QPointF &point, Qt::MouseButton button, Qt::MouseButtons buttons)
+{
+    QPointF position = point * m_size;
+    return new QMouseEvent(type, position, m_editor->mapToGlobal(position), button, buttons, Qt::NoModifier);
+}
+
+
+/**
+ * Give the move events to the editor in turn, first to warm up and then counting the allocations.
+ *
+ * @param events a const reference to a QList of the move events
+ *
+ * @return the number of allocations made by the counted moves
+ */
+int EditorAllocationTest::countMoves(const QList<QMouseEvent *> &events)
+{
+    for (int i = 0 ; i < warmUpMoves ; ++i) {
+        m_editor->mouseMoveEvent(events.at(i % events.count()));
+    }
+
+    allocations = 0;
+    counting = true;
+
+    for (int i = 0 ; i < countedMoves ; ++i) {
+        m_editor->mouseMoveEvent(events.at(i % events.count()));
+    }
+
+    counting = false;
+
+    return allocations;
+}
+
+
+/**
+ * Move the mouse without a button pressed, building the guides for each position.
+ * The mouse is first moved over a point so that the cursor is changed, and changed back by the
+ * first move away from it, the moves counted leaving the cursor as it is.
+ */
+void EditorAllocationTest::hover()
+{
+    QList<QMouseEvent *> events;
+    events << mouseEvent(QEvent::MouseMove, QPointF(0.2, 0.2), Qt::NoButton, Qt::NoButton);
+
+    for (int i = 0 ; i < 8 ; ++i) {
+        events << mouseEvent(QEvent::MouseMove, QPointF(0.3 + i * 0.05, 0.35 + i * 0.03), Qt::NoButton, Qt::NoButton);
+    }
+
+    QList<QMouseEvent *> away = events.mid(1);
+
+    m_editor->mouseMoveEvent(events.first());
+    QCOMPARE(countMoves(away), 0);
+
+    qDeleteAll(events);
+}
+
+
+/**
+ * Drag a point of the path around, moving the element of the path and building the guides for
+ * each position.
+ */
+void EditorAllocationTest::dragPoint()
+{
+    QScopedPointer<QMouseEvent> press(mouseEvent(QEvent::MouseButtonPress, QPointF(0.2, 0.2), Qt::LeftButton, Qt::LeftButton));
+    QScopedPointer<QMouseEvent> release(mouseEvent(QEvent::MouseButtonRelease, QPointF(0.6, 0.45), Qt::LeftButton, Qt::NoButton));
+    QList<QMouseEvent *> events;
+
+    for (int i = 0 ; i < 8 ; ++i) {
+        events << mouseEvent(QEvent::MouseMove, QPointF(0.3 + i * 0.05, 0.35 + i * 0.03), Qt::NoButton, Qt::LeftButton);
+    }
+
+    m_editor->mousePressEvent(press.data());
+    QCOMPARE(countMoves(events), 0);
+    m_editor->mouseReleaseEvent(release.data());
+
+    QVERIFY(QPointF(m_editor->symbol().second.path().elementAt(0)) != QPointF(0.2, 0.2));
+
+    qDeleteAll(events);
+}
+
+
+QTEST_MAIN(EditorAllocationTest)
+
+#include "EditorAllocationTest.moc"
@@ -0,0 +1,733 @@
+/********************************************************************************
+ * Copyright (C) 2011-2015 by Stephen Allewell                                  *
+ * steve.allewell@gmail.com                                                     *
+ *                                                                              *
+ * This program is free software; you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by         *
+ * the Free Software Foundation; either version 2 of the License, or            *
+ * (at your option) any later version.                                          *
+ ********************************************************************************/
+
+
+/**
+ * @file
+ * Round trip tests of the ways libraries and symbols are written and read.
+ *
+ * Random libraries are generated from a fixed seed, each case using its own seed so that a failing case
+ * can be run on its own. Each test checks 2000 libraries, the SERIALIZATION_CASES environment variable
+ * setting another number of cases. Each random library has between one and forty symbols, or up to six hundred for
+ * one library in sixteen so that collections have several shards, with sparse indexes. The symbols have
+ * random sequences of move, line and curve elements, fill rules, line widths, cap and join styles and
+ * components, and some of them have a history of random revisions. Some symbols are then removed, so that
+ * the next index is not one more than the highest index, and some are moved so that the library has a
+ * display order.
+ *
+ * Each library is checked with
+ * - Drag and drop, the items of a SymbolListWidget dragged as SymbolMimeData, decoded as they are when dropped and
+ *   added with a DragAndDropCommand
+ * - Library file, the library written and read as a library file
+ * - Flattened import, the library file read with SymbolLibrary::readFlattenedSymbols() as it is when imported
+ * - Revision delta, the revisions of the histories decoded and compared with those added
+ * - Collection, the library saved as a collection in a temporary directory and opened again
+ * - File versions, libraries without histories, display orders or components written as versions 101 to 103
+ *   of the library file, and the paths of the symbols written as version 100, and read back
+ * - Default library, the library built into the application written as a library file and a collection
+ *
+ * The time spent writing and reading in each test is measured, leaving out the generation of the libraries,
+ * and reported for each codec when the tests finish.
+ *
+ * Symbols are compared by their content hashes, so the paths, fill rules, rendering attributes and components
+ * must be identical. The libraries read must also have the same indexes, display order, next index and symbol
+ * histories.
+ */
+
+
+#include <QBuffer>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QListWidgetItem>
+#include <QMap>
+#include <QMimeData>
+#include <QRandomGenerator>
+#include <QScopedPointer>
+#include <QSet>
+#include <QTemporaryDir>
+#include <QTemporaryFile>
+#include <QTest>
+#include <QTransform>
+
+#include <algorithm>
+
+#include "Commands.h"
+#include "Symbol.h"
+#include "SymbolLibrary.h"
+#include "SymbolListWidget.h"
+#include "SymbolMimeData.h"
+
+
+/**
+ * @brief A SymbolListWidget allowing the mime data of a drag to be created.
+ */
+class DragSourceWidget : public SymbolListWidget
+{
+public:
+    using SymbolListWidget::mimeData;
+};
+
+
+class SerializationTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void cleanupTestCase();
+    void dragAndDrop_data();
+    void dragAndDrop();
+    void libraryFile_data();
+    void libraryFile();
+    void flattenedImport_data();
+    void flattenedImport();
+    void revisionDelta_data();
+    void revisionDelta();
+    void collection_data();
+    void collection();
+    void fileVersions_data();
+    void fileVersions();
+    void fileVersion100_data();
+    void fileVersion100();
+    void defaultLibrary();
+
+private:
+    static int cases();
+    static void addCases();
+    void generate(SymbolLibrary &library, quint32 seed, qint32 fileVersion = 104);
+    Symbol randomSymbol(const QList<qint16> &indexes);
+    void addTime(const QElapsedTimer &timer);
+    static QString compare(SymbolLibrary &expected, SymbolLibrary &actual);
+
+    static const int defaultCases = 2000;       /**< number of random libraries checked by each test unless SERIALIZATION_CASES is set */
+    static const quint32 seed = 20111111;       /**< seed of the first random library */
+
+    QRandomGenerator    m_random;               /**< generator of the random library being checked */
+    QMap<qint16, QList<Symbol> >    m_revisions;    /**< the revisions added to the symbols of the library being checked */
+    QMap<QString, qint64>   m_times;            /**< time spent writing and reading in each test in nanoseconds */
+    QMap<QString, int>      m_timedCases;       /**< number of cases timed in each test */
+};
+
+
+/**
+ * Get the number of random libraries checked by each test.
+ *
+ * @return the value of the SERIALIZATION_CASES environment variable if it is a positive number, otherwise defaultCases
+ */
+int SerializationTest::cases()
+{
+    bool ok;
+    int cases = qEnvironmentVariableIntValue("SERIALIZATION_CASES", &ok);
+
+    return (ok && cases > 0) ? cases : defaultCases;
+}
+
+
+/**
+ * Add a row for each random library to the test data.
+ */
+void SerializationTest::addCases()
+{
+    QTest::addColumn<quint32>("caseSeed");
+
+    for (int i = 0, count = cases() ; i < count ; ++i) {
+        QTest::addRow("seed %u", seed + i) << quint32(seed + i);
+    }
+}
+
+
+/**
+ * Fill a library with random symbols.
+ * The revisions added to the symbols are kept in m_revisions for the revisionDelta test. A library for
+ * an earlier version of the library file only has what that version can hold, histories being added from
+ * version 104, a display order from version 103 and components from version 102. The library for a
+ * version before 104 always has the feature added in that version when it has more than one symbol.
+ *
+ * @param library a reference to the empty SymbolLibrary to fill
+ * @param seed the seed of the random library
+ * @param fileVersion the version of the library file the library is for
+ */
+void SerializationTest::generate(SymbolLibrary &library, quint32 seed, qint32 fileVersion)
+{
+    m_random.seed(seed);
+    m_revisions.clear();
+
+    int count = m_random.bounded(1, (m_random.bounded(16) == 0) ? 600 : 40);
+    QList<qint16> indexes;
+    QSet<qint16> used;
+
+    while (indexes.count() < count) {
+        qint16 index = static_cast<qint16>(m_random.bounded(1, 32000));
+
+        if (used.contains(index)) {
+            continue;
+        }
+
+        used.insert(index);
+        library.setSymbol(index, randomSymbol((fileVersion >= 102) ? indexes : QList<qint16>()));
+
+        if (fileVersion >= 104 && m_random.bounded(4) == 0) {
+            for (int revisions = m_random.bounded(1, 20) ; revisions ; --revisions) {
+                Symbol revision = randomSymbol(indexes);
+                library.addRevision(index, revision);
+                m_revisions[index].append(revision);
+            }
+        }
+
+        indexes.append(index);
+    }
+
+    std::sort(indexes.begin(), indexes.end());
+
+    // remove the highest index and some others so that the next index is not one more than the highest
+    if (indexes.count() > 1) {
+        library.takeSymbol(indexes.takeLast());
+
+        for (int removals = m_random.bounded(indexes.count() / 4 + 1) ; removals ; --removals) {
+            library.takeSymbol(indexes.takeAt(m_random.bounded(indexes.count())));
+        }
+    }
+
+    if (fileVersion == 102 && indexes.count() > 1) {
+        Symbol symbol = library.symbol(indexes.last());
+
+        if (symbol.components().isEmpty()) {
+            symbol.setComponents(QList<SymbolComponent>() << SymbolComponent(indexes.first(), QTransform()));
+            library.setSymbol(indexes.last(), symbol);
+        }
+    }
+
+    if (fileVersion >= 103 && indexes.count() > 1 && (fileVersion == 103 || m_random.bounded(2))) {
+        qint16 moved = indexes.at(m_random.bounded(indexes.count()));
+        qint16 before = indexes.at(m_random.bounded(indexes.count()));
+        library.moveSymbols(QList<qint16>() << moved, before);
+    }
+}
+
+
+/**
+ * Create a random symbol.
+ * The random numbers are taken one at a time so that the symbols are the same for a seed whatever the
+ * order the compiler evaluates function arguments in.
+ *
+ * @param indexes a const reference to a QList of the indexes the symbol can use as components
+ *
+ * @return a Symbol
+ */
+Symbol SerializationTest::randomSymbol(const QList<qint16> &indexes)
+{
+    static const Qt::PenCapStyle capStyles[] = {Qt::FlatCap, Qt::SquareCap, Qt::RoundCap};
+    static const Qt::PenJoinStyle joinStyles[] = {Qt::MiterJoin, Qt::BevelJoin, Qt::RoundJoin};
+
+    QPainterPath path;
+    path.setFillRule(m_random.bounded(2) ? Qt::OddEvenFill : Qt::WindingFill);
+
+    for (int elements = m_random.bounded(1, 48) ; elements ; --elements) {
+        int type = m_random.bounded(3);
+        qreal p[6];
+
+        for (int i = 0 ; i < 6 ; ++i) {
+            p[i] = m_random.generateDouble();
+        }
+
+        switch (type) {
+        case 0:
+            path.moveTo(p[0], p[1]);
+            break;
+
+        case 1:
+            path.lineTo(p[0], p[1]);
+            break;
+
+        default:
+            path.cubicTo(p[0], p[1], p[2], p[3], p[4], p[5]);
+            break;
+        }
+    }
+
+    Symbol symbol;
+    symbol.setPath(path);
+    symbol.setFilled(m_random.bounded(2));
+    symbol.setLineWidth(m_random.generateDouble() / 10);
+    symbol.setCapStyle(capStyles[m_random.bounded(3)]);
+    symbol.setJoinStyle(joinStyles[m_random.bounded(3)]);
+
+    if (!indexes.isEmpty() && m_random.bounded(4) == 0) {
+        QList<SymbolComponent> components;
+
+        for (int count = m_random.bounded(1, 4) ; count ; --count) {
+            qint16 index = indexes.at(m_random.bounded(indexes.count()));
+            qreal m[6];
+
+            for (int i = 0 ; i < 6 ; ++i) {
+                m[i] = m_random.generateDouble();
+            }
+
+            components.append(SymbolComponent(index, QTransform(m[0], m[1], m[2], m[3], m[4], m[5])));
+        }
+
+        symbol.setComponents(components);
+    }
+
+    return symbol;
+}
+
+
+/**
+ * Add the time spent writing and reading a case to the time of the current test.
+ *
+ * @param timer a const reference to the QElapsedTimer started before the library was written
+ */
+void SerializationTest::addTime(const QElapsedTimer &timer)
+{
+    QString test = QString::fromLatin1(QTest::currentTestFunction());
+    m_times[test] += timer.nsecsElapsed();
+    m_timedCases[test]++;
+}
+
+
+/**
+ * Compare a library read with the library written.
+ *
+ * @param expected a reference to the SymbolLibrary written
+ * @param actual a reference to the SymbolLibrary read
+ *
+ * @return a QString describing the first difference, empty if they are the same
+ */
+QString SerializationTest::compare(SymbolLibrary &expected, SymbolLibrary &actual)
+{
+    if (actual.nextIndex() != expected.nextIndex()) {
+        return QStringLiteral("the next index %1 was read as %2").arg(expected.nextIndex()).arg(actual.nextIndex());
+    }
+
+    if (actual.indexes() != expected.indexes()) {
+        return QStringLiteral("%1 indexes were read instead of %2").arg(actual.indexes().count()).arg(expected.indexes().count());
+    }
+
+    if (actual.displayOrder() != expected.displayOrder()) {
+        return QStringLiteral("the display order differs");
+    }
+
+    foreach (qint16 index, expected.indexes()) {
+        if (actual.symbol(index).hash() != expected.symbol(index).hash()) {
+            return QStringLiteral("symbol %1 differs").arg(index);
+        }
+
+        SymbolHistory expectedHistory = expected.history(index);
+        SymbolHistory actualHistory = actual.history(index);
+
+        if (actualHistory.count() != expectedHistory.count()) {
+            return QStringLiteral("symbol %1 has %2 revisions instead of %3").arg(index).arg(actualHistory.count()).arg(expectedHistory.count());
+        }
+
+        for (int r = 0 ; r < expectedHistory.count() ; ++r) {
+            if (actualHistory.timestamp(r) != expectedHistory.timestamp(r) || actualHistory.revision(r).hash() != expectedHistory.revision(r).hash()) {
+                return QStringLiteral("revision %1 of symbol %2 differs").arg(r).arg(index);
+            }
+        }
+    }
+
+    return QString();
+}
+
+
+/**
+ * Report the time spent writing and reading in each test.
+ */
+void SerializationTest::cleanupTestCase()
+{
+    for (QMap<QString, qint64>::const_iterator i = m_times.constBegin() ; i != m_times.constEnd() ; ++i) {
+        int count = m_timedCases.value(i.key());
+        qInfo("%s: %d cases in %.1f ms, %.1f us per case", qPrintable(i.key()), count, i.value() / 1e6, i.value() / 1e3 / count);
+    }
+}
+
+
+void SerializationTest::dragAndDrop_data()
+{
+    addCases();
+}
+
+
+/**
+ * Drag all the items of a library view and drop them on another library.
+ * The mime data is created by the view, the symbols are taken from it as they are by a drop and
+ * added by a DragAndDropCommand. Undoing the command removes them again.
+ */
+void SerializationTest::dragAndDrop()
+{
+    QFETCH(quint32, caseSeed);
+
+    SymbolLibrary library;
+    generate(library, caseSeed);
+
+    DragSourceWidget source;
+    source.loadFromLibrary(&library);
+
+    QList<QListWidgetItem *> items;
+    QList<qint16> indexes;
+
+    for (int r = 0 ; r < source.count() ; ++r) {
+        items.append(source.item(r));
+        indexes.append(static_cast<qint16>(source.item(r)->data(Qt::UserRole).toInt()));
+    }
+
+    QCOMPARE(indexes, library.orderedIndexes());
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QScopedPointer<QMimeData> mimeData(source.mimeData(items));
+    SymbolLibrary target;
+    DragAndDropCommand command(&target, SymbolMimeData::symbols(mimeData.data()));
+    command.redo();
+
+    addTime(timer);
+
+    QList<qint16> added = target.orderedIndexes();
+    QCOMPARE(added.count(), indexes.count());
+
+    for (int i = 0 ; i < indexes.count() ; ++i) {
+        QVERIFY2(target.symbol(added.at(i)).hash() == library.flattenedSymbol(indexes.at(i)).hash(), qPrintable(QStringLiteral("symbol %1 differs").arg(indexes.at(i))));
+    }
+
+    command.undo();
+    QVERIFY(target.indexes().isEmpty());
+}
+
+
+void SerializationTest::libraryFile_data()
+{
+    addCases();
+}
+
+
+/**
+ * Write a library as a library file and read it back.
+ */
+void SerializationTest::libraryFile()
+{
+    QFETCH(quint32, caseSeed);
+
+    SymbolLibrary library;
+    generate(library, caseSeed);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QBuffer buffer;
+    buffer.open(QIODevice::ReadWrite);
+
+    QDataStream out(&buffer);
+    out << library;
+
+    buffer.seek(0);
+
+    QDataStream in(&buffer);
+    SymbolLibrary read;
+    in >> read;
+
+    addTime(timer);
+
+    QString failure = compare(library, read);
+    QVERIFY2(failure.isEmpty(), qPrintable(failure));
+}
+
+
+void SerializationTest::flattenedImport_data()
+{
+    addCases();
+}
+
+
+/**
+ * Read a library file as it is when it is imported.
+ */
+void SerializationTest::flattenedImport()
+{
+    QFETCH(quint32, caseSeed);
+
+    SymbolLibrary library;
+    generate(library, caseSeed);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QTemporaryFile file;
+    QVERIFY(file.open());
+
+    QDataStream out(&file);
+    out << library;
+    file.close();
+
+    QList<Symbol> symbols = SymbolLibrary::readFlattenedSymbols(file.fileName());
+
+    addTime(timer);
+    QList<qint16> indexes = library.orderedIndexes();
+
+    QCOMPARE(symbols.count(), indexes.count());
+
+    for (int i = 0 ; i < indexes.count() ; ++i) {
+        QVERIFY2(symbols.at(i).hash() == library.flattenedSymbol(indexes.at(i)).hash(), qPrintable(QStringLiteral("symbol %1 differs").arg(indexes.at(i))));
+    }
+}
+
+
+void SerializationTest::revisionDelta_data()
+{
+    addCases();
+}
+
+
+/**
+ * Decode the revisions of the histories of the symbols from their deltas.
+ */
+void SerializationTest::revisionDelta()
+{
+    QFETCH(quint32, caseSeed);
+
+    SymbolLibrary library;
+    generate(library, caseSeed);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QMap<qint16, QList<Symbol> > decoded;
+
+    foreach (qint16 index, library.indexes()) {
+        SymbolHistory history = library.history(index);
+
+        for (int r = 0 ; r < history.count() ; ++r) {
+            decoded[index].append(history.revision(r));
+        }
+    }
+
+    addTime(timer);
+
+    foreach (qint16 index, library.indexes()) {
+        QList<Symbol> revisions = m_revisions.value(index);
+
+        QCOMPARE(decoded.value(index).count(), revisions.count());
+
+        for (int r = 0 ; r < revisions.count() ; ++r) {
+            QVERIFY2(decoded.value(index).at(r).hash() == revisions.at(r).hash(), qPrintable(QStringLiteral("revision %1 of symbol %2 differs").arg(r).arg(index)));
+        }
+    }
+}
+
+
+void SerializationTest::collection_data()
+{
+    addCases();
+}
+
+
+/**
+ * Save a library as a collection and open it again.
+ */
+void SerializationTest::collection()
+{
+    QFETCH(quint32, caseSeed);
+
+    SymbolLibrary library;
+    generate(library, caseSeed);
+
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QString fileName = directory.filePath(QStringLiteral("check.symc"));
+    library.saveCollection(fileName);
+
+    SymbolLibrary read;
+    read.openCollection(fileName);
+    read.loadAllShards();
+
+    addTime(timer);
+
+    QString failure = compare(library, read);
+    QVERIFY2(failure.isEmpty(), qPrintable(failure));
+}
+
+
+void SerializationTest::fileVersions_data()
+{
+    QTest::addColumn<qint32>("fileVersion");
+    QTest::addColumn<quint32>("caseSeed");
+
+    for (qint32 fileVersion = 101 ; fileVersion <= 103 ; ++fileVersion) {
+        for (int i = 0, count = cases() ; i < count ; ++i) {
+            QTest::addRow("version %d seed %u", fileVersion, seed + i) << fileVersion << quint32(seed + i);
+        }
+    }
+}
+
+
+/**
+ * Write libraries that an earlier version of the library file can hold and read them back.
+ * The version written must be the earliest that holds the library, 101 for a library without
+ * components, a display order or histories.
+ */
+void SerializationTest::fileVersions()
+{
+    QFETCH(qint32, fileVersion);
+    QFETCH(quint32, caseSeed);
+
+    SymbolLibrary library;
+    generate(library, caseSeed, fileVersion);
+
+    qint32 expectedVersion = library.displayOrder().isEmpty() ? 101 : 103;
+
+    if (expectedVersion == 101) {
+        foreach (qint16 index, library.indexes()) {
+            if (!library.symbol(index).components().isEmpty()) {
+                expectedVersion = 102;
+                break;
+            }
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QBuffer buffer;
+    buffer.open(QIODevice::ReadWrite);
+
+    QDataStream out(&buffer);
+    out << library;
+
+    buffer.seek(0);
+
+    QDataStream in(&buffer);
+    SymbolLibrary read;
+    in >> read;
+
+    addTime(timer);
+
+    QDataStream header(buffer.data().mid(15));
+    header.setVersion(QDataStream::Qt_4_0);
+    qint32 writtenVersion;
+    header >> writtenVersion;
+
+    QCOMPARE(writtenVersion, expectedVersion);
+    QVERIFY(writtenVersion <= fileVersion);
+
+    QString failure = compare(library, read);
+    QVERIFY2(failure.isEmpty(), qPrintable(failure));
+}
+
+
+void SerializationTest::fileVersion100_data()
+{
+    addCases();
+}
+
+
+/**
+ * Read a library file of version 100, which only holds the paths of the symbols and the last
+ * index used. The symbols read must have the paths with the default attributes.
+ */
+void SerializationTest::fileVersion100()
+{
+    QFETCH(quint32, caseSeed);
+
+    SymbolLibrary library;
+    generate(library, caseSeed, 101);
+
+    QMap<qint16, QPainterPath> paths;
+
+    foreach (qint16 index, library.indexes()) {
+        paths.insert(index, library.symbol(index).path());
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QBuffer buffer;
+    buffer.open(QIODevice::ReadWrite);
+
+    QDataStream out(&buffer);
+    out.writeRawData("KXStitchSymbols", 15);
+    out.setVersion(QDataStream::Qt_4_0);
+    out << qint32(100);
+    out << qint16(library.nextIndex() - 1);
+    out << paths;
+
+    buffer.seek(0);
+
+    QDataStream in(&buffer);
+    SymbolLibrary read;
+    in >> read;
+
+    addTime(timer);
+
+    QCOMPARE(read.nextIndex(), library.nextIndex());
+    QCOMPARE(read.indexes(), library.indexes());
+    QVERIFY(read.displayOrder().isEmpty());
+
+    foreach (qint16 index, library.indexes()) {
+        Symbol expected;
+        expected.setPath(paths.value(index));
+
+        QVERIFY2(read.symbol(index).hash() == expected.hash(), qPrintable(QStringLiteral("symbol %1 differs").arg(index)));
+        QVERIFY(read.history(index).isEmpty());
+    }
+}
+
+
+/**
+ * Write the default library as a library file and as a collection and read them back.
+ */
+void SerializationTest::defaultLibrary()
+{
+    SymbolLibrary library;
+    library.loadDefault();
+
+    QVERIFY(!library.indexes().isEmpty());
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QBuffer buffer;
+    buffer.open(QIODevice::ReadWrite);
+
+    QDataStream out(&buffer);
+    out << library;
+
+    buffer.seek(0);
+
+    QDataStream in(&buffer);
+    SymbolLibrary read;
+    in >> read;
+
+    addTime(timer);
+
+    QString failure = compare(library, read);
+    QVERIFY2(failure.isEmpty(), qPrintable(failure));
+
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+
+    QString fileName = directory.filePath(QStringLiteral("default.symc"));
+    library.saveCollection(fileName);
+
+    SymbolLibrary collection;
+    collection.openCollection(fileName);
+    collection.loadAllShards();
+
+    failure = compare(library, collection);
+    QVERIFY2(failure.isEmpty(), qPrintable(failure));
+}
+
+
+QTEST_MAIN(SerializationTest)
+
+#include "SerializationTest.moc"